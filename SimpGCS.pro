@@ -4,6 +4,10 @@ CONFIG  += qt
 QT      += core gui opengl sql svg network xml declarative
 QT      += printsupport widgets
 
+# instruments & map use devicePixelRatio (5.1), QImage::Format_RGBA8888 (5.2)
+lessThan(QT_MAJOR_VERSION, 5): error("SimpGCS needs Qt 5.2 or newer")
+equals(QT_MAJOR_VERSION, 5):lessThan(QT_MINOR_VERSION, 2): error("SimpGCS needs Qt 5.2 or newer")
+
 UI_DIR       = ./build
 MOC_DIR      = ./build
 OBJECTS_DIR  = ./build
@@ -14,8 +18,22 @@ SOURCES += \
     ./src/MapWidget.cpp \
     ./src/utils_UART.cpp \
     ./src/utils_GPS.cpp \
+    ./src/utils_geodesy.cpp \
     ./src/utils_mavlink.cpp \
+    ./src/utils_filter.cpp \
+    ./src/utils_format.cpp \
     ./src/UAS.cpp \
+    ./src/RenderScheduler.cpp \
+    ./src/TelemetryRelay.cpp \
+    ./src/TelemetryShm.cpp \
+    ./src/telemetry_shm.c \
+    ./src/MissionTransfer.cpp \
+    ./src/ParamManager.cpp \
+    ./src/StreamRate.cpp \
+    ./src/LinkStats.cpp \
+    ./src/MsgProfiler.cpp \
+    ./src/MsgProfilerWidget.cpp \
+    ./src/GeoFence.cpp \
     ./src/SimpGCS.cpp
 
 HEADERS += \
@@ -24,8 +42,23 @@ HEADERS += \
     ./src/MapWidget.h \
     ./src/utils_UART.h \
     ./src/utils_GPS.h \
+    ./src/utils_geodesy.h \
     ./src/utils_mavlink.h \
-    ./src/UAS.h
+    ./src/utils_filter.h \
+    ./src/utils_format.h \
+    ./src/UAS.h \
+    ./src/RenderScheduler.h \
+    ./src/TelemetryRelay.h \
+    ./src/TelemetryShm.h \
+    ./src/telemetry_shm.h \
+    ./src/MissionTransfer.h \
+    ./src/ParamManager.h \
+    ./src/StreamRate.h \
+    ./src/LinkStats.h \
+    ./src/MsgProfiler.h \
+    ./src/MsgProfilerWidget.h \
+    ./src/GeoFence.h \
+    ./src/utils_simlink.h
 
 
 ################################################################################
@@ -40,6 +73,21 @@ RTK_DIR = ./libs/rtk++
 INCLUDEPATH += $$RTK_DIR/include
 LIBS += $$RTK_DIR/lib/librtk_osa.a $$RTK_DIR/lib/librtk_utils.a
 
+# the libraries are not committed, rtk++ is rebuilt (incrementally) before SimpGCS
+rtk.target      = rtk
+rtk.commands    = $(MAKE) -C $$RTK_DIR/src
+QMAKE_EXTRA_TARGETS += rtk
+PRE_TARGETDEPS  += rtk
+
+# shm_open (shared-memory telemetry)
+LIBS += -lrt
+
+# zone tracing (-fn_trace), enable by: qmake "DEFINES+=RTK_TRACE"
+#DEFINES += RTK_TRACE
+
+# operator new counted for test_format / test_listmap_alloc (not for release builds)
+#DEFINES += SIMPGCS_ALLOC_COUNT
+
 ################################################################################
 # qglviewer
 ################################################################################
@@ -54,4 +102,9 @@ INCLUDEPATH +=  $$OPMAPCONTROL_DIR/core \
                 $$OPMAPCONTROL_DIR/internals \
                 $$OPMAPCONTROL_DIR/mapwidget
 LIBS        += $$OPMAPCONTROL_DIR/libopmapwidget.a
+
+opmap.target    = opmap
+opmap.commands  = cd $$OPMAPCONTROL_DIR && $(QMAKE) opmapcontrol.pro && $(MAKE)
+QMAKE_EXTRA_TARGETS += opmap
+PRE_TARGETDEPS  += opmap
 RESOURCES   += $$OPMAPCONTROL_DIR/mapwidget/mapresources.qrc
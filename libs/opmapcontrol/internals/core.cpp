@@ -26,6 +26,8 @@
 */
 #include "core.h"
 
+#include <rtk_trace.h>
+
 #ifdef DEBUG_CORE
 qlonglong internals::Core::debugcounter=0;
 #endif
@@ -66,6 +68,8 @@ namespace internals {
 
     void Core::run()
     {
+        RTK_TRACE_ZONE("Core::run");
+
         MrunningThreads.lock();
         ++runningThreads;
         MrunningThreads.unlock();
@@ -112,9 +116,14 @@ namespace internals {
                 qDebug()<<"task as value, begining get"<<" ID="<<debug;;
 #endif //DEBUG_CORE
                 {
-                    Tile* m = Matrix.TileAt(task.Pos);
+                    bool empty;
+                    {
+                        TileMatrix::ReadGuard guard(Matrix);
+                        Tile* m = Matrix.TileAt(task.Pos);
+                        empty = m==0 || m->Overlays.count() == 0;
+                    }
 
-                    if(m==0 || m->Overlays.count() == 0)
+                    if(empty)
                     {
 #ifdef DEBUG_CORE
                         qDebug()<<"Fill empty TileMatrix: " + task.ToString()<<" ID="<<debug;;
@@ -140,6 +149,7 @@ namespace internals {
 #ifdef DEBUG_CORE
                                     qDebug()<<"start getting image"<<" ID="<<debug;
 #endif //DEBUG_CORE
+                                    RTK_TRACE_ZONE("OPMaps::GetImageFrom");
                                     img = OPMaps::Instance()->GetImageFrom(tl, task.Pos, task.Zoom);
 #ifdef DEBUG_CORE
                                     qDebug()<<"Core::run:gotimage size:"<<img.count()<<" ID="<<debug<<" time="<<t.elapsed();
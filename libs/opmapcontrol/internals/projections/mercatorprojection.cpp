@@ -26,8 +26,83 @@
 */
 #include "mercatorprojection.h"
 #include <qmath.h>
- 
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 namespace projections {
+
+/*
+ * Batched projection: sin() and log() are replaced by polynomials that stay
+ * far below a pixel at zoom 22 (map size 2^30 px):
+ *
+ *  sin(x), |x| <= 1.4845 (85.05 deg): Taylor series to x^17, |err| < 2e-14
+ *  log(v) = e*ln2 + 2*atanh(t), t = (m-1)/(m+1), m in [sqrt(.5),sqrt(2)):
+ *      series to t^17, |err| < 2e-16
+ *
+ * SSE2 computes two points per step, the remaining point (and builds
+ * without SSE2) use sin() & log().
+ */
+#if defined(__SSE2__)
+static const double kSin3  = -1.0/6.0;
+static const double kSin5  =  1.0/120.0;
+static const double kSin7  = -1.0/5040.0;
+static const double kSin9  =  1.0/362880.0;
+static const double kSin11 = -1.0/39916800.0;
+static const double kSin13 =  1.0/6227020800.0;
+static const double kSin15 = -1.0/1307674368000.0;
+static const double kSin17 =  1.0/355687428096000.0;
+
+static const double kSqrt2 = 1.4142135623730951;
+static const double kLn2   = 0.6931471805599453;
+
+static inline __m128d FastSin2(__m128d x)
+{
+    __m128d x2=_mm_mul_pd(x,x);
+    __m128d p=_mm_set1_pd(kSin17);
+    p=_mm_add_pd(_mm_mul_pd(p,x2),_mm_set1_pd(kSin15));
+    p=_mm_add_pd(_mm_mul_pd(p,x2),_mm_set1_pd(kSin13));
+    p=_mm_add_pd(_mm_mul_pd(p,x2),_mm_set1_pd(kSin11));
+    p=_mm_add_pd(_mm_mul_pd(p,x2),_mm_set1_pd(kSin9));
+    p=_mm_add_pd(_mm_mul_pd(p,x2),_mm_set1_pd(kSin7));
+    p=_mm_add_pd(_mm_mul_pd(p,x2),_mm_set1_pd(kSin5));
+    p=_mm_add_pd(_mm_mul_pd(p,x2),_mm_set1_pd(kSin3));
+    return _mm_add_pd(x,_mm_mul_pd(_mm_mul_pd(x,x2),p));
+}
+
+static inline __m128d FastLog2(__m128d v)
+{
+    const __m128d one=_mm_set1_pd(1.0);
+    __m128i b=_mm_castpd_si128(v);
+
+    // exponent: the biased bits as the mantissa of 2^52, minus 2^52 + 1023
+    __m128i eb=_mm_or_si128(_mm_srli_epi64(b,52),_mm_set1_epi64x(0x4330000000000000LL));
+    __m128d e=_mm_sub_pd(_mm_castsi128_pd(eb),_mm_set1_pd(4503599627370496.0+1023.0));
+
+    __m128i mb=_mm_or_si128(_mm_and_si128(b,_mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                            _mm_set1_epi64x(0x3FF0000000000000LL));
+    __m128d m=_mm_castsi128_pd(mb);
+    __m128d big=_mm_cmpgt_pd(m,_mm_set1_pd(kSqrt2));
+    m=_mm_sub_pd(m,_mm_and_pd(big,_mm_mul_pd(m,_mm_set1_pd(0.5))));
+    e=_mm_add_pd(e,_mm_and_pd(big,one));
+
+    __m128d t=_mm_div_pd(_mm_sub_pd(m,one),_mm_add_pd(m,one));
+    __m128d t2=_mm_mul_pd(t,t);
+    __m128d p=_mm_set1_pd(1.0/17);
+    p=_mm_add_pd(_mm_mul_pd(p,t2),_mm_set1_pd(1.0/15));
+    p=_mm_add_pd(_mm_mul_pd(p,t2),_mm_set1_pd(1.0/13));
+    p=_mm_add_pd(_mm_mul_pd(p,t2),_mm_set1_pd(1.0/11));
+    p=_mm_add_pd(_mm_mul_pd(p,t2),_mm_set1_pd(1.0/9));
+    p=_mm_add_pd(_mm_mul_pd(p,t2),_mm_set1_pd(1.0/7));
+    p=_mm_add_pd(_mm_mul_pd(p,t2),_mm_set1_pd(1.0/5));
+    p=_mm_add_pd(_mm_mul_pd(p,t2),_mm_set1_pd(1.0/3));
+    p=_mm_add_pd(_mm_mul_pd(p,t2),one);
+
+    return _mm_add_pd(_mm_mul_pd(_mm_mul_pd(_mm_set1_pd(2.0),t),p),_mm_mul_pd(e,_mm_set1_pd(kLn2)));
+}
+#endif
+
 MercatorProjection::MercatorProjection():MinLatitude(-85.05112878), MaxLatitude(85.05112878),MinLongitude(-177),
 MaxLongitude(177), tileSize(256, 256)
 {
@@ -52,6 +127,55 @@ Point MercatorProjection::FromLatLngToPixel(double lat, double lng, const int &z
 
     return ret;
 }
+void MercatorProjection::FromLatLngToPixelBatch(const double *lat, const double *lng, int n, const int &zoom,
+                                                double *x, double *y)
+{
+    Size s = GetTileMatrixSizePixel(zoom);
+    double mapSizeX = s.Width();
+    double mapSizeY = s.Height();
+    double d2r = M_PI / 180;
+    double k4pi = 1 / (4 * M_PI);
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128d one    = _mm_set1_pd(1.0);
+    const __m128d latMin = _mm_set1_pd(MinLatitude), latMax = _mm_set1_pd(MaxLatitude);
+    const __m128d lngMin = _mm_set1_pd(MinLongitude), lngMax = _mm_set1_pd(MaxLongitude);
+    const __m128d zero   = _mm_setzero_pd();
+    const __m128d sx     = _mm_set1_pd(mapSizeX), sy = _mm_set1_pd(mapSizeY);
+    const __m128d xMax   = _mm_set1_pd(mapSizeX - 1), yMax = _mm_set1_pd(mapSizeY - 1);
+
+    for(; i + 2 <= n; i += 2)
+    {
+        __m128d la = _mm_min_pd(_mm_max_pd(_mm_loadu_pd(lat + i), latMin), latMax);
+        __m128d ln = _mm_min_pd(_mm_max_pd(_mm_loadu_pd(lng + i), lngMin), lngMax);
+
+        __m128d xx = _mm_mul_pd(_mm_mul_pd(_mm_add_pd(ln, _mm_set1_pd(180.0)), _mm_set1_pd(1.0 / 360)), sx);
+
+        __m128d sl = FastSin2(_mm_mul_pd(la, _mm_set1_pd(d2r)));
+        __m128d r  = _mm_div_pd(_mm_add_pd(one, sl), _mm_sub_pd(one, sl));
+        __m128d yy = _mm_sub_pd(_mm_set1_pd(0.5), _mm_mul_pd(FastLog2(r), _mm_set1_pd(k4pi)));
+        yy = _mm_mul_pd(yy, sy);
+
+        _mm_storeu_pd(x + i, _mm_min_pd(_mm_max_pd(xx, zero), xMax));
+        _mm_storeu_pd(y + i, _mm_min_pd(_mm_max_pd(yy, zero), yMax));
+    }
+#endif
+
+    for(; i < n; i++)
+    {
+        double la = Clip(lat[i], MinLatitude, MaxLatitude);
+        double ln = Clip(lng[i], MinLongitude, MaxLongitude);
+
+        double xx = (ln + 180.0) * (1.0 / 360) * mapSizeX;
+
+        double sl = sin(la * d2r);
+        double yy = (0.5 - log((1 + sl) / (1 - sl)) * k4pi) * mapSizeY;
+
+        x[i] = Clip(xx, 0, mapSizeX - 1);
+        y[i] = Clip(yy, 0, mapSizeY - 1);
+    }
+}
 internals::PointLatLng MercatorProjection::FromPixelToLatLng(const int &x, const int &y, const int &zoom)
 {
     internals::PointLatLng ret;// = internals::PointLatLng.Empty;
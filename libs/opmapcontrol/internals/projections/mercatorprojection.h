@@ -39,6 +39,8 @@ public:
     virtual double Axis() const;
     virtual double Flattening()const;
     virtual core::Point FromLatLngToPixel(double lat, double lng, int const& zoom);
+    virtual void FromLatLngToPixelBatch(const double *lat, const double *lng, int n, int const& zoom,
+                                        double *x, double *y);
     virtual internals::PointLatLng FromPixelToLatLng(const int &x,const int &y,const int &zoom);
     virtual  Size GetTileMatrixMinXY(const int &zoom);
     virtual  Size GetTileMatrixMaxXY(const int &zoom);
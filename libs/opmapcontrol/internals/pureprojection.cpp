@@ -50,6 +50,17 @@ Point PureProjection::FromLatLngToPixel(const PointLatLng &p,const int &zoom)
       }
 
 
+      void PureProjection::FromLatLngToPixelBatch(const double *lat, const double *lng, int n, const int &zoom,
+                                                  double *x, double *y)
+      {
+         for(int i=0;i<n;i++)
+         {
+            Point p=FromLatLngToPixel(lat[i], lng[i], zoom);
+            x[i]=p.X();
+            y[i]=p.Y();
+         }
+      }
+
      PointLatLng PureProjection::FromPixelToLatLng(const Point &p,const int &zoom)
       {
          return FromPixelToLatLng(p.X(), p.Y(), zoom);
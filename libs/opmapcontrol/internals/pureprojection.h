@@ -33,6 +33,7 @@
 #include "pointlatlng.h"
 #include "cmath"
 #include "rectlatlng.h"
+#include <QVector>
 
 using namespace core;
 
@@ -55,6 +56,16 @@ public:
     virtual QString Type(){return "PureProjection";}
     core::Point FromLatLngToPixel(const PointLatLng &p,const int &zoom);
 
+    /**
+    * @brief Projects n points given as separate lat/lng arrays (degrees)
+    *
+    *        The results are not rounded, FromLatLngToPixel(lat,lng,zoom)
+    *        equals ((int)(x+0.5),(int)(y+0.5)). Projections without a
+    *        batched version return the rounded scalar results.
+    */
+    virtual void FromLatLngToPixelBatch(const double *lat, const double *lng, int n, int const& zoom,
+                                        double *x, double *y);
+
     PointLatLng FromPixelToLatLng(const Point &p,const int &zoom);
     virtual core::Point FromPixelToTileXY(const core::Point &p);
     virtual core::Point FromTileXYToPixel(const core::Point &p);
@@ -102,6 +113,29 @@ protected:
     static qlonglong GetUTMzone(const double &lon);
 };
 
+
+/**
+* @brief Overlay coordinates in SoA layout, projected in one batch
+*/
+struct LatLngArray
+{
+    QVector<double> lat, lng;       ///< coordinates (degrees)
+    QVector<double> x, y;           ///< projected positions, filled by Project()
+
+    int Count()const{return lat.size();}
+    void Clear(){lat.clear();lng.clear();x.clear();y.clear();}
+    void Append(PointLatLng const& p){lat.append(p.Lat());lng.append(p.Lng());}
+    void Set(int const& i, PointLatLng const& p){lat[i]=p.Lat();lng[i]=p.Lng();}
+    PointLatLng At(int const& i)const{return PointLatLng(lat[i],lng[i]);}
+
+    void Project(PureProjection* projection, int const& zoom)
+    {
+        x.resize(lat.size());
+        y.resize(lat.size());
+        projection->FromLatLngToPixelBatch(lat.constData(),lng.constData(),lat.size(),zoom,x.data(),y.data());
+    }
+};
+
 }
 
 
@@ -0,0 +1,263 @@
+/**
+******************************************************************************
+*
+* @file       spatialindex.cpp
+* @brief      Lat/lng quadtree for map overlay culling and hit-testing
+* @see        The GNU Public License (GPL) Version 3
+* @defgroup   OPMapWidget
+* @{
+*
+*****************************************************************************/
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+* for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+#include "spatialindex.h"
+#include <math.h>
+
+namespace internals {
+
+SpatialIndex::SpatialIndex()
+{
+    Clear();
+}
+void SpatialIndex::Clear()
+{
+    Node root;
+    root.lat0=-90;
+    root.lng0=-180;
+    root.lat1=90;
+    root.lng1=180;
+    root.child=-1;
+    root.count=0;
+    nodes.clear();
+    nodes.append(root);
+    freeNodes.clear();
+    coords.clear();
+}
+int SpatialIndex::Quadrant(Node const& n,double lat,double lng)const
+{
+    return (lat>=(n.lat0+n.lat1)/2?2:0)|(lng>=(n.lng0+n.lng1)/2?1:0);
+}
+void SpatialIndex::Split(int node,int depth)
+{
+    int c;
+    if(!freeNodes.isEmpty())
+    {
+        c=freeNodes.last();
+        freeNodes.removeLast();
+    }
+    else
+    {
+        c=nodes.count();
+        nodes.resize(c+4);
+    }
+
+    Node& n=nodes[node];
+    double latm=(n.lat0+n.lat1)/2, lngm=(n.lng0+n.lng1)/2;
+    for(int q=0;q<4;q++)
+    {
+        Node& k=nodes[c+q];
+        k.lat0=q&2?latm:n.lat0;
+        k.lat1=q&2?n.lat1:latm;
+        k.lng0=q&1?lngm:n.lng0;
+        k.lng1=q&1?n.lng1:lngm;
+        k.child=-1;
+        k.count=0;
+        k.entries.clear();
+    }
+    n.child=c;
+    foreach(const Entry& e,n.entries)
+    {
+        Node& k=nodes[c+Quadrant(n,e.lat,e.lng)];
+        k.entries.append(e);
+        k.count++;
+    }
+    n.entries.clear();
+
+    // identical coordinates stop at MaxDepth
+    for(int q=0;q<4;q++)
+        if(nodes[c+q].count>Bucket && depth+1<MaxDepth)
+            Split(c+q,depth+1);
+}
+void SpatialIndex::Gather(int node,QVector<Entry>& list)const
+{
+    const Node& n=nodes[node];
+    if(n.child<0)
+    {
+        list+=n.entries;
+        return;
+    }
+    for(int q=0;q<4;q++)
+        Gather(n.child+q,list);
+}
+void SpatialIndex::Collapse(int node)
+{
+    Node& n=nodes[node];
+    QVector<Entry> list;
+    Gather(node,list);
+
+    // release the children blocks bottom up
+    QVector<int> stack;
+    stack.append(n.child);
+    while(!stack.isEmpty())
+    {
+        int c=stack.last();
+        stack.removeLast();
+        for(int q=0;q<4;q++)
+        {
+            if(nodes[c+q].child>=0)
+                stack.append(nodes[c+q].child);
+            nodes[c+q].entries.clear();
+        }
+        freeNodes.append(c);
+    }
+    n.child=-1;
+    n.entries=list;
+}
+void SpatialIndex::Insert(void* item,PointLatLng const& p)
+{
+    QHash<void*,PointLatLng>::iterator it=coords.find(item);
+    if(it!=coords.end())
+    {
+        if(it.value()==p)
+            return;
+        Remove(item);
+    }
+    coords.insert(item,p);
+
+    Entry e;
+    e.item=item;
+    e.lat=qBound(-90.0,p.Lat(),90.0);
+    e.lng=qBound(-180.0,p.Lng(),180.0);
+
+    int node=0,depth=0;
+    while(nodes[node].child>=0)
+    {
+        nodes[node].count++;
+        node=nodes[node].child+Quadrant(nodes[node],e.lat,e.lng);
+        depth++;
+    }
+    nodes[node].count++;
+    nodes[node].entries.append(e);
+    if(nodes[node].count>Bucket && depth<MaxDepth)
+        Split(node,depth);
+}
+bool SpatialIndex::Remove(void* item)
+{
+    QHash<void*,PointLatLng>::iterator it=coords.find(item);
+    if(it==coords.end())
+        return false;
+    double lat=qBound(-90.0,it.value().Lat(),90.0);
+    double lng=qBound(-180.0,it.value().Lng(),180.0);
+    coords.erase(it);
+
+    // the first node on the path small enough is merged back into a leaf
+    int node=0,merge=-1;
+    while(nodes[node].child>=0)
+    {
+        nodes[node].count--;
+        if(merge<0 && nodes[node].count<=Bucket/2)
+            merge=node;
+        node=nodes[node].child+Quadrant(nodes[node],lat,lng);
+    }
+    nodes[node].count--;
+    QVector<Entry>& list=nodes[node].entries;
+    for(int i=0;i<list.count();i++)
+    {
+        if(list[i].item==item)
+        {
+            list[i]=list.last();
+            list.removeLast();
+            break;
+        }
+    }
+    if(merge>=0)
+        Collapse(merge);
+    return true;
+}
+int SpatialIndex::Query(RectLatLng const& rect,QVector<void*>& list)const
+{
+    double lat0=rect.Bottom(), lat1=rect.Top();
+    double lng0=rect.Left(), lng1=rect.Right();
+    int n0=list.count();
+    QVector<int> stack;
+
+    if(lat0>lat1) qSwap(lat0,lat1);
+    if(lng0>lng1) qSwap(lng0,lng1);
+
+    stack.append(0);
+    while(!stack.isEmpty())
+    {
+        const Node& n=nodes[stack.last()];
+        stack.removeLast();
+        if(n.count==0 || n.lat0>lat1 || n.lat1<lat0 || n.lng0>lng1 || n.lng1<lng0)
+            continue;
+        if(n.child>=0)
+        {
+            for(int q=0;q<4;q++)
+                stack.append(n.child+q);
+            continue;
+        }
+        foreach(const Entry& e,n.entries)
+        {
+            if(e.lat>=lat0 && e.lat<=lat1 && e.lng>=lng0 && e.lng<=lng1)
+                list.append(e.item);
+        }
+    }
+    return list.count()-n0;
+}
+void* SpatialIndex::Nearest(PointLatLng const& p,double maxDist)const
+{
+    double kx=cos(p.Lat()*M_PI/180);
+    double best=maxDist*maxDist;
+    void* ret=0;
+    QVector<int> stack;
+
+    // depth first, nearest quadrant first, boxes farther than the best skipped
+    stack.append(0);
+    while(!stack.isEmpty())
+    {
+        const Node& n=nodes[stack.last()];
+        stack.removeLast();
+
+        double dx=p.Lng()<n.lng0?n.lng0-p.Lng():(p.Lng()>n.lng1?p.Lng()-n.lng1:0);
+        double dy=p.Lat()<n.lat0?n.lat0-p.Lat():(p.Lat()>n.lat1?p.Lat()-n.lat1:0);
+        if(n.count==0 || dx*dx*kx*kx+dy*dy>best)
+            continue;
+
+        if(n.child>=0)
+        {
+            int q=Quadrant(n,p.Lat(),p.Lng());
+            stack.append(n.child+(q^3));
+            stack.append(n.child+(q^1));
+            stack.append(n.child+(q^2));
+            stack.append(n.child+q);
+            continue;
+        }
+        foreach(const Entry& e,n.entries)
+        {
+            double ex=(e.lng-p.Lng())*kx, ey=e.lat-p.Lat();
+            double d=ex*ex+ey*ey;
+            if(d<=best)
+            {
+                best=d;
+                ret=e.item;
+            }
+        }
+    }
+    return ret;
+}
+
+}
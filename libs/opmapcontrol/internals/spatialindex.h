@@ -0,0 +1,98 @@
+/**
+******************************************************************************
+*
+* @file       spatialindex.h
+* @brief      Lat/lng quadtree for map overlay culling and hit-testing
+* @see        The GNU Public License (GPL) Version 3
+* @defgroup   OPMapWidget
+* @{
+*
+*****************************************************************************/
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+* for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+#ifndef SPATIALINDEX_H
+#define SPATIALINDEX_H
+
+#include <QHash>
+#include <QVector>
+#include "pointlatlng.h"
+#include "rectlatlng.h"
+
+namespace internals {
+
+/**
+* @brief Lat/lng point index for map overlay items (bucket quadtree)
+*
+* Items are opaque pointers registered with one coordinate; registering an
+* item again moves it. Viewport and nearest queries only descend into the
+* quadrants they touch, O(log n + k) for k results, so the map projects
+* and hit-tests the items in view instead of all of them.
+*/
+class SpatialIndex
+{
+public:
+    SpatialIndex();
+    /**
+    * @brief Adds item at p, or moves it there if already registered
+    */
+    void Insert(void* item,PointLatLng const& p);
+    bool Remove(void* item);
+    void Clear();
+    int Count()const{return coords.count();}
+    bool Contains(void* item)const{return coords.contains(item);}
+    PointLatLng Coord(void* item)const{return coords.value(item);}
+    /**
+    * @brief Appends the items inside rect to list
+    *
+    * @return number of items appended
+    */
+    int Query(RectLatLng const& rect,QVector<void*>& list)const;
+    /**
+    * @brief Returns the item closest to p, 0 if none within maxDist
+    *
+    * @param maxDist distance in degrees of latitude (longitude scaled by cos(lat))
+    */
+    void* Nearest(PointLatLng const& p,double maxDist=360)const;
+    /**
+    * @brief Quadtree nodes in use (for diagnostics)
+    */
+    int Nodes()const{return nodes.count()-freeNodes.count()*4;}
+protected:
+    enum { Bucket = 16, MaxDepth = 30 };
+    struct Entry
+    {
+        void* item;
+        double lat,lng;
+    };
+    struct Node
+    {
+        double lat0,lng0,lat1,lng1;
+        int child;                  ///< first of 4 children, -1 for a leaf
+        int count;                  ///< items in the subtree
+        QVector<Entry> entries;     ///< leaf items
+    };
+    int Quadrant(Node const& n,double lat,double lng)const;
+    void Split(int node,int depth);
+    void Collapse(int node);
+    void Gather(int node,QVector<Entry>& list)const;
+
+    QVector<Node> nodes;
+    QVector<int> freeNodes;         ///< unused blocks of 4 children
+    QHash<void*,PointLatLng> coords;
+};
+
+}
+#endif // SPATIALINDEX_H
@@ -28,18 +28,132 @@
 
  
 namespace internals {
+const qint64 TileMatrix::EmptyKey=Q_INT64_C(0x7fffffffffffffff);
+
 TileMatrix::TileMatrix()
 {
+    table.storeRelease(NewTable(0));
+    epoch.storeRelease(0);
+}
+TileMatrix::~TileMatrix()
+{
+    Free(pending[0]);
+    Free(pending[1]);
+    Table* t=table.loadAcquire();
+    for(int i=0;i<=t->mask;i++)
+        delete t->slots[i].tile;
+    delete[] t->slots;
+    delete t;
+}
+TileMatrix::Table* TileMatrix::NewTable(int n)
+{
+    int cap=16;
+    while(cap<2*n) cap<<=1;
+    Table* t=new Table;
+    t->mask=cap-1;
+    t->count=0;
+    t->slots=new Slot[cap];
+    for(int i=0;i<cap;i++)
+    {
+        t->slots[i].key=EmptyKey;
+        t->slots[i].tile=0;
+    }
+    return t;
+}
+static inline int SlotOf(qint64 key,int mask)
+{
+    quint64 h=(quint64)key*Q_UINT64_C(0x9E3779B97F4A7C15);
+    return (int)(h>>32)&mask;
+}
+Tile* TileMatrix::Find(const Table* t,qint64 key)
+{
+    for(int i=SlotOf(key,t->mask);;i=(i+1)&t->mask)
+    {
+        const Slot& s=t->slots[i];
+        if(s.key==key) return s.tile;
+        if(s.key==EmptyKey) return 0;
+    }
+}
+void TileMatrix::Insert(Table* t,qint64 key,Tile* tile)
+{
+    for(int i=SlotOf(key,t->mask);;i=(i+1)&t->mask)
+    {
+        Slot& s=t->slots[i];
+        if(s.key==EmptyKey)
+        {
+            s.key=key;
+            s.tile=tile;
+            t->count++;
+            return;
+        }
+    }
+}
+
+TileMatrix::ReadGuard::ReadGuard(TileMatrix& m):matrix(m)
+{
+    // register in the current epoch, retry if a writer advanced it meanwhile
+    for(;;)
+    {
+        epoch=matrix.epoch.loadAcquire();
+        matrix.readers[epoch&1].fetchAndAddOrdered(1);
+        if(matrix.epoch.fetchAndAddOrdered(0)==epoch) break;
+        matrix.readers[epoch&1].fetchAndAddOrdered(-1);
+    }
+}
+TileMatrix::ReadGuard::~ReadGuard()
+{
+    matrix.readers[epoch&1].fetchAndAddRelease(-1);
+}
+
+void TileMatrix::Retire(Table* t,Tile* tile)
+{
+    Retired r;
+    r.table=t;
+    r.tile=tile;
+    pending[epoch.loadAcquire()&1].append(r);
+}
+void TileMatrix::Free(QList<Retired>& list)
+{
+    foreach(const Retired& r,list)
+    {
+        if(r.table)
+        {
+            delete[] r.table->slots;
+            delete r.table;
+        }
+        delete r.tile;
+    }
+    list.clear();
+}
+void TileMatrix::Reclaim()
+{
+    // what was retired in epoch e-1 is unreachable for readers of e and
+    // later, free it and advance once the readers of e-1 have left
+    int e=epoch.loadAcquire();
+    if(readers[(e+1)&1].fetchAndAddOrdered(0)!=0) return;
+    Free(pending[(e+1)&1]);
+    epoch.fetchAndAddOrdered(1);
+}
+
+int TileMatrix::retired()
+{
+    mutex.lock();
+    int n=pending[0].count()+pending[1].count();
+    mutex.unlock();
+    return n;
 }
 void TileMatrix::Clear()
 {
     mutex.lock();
-    foreach(Tile* t,matrix.values())
+    Table* old=table.loadAcquire();
+    table.storeRelease(NewTable(0));
+    for(int i=0;i<=old->mask;i++)
     {
-        delete t;
-        t=0;
+        if(old->slots[i].tile)
+            Retire(0,old->slots[i].tile);
     }
-    matrix.clear();
+    Retire(old,0);
+    Reclaim();
     mutex.unlock();
 }
 //void TileMatrix::RebuildToUpperZoom()
@@ -99,30 +213,34 @@ void TileMatrix::Clear()
 
 void TileMatrix::ClearPointsNotIn(QList<Point>list)
 {
-    removals.clear();
     mutex.lock();
-    foreach(Point p, matrix.keys())
+    Table* old=table.loadAcquire();
+    Table* t=NewTable(list.count());
+    foreach(const Point& p,list)
     {
-        if(!list.contains(p))
-        {
-            removals.append(p);
-        }
+        qint64 key=Key(p);
+        Tile* tile=Find(old,key);
+        if(tile!=0 && Find(t,key)==0)
+            Insert(t,key,tile);
     }
-    mutex.unlock();
-    foreach(Point p,removals)
+    if(t->count==old->count)
     {
-        Tile* t=TileAt(p);
-        if(t!=0)
-        {
-            mutex.lock();
-            delete t;
-            t=0;
-            matrix.remove(p);
-            mutex.unlock();
-        }
-
+        // nothing to evict
+        delete[] t->slots;
+        delete t;
+        mutex.unlock();
+        return;
+    }
+    table.storeRelease(t);
+    for(int i=0;i<=old->mask;i++)
+    {
+        const Slot& s=old->slots[i];
+        if(s.tile!=0 && Find(t,s.key)==0)
+            Retire(0,s.tile);
     }
-    removals.clear();
+    Retire(old,0);
+    Reclaim();
+    mutex.unlock();
 }
 Tile* TileMatrix::TileAt(const Point &p)
 {
@@ -130,19 +248,29 @@ Tile* TileMatrix::TileAt(const Point &p)
 #ifdef DEBUG_TILEMATRIX
     qDebug()<<"TileMatrix:TileAt:"<<p.ToString();
 #endif //DEBUG_TILEMATRIX
-    Tile* ret;
-    mutex.lock();
-    ret=matrix.value(p,0);
-    mutex.unlock();
-    return ret;
+    return Find(table.loadAcquire(),Key(p));
 }
 void TileMatrix::SetTileAt(const Point &p, Tile* tile)
 {
     mutex.lock();
-    Tile* t=matrix.value(p,0);
-    if(t!=0)
-        delete t;
-    matrix.insert(p,tile);
+    Table* old=table.loadAcquire();
+    Table* t=NewTable(old->count+1);
+    qint64 key=Key(p);
+    Tile* prev=0;
+    for(int i=0;i<=old->mask;i++)
+    {
+        const Slot& s=old->slots[i];
+        if(s.key==EmptyKey) continue;
+        if(s.key==key) prev=s.tile;
+        else Insert(t,s.key,s.tile);
+    }
+    if(tile!=0)
+        Insert(t,key,tile);
+    table.storeRelease(t);
+    if(prev!=0 && prev!=tile)
+        Retire(0,prev);
+    Retire(old,0);
+    Reclaim();
     mutex.unlock();
 }
 }
@@ -27,26 +27,86 @@
 #ifndef TILEMATRIX_H
 #define TILEMATRIX_H
 
-#include <QHash>
 #include "tile.h"
 #include <QList>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QAtomicPointer>
 #include "../core/point.h"
 #include "debugheader.h"
 #include <QBuffer>
 namespace internals {
+
+/**
+* @brief Tiles of the current view, keyed by tile position
+*
+* The tiles live in a flat open-addressing table (linear probing, at most
+* half full). Writers (the loader threads) serialize on the mutex, build a
+* new table and publish it with one pointer store, so TileAt() never
+* locks: the paint code looks tiles up while the loaders add and evict.
+*
+* Replaced tables and tiles are retired and freed once no reader can
+* still hold them (two-epoch reclamation). Tile pointers obtained from
+* TileAt() are valid while a ReadGuard is alive.
+*/
 class TileMatrix
 {
 public:
     TileMatrix();
+    ~TileMatrix();
     void Clear();
+    /**
+    * @brief Evicts every tile whose position is not in list, O(count + list)
+    */
     void ClearPointsNotIn(QList<core::Point> list);
     Tile* TileAt(const core::Point &p);
     void SetTileAt(const core::Point &p,Tile* tile);
-    int count()const{return matrix.count();}
+    int count()const{return table.loadAcquire()->count;}
+    /**
+    * @brief Number of retired tables and tiles not freed yet
+    */
+    int retired();
+
+    class ReadGuard
+    {
+    public:
+        ReadGuard(TileMatrix& m);
+        ~ReadGuard();
+    private:
+        TileMatrix& matrix;
+        int epoch;
+    };
    // void RebuildToUpperZoom();
 protected:
-    QHash<core::Point,Tile*> matrix;
-    QList<core::Point> removals;
+    struct Slot
+    {
+        qint64 key;
+        Tile* tile;
+    };
+    struct Table
+    {
+        int mask;
+        int count;
+        Slot* slots;
+    };
+    static const qint64 EmptyKey;
+    static qint64 Key(const core::Point &p){return ((qint64)p.X()<<32)|(quint32)p.Y();}
+    static Table* NewTable(int n);
+    static Tile* Find(const Table* t,qint64 key);
+    static void Insert(Table* t,qint64 key,Tile* tile);
+    struct Retired
+    {
+        Table* table;
+        Tile* tile;
+    };
+    void Retire(Table* t,Tile* tile);
+    void Reclaim();
+    void Free(QList<Retired>& list);
+
+    QAtomicPointer<Table> table;
+    QAtomicInt epoch;
+    QAtomicInt readers[2];
+    QList<Retired> pending[2];
     QMutex mutex;
 };
 
@@ -0,0 +1,320 @@
+/**
+******************************************************************************
+*
+* @file       glmapcompositor.cpp
+* @brief      Draws the map tiles with OpenGL from a texture atlas
+* @see        The GNU Public License (GPL) Version 3
+* @defgroup   OPMapWidget
+* @{
+*
+*****************************************************************************/
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+* for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+#include "glmapcompositor.h"
+#include <string.h>
+#include <QPaintEngine>
+#include <QImage>
+#include <QDebug>
+
+#include <rtk_trace.h>
+
+namespace mapcontrol
+{
+static const char* vertexShader =
+        "attribute highp vec4 vertex;\n"
+        "uniform highp mat4 matrix;\n"
+        "varying highp vec2 texc;\n"
+        "void main(void)\n"
+        "{\n"
+        "    gl_Position = matrix * vec4(vertex.xy, 0.0, 1.0);\n"
+        "    texc = vertex.zw;\n"
+        "}\n";
+
+static const char* fragmentShader =
+        "uniform sampler2D tex;\n"
+        "varying highp vec2 texc;\n"
+        "void main(void)\n"
+        "{\n"
+        "    gl_FragColor = texture2D(tex, texc);\n"
+        "}\n";
+
+GLMapCompositor::GLMapCompositor(int atlasSize, int tileSize):context(0),
+    program(0),
+    texture(0),
+    atlasSize(atlasSize),
+    tileSize(tileSize),
+    slotsPerRow(0),
+    batch(1),
+    useCounter(0),
+    nUpload(0),
+    nBatch(0),
+    failed(false),
+    active(false)
+{
+}
+GLMapCompositor::~GLMapCompositor()
+{
+    // GL objects die with the context if it is not current
+    if(context!=0 && QOpenGLContext::currentContext()==context)
+        Release();
+    delete program;
+}
+bool GLMapCompositor::IsGLPainter(QPainter* painter)
+{
+    if(painter==0 || painter->paintEngine()==0)
+        return false;
+
+    QPaintEngine::Type t=painter->paintEngine()->type();
+    return t==QPaintEngine::OpenGL2 || t==QPaintEngine::OpenGL;
+}
+bool GLMapCompositor::Begin(QPainter* painter)
+{
+    if(failed || !IsGLPainter(painter))
+        return false;
+
+    painter->beginNativePainting();
+
+    // viewport widget was replaced: resources belong to the old context
+    if(context!=QOpenGLContext::currentContext())
+    {
+        if(context!=0)
+        {
+            delete program;
+            program=0;
+            texture=0;
+            Clear();
+        }
+        context=QOpenGLContext::currentContext();
+        if(context==0 || !Init())
+        {
+            qDebug()<<"GLMapCompositor: OpenGL setup failed, using QPainter";
+            failed=true;
+            context=0;
+            painter->endNativePainting();
+            return false;
+        }
+    }
+
+    // painter coordinates -> clip space
+    QPaintDevice* dev=painter->device();
+    matrix.setToIdentity();
+    matrix.ortho(0,dev->width(),dev->height(),0,-1,1);
+    matrix*=QMatrix4x4(painter->combinedTransform());
+
+    vertices.resize(0);
+    active=true;
+    return true;
+}
+bool GLMapCompositor::Init()
+{
+    gl.initializeOpenGLFunctions();
+
+    GLint maxSize=0;
+    gl.glGetIntegerv(GL_MAX_TEXTURE_SIZE,&maxSize);
+    if(maxSize<tileSize)
+        return false;
+    while(atlasSize>maxSize)
+        atlasSize/=2;
+    if(atlasSize<tileSize)
+        atlasSize=tileSize;
+
+    program=new QOpenGLShaderProgram;
+    program->addShaderFromSourceCode(QOpenGLShader::Vertex,vertexShader);
+    program->addShaderFromSourceCode(QOpenGLShader::Fragment,fragmentShader);
+    program->bindAttributeLocation("vertex",0);
+    if(!program->link())
+    {
+        qDebug()<<"GLMapCompositor:"<<program->log();
+        delete program;
+        program=0;
+        return false;
+    }
+
+    gl.glGenTextures(1,&texture);
+    gl.glBindTexture(GL_TEXTURE_2D,texture);
+    gl.glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_LINEAR);
+    gl.glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_LINEAR);
+    gl.glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+    gl.glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+    gl.glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA,atlasSize,atlasSize,0,GL_RGBA,GL_UNSIGNED_BYTE,0);
+    gl.glBindTexture(GL_TEXTURE_2D,0);
+    if(gl.glGetError()!=GL_NO_ERROR)
+    {
+        Release();
+        delete program;
+        program=0;
+        return false;
+    }
+
+    slotsPerRow=atlasSize/tileSize;
+    atlasSlots.resize(slotsPerRow*slotsPerRow);
+    Clear();
+    return true;
+}
+void GLMapCompositor::Release()
+{
+    if(texture!=0)
+        gl.glDeleteTextures(1,&texture);
+    texture=0;
+}
+void GLMapCompositor::Clear()
+{
+    for(int i=0;i<atlasSlots.size();++i)
+    {
+        atlasSlots[i].key=0;
+        atlasSlots[i].data=0;
+        atlasSlots[i].size=0;
+        atlasSlots[i].batch=0;
+        atlasSlots[i].lastUse=0;
+    }
+    slotOf.clear();
+}
+int GLMapCompositor::SlotFor(quint64 const& key, QByteArray const& img)
+{
+    QHash<quint64,int>::const_iterator it=slotOf.constFind(key);
+    int s=-1;
+
+    if(it!=slotOf.constEnd())
+    {
+        s=it.value();
+        // same tile data: no upload
+        if(atlasSlots[s].data==img.constData() && atlasSlots[s].size==img.size())
+        {
+            atlasSlots[s].batch=batch;
+            atlasSlots[s].lastUse=++useCounter;
+            return s;
+        }
+    }
+    else
+    {
+        // least recently used slot not drawn by the current batch
+        for(int k=0;k<2 && s<0;++k)
+        {
+            quint64 oldest=0;
+            for(int i=0;i<atlasSlots.size();++i)
+            {
+                if(atlasSlots[i].batch==batch)
+                    continue;
+                if(s<0 || atlasSlots[i].lastUse<oldest)
+                {
+                    s=i;
+                    oldest=atlasSlots[i].lastUse;
+                }
+            }
+            // every slot is used by this batch: draw it & start a new one
+            if(s<0)
+                Flush();
+        }
+        if(s<0)
+            return -1;
+        if(atlasSlots[s].data!=0)
+            slotOf.remove(atlasSlots[s].key);
+        slotOf.insert(key,s);
+    }
+
+    QImage im=QImage::fromData(img);
+    if(im.isNull())
+    {
+        slotOf.remove(key);
+        atlasSlots[s].data=0;
+        return -1;
+    }
+    if(im.width()!=tileSize || im.height()!=tileSize)
+        im=im.scaled(tileSize,tileSize,Qt::IgnoreAspectRatio,Qt::SmoothTransformation);
+    im=im.convertToFormat(QImage::Format_RGBA8888);
+
+    gl.glBindTexture(GL_TEXTURE_2D,texture);
+    gl.glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+    gl.glTexSubImage2D(GL_TEXTURE_2D,0,(s%slotsPerRow)*tileSize,(s/slotsPerRow)*tileSize,
+                       tileSize,tileSize,GL_RGBA,GL_UNSIGNED_BYTE,im.constBits());
+    nUpload++;
+
+    atlasSlots[s].key=key;
+    atlasSlots[s].data=img.constData();
+    atlasSlots[s].size=img.size();
+    atlasSlots[s].batch=batch;
+    atlasSlots[s].lastUse=++useCounter;
+    return s;
+}
+void GLMapCompositor::AddTile(core::Point const& tile, int const& zoom, int const& layer,
+                              QByteArray const& img, QRectF const& rect)
+{
+    if(!active || img.isEmpty())
+        return;
+
+    quint64 key=((quint64)(zoom&0x3f)<<58)|((quint64)(layer&0x3)<<56)|
+                ((quint64)(tile.X()&0xfffffff)<<28)|(quint64)(tile.Y()&0xfffffff);
+    int s=SlotFor(key,img);
+    if(s<0)
+        return;
+
+    // half texel inset, no bleeding from the neighbour atlasSlots
+    GLfloat t=1.0f/atlasSize;
+    GLfloat u0=((s%slotsPerRow)*tileSize+0.5f)*t;
+    GLfloat v0=((s/slotsPerRow)*tileSize+0.5f)*t;
+    GLfloat u1=u0+(tileSize-1)*t;
+    GLfloat v1=v0+(tileSize-1)*t;
+    GLfloat x0=rect.left(),y0=rect.top(),x1=rect.right(),y1=rect.bottom();
+
+    GLfloat q[24]={x0,y0,u0,v0, x1,y0,u1,v0, x1,y1,u1,v1,
+                   x0,y0,u0,v0, x1,y1,u1,v1, x0,y1,u0,v1};
+    int n=vertices.size();
+    vertices.resize(n+24);
+    memcpy(vertices.data()+n,q,sizeof(q));
+}
+void GLMapCompositor::Flush()
+{
+    if(vertices.isEmpty())
+    {
+        batch++;
+        return;
+    }
+
+    RTK_TRACE_ZONE("GLMapCompositor::Flush");
+
+    gl.glBindBuffer(GL_ARRAY_BUFFER,0);
+    gl.glEnable(GL_BLEND);
+    gl.glBlendFunc(GL_SRC_ALPHA,GL_ONE_MINUS_SRC_ALPHA);
+    gl.glDisable(GL_DEPTH_TEST);
+    gl.glActiveTexture(GL_TEXTURE0);
+    gl.glBindTexture(GL_TEXTURE_2D,texture);
+
+    program->bind();
+    program->setUniformValue("matrix",matrix);
+    program->setUniformValue("tex",0);
+    program->enableAttributeArray(0);
+    program->setAttributeArray(0,GL_FLOAT,vertices.constData(),4);
+
+    gl.glDrawArrays(GL_TRIANGLES,0,vertices.size()/4);
+
+    program->disableAttributeArray(0);
+    program->release();
+    gl.glBindTexture(GL_TEXTURE_2D,0);
+
+    vertices.resize(0);
+    batch++;
+    nBatch++;
+}
+void GLMapCompositor::End(QPainter* painter)
+{
+    if(!active)
+        return;
+
+    Flush();
+    active=false;
+    painter->endNativePainting();
+}
+}
@@ -0,0 +1,144 @@
+/**
+******************************************************************************
+*
+* @file       glmapcompositor.h
+* @brief      Draws the map tiles with OpenGL from a texture atlas
+* @see        The GNU Public License (GPL) Version 3
+* @defgroup   OPMapWidget
+* @{
+*
+*****************************************************************************/
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+* for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+#ifndef GLMAPCOMPOSITOR_H
+#define GLMAPCOMPOSITOR_H
+
+#include <QPainter>
+#include <QByteArray>
+#include <QRectF>
+#include <QHash>
+#include <QVector>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QMatrix4x4>
+#include "../core/point.h"
+
+namespace mapcontrol
+{
+    /**
+    * @brief Draws map tiles through native OpenGL painting
+    *
+    *        Decoded tiles are kept in one atlas texture (LRU slots, keyed by
+    *        tile/zoom/layer, re-uploaded if the tile data changes). The tiles
+    *        of a frame are drawn as one batch of textured quads with the
+    *        painter transform, so rotation and zoom animation run on the GL
+    *        side. Begin() returns false if the painter is not an OpenGL one or
+    *        GL setup failed, the caller then draws with QPainter.
+    *
+    * @class GLMapCompositor glmapcompositor.h "mapwidget/glmapcompositor.h"
+    */
+    class GLMapCompositor
+    {
+    public:
+        /**
+        * @brief Constructer
+        *
+        * @param atlasSize atlas texture size (clamped to GL_MAX_TEXTURE_SIZE)
+        * @param tileSize tile size in pixels
+        */
+        GLMapCompositor(int atlasSize=4096, int tileSize=256);
+        ~GLMapCompositor();
+
+        /**
+        * @brief Returns true if the painter draws with OpenGL
+        */
+        static bool IsGLPainter(QPainter* painter);
+
+        /**
+        * @brief Starts native painting
+        *
+        * @return false if GL can not be used, nothing is started then
+        */
+        bool Begin(QPainter* painter);
+        /**
+        * @brief Adds a tile layer to the batch (between Begin & End)
+        *
+        * @param tile tile position
+        * @param zoom zoom level
+        * @param layer overlay index of the tile
+        * @param img encoded tile image
+        * @param rect tile rectangle in painter coordinates
+        */
+        void AddTile(core::Point const& tile, int const& zoom, int const& layer,
+                     QByteArray const& img, QRectF const& rect);
+        /**
+        * @brief Draws the remaining batch & ends native painting
+        */
+        void End(QPainter* painter);
+
+        /**
+        * @brief Drops all cached tiles
+        */
+        void Clear();
+
+        /**
+        * @brief GL setup failed, the raster path is used
+        */
+        bool IsFailed()const{return failed;}
+
+        int SlotCount()const{return atlasSlots.size();}
+        quint64 Uploads()const{return nUpload;}
+        quint64 Batches()const{return nBatch;}
+
+    private:
+        struct Slot
+        {
+            quint64     key;
+            const char* data;           ///< tile data the slot holds
+            int         size;
+            quint64     batch;          ///< last batch using the slot
+            quint64     lastUse;
+        };
+
+        bool Init();
+        void Release();
+        int  SlotFor(quint64 const& key, QByteArray const& img);
+        void Flush();
+
+        QOpenGLContext*         context;
+        QOpenGLFunctions        gl;
+        QOpenGLShaderProgram*   program;
+        GLuint                  texture;
+
+        int atlasSize;
+        int tileSize;
+        int slotsPerRow;
+        QVector<Slot> atlasSlots;
+        QHash<quint64,int> slotOf;
+
+        QVector<GLfloat> vertices;      ///< x, y, u, v for each vertex
+        QMatrix4x4 matrix;
+
+        quint64 batch;
+        quint64 useCounter;
+        quint64 nUpload;
+        quint64 nBatch;
+        bool failed;
+        bool active;
+    };
+}
+#endif // GLMAPCOMPOSITOR_H
@@ -83,10 +83,7 @@ void GPSItem::SetUAVPos(const internals::PointLatLng &position, const int &altit
         {
             if(timer.elapsed()>trailtime*1000)
             {
-                trail->addToGroup(new TrailItem(position,altitude,Qt::green,this));
-                if(!lasttrailline.IsEmpty())
-                    trailLine->addToGroup((new TrailLineItem(lasttrailline,position,Qt::green,map)));
-                lasttrailline=position;
+                AddTrailPoint(position,altitude);
                 timer.restart();
             }
 
@@ -95,11 +92,7 @@ void GPSItem::SetUAVPos(const internals::PointLatLng &position, const int &altit
         {
             if(qAbs(internals::PureProjection::DistanceBetweenLatLng(lastcoord,position)*1000)>traildistance)
             {
-                trail->addToGroup(new TrailItem(position,altitude,Qt::green,this));
-                if(!lasttrailline.IsEmpty())
-
-                    trailLine->addToGroup((new TrailLineItem(lasttrailline,position,Qt::green,this)));
-                lasttrailline=position;
+                AddTrailPoint(position,altitude);
                 lastcoord=position;
             }
         }
@@ -178,18 +171,34 @@ void GPSItem::RefreshPos()
 {
     localposition=map->FromLatLngToLocal(coord);
     this->setPos(localposition.X(),localposition.Y());
-    foreach(QGraphicsItem* i,trail->childItems())
-    {
-        TrailItem* w=qgraphicsitem_cast<TrailItem*>(i);
-        if(w)
-            w->setPos(map->FromLatLngToLocal(w->coord).X(),map->FromLatLngToLocal(w->coord).Y());
-    }
-    foreach(QGraphicsItem* i,trailLine->childItems())
+
+    // trail dots & line ends are projected in one batch each
+    map->FromLatLngToLocal(trailcoords);
+    for(int i=0;i<trailitems.size();i++)
+        trailitems[i]->setPos(trailcoords.x[i],trailcoords.y[i]);
+
+    map->FromLatLngToLocal(traillinecoords);
+    for(int i=0;i<traillineitems.size();i++)
+        traillineitems[i]->setLine(traillinecoords.x[2*i],traillinecoords.y[2*i],
+                                   traillinecoords.x[2*i+1],traillinecoords.y[2*i+1]);
+}
+
+void GPSItem::AddTrailPoint(internals::PointLatLng const& position, int const& altitude)
+{
+    TrailItem* t=new TrailItem(position,altitude,Qt::green,this);
+    trail->addToGroup(t);
+    trailitems.append(t);
+    trailcoords.Append(position);
+
+    if(!lasttrailline.IsEmpty())
     {
-        TrailLineItem* ww=qgraphicsitem_cast<TrailLineItem*>(i);
-        if(ww)
-            ww->setLine(map->FromLatLngToLocal(ww->coord1).X(),map->FromLatLngToLocal(ww->coord1).Y(),map->FromLatLngToLocal(ww->coord2).X(),map->FromLatLngToLocal(ww->coord2).Y());
+        TrailLineItem* l=new TrailLineItem(lasttrailline,position,Qt::green,map);
+        trailLine->addToGroup(l);
+        traillineitems.append(l);
+        traillinecoords.Append(lasttrailline);
+        traillinecoords.Append(position);
     }
+    lasttrailline=position;
 }
 
 void GPSItem::SetTrailType(const UAVTrailType::Types &value)
@@ -218,6 +227,11 @@ void GPSItem::DeleteTrail()const
         delete i;
     foreach(QGraphicsItem* i,trailLine->childItems())
         delete i;
+
+    trailitems.clear();
+    traillineitems.clear();
+    trailcoords.Clear();
+    traillinecoords.Clear();
 }
 
 double GPSItem::Distance3D(const internals::PointLatLng &coord, const int &altitude)
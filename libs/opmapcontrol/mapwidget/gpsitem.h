@@ -207,6 +207,10 @@ namespace mapcontrol
         QGraphicsItemGroup* trail;
         QGraphicsItemGroup * trailLine;
         internals::PointLatLng lasttrailline;
+        mutable QVector<TrailItem*> trailitems;
+        mutable QVector<TrailLineItem*> traillineitems;
+        mutable internals::LatLngArray trailcoords;         ///< trail dots (SoA)
+        mutable internals::LatLngArray traillinecoords;     ///< trail line ends, 2 per line
         QTime timer;
         bool showtrail;
         bool showtrailline;
@@ -214,6 +218,7 @@ namespace mapcontrol
         int traildistance;
         bool autosetreached;
         double Distance3D(internals::PointLatLng const& coord, int const& altitude);
+        void AddTrailPoint(internals::PointLatLng const& position, int const& altitude);
         double autosetdistance;
       //  QRectF rect;
 
@@ -31,8 +31,11 @@
 #include "homeitem.h"
 #include "mapgraphicitem.h"
 #include "waypointlineitem.h"
+#include "glmapcompositor.h"
 #include <QGraphicsSceneMouseEvent>
 
+#include <rtk_trace.h>
+
 namespace mapcontrol
 {
 MapGraphicItem::MapGraphicItem(internals::Core *core, Configuration *configuration):core(core),
@@ -43,7 +46,9 @@ MapGraphicItem::MapGraphicItem(internals::Core *core, Configuration *configurati
     zoomReal(0),
     rotation(0),
     zoomDigi(0),
-    isSelected(false)
+    isSelected(false),
+    useGLCompositor(false),
+    glCompositor(0)
 {
     dragons.load(QString::fromUtf8(":/markers/images/dragons1.jpg"));
     showTileGridLines=false;
@@ -57,6 +62,17 @@ MapGraphicItem::MapGraphicItem(internals::Core *core, Configuration *configurati
     connect(core,SIGNAL(OnMapZoomChanged()),this,SLOT(ChildPosRefresh()));
     //resize();
 }
+MapGraphicItem::~MapGraphicItem()
+{
+    delete glCompositor;
+}
+void MapGraphicItem::SetUseGLCompositor(bool const& value)
+{
+    useGLCompositor=value;
+    if(useGLCompositor && glCompositor==0)
+        glCompositor=new GLMapCompositor();
+    this->update();
+}
 void MapGraphicItem::start()
 {
     core->StartSystem();
@@ -89,43 +105,105 @@ QRectF MapGraphicItem::boundingRect() const
 void MapGraphicItem::Core_OnNeedInvalidation()
 {
     this->update();
-    foreach(QGraphicsItem* i,this->childItems())
+    ChildPosRefresh();
+}
+void MapGraphicItem::ChildPosRefresh()
+{
+    RTK_TRACE_ZONE("MapGraphicItem::ChildPosRefresh");
+
+    foreach(QGraphicsItem* i,refreshItems)
+    {
+        switch(i->type())
+        {
+        case UAVItem::Type:
+            static_cast<UAVItem*>(i)->RefreshPos();
+            break;
+        case HomeItem::Type:
+            static_cast<HomeItem*>(i)->RefreshPos();
+            break;
+        case GPSItem::Type:
+            static_cast<GPSItem*>(i)->RefreshPos();
+            break;
+        }
+    }
+
+    // registered overlays: the ones in view and the ones which just left it
+    // are projected in one batch, the others already sit outside the view
+    QVector<void*> inView;
+    QVector<QGraphicsItem*> items;
+    QSet<QGraphicsItem*> shown;
+    internals::LatLngArray coords;
+
+    overlayIndex.Query(ViewArea(64),inView);
+    foreach(void* p,inView)
+    {
+        QGraphicsItem* i=static_cast<QGraphicsItem*>(p);
+        shown.insert(i);
+        overlaysShown.remove(i);
+        items.append(i);
+        coords.Append(overlayIndex.Coord(p));
+    }
+    foreach(QGraphicsItem* i,overlaysShown)
     {
-        WayPointItem* w=qgraphicsitem_cast<WayPointItem*>(i);
-        if(w)
-            w->RefreshPos();
-        UAVItem* ww=qgraphicsitem_cast<UAVItem*>(i);
-        if(ww)
-            ww->RefreshPos();
-        HomeItem* www=qgraphicsitem_cast<HomeItem*>(i);
-        if(www)
-            www->RefreshPos();
-        GPSItem* wwww=qgraphicsitem_cast<GPSItem*>(i);
-        if(wwww)
-            wwww->RefreshPos();
-
-        emit mapChanged();
+        items.append(i);
+        coords.Append(overlayIndex.Coord(i));
     }
+    overlaysShown=shown;
+
+    FromLatLngToLocal(coords);
+    for(int i=0;i<items.size();i++)
+        items[i]->setPos(coords.x[i],coords.y[i]);
+
+    emit mapChanged();
 }
-void MapGraphicItem::ChildPosRefresh()
+QVariant MapGraphicItem::itemChange(GraphicsItemChange change,const QVariant &value)
 {
-    foreach(QGraphicsItem* i,this->childItems())
+    if(change==ItemChildAddedChange)
+    {
+        QGraphicsItem* i=value.value<QGraphicsItem*>();
+        int t=i->type();
+        if(t==UAVItem::Type || t==HomeItem::Type || t==GPSItem::Type)
+            refreshItems.append(i);
+    }
+    else if(change==ItemChildRemovedChange)
     {
-        WayPointItem* w=qgraphicsitem_cast<WayPointItem*>(i);
-        if(w)
-            w->RefreshPos();
-        UAVItem* ww=qgraphicsitem_cast<UAVItem*>(i);
-        if(ww)
-            ww->RefreshPos();
-        HomeItem* www=qgraphicsitem_cast<HomeItem*>(i);
-        if(www)
-            www->RefreshPos();
-        GPSItem* wwww=qgraphicsitem_cast<GPSItem*>(i);
-        if(wwww)
-            wwww->RefreshPos();
-
-        emit mapChanged();
+        // called from the child destructor too, no type() here
+        QGraphicsItem* i=value.value<QGraphicsItem*>();
+        refreshItems.removeAll(i);
+        UnregisterOverlay(i);
     }
+    return QGraphicsItem::itemChange(change,value);
+}
+void MapGraphicItem::RegisterOverlay(QGraphicsItem* item,internals::PointLatLng const& coord)
+{
+    overlayIndex.Insert(item,coord);
+    overlaysShown.insert(item);
+}
+void MapGraphicItem::UnregisterOverlay(QGraphicsItem* item)
+{
+    overlayIndex.Remove(item);
+    overlaysShown.remove(item);
+}
+QList<QGraphicsItem*> MapGraphicItem::OverlaysIn(internals::RectLatLng const& rect)
+{
+    QVector<void*> found;
+    QList<QGraphicsItem*> list;
+    overlayIndex.Query(rect,found);
+    foreach(void* p,found)
+        list.append(static_cast<QGraphicsItem*>(p));
+    return list;
+}
+QGraphicsItem* MapGraphicItem::OverlayNearest(internals::PointLatLng const& coord,int maxPixels)
+{
+    // meters per pixel, then degrees of latitude
+    double res=Projection()->GetGroundResolution(core->Zoom(),coord.Lat());
+    return static_cast<QGraphicsItem*>(overlayIndex.Nearest(coord,maxPixels*res/111319.49));
+}
+internals::RectLatLng MapGraphicItem::ViewArea(int margin)
+{
+    internals::PointLatLng tl=FromLocalToLatLng(-margin,-margin);
+    internals::PointLatLng br=FromLocalToLatLng((int) maprect.width()+margin,(int) maprect.height()+margin);
+    return internals::RectLatLng::FromLTRB(tl.Lng(),tl.Lat(),br.Lng(),br.Lat());
 }
 void MapGraphicItem::ConstructLastImage(int const& zoomdiff)
 {
@@ -169,6 +247,8 @@ void MapGraphicItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *op
     Q_UNUSED(option);
     Q_UNUSED(widget);
 
+    RTK_TRACE_ZONE("MapGraphicItem::paint");
+
     if(MapRenderTransform!=1)
     {
         QTransform transform;
@@ -363,12 +443,57 @@ void MapGraphicItem::wheelEvent(QGraphicsSceneWheelEvent *event)
     }
 }
 
+bool MapGraphicItem::DrawMap2DGL(QPainter *painter)
+{
+    if(!useGLCompositor || glCompositor==0 || !glCompositor->Begin(painter))
+        return false;
+
+    RTK_TRACE_ZONE("MapGraphicItem::DrawMap2DGL");
+    internals::TileMatrix::ReadGuard guard(core->Matrix);
+
+    for(int i = -core->GetsizeOfMapArea().Width(); i <= core->GetsizeOfMapArea().Width(); i++)
+    {
+        for(int j = -core->GetsizeOfMapArea().Height(); j <= core->GetsizeOfMapArea().Height(); j++)
+        {
+            core->SettilePoint (core->GetcenterTileXYLocation());
+            core->SettilePoint(Point(core->GettilePoint().X()+ i,core->GettilePoint().Y()+j));
+
+            internals::Tile* t = core->Matrix.TileAt(core->GettilePoint());
+            if(t==0)
+                continue;
+
+            core->tileRect.SetX(core->GettilePoint().X()*core->tileRect.Width());
+            core->tileRect.SetY(core->GettilePoint().Y()*core->tileRect.Height());
+            core->tileRect.Offset(core->GetrenderOffset());
+            if(!core->GetCurrentRegion().IntersectsWith(core->tileRect))
+                continue;
+
+            QRectF rect(core->tileRect.X(),core->tileRect.Y(), core->tileRect.Width(), core->tileRect.Height());
+            int layer=0;
+            foreach(QByteArray img,t->Overlays)
+            {
+                if(img.count()!=0)
+                    glCompositor->AddTile(core->GettilePoint(),core->Zoom(),layer,img,rect);
+                layer++;
+            }
+        }
+    }
+
+    glCompositor->End(painter);
+    return true;
+}
 void MapGraphicItem::DrawMap2D(QPainter *painter)
 {
     painter->setBackground(QBrush(Qt::black));
     if(!lastimage.isNull())
         painter->drawImage(core->GetrenderOffset().X()-lastimagepoint.X(),core->GetrenderOffset().Y()-lastimagepoint.Y(),lastimage);
 
+    // tiles stay valid while the loader threads replace and evict them
+    internals::TileMatrix::ReadGuard guard(core->Matrix);
+
+    // tiles drawn by GL, the loop below only draws grid lines & selection
+    bool drawTiles = !DrawMap2DGL(painter);
+
     for(int i = -core->GetsizeOfMapArea().Width(); i <= core->GetsizeOfMapArea().Width(); i++)
     {
         for(int j = -core->GetsizeOfMapArea().Height(); j <= core->GetsizeOfMapArea().Height(); j++)
@@ -388,7 +513,7 @@ void MapGraphicItem::DrawMap2D(QPainter *painter)
 
                         // render tile
                         //lock(t.Overlays)
-                        if(t!=0)
+                        if(t!=0 && drawTiles)
                         {
                             foreach(QByteArray img,t->Overlays)
                             {
@@ -472,6 +597,45 @@ core::Point MapGraphicItem::FromLatLngToLocal(internals::PointLatLng const& poin
     return ret;
 }
 
+void MapGraphicItem::FromLatLngToLocal(internals::LatLngArray& points)
+{
+    points.Project(core->Projection(),core->Zoom());
+
+    double ox=core->GetrenderOffset().X();
+    double oy=core->GetrenderOffset().Y();
+    double dx=((boundingRect().width()*MapRenderTransform)-(boundingRect().width()))/2;
+    double dy=((boundingRect().height()*MapRenderTransform)-(boundingRect().height()))/2;
+
+    // the same integer steps as FromLatLngToLocal
+    for(int i=0;i<points.Count();i++)
+    {
+        int x=(int)(points.x[i]+0.5)+ox;
+        int y=(int)(points.y[i]+0.5)+oy;
+        if(MapRenderTransform!=1)
+        {
+            x=(int)(x*MapRenderTransform);
+            y=(int)(y*MapRenderTransform);
+            x=x-dx;
+            y=y-dy;
+        }
+        points.x[i]=x;
+        points.y[i]=y;
+    }
+}
+
+QTransform MapGraphicItem::FromPixelToLocalTransform()
+{
+    // same mapping as FromLatLngToLocal, without rounding to int
+    QTransform transform;
+    if(MapRenderTransform!=1)
+    {
+        transform.translate(-((boundingRect().width()*MapRenderTransform)-(boundingRect().width()))/2,-((boundingRect().height()*MapRenderTransform)-(boundingRect().height()))/2);
+        transform.scale(MapRenderTransform,MapRenderTransform);
+    }
+    transform.translate(core->GetrenderOffset().X(),core->GetrenderOffset().Y());
+    return transform;
+}
+
 internals::PointLatLng MapGraphicItem::FromLocalToLatLng(int x, int y)
 {
     if(MapRenderTransform!=1)
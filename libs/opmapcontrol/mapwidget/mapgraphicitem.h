@@ -29,6 +29,7 @@
 
 #include <QGraphicsItem>
 #include "../internals/core.h"
+#include "../internals/spatialindex.h"
 //#include "../internals/point.h"
 #include "../core/diagnostics.h"
 #include "omapconfiguration.h"
@@ -38,11 +39,13 @@
 #include <QBrush>
 #include <QFont>
 #include <QObject>
+#include <QSet>
 #include "waypointitem.h"
 //#include "uavitem.h"
 namespace mapcontrol
 {
     class OPMapWidget;
+    class GLMapCompositor;
     /**
     * @brief The main graphicsItem used on the widget, contains the map and map logic
     *
@@ -64,6 +67,7 @@ namespace mapcontrol
         * @return
         */
         MapGraphicItem(internals::Core *core,Configuration *configuration);
+        ~MapGraphicItem();
         QRectF boundingRect() const;
         void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
                    QWidget *widget);
@@ -77,6 +81,13 @@ namespace mapcontrol
         */
         core::Point FromLatLngToLocal(internals::PointLatLng const& point);
         /**
+        * @brief Converts arrays of LatLong coordinates to local item coordinates
+        *        in one batch (same results as FromLatLngToLocal per point)
+        *
+        * @param points coordinates, the local positions are stored in points.x/y
+        */
+        void FromLatLngToLocal(internals::LatLngArray& points);
+        /**
         * @brief Converts from local item coordinates to LatLong point
         *
         * @param x x local coordinate
@@ -85,6 +96,19 @@ namespace mapcontrol
         */
         internals::PointLatLng FromLocalToLatLng(int x, int y);
         /**
+        * @brief Returns the transform from projection pixel coordinates (at ZoomPixel())
+        *        to local item coordinates
+        *
+        * @return QTransform
+        */
+        QTransform FromPixelToLocalTransform();
+        /**
+        * @brief Returns the integer zoom used by the projection
+        *
+        * @return int
+        */
+        int ZoomPixel()const{return core->Zoom();}
+        /**
         * @brief Converts from meters at one location to pixels
         *
         * @param meters Distance to convert
@@ -116,6 +140,46 @@ namespace mapcontrol
         */
         internals::RectLatLng SelectedArea()const{return selectedArea;}
 
+        /**
+        * @brief Draws the tiles with the OpenGL compositor if the view is painted
+        *        with OpenGL (see OPMapWidget::SetUseOpenGL), QPainter otherwise
+        *
+        * @param value
+        */
+        void SetUseGLCompositor(bool const& value);
+        bool UseGLCompositor()const{return useGLCompositor;}
+        GLMapCompositor* Compositor()const{return glCompositor;}
+
+        /**
+        * @brief Registers an overlay item at coord, again to move it
+        *
+        * Registered items are only projected while in view (ChildPosRefresh)
+        * and can be found with OverlaysIn/OverlayNearest. Children are
+        * unregistered when they are removed from the map.
+        *
+        * @param item child item, positioned at coord
+        * @param coord LatLng coordinate of the item
+        */
+        void RegisterOverlay(QGraphicsItem* item,internals::PointLatLng const& coord);
+        void UnregisterOverlay(QGraphicsItem* item);
+        /**
+        * @brief Returns the registered overlay items inside rect
+        */
+        QList<QGraphicsItem*> OverlaysIn(internals::RectLatLng const& rect);
+        /**
+        * @brief Returns the registered overlay item closest to coord
+        *
+        * @param coord LatLng coordinate
+        * @param maxPixels search radius in pixels at the current zoom
+        * @return the item, 0 if none within maxPixels
+        */
+        QGraphicsItem* OverlayNearest(internals::PointLatLng const& coord,int maxPixels);
+        /**
+        * @brief Returns the area in view, widened by margin pixels
+        */
+        internals::RectLatLng ViewArea(int margin=0);
+        internals::SpatialIndex const& OverlayIndex()const{return overlayIndex;}
+
     public slots:
         void SetSelectedArea(internals::RectLatLng const& value){selectedArea = value;this->update();}
 
@@ -124,6 +188,7 @@ namespace mapcontrol
         void mousePressEvent ( QGraphicsSceneMouseEvent * event );
         void wheelEvent ( QGraphicsSceneWheelEvent * event );
         void mouseReleaseEvent(QGraphicsSceneMouseEvent *event);
+        QVariant itemChange(GraphicsItemChange change,const QVariant &value);
         bool IsMouseOverMarker()const{return isMouseOverMarker;}
 
         /**
@@ -153,6 +218,12 @@ namespace mapcontrol
         bool showTileGridLines;
         qreal MapRenderTransform;
         void DrawMap2D(QPainter *painter);
+        bool DrawMap2DGL(QPainter *painter);
+        bool useGLCompositor;
+        GLMapCompositor* glCompositor;
+        internals::SpatialIndex overlayIndex;
+        QSet<QGraphicsItem*> overlaysShown;    ///< overlays positioned in view at the last refresh
+        QList<QGraphicsItem*> refreshItems;    ///< UAV, home & GPS children, refreshed always
         /**
         * @brief Maximum possible zoom
         *
@@ -260,6 +260,8 @@ void OPMapWidget::SetUseOpenGL(const bool &value)
         setViewport(new QGLWidget(QGLFormat(QGL::SampleBuffers)));
     else
         setupViewport(new QWidget());
+    // tiles from the GL texture atlas, QPainter is used if GL is not available
+    map->SetUseGLCompositor(useOpenGL);
     update();
 }
 
@@ -421,6 +423,23 @@ QList<WayPointItem*> OPMapWidget::WPSelected()
     return list;
 }
 
+QList<WayPointItem*> OPMapWidget::WPInArea(internals::RectLatLng const& rect)
+{
+    QList<WayPointItem*> list;
+    foreach(QGraphicsItem* i,map->OverlaysIn(rect))
+    {
+        WayPointItem* w=qgraphicsitem_cast<WayPointItem*>(i);
+        if(w)
+            list.append(w);
+    }
+    return list;
+}
+
+WayPointItem* OPMapWidget::WPNearest(internals::PointLatLng const& coord,int maxPixels)
+{
+    return qgraphicsitem_cast<WayPointItem*>(map->OverlayNearest(coord,maxPixels));
+}
+
 void OPMapWidget::WPRenumber(WayPointItem *item, const int &newnumber)
 {
     item->SetNumber(newnumber);
@@ -451,6 +451,23 @@ namespace mapcontrol
         */
         QList<WayPointItem*> WPSelected();
 
+        /**
+        * @brief Returns the WayPoints inside an area (spatial index, no scan)
+        *
+        * @param rect area in LatLng coordinates
+        * @return QList<WayPointItem *>
+        */
+        QList<WayPointItem*> WPInArea(internals::RectLatLng const& rect);
+
+        /**
+        * @brief Returns the WayPoint closest to a coordinate
+        *
+        * @param coord LatLng coordinate, e.g. currentMousePosition()
+        * @param maxPixels search radius in pixels
+        * @return the WayPoint, 0 if none within maxPixels
+        */
+        WayPointItem* WPNearest(internals::PointLatLng const& coord,int maxPixels=16);
+
         /**
         * @brief Renumbers the WayPoint and all others as needed
         *
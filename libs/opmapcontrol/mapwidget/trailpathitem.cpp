@@ -0,0 +1,541 @@
+/**
+******************************************************************************
+*
+* @file       trailpathitem.cpp
+* @brief      A graphicsItem drawing the whole UAV trail as cached paths
+* @see        The GNU Public License (GPL) Version 3
+* @defgroup   OPMapWidget
+* @{
+*
+*****************************************************************************/
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+* for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+#include <QStyleOptionGraphicsItem>
+#include "trailpathitem.h"
+#include "mapgraphicitem.h"
+
+#include <rtk_trace.h>
+
+namespace mapcontrol
+{
+
+// vertices per path chunk (culling granularity)
+static const int    kChunkSize   = 256;
+// zoom levels kept in cache
+static const int    kMaxLevels   = 4;
+// maximum points merged into one segment while appending
+static const int    kMaxMerged   = 32;
+// minimum distance between two trail dots (pixels)
+static const qreal  kDotSpacing  = 6.0;
+// dot radius & margin of the bounding rect (pixels)
+static const qreal  kDotRadius   = 2.0;
+static const qreal  kMargin      = 4.0;
+
+static inline qreal Dist2(QPointF const& a, QPointF const& b)
+{
+    qreal dx=a.x()-b.x(), dy=a.y()-b.y();
+    return dx*dx+dy*dy;
+}
+
+static inline qreal DistSeg2(QPointF const& p, QPointF const& a, QPointF const& b)
+{
+    qreal dx=b.x()-a.x(), dy=b.y()-a.y();
+    qreal vx=p.x()-a.x(), vy=p.y()-a.y();
+    qreal len2=dx*dx+dy*dy;
+    qreal u=len2>0?(vx*dx+vy*dy)/len2:0;
+
+    u=qMax((qreal)0,qMin((qreal)1,u));
+    vx-=u*dx;
+    vy-=u*dy;
+    return vx*vx+vy*vy;
+}
+
+static inline void ExpandRect(QRectF& r, QPointF const& p, bool first)
+{
+    if(first)
+    {
+        r.setCoords(p.x(),p.y(),p.x(),p.y());
+        return;
+    }
+    if(p.x()<r.left()) r.setLeft(p.x());
+    else if(p.x()>r.right()) r.setRight(p.x());
+    if(p.y()<r.top()) r.setTop(p.y());
+    else if(p.y()>r.bottom()) r.setBottom(p.y());
+}
+
+/**
+* Douglas-Peucker simplification of p[first..last], marks the kept points.
+* Iterative (explicit stack) so long trails can not overflow the call stack.
+*/
+static void SimplifyDP(QVector<QPointF> const& p, int first, int last, qreal tol, QVector<char>& keep)
+{
+    QVector<QPair<int,int> > stack;
+    qreal tol2=tol*tol;
+
+    keep[first]=1;
+    keep[last]=1;
+    stack.append(qMakePair(first,last));
+
+    while(!stack.isEmpty())
+    {
+        QPair<int,int> r=stack.last();
+        stack.pop_back();
+        if(r.second-r.first<2)
+            continue;
+
+        QPointF a=p[r.first];
+        qreal dx=p[r.second].x()-a.x(), dy=p[r.second].y()-a.y();
+        qreal len2=dx*dx+dy*dy;
+        qreal dmax=tol2;
+        int   imax=-1;
+
+        for(int i=r.first+1;i<r.second;i++)
+        {
+            qreal vx=p[i].x()-a.x(), vy=p[i].y()-a.y();
+            qreal d2;
+            if(len2>0)
+            {
+                qreal cross=vx*dy-vy*dx;
+                d2=cross*cross/len2;
+            }
+            else
+                d2=vx*vx+vy*vy;
+            if(d2>dmax)
+            {
+                dmax=d2;
+                imax=i;
+            }
+        }
+
+        if(imax>=0)
+        {
+            keep[imax]=1;
+            stack.append(qMakePair(r.first,imax));
+            stack.append(qMakePair(imax,r.second));
+        }
+    }
+}
+
+
+TrailPathItem::TrailPathItem(MapGraphicItem* map, QGraphicsItem* parent, int maxPoints):
+    QGraphicsItem(parent),map(map),projection(0),zoom(-1),
+    capacity(qMax(maxPoints,16)),head(0),count(0),total(0),gen(0),
+    useCounter(0),showdots(true),showline(true),tolerance(1.0)
+{
+    lats.resize(capacity);
+    lngs.resize(capacity);
+    alts.resize(capacity);
+    colors.resize(capacity);
+    this->setFlag(QGraphicsItem::ItemUsesExtendedStyleOption,true);
+    RefreshPos();
+}
+
+TrailPathItem::~TrailPathItem()
+{
+}
+
+int TrailPathItem::Index(quint64 const& seq)const
+{
+    return (head+(int)(seq-(total-count)))%capacity;
+}
+
+void TrailPathItem::Project(quint64 const& first, quint64 const& last)
+{
+    int n=(int)(last-first);
+    int i0=Index(first);
+    int n1=qMin(n,capacity-i0);
+
+    projx.resize(n);
+    projy.resize(n);
+
+    // the ring wraps at most once: two contiguous runs
+    projection->FromLatLngToPixelBatch(lats.constData()+i0,lngs.constData()+i0,n1,zoom,
+                                       projx.data(),projy.data());
+    if(n>n1)
+        projection->FromLatLngToPixelBatch(lats.constData(),lngs.constData(),n-n1,zoom,
+                                           projx.data()+n1,projy.data()+n1);
+}
+
+void TrailPathItem::AddPoint(internals::PointLatLng const& coord, int const& altitude, QColor const& color)
+{
+    if(count==capacity)
+    {
+        // drop a block of old points at once, so the caches are rebuilt
+        // once per block instead of once per point
+        int n=qMax(1,capacity/8);
+        head=(head+n)%capacity;
+        count-=n;
+        gen++;
+    }
+
+    int i=(head+count)%capacity;
+    lats[i]=coord.Lat();
+    lngs[i]=coord.Lng();
+    alts[i]=altitude;
+    colors[i]=color.rgba();
+    count++;
+    total++;
+
+    UpdateGeometry();
+}
+
+void TrailPathItem::Clear()
+{
+    head=0;
+    count=0;
+    gen++;
+    levels.clear();
+    UpdateGeometry();
+}
+
+void TrailPathItem::SetMaxPoints(int const& value)
+{
+    int cap=qMax(value,16);
+    if(cap==capacity)
+        return;
+
+    // keep the newest points
+    int n=qMin(count,cap);
+    QVector<double> nlat(cap), nlng(cap);
+    QVector<float>  nalt(cap);
+    QVector<QRgb>   ncol(cap);
+    for(int i=0;i<n;i++)
+    {
+        int k=Index(total-n+i);
+        nlat[i]=lats[k];
+        nlng[i]=lngs[k];
+        nalt[i]=alts[k];
+        ncol[i]=colors[k];
+    }
+
+    lats=nlat;
+    lngs=nlng;
+    alts=nalt;
+    colors=ncol;
+    capacity=cap;
+    head=0;
+    count=n;
+    gen++;
+    UpdateGeometry();
+}
+
+void TrailPathItem::SetShowDots(bool const& value)
+{
+    showdots=value;
+    setVisible(showdots||showline);
+    update();
+}
+
+void TrailPathItem::SetShowLine(bool const& value)
+{
+    showline=value;
+    setVisible(showdots||showline);
+    update();
+}
+
+void TrailPathItem::SetTolerance(qreal const& value)
+{
+    tolerance=qMax(value,(qreal)0.1);
+    gen++;
+    UpdateGeometry();
+}
+
+void TrailPathItem::SetProjection(internals::PureProjection* projection, int const& zoom)
+{
+    if(this->projection==projection&&this->zoom==zoom)
+        return;
+
+    // a new projection invalidates all the cached levels
+    if(this->projection!=projection)
+        levels.clear();
+
+    this->projection=projection;
+    this->zoom=zoom;
+    UpdateGeometry();
+}
+
+void TrailPathItem::RefreshPos()
+{
+    if(map==0)
+        return;
+
+    SetProjection(map->Projection(),map->ZoomPixel());
+    setTransform(map->FromPixelToLocalTransform());
+}
+
+int TrailPathItem::VertexCount()
+{
+    LevelCache* c=Level();
+    return c?c->nVertex:0;
+}
+
+TrailPathItem::LevelCache* TrailPathItem::Level()
+{
+    if(projection==0||zoom<0)
+        return 0;
+
+    LevelCache* c=0;
+    for(int i=0;i<levels.size();i++)
+    {
+        if(levels[i].zoom==zoom)
+        {
+            c=&levels[i];
+            break;
+        }
+    }
+
+    if(c==0)
+    {
+        // evict the least recently used level
+        if(levels.size()>=kMaxLevels)
+        {
+            int lru=0;
+            for(int i=1;i<levels.size();i++)
+                if(levels[i].lastUse<levels[lru].lastUse)
+                    lru=i;
+            levels.remove(lru);
+        }
+
+        levels.append(LevelCache());
+        c=&levels.last();
+        c->zoom=zoom;
+        Rebuild(*c);
+    }
+    else if(c->gen!=gen)
+        Rebuild(*c);
+    else if(c->used<total)
+        Append(*c);
+
+    c->lastUse=++useCounter;
+    return c;
+}
+
+void TrailPathItem::Rebuild(LevelCache& c)
+{
+    QVector<QPointF> px;
+    QVector<QRgb>    col;
+    qreal            tol2=tolerance*tolerance;
+
+    c.gen=gen;
+    c.used=total;
+    c.nVertex=0;
+    c.bounds=QRectF();
+    c.chunks.clear();
+    c.merged.clear();
+    if(count==0)
+        return;
+
+    Project(total-count,total);
+    c.anchor=QPointF(projx[0],projy[0]);
+
+    // radial distance pre-filter (keeps color changes and the last point)
+    px.reserve(count);
+    col.reserve(count);
+    for(int i=0;i<count;i++)
+    {
+        QRgb    color=colors[Index(total-count+i)];
+        QPointF p=QPointF(projx[i],projy[i])-c.anchor;
+
+        if(px.isEmpty()||col.last()!=color||Dist2(p,px.last())>=tol2||i==count-1)
+        {
+            px.append(p);
+            col.append(color);
+        }
+    }
+
+    // Douglas-Peucker on each run of equal color
+    QVector<char> keep(px.size(),0);
+    int first=0;
+    for(int i=1;i<=px.size();i++)
+    {
+        if(i==px.size()||col[i]!=col[first])
+        {
+            SimplifyDP(px,first,i-1,tolerance,keep);
+            first=i;
+        }
+    }
+
+    for(int i=0;i<px.size();i++)
+    {
+        if(keep[i])
+            AppendVertex(c,px[i],col[i]);
+        AppendDot(c,px[i]);
+    }
+}
+
+void TrailPathItem::Append(LevelCache& c)
+{
+    qreal tol2=tolerance*tolerance;
+
+    if(c.nVertex==0&&count>0)
+    {
+        Project(total-count,total-count+1);
+        c.anchor=QPointF(projx[0],projy[0]);
+    }
+
+    quint64 first=qMax(c.used,total-count);
+    if(first<total)
+        Project(first,total);
+
+    for(quint64 s=first;s<total;s++)
+    {
+        QRgb    color=colors[Index(s)];
+        QPointF p=QPointF(projx[s-first],projy[s-first])-c.anchor;
+
+        if(c.nVertex>0&&c.chunks.last().color==color&&Dist2(p,c.lastLine)<tol2)
+            continue;
+
+        // move the last vertex to p while the merged points stay within tolerance
+        bool merge=c.nVertex>0&&!c.merged.isEmpty()&&c.merged.size()<kMaxMerged&&
+                   c.chunks.last().color==color;
+        for(int i=0;merge&&i<c.merged.size();i++)
+            if(DistSeg2(c.merged[i],c.fixed,p)>tol2)
+                merge=false;
+
+        if(merge)
+        {
+            Chunk& ck=c.chunks.last();
+            ck.line.setElementPositionAt(ck.line.elementCount()-1,p.x(),p.y());
+            ExpandRect(ck.bounds,p,false);
+            ExpandRect(c.bounds,p,false);
+            c.lastLine=p;
+        }
+        else
+        {
+            c.fixed=c.lastLine;
+            c.merged.clear();
+            AppendVertex(c,p,color);
+        }
+        c.merged.append(p);
+        AppendDot(c,p);
+    }
+
+    c.used=total;
+}
+
+void TrailPathItem::AppendVertex(LevelCache& c, QPointF const& p, QRgb const& color)
+{
+    Chunk* ck=c.chunks.isEmpty()?0:&c.chunks.last();
+
+    if(ck==0||ck->color!=color||ck->line.elementCount()>=kChunkSize)
+    {
+        // a new chunk starts at the previous vertex, so the line stays connected
+        Chunk n;
+        n.color=color;
+        if(ck)
+        {
+            n.line.moveTo(c.lastLine);
+            n.line.lineTo(p);
+            ExpandRect(n.bounds,c.lastLine,true);
+            ExpandRect(n.bounds,p,false);
+        }
+        else
+        {
+            n.line.moveTo(p);
+            ExpandRect(n.bounds,p,true);
+        }
+        c.chunks.append(n);
+        ck=&c.chunks.last();
+    }
+    else
+    {
+        ck->line.lineTo(p);
+        ExpandRect(ck->bounds,p,false);
+    }
+
+    ExpandRect(c.bounds,p,c.nVertex==0);
+    c.lastLine=p;
+    c.nVertex++;
+}
+
+void TrailPathItem::AppendDot(LevelCache& c, QPointF const& p)
+{
+    // dots are drawn at the trail points (not the simplified vertices),
+    // skipped if they would overlap
+    if(c.chunks.isEmpty())
+        return;
+    if(!c.chunks.last().dots.isEmpty()&&Dist2(p,c.lastDot)<kDotSpacing*kDotSpacing)
+        return;
+
+    c.chunks.last().dots.addEllipse(p,kDotRadius,kDotRadius);
+    c.lastDot=p;
+}
+
+void TrailPathItem::UpdateGeometry()
+{
+    LevelCache* c=Level();
+    QRectF r;
+
+    if(c&&c->nVertex>0)
+        r=c->bounds.translated(c->anchor).adjusted(-kMargin,-kMargin,kMargin,kMargin);
+
+    if(r!=bounds)
+    {
+        prepareGeometryChange();
+        bounds=r;
+    }
+    update();
+}
+
+void TrailPathItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, QWidget *widget)
+{
+    Q_UNUSED(widget);
+
+    RTK_TRACE_ZONE("TrailPathItem::paint");
+    LevelCache* c=Level();
+    if(c==0||c->nVertex==0)
+        return;
+
+    QRectF exposed=option->exposedRect.translated(-c->anchor).adjusted(-kMargin,-kMargin,kMargin,kMargin);
+    QPen pen;
+    pen.setWidth(1);
+    pen.setCosmetic(true);
+
+    painter->save();
+    painter->translate(c->anchor);
+    for(int i=0;i<c->chunks.size();i++)
+    {
+        Chunk const& ck=c->chunks[i];
+        if(!exposed.intersects(ck.bounds.adjusted(-kMargin,-kMargin,kMargin,kMargin)))
+            continue;
+
+        QColor color=QColor::fromRgba(ck.color);
+        if(showline)
+        {
+            pen.setColor(color);
+            painter->strokePath(ck.line,pen);
+        }
+        if(showdots&&!ck.dots.isEmpty())
+        {
+            painter->setPen(QPen(Qt::black,0));
+            painter->setBrush(color);
+            painter->drawPath(ck.dots);
+        }
+    }
+    painter->restore();
+}
+
+QRectF TrailPathItem::boundingRect()const
+{
+    return bounds;
+}
+
+int TrailPathItem::type()const
+{
+    return Type;
+}
+
+}
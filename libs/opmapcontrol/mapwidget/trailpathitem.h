@@ -0,0 +1,173 @@
+/**
+******************************************************************************
+*
+* @file       trailpathitem.h
+* @brief      A graphicsItem drawing the whole UAV trail as cached paths
+* @see        The GNU Public License (GPL) Version 3
+* @defgroup   OPMapWidget
+* @{
+*
+*****************************************************************************/
+/*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation; either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful, but
+* WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+* or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+* for more details.
+*
+* You should have received a copy of the GNU General Public License along
+* with this program; if not, write to the Free Software Foundation, Inc.,
+* 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+*/
+#ifndef TRAILPATHITEM_H
+#define TRAILPATHITEM_H
+
+#include <QGraphicsItem>
+#include <QPainter>
+#include <QPainterPath>
+#include <QVector>
+#include "../internals/pointlatlng.h"
+#include "../internals/pureprojection.h"
+
+namespace mapcontrol
+{
+    class MapGraphicItem;
+
+    /**
+    * @brief A single QGraphicsItem drawing the whole trail (line and dots)
+    *
+    *        Trail points are stored in a fixed size ring buffer. For each zoom
+    *        level the points are projected once to pixel coordinates (in
+    *        batches, PureProjection::FromLatLngToPixelBatch),
+    *        simplified (radial distance + Douglas-Peucker, Tolerance() pixels)
+    *        and kept as a few QPainterPath chunks. Panning only changes the
+    *        item transform, new points extend the cached paths (nearly
+    *        collinear points are merged into the last segment) and chunks
+    *        outside the exposed rect are skipped while painting.
+    *
+    * @class TrailPathItem trailpathitem.h "mapwidget/trailpathitem.h"
+    */
+    class TrailPathItem:public QGraphicsItem
+    {
+    public:
+        enum { Type = UserType + 8 };
+        /**
+        * @brief Constructer
+        *
+        * @param map the map item, used for projection & zoom (can be 0, see SetProjection)
+        * @param parent parent item
+        * @param maxPoints ring buffer size, the oldest points are dropped if it is full
+        */
+        TrailPathItem(MapGraphicItem* map, QGraphicsItem* parent=0, int maxPoints=100000);
+        ~TrailPathItem();
+
+        /**
+        * @brief Appends a trail point
+        */
+        void AddPoint(internals::PointLatLng const& coord, int const& altitude, QColor const& color);
+        /**
+        * @brief Deletes all the trail points
+        */
+        void Clear();
+        /**
+        * @brief Returns the number of stored trail points
+        */
+        int Count()const{return count;}
+
+        int MaxPoints()const{return capacity;}
+        void SetMaxPoints(int const& value);
+
+        bool ShowDots()const{return showdots;}
+        void SetShowDots(bool const& value);
+        bool ShowLine()const{return showline;}
+        void SetShowLine(bool const& value);
+
+        /**
+        * @brief Simplification tolerance in pixels (default 1.0)
+        */
+        qreal Tolerance()const{return tolerance;}
+        void SetTolerance(qreal const& value);
+
+        /**
+        * @brief Sets projection & zoom directly (used if the item has no map)
+        */
+        void SetProjection(internals::PureProjection* projection, int const& zoom);
+        /**
+        * @brief Follows the map zoom & render offset, call it when the map changes
+        */
+        void RefreshPos();
+
+        /**
+        * @brief Returns the number of path vertices cached for the current zoom
+        */
+        int VertexCount();
+
+        void paint(QPainter *painter, const QStyleOptionGraphicsItem *option,
+                   QWidget *widget);
+        QRectF boundingRect() const;
+        int type() const;
+
+    private:
+        struct Chunk
+        {
+            QRgb            color;
+            QPainterPath    line;
+            QPainterPath    dots;
+            QRectF          bounds;
+        };
+
+        struct LevelCache
+        {
+            int             zoom;
+            quint64         gen;                ///< ring generation the cache was built for
+            quint64         used;               ///< points consumed (sequence number)
+            quint64         lastUse;
+            QPointF         anchor;             ///< pixel origin of the path coordinates
+            QPointF         lastLine;
+            QPointF         lastDot;
+            QPointF         fixed;              ///< vertex before lastLine
+            QVector<QPointF> merged;            ///< points merged into the last segment
+            int             nVertex;
+            QRectF          bounds;
+            QVector<Chunk>  chunks;
+        };
+
+        MapGraphicItem* map;
+        internals::PureProjection* projection;
+        int zoom;
+
+        // ring buffer in SoA layout, projected in batches
+        QVector<double> lats;
+        QVector<double> lngs;
+        QVector<float>  alts;
+        QVector<QRgb>   colors;
+        QVector<double> projx, projy;           ///< Project() output
+        int capacity;
+        int head;
+        int count;
+        quint64 total;
+        quint64 gen;
+
+        QVector<LevelCache> levels;
+        quint64 useCounter;
+
+        bool showdots;
+        bool showline;
+        qreal tolerance;
+        QRectF bounds;
+
+        int Index(quint64 const& seq)const;
+        void Project(quint64 const& first, quint64 const& last);
+        LevelCache* Level();
+        void Rebuild(LevelCache& c);
+        void Append(LevelCache& c);
+        void AppendVertex(LevelCache& c, QPointF const& p, QRgb const& color);
+        void AppendDot(LevelCache& c, QPointF const& p);
+        void UpdateGeometry();
+    };
+}
+#endif // TRAILPATHITEM_H
@@ -29,6 +29,8 @@
 #include "../internals/pureprojection.h"
 #include "uavitem.h"
 
+#include <rtk_trace.h>
+
 namespace mapcontrol {
 
 UAVItem::UAVItem(MapGraphicItem* map,OPMapWidget* parent,QString uavPic) :
@@ -45,10 +47,7 @@ UAVItem::UAVItem(MapGraphicItem* map,OPMapWidget* parent,QString uavPic) :
     localposition=map->FromLatLngToLocal(mapwidget->CurrentPosition());
     this->setPos(localposition.X(),localposition.Y());
     this->setZValue(4);
-    trail=new QGraphicsItemGroup();
-    trail->setParentItem(map);
-    trailLine=new QGraphicsItemGroup();
-    trailLine->setParentItem(map);
+    trail=new TrailPathItem(map,map);
     this->setFlag(QGraphicsItem::ItemIgnoresTransformations,true);
     mapfollowtype=UAVMapFollowType::None;
     trailtype=UAVTrailType::ByDistance;
@@ -64,6 +63,8 @@ void UAVItem::paint(QPainter *painter, const QStyleOptionGraphicsItem *option, Q
 {
     Q_UNUSED(option);
     Q_UNUSED(widget);
+
+    RTK_TRACE_ZONE("UAVItem::paint");
     // painter->rotate(-90);
     QPainter::RenderHints oldhints = painter->renderHints();
     painter->setRenderHints(QPainter::Antialiasing | QPainter::SmoothPixmapTransform);
@@ -88,10 +89,7 @@ void UAVItem::SetUAVPos(const internals::PointLatLng &position, const int &altit
         {
             if(timer.elapsed()>trailtime*1000)
             {
-                trail->addToGroup(new TrailItem(position,altitude,color,this));
-                if(!lasttrailline.IsEmpty())
-                    trailLine->addToGroup((new TrailLineItem(lasttrailline,position,color,map)));
-                lasttrailline=position;
+                trail->AddPoint(position,altitude,color);
                 timer.restart();
             }
         }
@@ -99,10 +97,7 @@ void UAVItem::SetUAVPos(const internals::PointLatLng &position, const int &altit
         {
             if(qAbs(internals::PureProjection::DistanceBetweenLatLng(lastcoord,position)*1000)>traildistance)
             {
-                trail->addToGroup(new TrailItem(position,altitude,color,this));
-                if(!lasttrailline.IsEmpty())
-                    trailLine->addToGroup((new TrailLineItem(lasttrailline,position,color,map)));
-                lasttrailline=position;
+                trail->AddPoint(position,altitude,color);
                 lastcoord=position;
             }
         }
@@ -185,20 +180,8 @@ void UAVItem::RefreshPos()
     localposition=map->FromLatLngToLocal(coord);
     this->setPos(localposition.X(), localposition.Y());
 
-    foreach(QGraphicsItem* i,trail->childItems())
-    {
-        TrailItem* w=qgraphicsitem_cast<TrailItem*>(i);
-        if(w)
-            w->setPos(map->FromLatLngToLocal(w->coord).X(),map->FromLatLngToLocal(w->coord).Y());
-    }
-
-    foreach(QGraphicsItem* i,trailLine->childItems())
-    {
-        TrailLineItem* ww=qgraphicsitem_cast<TrailLineItem*>(i);
-        if(ww)
-            ww->setLine(map->FromLatLngToLocal(ww->coord1).X(),map->FromLatLngToLocal(ww->coord1).Y(),map->FromLatLngToLocal(ww->coord2).X(),map->FromLatLngToLocal(ww->coord2).Y());
-    }
-
+    // the trail is cached in pixel coordinates, only its transform changes
+    trail->RefreshPos();
 }
 
 void UAVItem::SetTrailType(const UAVTrailType::Types &value)
@@ -211,21 +194,18 @@ void UAVItem::SetTrailType(const UAVTrailType::Types &value)
 void UAVItem::SetShowTrail(const bool &value)
 {
     showtrail=value;
-    trail->setVisible(value);
+    trail->SetShowDots(value);
 }
 
 void UAVItem::SetShowTrailLine(const bool &value)
 {
     showtrailline=value;
-    trailLine->setVisible(value);
+    trail->SetShowLine(value);
 }
 
 void UAVItem::DeleteTrail() const
 {
-    foreach(QGraphicsItem* i,trail->childItems())
-        delete i;
-    foreach(QGraphicsItem* i,trailLine->childItems())
-        delete i;
+    trail->Clear();
 }
 
 double UAVItem::Distance3D(const internals::PointLatLng &coord, const int &altitude)
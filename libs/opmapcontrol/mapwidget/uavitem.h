@@ -40,8 +40,7 @@
 #include "uavtrailtype.h"
 #include <QtSvg/QSvgRenderer>
 #include "opmapwidget.h"
-#include "trailitem.h"
-#include "traillineitem.h"
+#include "trailpathitem.h"
 
 namespace mapcontrol
 {
@@ -171,6 +170,18 @@ public:
         * @brief Deletes all the trail points
         */
     void DeleteTrail()const;
+    /**
+        * @brief Returns the maximum number of trail points kept (the oldest are dropped)
+        *
+        * @return int
+        */
+    int TrailMaxPoints()const{return trail->MaxPoints();}
+    /**
+        * @brief Sets the maximum number of trail points kept
+        *
+        * @param value
+        */
+    void SetTrailMaxPoints(int const& value){trail->SetMaxPoints(value);}
     /**
         * @brief Returns true if the UAV automaticaly sets WP reached value (changing its color)
         *
@@ -213,9 +224,7 @@ private:
     internals::PointLatLng lastcoord;
     core::Point localposition;
     OPMapWidget* mapwidget;
-    QGraphicsItemGroup* trail;
-    QGraphicsItemGroup * trailLine;
-    internals::PointLatLng lasttrailline;
+    TrailPathItem* trail;
     QTime timer;
     bool showtrail;
     bool showtrailline;
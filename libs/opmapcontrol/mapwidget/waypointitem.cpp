@@ -59,6 +59,7 @@ WayPointItem::WayPointItem(const internals::PointLatLng &coord,double const& alt
     SetShowNumber(shownumber);
     RefreshToolTip();
     RefreshPos();
+    map->RegisterOverlay(this,coord);
 }
 
 WayPointItem::WayPointItem(const internals::PointLatLng &coord,
@@ -90,6 +91,7 @@ WayPointItem::WayPointItem(const internals::PointLatLng &coord,
     SetShowNumber(shownumber);
     RefreshToolTip();
     RefreshPos();
+    map->RegisterOverlay(this,coord);
 }
 
 QRectF WayPointItem::boundingRect() const
@@ -148,6 +150,7 @@ void WayPointItem::mouseReleaseEvent(QGraphicsSceneMouseEvent *event)
         delete textBG;
         textBG = NULL;
         coord=map->FromLocalToLatLng(this->pos().x(),this->pos().y());
+        map->RegisterOverlay(this,coord);
         QString coord_str = " " + QString::number(coord.Lat(), 'f', 6) + "   " + QString::number(coord.Lng(), 'f', 6);
         // qDebug() << "WP MOVE:" << coord_str << __FILE__ << __LINE__;
         isDragging=false;
@@ -164,6 +167,7 @@ void WayPointItem::mouseMoveEvent(QGraphicsSceneMouseEvent *event)
     if(isDragging)
     {
         coord=map->FromLocalToLatLng(this->pos().x(),this->pos().y());
+        map->RegisterOverlay(this,coord);
         QString coord_str = " " + QString::number(coord.Lat(), 'f', 6) + "   " + QString::number(coord.Lng(), 'f', 6);
         text->setText(coord_str);
         // qDebug() << "WP DRAG:" << coord_str << __FILE__ << __LINE__;
@@ -196,6 +200,7 @@ void WayPointItem::SetHeading(const float &value)
 void WayPointItem::SetCoord(const internals::PointLatLng &value)
 {
     coord=value;
+    map->RegisterOverlay(this,coord);
     emit WPValuesChanged(this);
     RefreshPos();
     RefreshToolTip();
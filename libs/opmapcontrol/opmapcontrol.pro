@@ -1,5 +1,5 @@
 
-QT       += network sql
+QT       += network sql opengl
 CONFIG   += staticlib
 TEMPLATE  = lib
 
@@ -13,6 +13,9 @@ INCLUDEPATH += . ./core ./internals ./internals/projections ./mapwidget
 
 DEFINES     += OPMAPWIDGET_LIBRARY EXTERNAL_USE
 
+# zone tracing (rtk_trace.h), enable by: qmake "DEFINES+=RTK_TRACE"
+INCLUDEPATH += ../rtk++/include
+
 
 
 HEADERS += \
@@ -48,8 +51,10 @@ HEADERS += \
     ./internals/rectangle.h \
     ./internals/rectlatlng.h \
     ./internals/sizelatlng.h \
+    ./internals/spatialindex.h \
     ./internals/tile.h \
     ./internals/tilematrix.h \
+    ./mapwidget/glmapcompositor.h \
     ./mapwidget/gpsitem.h \
     ./mapwidget/homeitem.h \
     ./mapwidget/mapgraphicitem.h \
@@ -58,6 +63,7 @@ HEADERS += \
     ./mapwidget/opmapwidget.h \
     ./mapwidget/trailitem.h \
     ./mapwidget/traillineitem.h \
+    ./mapwidget/trailpathitem.h \
     ./mapwidget/uavitem.h \
     ./mapwidget/uavmapfollowtype.h \
     ./mapwidget/uavtrailtype.h \
@@ -96,9 +102,11 @@ SOURCES += \
     ./internals/rectangle.cpp \
     ./internals/rectlatlng.cpp \
     ./internals/sizelatlng.cpp \
+    ./internals/spatialindex.cpp \
     ./internals/tile.cpp \
     ./internals/tilematrix.cpp \
     ./mapwidget/configuration.cpp \
+    ./mapwidget/glmapcompositor.cpp \
     ./mapwidget/gpsitem.cpp \
     ./mapwidget/homeitem.cpp \
     ./mapwidget/mapgraphicitem.cpp \
@@ -107,6 +115,7 @@ SOURCES += \
     ./mapwidget/opmapwidget.cpp \
     ./mapwidget/trailitem.cpp \
     ./mapwidget/traillineitem.cpp \
+    ./mapwidget/trailpathitem.cpp \
     ./mapwidget/uavitem.cpp \
     ./mapwidget/waypointitem.cpp \
     ./mapwidget/waypointlineitem.cpp \
@@ -0,0 +1,138 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef __RTK_BINLOG_H__
+#define __RTK_BINLOG_H__
+
+#include <stdio.h>
+#include <string>
+
+#include "rtk_types.h"
+
+namespace rtk {
+
+////////////////////////////////////////////////////////////////////////////////
+/// Binary deferred-formatting logger
+///
+///     Each call site owns a static RBinLogSite. At the first call the format
+///     string is parsed once and the site gets a numeric id. Later calls only
+///     copy the site id, a TSC time stamp and the raw arguments into a
+///     per-thread ring buffer. A background thread writes the buffers to a
+///     compact binary file, which is rendered to text by blog_decode().
+///
+///     If no log file is opened the message is formatted and printed by
+///     dbg_printf(), so blog_pX() can be used as a drop-in for dbg_pX().
+///
+////////////////////////////////////////////////////////////////////////////////
+
+#define RTK_BINLOG_MAX_ARGS     16
+
+///
+/// \brief argument types recorded for each call site
+///
+enum RBinLogArgType
+{
+    BLOG_ARG_INT    = 1,            ///< int (and promoted char/short)
+    BLOG_ARG_LONG   = 2,            ///< long
+    BLOG_ARG_LLONG  = 3,            ///< long long
+    BLOG_ARG_DOUBLE = 4,            ///< double (and promoted float)
+    BLOG_ARG_STR    = 5,            ///< C string (copied, max 255 bytes)
+    BLOG_ARG_PTR    = 6,            ///< pointer
+};
+
+///
+/// \brief call site information (one static object per call site)
+///
+struct RBinLogSite
+{
+    volatile ru32   id;             ///< site id (0: not registered)
+    int             level;          ///< debug level
+    const char      *file;          ///< source file
+    int             line;           ///< source line
+    const char      *func;          ///< function name
+    const char      *fmt;           ///< format string
+
+    int             nArgs;          ///< argument number
+    ru8             argTypes[RTK_BINLOG_MAX_ARGS];
+};
+
+///
+/// \brief open binary log file & start writer thread
+/// \param fn - output file name
+/// \param ringSize - per-thread ring buffer size (in bytes)
+/// \return 0 - success
+///
+int  blog_open(const std::string &fn, int ringSize = 65536);
+
+///
+/// \brief flush all buffers, stop writer thread & close log file
+///
+int  blog_close(void);
+
+///
+/// \brief flush all buffers to file now
+///
+int  blog_flush(void);
+
+///
+/// \brief number of dropped messages (ring buffer full)
+///
+ru64 blog_dropped(void);
+
+///
+/// \brief record a message (use blog_pX macros instead)
+///
+void blog_write(RBinLogSite *site, const char *fmt, ...);
+
+///
+/// \brief render a binary log file to text
+/// \param fn - binary log file
+/// \param fp - output file (stdout for default)
+/// \return number of decoded messages (-1 if failed)
+///
+int  blog_decode(const std::string &fn, FILE *fp = stdout);
+
+
+#define blog_printf(lvl, ...) \
+    do { \
+        static rtk::RBinLogSite __blog_site = \
+            {0, lvl, __FILE__, __LINE__, __FUNCTION__, NULL, 0, {0}}; \
+        rtk::blog_write(&__blog_site, __VA_ARGS__); \
+    } while(0)
+
+// level 1: error message
+#define blog_pe(...) blog_printf(1, __VA_ARGS__)
+
+// level 2: warning message
+#define blog_pw(...) blog_printf(2, __VA_ARGS__)
+
+// level 3: information message
+#define blog_pi(...) blog_printf(3, __VA_ARGS__)
+
+// level 4: trace message
+#define blog_pt(...) blog_printf(4, __VA_ARGS__)
+
+} // end of namespace rtk
+
+#endif // end of __RTK_BINLOG_H__
@@ -0,0 +1,264 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef __RTK_PARAMREGISTRY_H__
+#define __RTK_PARAMREGISTRY_H__
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "rtk_types.h"
+#include "rtk_paramarray.h"
+
+namespace rtk {
+
+////////////////////////////////////////////////////////////////////////////////
+/// Typed parameter registry
+///
+///     Parameters are declared once (usually as static RParam<T> objects) and
+///     bound to a slot in the registry when they are constructed. After that
+///     reading a value is a single pointer load, no string lookup and no type
+///     conversion is done on the hot path.
+///
+///     Example:
+///         static RParam<int>    g_rssiMin("uas_rssi_min", 90);
+///         ...
+///         int v = g_rssiMin();            // O(1) read
+///         g_rssiMin.set(80);              // change & notify callbacks
+///
+////////////////////////////////////////////////////////////////////////////////
+
+///
+/// \brief FNV-1a 32-bit hash of a parameter name
+/// \param s - parameter name
+/// \return hash value
+///
+inline ru32 param_hash(const char *s)
+{
+    ru32 h = 2166136261u;
+
+    while( *s ) {
+        h ^= (ru8) *s++;
+        h *= 16777619u;
+    }
+
+    return h;
+}
+
+class RParamSlot;
+
+///
+/// \brief parameter change callback
+/// \param slot - changed parameter slot
+/// \param arg  - user argument given at registration
+///
+typedef void (*RParamCallback)(RParamSlot *slot, void *arg);
+
+///
+/// \brief The parameter slot class (one per parameter name)
+///
+class RParamSlot
+{
+public:
+    RParamSlot(const char *n, ru32 h, CVariantType t);
+    ~RParamSlot() {}
+
+    // typed raw pointers (stable for the life time of registry)
+    int*    pi(void) { return &m_iVal; }
+    float*  pf(void) { return &m_fVal; }
+    double* pd(void) { return &m_dVal; }
+
+    // set value (convert to slot type & notify callbacks)
+    void set_i(int v);
+    void set_f(float v);
+    void set_d(double v);
+    void set_s(const std::string &v);
+
+    // get value as string (for serialization)
+    std::string to_s(void);
+
+    const std::string&  name(void) { return m_name; }
+    ru32                hash(void) { return m_hash; }
+    CVariantType        type(void) { return m_type; }
+
+    ///
+    /// \brief generation counter, increased by one on each change
+    ///
+    ru32                generation(void) { return m_gen; }
+
+    int addCallback(RParamCallback f, void *arg);
+    int delCallback(RParamCallback f, void *arg);
+
+protected:
+    void notify(void);
+
+protected:
+    std::string         m_name;             ///< parameter name
+    ru32                m_hash;             ///< name hash
+    CVariantType        m_type;             ///< value type
+
+    int                 m_iVal;             ///< integer value
+    float               m_fVal;             ///< float value
+    double              m_dVal;             ///< double value
+    std::string         m_sVal;             ///< string value
+
+    volatile ru32       m_gen;              ///< change generation
+
+    std::vector<RParamCallback> m_cbFunc;   ///< callback functions
+    std::vector<void*>          m_cbArg;    ///< callback arguments
+};
+
+
+///
+/// \brief The parameter registry class
+///
+class RParamRegistry
+{
+public:
+    RParamRegistry();
+    virtual ~RParamRegistry();
+
+    ///
+    /// \brief get or create a slot
+    /// \param n - parameter name
+    /// \param t - value type (only used when the slot is created)
+    /// \return slot pointer (NULL if hash collision or the name has an other type)
+    ///
+    RParamSlot* reg(const char *n, CVariantType t);
+
+    ///
+    /// \brief find a slot by name or hash
+    /// \return slot pointer (NULL if not exist)
+    ///
+    RParamSlot* find(const char *n);
+    RParamSlot* find(ru32 h);
+
+    // number of slots & slot by index
+    int         size(void) { return m_slots.size(); }
+    RParamSlot* at(int i)  { return m_slots[i]; }
+
+    ///
+    /// \brief copy values from/to a CParamArray (only registered keys)
+    /// \return number of copied items
+    ///
+    int from_pa(CParamArray &pa);
+    int to_pa(CParamArray &pa);
+
+    ///
+    /// \brief load/save registered values from/to a CParamArray::load file
+    ///
+    int load(const std::string &f);
+    int save(const std::string &f);
+
+    // print all parameters
+    void print(void);
+
+protected:
+    std::vector<RParamSlot*>        m_slots;    ///< slot array
+    std::map<ru32, RParamSlot*>     m_hashMap;  ///< hash -> slot
+};
+
+RParamRegistry* pr_get(void);
+
+
+///
+/// \brief Typed parameter key
+///
+template<class T>
+class RParam
+{
+public:
+    RParam(const char *n, T defVal, RParamRegistry *r = NULL);
+
+    ///
+    /// \brief get value (a single pointer load)
+    ///
+    T operator ()(void) const { return *m_val; }
+    T get(void) const { return *m_val; }
+
+    void set(T v);
+
+    RParamSlot* slot(void) { return m_slot; }
+
+protected:
+    RParamSlot      *m_slot;
+    T               *m_val;
+    T               m_dummy;
+};
+
+template<> inline RParam<int>::RParam(const char *n, int defVal, RParamRegistry *r)
+{
+    if( r == NULL ) r = pr_get();
+    int bNew = (r->find(n) == NULL);
+
+    m_dummy = defVal;
+    m_slot  = r->reg(n, VT_INT);
+    m_val   = (m_slot != NULL) ? m_slot->pi() : &m_dummy;
+    if( bNew && m_slot != NULL ) m_slot->set_i(defVal);
+}
+
+template<> inline RParam<float>::RParam(const char *n, float defVal, RParamRegistry *r)
+{
+    if( r == NULL ) r = pr_get();
+    int bNew = (r->find(n) == NULL);
+
+    m_dummy = defVal;
+    m_slot  = r->reg(n, VT_FLOAT);
+    m_val   = (m_slot != NULL) ? m_slot->pf() : &m_dummy;
+    if( bNew && m_slot != NULL ) m_slot->set_f(defVal);
+}
+
+template<> inline RParam<double>::RParam(const char *n, double defVal, RParamRegistry *r)
+{
+    if( r == NULL ) r = pr_get();
+    int bNew = (r->find(n) == NULL);
+
+    m_dummy = defVal;
+    m_slot  = r->reg(n, VT_DOUBLE);
+    m_val   = (m_slot != NULL) ? m_slot->pd() : &m_dummy;
+    if( bNew && m_slot != NULL ) m_slot->set_d(defVal);
+}
+
+template<> inline void RParam<int>::set(int v)
+{
+    if( m_slot != NULL ) m_slot->set_i(v);
+    else                 m_dummy = v;
+}
+
+template<> inline void RParam<float>::set(float v)
+{
+    if( m_slot != NULL ) m_slot->set_f(v);
+    else                 m_dummy = v;
+}
+
+template<> inline void RParam<double>::set(double v)
+{
+    if( m_slot != NULL ) m_slot->set_d(v);
+    else                 m_dummy = v;
+}
+
+} // end of namespace rtk
+
+#endif // end of __RTK_PARAMREGISTRY_H__
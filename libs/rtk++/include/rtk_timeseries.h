@@ -0,0 +1,259 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#ifndef __RTK_TIMESERIES_H__
+#define __RTK_TIMESERIES_H__
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "rtk_types.h"
+
+namespace rtk {
+
+////////////////////////////////////////////////////////////////////////////////
+/// Time-series store for telemetry channels
+///
+///     Each channel keeps the latest samples in fixed-size column rings
+///     (time, value) and a pyramid of min/max/mean buckets. Level k bucket
+///     summarizes factor^k samples, every level is a ring of the same
+///     capacity, so coarse levels reach back hours while memory stays fixed.
+///     query() uses the finest level covering the range with at most 4
+///     items per output bin, so plotting hours costs O(bins), not O(samples).
+///
+///     Example:
+///         RTimeSeriesStore    ts;
+///         RTimeSeries         *alt = ts.channel("gp_alt");
+///
+///         alt->push(t, v);                        // receiving thread
+///         alt->query(t - 3600, t, 800, bins);     // plot widget
+///
+////////////////////////////////////////////////////////////////////////////////
+
+///
+/// \brief running statistics of all pushed samples (O(1) per sample)
+///
+struct RTimeSeriesStats
+{
+    ru64        n;                      ///< sample number
+    double      min, max;               ///< min/max value
+    double      mean;                   ///< mean value
+    double      m2;                     ///< sum of squared differences (Welford)
+    double      tFirst, tLast;          ///< time of the first/last sample
+    double      vLast;                  ///< last value
+
+    double var(void) const { return n > 1 ? m2 / (n - 1) : 0.0; }
+};
+
+///
+/// \brief one output bin of a query (or one pyramid bucket)
+///
+struct RTimeSeriesBin
+{
+    double      t;                      ///< time of the first sample
+    double      min, max;               ///< value envelope
+    double      sum;                    ///< sum of the values
+    int         n;                      ///< sample number (0: empty bin)
+
+    double mean(void) const { return n > 0 ? sum / n : 0.0; }
+};
+
+class RTimeSeries;
+
+///
+/// \brief new sample callback
+///
+///     Called in the pushing thread with the channel locked: keep it short
+///     (e.g. mark a plot dirty) and do not access the channel from it.
+///
+typedef void (*RTimeSeriesCallback)(RTimeSeries *ch, double t, double v, void *arg);
+
+
+///
+/// \brief one telemetry channel
+///
+class RTimeSeries
+{
+public:
+    ///
+    /// \param name     - channel name
+    /// \param capacity - ring size of the samples & of each pyramid level
+    /// \param nLevel   - pyramid levels above the raw samples
+    /// \param factor   - samples (buckets) merged into one bucket of the next level
+    ///
+    RTimeSeries(const std::string &name, int capacity = 16384,
+                int nLevel = 3, int factor = 16);
+    virtual ~RTimeSeries();
+
+    ///
+    /// \brief append a sample, the time must not decrease
+    ///
+    void push(double t, double v);
+
+    ///
+    /// \brief min/max/mean envelope of [t0, t1] in nBin equal bins
+    /// \param bins - output bins (bins with n == 0 have no data)
+    /// \return pyramid level used (0: raw samples), -1 if no data
+    ///
+    int query(double t0, double t1, int nBin, std::vector<RTimeSeriesBin> &bins);
+
+    ///
+    /// \brief copy the raw samples in [t0, t1]
+    /// \return sample number
+    ///
+    int samples(double t0, double t1, std::vector<double> &ts, std::vector<double> &vs);
+
+    ///
+    /// \brief remove all samples & statistics
+    ///
+    void clear(void);
+
+    ///
+    /// \brief running statistics since created or cleared
+    ///
+    RTimeSeriesStats stats(void);
+
+    ///
+    /// \brief subscribe to new samples (e.g. mark a plot dirty)
+    ///
+    int subscribe(RTimeSeriesCallback cb, void *arg);
+    int unsubscribe(RTimeSeriesCallback cb, void *arg);
+
+    ///
+    /// \brief number of stored raw samples
+    ///
+    int size(void);
+
+    ///
+    /// \brief oldest time kept by a level (0: raw samples)
+    ///
+    double first_time(int level = 0);
+
+    const std::string& name(void) { return m_name; }
+    int capacity(void) { return m_capacity; }
+    int levels(void) { return m_nLevel; }
+    int factor(void) { return m_factor; }
+
+    ///
+    /// \brief allocated memory (bytes), fixed after construction
+    ///
+    size_t memory_usage(void);
+
+protected:
+    struct Level
+    {
+        std::vector<RTimeSeriesBin>     buckets;    ///< ring of buckets
+        int                             head;       ///< index of the oldest bucket
+        int                             n;          ///< bucket number
+        RTimeSeriesBin                  pending;    ///< bucket being filled
+        int                             nMerged;    ///< samples/buckets in pending
+    };
+
+    void level_push(int l, const RTimeSeriesBin &b);
+    int  lower_bound(int l, double t);
+    const RTimeSeriesBin& level_at(int l, int i) {
+        Level &lv = m_levels[l];
+        return lv.buckets[(lv.head + i) % m_capacity];
+    }
+
+    std::string                     m_name;
+    int                             m_capacity;
+    int                             m_nLevel;
+    int                             m_factor;
+
+    // raw samples (columns)
+    std::vector<double>             m_t, m_v;
+    int                             m_head, m_n;
+
+    // pyramid level 1 .. nLevel (m_levels[0] is unused)
+    std::vector<Level>              m_levels;
+
+    RTimeSeriesStats                m_stats;
+
+    std::vector<RTimeSeriesCallback>    m_cbs;
+    std::vector<void*>                  m_cbArgs;
+
+    pthread_mutex_t                 m_mutex;
+};
+
+
+///
+/// \brief named channels
+///
+class RTimeSeriesStore
+{
+public:
+    RTimeSeriesStore(int capacity = 16384, int nLevel = 3, int factor = 16);
+    virtual ~RTimeSeriesStore();
+
+    ///
+    /// \brief get a channel, created with the store defaults if not exist
+    ///
+    RTimeSeries* channel(const std::string &name);
+
+    ///
+    /// \brief get a channel, NULL if not exist
+    ///
+    RTimeSeries* find(const std::string &name);
+
+    ///
+    /// \brief subscribe to a channel (created if not exist)
+    ///
+    int subscribe(const std::string &name, RTimeSeriesCallback cb, void *arg);
+    int unsubscribe(const std::string &name, RTimeSeriesCallback cb, void *arg);
+
+    ///
+    /// \brief channel names
+    ///
+    int channel_names(std::vector<std::string> &names);
+
+    ///
+    /// \brief total memory of all channels (bytes)
+    ///
+    size_t memory_usage(void);
+
+    ///
+    /// \brief print channels, sizes & memory usage
+    ///
+    void print(void);
+
+    void clear(void);
+
+protected:
+    typedef std::map<std::string, RTimeSeries*> ChannelMap;
+
+    ChannelMap                      m_channels;
+    int                             m_capacity;
+    int                             m_nLevel;
+    int                             m_factor;
+
+    pthread_mutex_t                 m_mutex;
+};
+
+} // end of namespace rtk
+
+#endif // end of __RTK_TIMESERIES_H__
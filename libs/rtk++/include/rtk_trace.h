@@ -0,0 +1,172 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+
+#ifndef __RTK_TRACE_H__
+#define __RTK_TRACE_H__
+
+#include <string>
+
+#include "rtk_types.h"
+#include "rtk_utils.h"
+
+namespace rtk {
+
+////////////////////////////////////////////////////////////////////////////////
+/// Scoped-zone tracing
+///
+///     RTK_TRACE_ZONE("name") records the begin/end TSC time stamp of the
+///     enclosing scope into a per-thread ring buffer (the oldest events are
+///     overwritten). Recording is started by trace_start() and the events
+///     can be saved as Chrome trace_event JSON (chrome://tracing, Perfetto)
+///     or as a compact binary file.
+///
+///     The macros are compiled out unless RTK_TRACE is defined, e.g.
+///         qmake "DEFINES+=RTK_TRACE"
+///     Zone names must be string literals (only the pointer is stored).
+///
+////////////////////////////////////////////////////////////////////////////////
+
+///
+/// \brief one recorded zone
+///
+struct RTraceEvent
+{
+    const char      *name;          ///< zone name (string literal)
+    ru64            t0;             ///< begin time (TSC)
+    ru64            t1;             ///< end time (TSC)
+};
+
+///
+/// \brief per-thread event buffer
+///
+struct RTraceBuffer
+{
+    RTraceEvent     *events;        ///< event ring
+    ru32            size;           ///< ring size (power of 2)
+    volatile ru32   head;           ///< number of written events
+
+    int             tid;            ///< thread index
+    char            threadName[32]; ///< thread name
+
+    RTraceBuffer    *next;          ///< next buffer in global list
+};
+
+extern volatile int g_traceEnabled;
+
+///
+/// \brief start recording
+/// \param ringSize - events kept per thread
+///
+int  trace_start(int ringSize = 65536);
+
+///
+/// \brief stop recording (recorded events are kept until trace_clear)
+///
+int  trace_stop(void);
+
+///
+/// \brief drop all recorded events
+///
+int  trace_clear(void);
+
+///
+/// \brief set name of the calling thread (shown in trace viewer)
+///
+void trace_thread_name(const char *name);
+
+///
+/// \brief save recorded events as Chrome trace_event JSON
+/// \return number of saved events (-1 if failed)
+///
+int  trace_save_json(const std::string &fn);
+
+///
+/// \brief save recorded events in binary format
+///     header : "RTRC" ver(u32) tsc_per_us(f64) nThreads(u32)
+///     thread : tid(i32) name(char[32]) nNames(u32) nEvents(u32)
+///              nNames x [len(u16) chars]
+///              nEvents x [name_idx(u32) t0(u64) t1(u64)]
+/// \return number of saved events (-1 if failed)
+///
+int  trace_save_bin(const std::string &fn);
+
+///
+/// \brief get buffer of the calling thread (created at first call)
+///
+RTraceBuffer* trace_buffer(void);
+
+
+///
+/// \brief scoped zone (use RTK_TRACE_ZONE instead)
+///
+class RTraceZone
+{
+public:
+    RTraceZone(const char *name) {
+        if( g_traceEnabled ) {
+            m_buf = trace_buffer();
+            m_name = name;
+            m_t0 = tm_get_tsc();
+        } else {
+            m_buf = NULL;
+        }
+    }
+
+    ~RTraceZone() {
+        if( m_buf != NULL ) {
+            RTraceEvent *e = m_buf->events + (m_buf->head & (m_buf->size-1));
+
+            e->name = m_name;
+            e->t0   = m_t0;
+            e->t1   = tm_get_tsc();
+
+            __asm__ __volatile__ ("" ::: "memory");
+            m_buf->head ++;
+        }
+    }
+
+protected:
+    RTraceBuffer    *m_buf;
+    const char      *m_name;
+    ru64            m_t0;
+};
+
+
+#ifdef RTK_TRACE
+    #define RTK_TRACE_CAT2(a, b)        a##b
+    #define RTK_TRACE_CAT(a, b)         RTK_TRACE_CAT2(a, b)
+
+    #define RTK_TRACE_ZONE(name)        rtk::RTraceZone RTK_TRACE_CAT(__trace_zone_, __LINE__)(name)
+    #define RTK_TRACE_FUNC()            RTK_TRACE_ZONE(__FUNCTION__)
+    #define RTK_TRACE_THREAD(name)      rtk::trace_thread_name(name)
+#else
+    #define RTK_TRACE_ZONE(name)
+    #define RTK_TRACE_FUNC()
+    #define RTK_TRACE_THREAD(name)
+#endif
+
+} // end of namespace rtk
+
+#endif // end of __RTK_TRACE_H__
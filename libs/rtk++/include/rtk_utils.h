@@ -61,6 +61,27 @@ ru64 tm_get_ms(void);
 ///
 ru64 tm_get_us(void);
 
+///
+/// \brief get CPU time-stamp counter (tm_get_us() on non-x86 targets)
+/// \return time-stamp counter value
+///
+inline ru64 tm_get_tsc(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    ru32 lo, hi;
+    __asm__ __volatile__ ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((ru64) hi << 32) | lo;
+#else
+    return tm_get_us();
+#endif
+}
+
+///
+/// \brief get tm_get_tsc() ticks per micro-second (calibrated at first call)
+/// \return ticks per micro-second
+///
+double tm_tsc_per_us(void);
+
 ///
 /// \brief sleep a mil-second
 /// \param t - mil-second (unsigned 32-bit interger)
@@ -22,6 +22,7 @@ INCLUDEPATH += . include include/osa src/osa include/cppformat src/utils
 # Input
 HEADERS += include/rtk_3d.h \
            include/rtk_app.h \
+           include/rtk_binlog.h \
            include/rtk_cv.h \
            include/rtk_datetime.h \
            include/rtk_datastream.h \
@@ -32,8 +33,11 @@ HEADERS += include/rtk_3d.h \
            include/rtk_osa++.h \
            include/rtk_osa.h \
            include/rtk_paramarray.h \
+           include/rtk_paramregistry.h \
            include/rtk_pr.h \
            include/rtk_test_module.h \
+           include/rtk_timeseries.h \
+           include/rtk_trace.h \
            include/rtk_types.h \
            include/rtk_UART.h \
            include/rtk_utils.h \
@@ -77,11 +81,15 @@ SOURCES += src/osa/_osa_in.cpp \
            src/utils/cppformat_posix.cpp \
            src/utils/dSFMT.cpp \
            src/utils/rtk_3d.cpp \
+           src/utils/rtk_binlog.cpp \
            src/utils/rtk_datetime.cpp \
            src/utils/rtk_datastream.cpp \
            src/utils/rtk_debug.cpp \
            src/utils/rtk_math.cpp \
            src/utils/rtk_paramarray.cpp \
+           src/utils/rtk_paramregistry.cpp \
+           src/utils/rtk_timeseries.cpp \
+           src/utils/rtk_trace.cpp \
            src/utils/rtk_UART.cpp \
            src/utils/rtk_utils.cpp \
            test/osa/test_osa_main.cpp \
@@ -119,11 +127,15 @@ SOURCES += src/osa/_osa_in.cpp \
            test/osa_ex/test_osaex_thread_7.cpp \
            test/utils/test_cppformat.cpp \
            test/utils/test_rtk_3d.cpp \
+           test/utils/test_rtk_binlog.cpp \
            test/utils/test_rtk_datetime.cpp \
            test/utils/test_rtk_datastream.cpp \
            test/utils/test_rtk_debug.cpp \
+           test/utils/test_rtk_paramregistry.cpp \
            test/utils/test_rtk_string.cpp \
            test/utils/test_rtk_testModule.cpp \
+           test/utils/test_rtk_timeseries.cpp \
+           test/utils/test_rtk_trace.cpp \
            test/utils/test_rtk_types.cpp \
            test/utils/test_rtk_utils.cpp \
            src/osa/linux/osa_cv_linux.cpp \
@@ -177,6 +177,8 @@ OSA_RESULT _osa_t_setup_signal(void)
         d1(printf("osa_t_init: failed to regist SIGCONT signal handler\n"));
         return -1;
     }
+
+    return 0;
 }
 
 /******************************************************************************
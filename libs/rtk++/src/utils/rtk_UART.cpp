@@ -30,6 +30,14 @@
 #include <time.h>
 #include <errno.h>
 
+// system headers outside namespace rtk (::close, ::write)
+#ifdef RTK_LINUX
+#include <unistd.h>
+#include <termios.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
 #include "rtk_utils.h"
 #include "rtk_debug.h"
 #include "rtk_UART.h"
@@ -371,11 +379,6 @@ int RUART::read(void *d, int *len)
 
 #ifdef RTK_LINUX
 
-#include <unistd.h>
-#include <termios.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -672,9 +675,8 @@ int RUART::read(void *d, int len)
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 
-RVirtualUART::RVirtualUART()
+RVirtualUART::RVirtualUART() : RUART()
 {
-    RUART::RUART();
 }
 
 RVirtualUART::~RVirtualUART()
@@ -708,6 +710,8 @@ int RVirtualUART::close(void)
         fclose(uid->fp);
         uid->fp = NULL;
     }
+
+    return 0;
 }
 
 int RVirtualUART::write(void *d, int len)
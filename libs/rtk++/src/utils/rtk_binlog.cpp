@@ -0,0 +1,688 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#include <unistd.h>
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "rtk_debug.h"
+#include "rtk_utils.h"
+#include "rtk_binlog.h"
+
+using namespace std;
+
+namespace rtk {
+
+#define BLOG_MAGIC              "RBLG"
+#define BLOG_VERSION            1
+
+#define BLOG_BLOCK_SITE         1
+#define BLOG_BLOCK_EVENTS       2
+
+#define BLOG_STR_MAXLEN         255
+#define BLOG_REC_MAXLEN         (16 + RTK_BINLOG_MAX_ARGS*(BLOG_STR_MAXLEN+1))
+
+// producer side write barrier (x86 keeps store order, only stop the compiler)
+#if defined(__i386__) || defined(__x86_64__)
+    #define BLOG_WMB()  __asm__ __volatile__ ("" ::: "memory")
+#else
+    #define BLOG_WMB()  __sync_synchronize()
+#endif
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// per-thread ring buffer (single producer, single consumer)
+////////////////////////////////////////////////////////////////////////////////
+
+struct BLogRing
+{
+    ru8             *buf;           ///< data buffer
+    ru32            size;           ///< buffer size (power of 2)
+    volatile ru32   head;           ///< written by producer
+    volatile ru32   tail;           ///< written by consumer
+
+    BLogRing        *next;          ///< next ring in global list
+};
+
+static pthread_mutex_t          g_blogMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t          g_blogFlushMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t                g_blogThread;
+
+static volatile int             g_blogOpened = 0;
+static volatile int             g_blogRunning = 0;
+static FILE                     *g_blogFile = NULL;
+static ru32                     g_blogRingSize = 65536;
+
+static BLogRing * volatile      g_blogRings = NULL;
+static vector<RBinLogSite*>     g_blogSites;
+static int                      g_blogSitesWritten = 0;
+static volatile ru64            g_blogDropped = 0;
+
+static __thread BLogRing        *t_blogRing = NULL;
+
+
+static BLogRing* blog_ring_create(void)
+{
+    BLogRing    *r;
+
+    r = new BLogRing;
+    r->size = g_blogRingSize;
+    r->buf  = new ru8[r->size];
+    r->head = 0;
+    r->tail = 0;
+
+    pthread_mutex_lock(&g_blogMutex);
+    r->next = g_blogRings;
+    __sync_synchronize();
+    g_blogRings = r;
+    pthread_mutex_unlock(&g_blogMutex);
+
+    return r;
+}
+
+static inline int blog_ring_put(BLogRing *r, ru8 *d, ru32 len)
+{
+    ru32    head, tail, p, l1;
+
+    head = r->head;
+    tail = r->tail;
+
+    if( r->size - (head - tail) < len ) return -1;
+
+    p  = head & (r->size - 1);
+    l1 = r->size - p;
+    if( l1 >= len ) {
+        memcpy(r->buf + p, d, len);
+    } else {
+        memcpy(r->buf + p, d, l1);
+        memcpy(r->buf, d + l1, len - l1);
+    }
+
+    BLOG_WMB();
+    r->head = head + len;
+
+    return 0;
+}
+
+static int blog_ring_drain(BLogRing *r, FILE *fp)
+{
+    ru32    head, tail, len, p, l1;
+    ru8     t = BLOG_BLOCK_EVENTS;
+
+    head = r->head;
+    __sync_synchronize();
+    tail = r->tail;
+
+    len = head - tail;
+    if( len == 0 ) return 0;
+
+    fwrite(&t, 1, 1, fp);
+    fwrite(&len, sizeof(ru32), 1, fp);
+
+    p  = tail & (r->size - 1);
+    l1 = r->size - p;
+    if( l1 >= len ) {
+        fwrite(r->buf + p, 1, len, fp);
+    } else {
+        fwrite(r->buf + p, 1, l1, fp);
+        fwrite(r->buf, 1, len - l1, fp);
+    }
+
+    __sync_synchronize();
+    r->tail = head;
+
+    return len;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// format string parsing
+////////////////////////////////////////////////////////////////////////////////
+
+static int blog_parse_fmt(const char *fmt, ru8 *types, int maxN)
+{
+    const char  *p = fmt;
+    int         n = 0, l;
+
+    while( *p ) {
+        if( *p++ != '%' ) continue;
+        if( *p == '%' ) { p++; continue; }
+
+        // flags
+        while( *p && strchr("-+ #0'", *p) ) p++;
+
+        // width
+        if( *p == '*' ) {
+            if( n < maxN ) types[n++] = BLOG_ARG_INT;
+            p++;
+        }
+        while( *p >= '0' && *p <= '9' ) p++;
+
+        // precision
+        if( *p == '.' ) {
+            p++;
+            if( *p == '*' ) {
+                if( n < maxN ) types[n++] = BLOG_ARG_INT;
+                p++;
+            }
+            while( *p >= '0' && *p <= '9' ) p++;
+        }
+
+        // length modifier
+        l = 0;
+        while( *p && strchr("hlLqjzt", *p) ) {
+            if( *p == 'l' || *p == 'q' || *p == 'L' ) l++;
+            else if( *p == 'j' || *p == 'z' || *p == 't' ) l = 1;
+            p++;
+        }
+
+        if( *p == 0 ) break;
+        if( n >= maxN ) break;
+
+        switch( *p ) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X': case 'c':
+            if( l == 0 )      types[n++] = BLOG_ARG_INT;
+            else if( l == 1 ) types[n++] = BLOG_ARG_LONG;
+            else              types[n++] = BLOG_ARG_LLONG;
+            break;
+
+        case 'e': case 'E': case 'f': case 'F':
+        case 'g': case 'G': case 'a': case 'A':
+            types[n++] = BLOG_ARG_DOUBLE;
+            break;
+
+        case 's':
+            types[n++] = BLOG_ARG_STR;
+            break;
+
+        default:
+            types[n++] = BLOG_ARG_PTR;
+            break;
+        }
+
+        p++;
+    }
+
+    return n;
+}
+
+static void blog_register(RBinLogSite *site, const char *fmt)
+{
+    pthread_mutex_lock(&g_blogMutex);
+
+    if( site->id == 0 ) {
+        site->fmt   = fmt;
+        site->nArgs = blog_parse_fmt(fmt, site->argTypes, RTK_BINLOG_MAX_ARGS);
+
+        g_blogSites.push_back(site);
+
+        __sync_synchronize();
+        site->id = g_blogSites.size();
+    }
+
+    pthread_mutex_unlock(&g_blogMutex);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// writer thread
+////////////////////////////////////////////////////////////////////////////////
+
+static void blog_write_str(FILE *fp, const char *s)
+{
+    ru16    l = strlen(s);
+
+    fwrite(&l, sizeof(ru16), 1, fp);
+    fwrite(s, 1, l, fp);
+}
+
+static void blog_flush_inner(void)
+{
+    RBinLogSite     *s;
+    BLogRing        *r;
+    ru8             t = BLOG_BLOCK_SITE;
+    ri32            v;
+
+    // only one consumer at a time
+    pthread_mutex_lock(&g_blogFlushMutex);
+
+    // write new site definitions first (events always refer to old sites)
+    pthread_mutex_lock(&g_blogMutex);
+    for(; g_blogSitesWritten < g_blogSites.size(); g_blogSitesWritten++) {
+        s = g_blogSites[g_blogSitesWritten];
+
+        fwrite(&t, 1, 1, g_blogFile);
+        fwrite((void*) &s->id, sizeof(ru32), 1, g_blogFile);
+        v = s->level;   fwrite(&v, sizeof(ri32), 1, g_blogFile);
+        v = s->line;    fwrite(&v, sizeof(ri32), 1, g_blogFile);
+        blog_write_str(g_blogFile, s->file);
+        blog_write_str(g_blogFile, s->func);
+        blog_write_str(g_blogFile, s->fmt);
+    }
+    r = g_blogRings;
+    pthread_mutex_unlock(&g_blogMutex);
+
+    // drain each thread's buffer
+    for(; r != NULL; r = r->next) blog_ring_drain(r, g_blogFile);
+
+    fflush(g_blogFile);
+
+    pthread_mutex_unlock(&g_blogFlushMutex);
+}
+
+static void* blog_thread_func(void *arg)
+{
+    while( g_blogRunning ) {
+        blog_flush_inner();
+        usleep(10000);
+    }
+
+    return NULL;
+}
+
+int blog_open(const string &fn, int ringSize)
+{
+    ru64    tsc0, us0;
+    double  tsc_per_us;
+    ru32    ver = BLOG_VERSION;
+
+    if( g_blogOpened ) blog_close();
+
+    g_blogFile = fopen(fn.c_str(), "wb");
+    if( g_blogFile == NULL ) {
+        dbg_pe("Failed to open file: %s\n", fn.c_str());
+        return -1;
+    }
+
+    // ring size must be power of 2
+    g_blogRingSize = 1024;
+    while( g_blogRingSize < ringSize ) g_blogRingSize *= 2;
+
+    // file header
+    tsc_per_us = tm_tsc_per_us();
+    tsc0       = tm_get_tsc();
+    us0        = tm_get_us();
+
+    fwrite(BLOG_MAGIC, 1, 4, g_blogFile);
+    fwrite(&ver, sizeof(ru32), 1, g_blogFile);
+    fwrite(&tsc_per_us, sizeof(double), 1, g_blogFile);
+    fwrite(&tsc0, sizeof(ru64), 1, g_blogFile);
+    fwrite(&us0, sizeof(ru64), 1, g_blogFile);
+
+    g_blogSitesWritten = 0;
+    g_blogDropped = 0;
+
+    g_blogRunning = 1;
+    if( 0 != pthread_create(&g_blogThread, NULL, blog_thread_func, NULL) ) {
+        dbg_pe("Failed to create log writer thread\n");
+        fclose(g_blogFile);
+        g_blogFile = NULL;
+        g_blogRunning = 0;
+        return -1;
+    }
+
+    __sync_synchronize();
+    g_blogOpened = 1;
+
+    return 0;
+}
+
+int blog_close(void)
+{
+    if( !g_blogOpened ) return -1;
+
+    g_blogOpened = 0;
+    g_blogRunning = 0;
+    pthread_join(g_blogThread, NULL);
+
+    blog_flush_inner();
+
+    fclose(g_blogFile);
+    g_blogFile = NULL;
+
+    return 0;
+}
+
+int blog_flush(void)
+{
+    if( !g_blogOpened ) return -1;
+
+    blog_flush_inner();
+
+    return 0;
+}
+
+ru64 blog_dropped(void)
+{
+    return g_blogDropped;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// write a message
+////////////////////////////////////////////////////////////////////////////////
+
+void blog_write(RBinLogSite *site, const char *fmt, ...)
+{
+    ru8         rec[BLOG_REC_MAXLEN];
+    ru32        p;
+    ru16        len;
+    ru64        tsc;
+    va_list     va;
+
+    if( site->level > dbg_get_level() ) return;
+
+    // not opened, print the message directly
+    if( !g_blogOpened ) {
+        char buf[BLOG_REC_MAXLEN];
+
+        va_start(va, fmt);
+        vsnprintf(buf, BLOG_REC_MAXLEN, fmt, va);
+        va_end(va);
+
+        dbg_printf(site->level, site->file, site->line, site->func, "%s", buf);
+        return;
+    }
+
+    if( site->id == 0 ) blog_register(site, fmt);
+    if( t_blogRing == NULL ) t_blogRing = blog_ring_create();
+
+    // record header: len, reserved, site id, time stamp
+    tsc = tm_get_tsc();
+    p = 4;
+    memcpy(rec+p, (void*) &site->id, sizeof(ru32));  p += sizeof(ru32);
+    memcpy(rec+p, &tsc, sizeof(ru64));               p += sizeof(ru64);
+
+    // raw arguments
+    va_start(va, fmt);
+    for(int i=0; i<site->nArgs; i++) {
+        switch( site->argTypes[i] ) {
+        case BLOG_ARG_INT: {
+            int v = va_arg(va, int);
+            memcpy(rec+p, &v, sizeof(v));   p += sizeof(v);
+            break;
+        }
+
+        case BLOG_ARG_LONG:
+        case BLOG_ARG_LLONG: {
+            long long v;
+            if( site->argTypes[i] == BLOG_ARG_LONG ) v = va_arg(va, long);
+            else                                     v = va_arg(va, long long);
+            memcpy(rec+p, &v, sizeof(v));   p += sizeof(v);
+            break;
+        }
+
+        case BLOG_ARG_DOUBLE: {
+            double v = va_arg(va, double);
+            memcpy(rec+p, &v, sizeof(v));   p += sizeof(v);
+            break;
+        }
+
+        case BLOG_ARG_STR: {
+            const char *s = va_arg(va, const char *);
+            ru32       l;
+
+            if( s == NULL ) s = "(null)";
+            l = strlen(s);
+            if( l > BLOG_STR_MAXLEN ) l = BLOG_STR_MAXLEN;
+
+            rec[p++] = l;
+            memcpy(rec+p, s, l);            p += l;
+            break;
+        }
+
+        default: {
+            ru64 v = (ru64)(size_t) va_arg(va, void *);
+            memcpy(rec+p, &v, sizeof(v));   p += sizeof(v);
+            break;
+        }
+        }
+    }
+    va_end(va);
+
+    len = p;
+    memcpy(rec, &len, sizeof(ru16));
+    rec[2] = 0;
+    rec[3] = 0;
+
+    if( 0 != blog_ring_put(t_blogRing, rec, p) )
+        __sync_fetch_and_add(&g_blogDropped, 1);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// offline decoder
+////////////////////////////////////////////////////////////////////////////////
+
+struct BLogDecSite
+{
+    int             level;
+    int             line;
+    string          file, func, fmt;
+
+    int             nArgs;
+    ru8             argTypes[RTK_BINLOG_MAX_ARGS];
+};
+
+static int blog_read_str(FILE *fp, string &s)
+{
+    ru16    l;
+    char    buf[65536];
+
+    if( 1 != fread(&l, sizeof(ru16), 1, fp) ) return -1;
+    if( l != fread(buf, 1, l, fp) ) return -1;
+    buf[l] = 0;
+    s = buf;
+
+    return 0;
+}
+
+///
+/// render one message, arguments are stored in a raw record buffer
+///
+static string blog_render(BLogDecSite &s, ru8 *d, int len)
+{
+    const char  *f = s.fmt.c_str();
+    const char  *p, *q;
+    string      out, spec;
+    char        buf[512];
+    int         ia = 0, pos = 0;
+
+    p = f;
+    while( *p ) {
+        if( *p != '%' ) { out += *p++; continue; }
+        if( p[1] == '%' ) { out += '%'; p += 2; continue; }
+
+        // copy conversion spec, replace '*' by decoded integer
+        spec = "";
+        q = p++;
+        spec += *q;
+        while( *p && !strchr("diouxXceEfFgGaAspn", *p) ) {
+            if( *p == '*' && ia < s.nArgs && pos + 4 <= len ) {
+                int v;
+                memcpy(&v, d+pos, sizeof(int));
+                pos += sizeof(int);
+                ia++;
+                snprintf(buf, sizeof(buf), "%d", v);
+                spec += buf;
+            } else {
+                spec += *p;
+            }
+            p++;
+        }
+        if( *p == 0 ) break;
+        spec += *p++;
+
+        if( ia >= s.nArgs ) break;
+
+        buf[0] = 0;
+        switch( s.argTypes[ia++] ) {
+        case BLOG_ARG_INT: {
+            int v;
+            memcpy(&v, d+pos, sizeof(v));   pos += sizeof(v);
+            snprintf(buf, sizeof(buf), spec.c_str(), v);
+            break;
+        }
+
+        case BLOG_ARG_LONG: {
+            long long v;
+            memcpy(&v, d+pos, sizeof(v));   pos += sizeof(v);
+            snprintf(buf, sizeof(buf), spec.c_str(), (long) v);
+            break;
+        }
+
+        case BLOG_ARG_LLONG: {
+            long long v;
+            memcpy(&v, d+pos, sizeof(v));   pos += sizeof(v);
+            snprintf(buf, sizeof(buf), spec.c_str(), v);
+            break;
+        }
+
+        case BLOG_ARG_DOUBLE: {
+            double v;
+            memcpy(&v, d+pos, sizeof(v));   pos += sizeof(v);
+            snprintf(buf, sizeof(buf), spec.c_str(), v);
+            break;
+        }
+
+        case BLOG_ARG_STR: {
+            char sv[BLOG_STR_MAXLEN+1];
+            int  l = d[pos++];
+            memcpy(sv, d+pos, l);           pos += l;
+            sv[l] = 0;
+            snprintf(buf, sizeof(buf), spec.c_str(), sv);
+            break;
+        }
+
+        default: {
+            ru64 v;
+            memcpy(&v, d+pos, sizeof(v));   pos += sizeof(v);
+            snprintf(buf, sizeof(buf), "%p", (void*)(size_t) v);
+            break;
+        }
+        }
+
+        out += buf;
+        if( pos > len ) break;
+    }
+
+    // remove tailing CR
+    while( out.size() > 0 && out[out.size()-1] == '\n' )
+        out.erase(out.size()-1);
+
+    return out;
+}
+
+int blog_decode(const string &fn, FILE *fpOut)
+{
+    FILE                        *fp;
+    char                        magic[4];
+    ru32                        ver, id, n, p;
+    double                      tsc_per_us;
+    ru64                        tsc0, us0, tsc;
+    ru8                         t;
+    ri32                        v;
+    ru16                        len;
+    int                         nMsg = 0;
+
+    map<ru32, BLogDecSite>      sites;
+    vector<ru8>                 blk;
+
+    const char                  *lvlName[] = {"", "ERR ", "WARN", "INFO", "TRAC", "NORM"};
+
+    fp = fopen(fn.c_str(), "rb");
+    if( fp == NULL ) {
+        dbg_pe("Failed to open file: %s\n", fn.c_str());
+        return -1;
+    }
+
+    // header
+    if( 4 != fread(magic, 1, 4, fp) || 0 != memcmp(magic, BLOG_MAGIC, 4) ) {
+        dbg_pe("Not a binary log file: %s\n", fn.c_str());
+        fclose(fp);
+        return -1;
+    }
+    fread(&ver, sizeof(ru32), 1, fp);
+    fread(&tsc_per_us, sizeof(double), 1, fp);
+    fread(&tsc0, sizeof(ru64), 1, fp);
+    fread(&us0, sizeof(ru64), 1, fp);
+
+    while( 1 == fread(&t, 1, 1, fp) ) {
+        if( t == BLOG_BLOCK_SITE ) {
+            BLogDecSite s;
+
+            fread(&id, sizeof(ru32), 1, fp);
+            fread(&v, sizeof(ri32), 1, fp);     s.level = v;
+            fread(&v, sizeof(ri32), 1, fp);     s.line  = v;
+            blog_read_str(fp, s.file);
+            blog_read_str(fp, s.func);
+            if( 0 != blog_read_str(fp, s.fmt) ) break;
+
+            s.nArgs = blog_parse_fmt(s.fmt.c_str(), s.argTypes, RTK_BINLOG_MAX_ARGS);
+            sites[id] = s;
+        } else if( t == BLOG_BLOCK_EVENTS ) {
+            if( 1 != fread(&n, sizeof(ru32), 1, fp) ) break;
+            blk.resize(n);
+            if( n != fread(&blk[0], 1, n, fp) ) break;
+
+            for(p=0; p + 16 <= n; p += len) {
+                memcpy(&len, &blk[p], sizeof(ru16));
+                memcpy(&id,  &blk[p+4], sizeof(ru32));
+                memcpy(&tsc, &blk[p+8], sizeof(ru64));
+                if( len < 16 || p + len > n ) break;
+
+                map<ru32, BLogDecSite>::iterator it = sites.find(id);
+                if( it == sites.end() ) continue;
+
+                BLogDecSite &s = it->second;
+                double tm = (us0 + ((ri64)(tsc - tsc0)) / tsc_per_us) / 1e6;
+
+                fprintf(fpOut, "%17.6f %s %s: %s  (%s:%d)\n",
+                        tm,
+                        (s.level >= 1 && s.level <= 5) ? lvlName[s.level] : "    ",
+                        s.func.c_str(),
+                        blog_render(s, &blk[p+16], len-16).c_str(),
+                        s.file.c_str(), s.line);
+                nMsg ++;
+            }
+        } else {
+            dbg_pe("Unknown block type: %d\n", t);
+            break;
+        }
+    }
+
+    fclose(fp);
+
+    return nMsg;
+}
+
+} // end of namespace rtk
@@ -190,6 +190,8 @@ int RDateTime::setDateTime(const RDateTime &dt)
 
     timeZone = dt.timeZone;
     dt_type  = dt.dt_type;
+
+    return 0;
 }
 
 int RDateTime::setDate(ri32 y, ri32 m, ri32 d,
@@ -391,6 +393,8 @@ const int RDateTime::toTM(struct tm *t) const
     t->tm_sec  = sec;
 
     t->tm_isdst = 0;
+
+    return 0;
 }
 
 const ri64 RDateTime::toTime_t(void) const
@@ -429,6 +433,8 @@ int RDateTime::fromTime_t(ri64 t)
     sec  = tm1->tm_sec;
 
     nano_sec = 0;
+
+    return 0;
 }
 
 const ri64 RDateTime::toTimeStamp(void) const
@@ -469,6 +475,8 @@ int RDateTime::fromTimeStamp(ri64 ts)
     sec  = tm1->tm_sec;
 
     nano_sec = (ts % 1000000)*1000;
+
+    return 0;
 }
 
 RDateTime& RDateTime::toUTC(void)
@@ -742,6 +750,8 @@ int RDateTime::fromStream(RDataStream &s, int isSingleDS)
 int set_timeZone(int tz)
 {
     g_timeZone = tz;
+
+    return 0;
 }
 
 int get_timeZone(void)
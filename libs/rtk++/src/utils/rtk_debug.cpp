@@ -519,6 +519,8 @@ int dbg_stacktrace_setup(void)
     signal( SIGBUS,  abortHandler );
     signal( SIGILL,  abortHandler );
     signal( SIGFPE,  abortHandler );
+
+    return 0;
 }
 
 
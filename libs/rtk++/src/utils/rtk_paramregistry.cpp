@@ -0,0 +1,358 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "rtk_debug.h"
+#include "rtk_utils.h"
+#include "rtk_paramregistry.h"
+
+using namespace std;
+
+namespace rtk {
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+RParamSlot::RParamSlot(const char *n, ru32 h, CVariantType t)
+{
+    m_name = n;
+    m_hash = h;
+    m_type = t;
+
+    m_iVal = 0;
+    m_fVal = 0;
+    m_dVal = 0;
+    m_sVal = "";
+
+    m_gen  = 0;
+}
+
+void RParamSlot::set_i(int v)
+{
+    switch(m_type) {
+    case VT_INT:
+        m_iVal = v;
+        break;
+
+    case VT_FLOAT:
+        m_fVal = (float) v;
+        break;
+
+    case VT_DOUBLE:
+        m_dVal = (double) v;
+        break;
+
+    default:
+        m_sVal = fmt::format("{}", v);
+        break;
+    }
+
+    notify();
+}
+
+void RParamSlot::set_f(float v)
+{
+    set_d(v);
+}
+
+void RParamSlot::set_d(double v)
+{
+    switch(m_type) {
+    case VT_INT:
+        m_iVal = (int) v;
+        break;
+
+    case VT_FLOAT:
+        m_fVal = (float) v;
+        break;
+
+    case VT_DOUBLE:
+        m_dVal = v;
+        break;
+
+    default:
+        m_sVal = fmt::format("{}", v);
+        break;
+    }
+
+    notify();
+}
+
+void RParamSlot::set_s(const string &v)
+{
+    string  s;
+
+    // remove quotation marks
+    s = trim(v);
+    if( s.size() >= 2 && s[0] == '\"' && s[s.size()-1] == '\"' )
+        s = s.substr(1, s.size()-2);
+
+    switch(m_type) {
+    case VT_INT:
+        m_iVal = str_to_int(s);
+        break;
+
+    case VT_FLOAT:
+        m_fVal = str_to_float(s);
+        break;
+
+    case VT_DOUBLE:
+        m_dVal = str_to_double(s);
+        break;
+
+    default:
+        m_sVal = s;
+        break;
+    }
+
+    notify();
+}
+
+string RParamSlot::to_s(void)
+{
+    switch(m_type) {
+    case VT_INT:
+        return fmt::format("{}", m_iVal);
+
+    case VT_FLOAT:
+        return fmt::format("{}", m_fVal);
+
+    case VT_DOUBLE:
+        return fmt::format("{}", m_dVal);
+
+    default:
+        return m_sVal;
+    }
+}
+
+int RParamSlot::addCallback(RParamCallback f, void *arg)
+{
+    m_cbFunc.push_back(f);
+    m_cbArg.push_back(arg);
+
+    return 0;
+}
+
+int RParamSlot::delCallback(RParamCallback f, void *arg)
+{
+    for(int i=0; i<m_cbFunc.size(); i++) {
+        if( m_cbFunc[i] == f && m_cbArg[i] == arg ) {
+            m_cbFunc.erase(m_cbFunc.begin() + i);
+            m_cbArg.erase(m_cbArg.begin() + i);
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+void RParamSlot::notify(void)
+{
+    m_gen++;
+
+    for(int i=0; i<m_cbFunc.size(); i++)
+        m_cbFunc[i](this, m_cbArg[i]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+RParamRegistry::RParamRegistry()
+{
+    m_slots.clear();
+    m_hashMap.clear();
+}
+
+RParamRegistry::~RParamRegistry()
+{
+    for(int i=0; i<m_slots.size(); i++) delete m_slots[i];
+
+    m_slots.clear();
+    m_hashMap.clear();
+}
+
+RParamSlot* RParamRegistry::reg(const char *n, CVariantType t)
+{
+    ru32                                    h;
+    RParamSlot                              *s;
+    std::map<ru32, RParamSlot*>::iterator   it;
+
+    h  = param_hash(n);
+    it = m_hashMap.find(h);
+
+    if( it != m_hashMap.end() ) {
+        s = it->second;
+
+        if( s->name() != n ) {
+            dbg_pe("Parameter hash collision: %s <-> %s\n", n, s->name().c_str());
+            return NULL;
+        }
+
+        // an other type would bind to a value member never written
+        if( s->type() != t ) {
+            dbg_pe("Parameter type mismatch: %s (%d <-> %d)\n", n, (int) t, (int) s->type());
+            return NULL;
+        }
+
+        return s;
+    }
+
+    // insert new slot
+    s = new RParamSlot(n, h, t);
+    m_slots.push_back(s);
+    m_hashMap.insert(make_pair(h, s));
+
+    return s;
+}
+
+RParamSlot* RParamRegistry::find(const char *n)
+{
+    RParamSlot *s = find(param_hash(n));
+
+    if( s != NULL && s->name() != n ) return NULL;
+
+    return s;
+}
+
+RParamSlot* RParamRegistry::find(ru32 h)
+{
+    std::map<ru32, RParamSlot*>::iterator   it;
+
+    it = m_hashMap.find(h);
+    if( it != m_hashMap.end() ) return it->second;
+
+    return NULL;
+}
+
+int RParamRegistry::from_pa(CParamArray &pa)
+{
+    string  v;
+    int     n = 0;
+
+    for(int i=0; i<m_slots.size(); i++) {
+        if( 0 == pa.s(m_slots[i]->name(), v) ) {
+            m_slots[i]->set_s(v);
+            n++;
+        }
+    }
+
+    return n;
+}
+
+int RParamRegistry::to_pa(CParamArray &pa)
+{
+    RParamSlot  *s;
+
+    for(int i=0; i<m_slots.size(); i++) {
+        s = m_slots[i];
+
+        switch(s->type()) {
+        case VT_INT:
+            pa.set_i(s->name(), *s->pi());
+            break;
+
+        case VT_FLOAT:
+            pa.set_f(s->name(), *s->pf());
+            break;
+
+        case VT_DOUBLE:
+            pa.set_d(s->name(), *s->pd());
+            break;
+
+        default:
+            pa.set_s(s->name(), s->to_s());
+            break;
+        }
+    }
+
+    return m_slots.size();
+}
+
+int RParamRegistry::load(const string &f)
+{
+    CParamArray     pa;
+
+    if( 0 != pa.load(f) ) return -1;
+
+    from_pa(pa);
+
+    return 0;
+}
+
+int RParamRegistry::save(const string &f)
+{
+    FILE    *fp;
+
+    fp = fopen(f.c_str(), "wt");
+    if( fp == NULL ) {
+        dbg_pe("Failed to open file: %s\n", f.c_str());
+        return -1;
+    }
+
+    fprintf(fp, "# parameters saved by RParamRegistry\n");
+    for(int i=0; i<m_slots.size(); i++) {
+        fprintf(fp, "%s = %s\n",
+                m_slots[i]->name().c_str(), m_slots[i]->to_s().c_str());
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+void RParamRegistry::print(void)
+{
+    fmt::printf("--------------------");
+    fmt::print_colored(fmt::GREEN, " Registry ");
+    fmt::printf("---------------------------\n");
+
+    for(int i=0; i<m_slots.size(); i++) {
+        fmt::printf("%24s = %s\n",
+                    m_slots[i]->name(), m_slots[i]->to_s());
+    }
+
+    fmt::printf("---------------------------------------------------------\n\n");
+}
+
+
+RParamRegistry* pr_get(void)
+{
+    // created on first use, so static RParam objects in any translation
+    // unit can be registered safely
+    static RParamRegistry *g_pr = NULL;
+
+    if( g_pr == NULL ) g_pr = new RParamRegistry;
+
+    return g_pr;
+}
+
+} // end of namespace rtk
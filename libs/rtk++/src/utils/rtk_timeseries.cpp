@@ -0,0 +1,526 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "rtk_debug.h"
+#include "rtk_utils.h"
+#include "rtk_timeseries.h"
+
+using namespace std;
+
+namespace rtk {
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+static inline void ts_bin_merge(RTimeSeriesBin &d, const RTimeSeriesBin &s)
+{
+    if( d.n == 0 ) {
+        d = s;
+        return;
+    }
+
+    if( s.min < d.min ) d.min = s.min;
+    if( s.max > d.max ) d.max = s.max;
+    if( s.t < d.t ) d.t = s.t;
+    d.sum += s.sum;
+    d.n   += s.n;
+}
+
+RTimeSeries::RTimeSeries(const std::string &name, int capacity, int nLevel, int factor)
+{
+    m_name     = name;
+    m_capacity = capacity > 1 ? capacity : 2;
+    m_nLevel   = nLevel >= 0 ? nLevel : 0;
+    m_factor   = factor > 1 ? factor : 2;
+
+    m_t.resize(m_capacity);
+    m_v.resize(m_capacity);
+
+    m_levels.resize(m_nLevel + 1);
+    for(int l=1; l<=m_nLevel; l++) m_levels[l].buckets.resize(m_capacity);
+
+    pthread_mutex_init(&m_mutex, NULL);
+
+    clear();
+}
+
+RTimeSeries::~RTimeSeries()
+{
+    pthread_mutex_destroy(&m_mutex);
+}
+
+void RTimeSeries::clear(void)
+{
+    pthread_mutex_lock(&m_mutex);
+
+    m_head = 0;
+    m_n    = 0;
+
+    for(int l=1; l<=m_nLevel; l++) {
+        m_levels[l].head    = 0;
+        m_levels[l].n       = 0;
+        m_levels[l].nMerged = 0;
+        memset(&m_levels[l].pending, 0, sizeof(RTimeSeriesBin));
+    }
+
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    pthread_mutex_unlock(&m_mutex);
+}
+
+void RTimeSeries::level_push(int l, const RTimeSeriesBin &b)
+{
+    Level &lv = m_levels[l];
+
+    if( lv.nMerged == 0 ) lv.pending = b;
+    else                  ts_bin_merge(lv.pending, b);
+
+    if( ++lv.nMerged < m_factor ) return;
+
+    // bucket complete: store it & feed the next level
+    int i;
+
+    if( lv.n < m_capacity ) {
+        i = (lv.head + lv.n) % m_capacity;
+        lv.n ++;
+    } else {
+        i = lv.head;
+        lv.head = (lv.head + 1) % m_capacity;
+    }
+
+    lv.buckets[i] = lv.pending;
+    lv.nMerged    = 0;
+
+    if( l < m_nLevel ) level_push(l+1, lv.buckets[i]);
+}
+
+void RTimeSeries::push(double t, double v)
+{
+    int i;
+
+    pthread_mutex_lock(&m_mutex);
+
+    // raw samples
+    if( m_n < m_capacity ) {
+        i = (m_head + m_n) % m_capacity;
+        m_n ++;
+    } else {
+        i = m_head;
+        m_head = (m_head + 1) % m_capacity;
+    }
+
+    m_t[i] = t;
+    m_v[i] = v;
+
+    // running statistics (Welford)
+    if( m_stats.n == 0 ) {
+        m_stats.min    = v;
+        m_stats.max    = v;
+        m_stats.tFirst = t;
+    } else {
+        if( v < m_stats.min ) m_stats.min = v;
+        if( v > m_stats.max ) m_stats.max = v;
+    }
+
+    m_stats.n ++;
+    double d = v - m_stats.mean;
+    m_stats.mean += d / m_stats.n;
+    m_stats.m2   += d * (v - m_stats.mean);
+    m_stats.tLast = t;
+    m_stats.vLast = v;
+
+    // pyramid
+    if( m_nLevel > 0 ) {
+        RTimeSeriesBin b;
+
+        b.t   = t;
+        b.min = v;
+        b.max = v;
+        b.sum = v;
+        b.n   = 1;
+
+        level_push(1, b);
+    }
+
+    for(i=0; i<(int)m_cbs.size(); i++) m_cbs[i](this, t, v, m_cbArgs[i]);
+
+    pthread_mutex_unlock(&m_mutex);
+}
+
+int RTimeSeries::lower_bound(int l, double t)
+{
+    int lo = 0, hi, mid;
+
+    if( l == 0 ) {
+        hi = m_n;
+        while( lo < hi ) {
+            mid = (lo + hi) / 2;
+            if( m_t[(m_head + mid) % m_capacity] < t ) lo = mid + 1;
+            else                                        hi = mid;
+        }
+    } else {
+        hi = m_levels[l].n;
+        while( lo < hi ) {
+            mid = (lo + hi) / 2;
+            if( level_at(l, mid).t < t ) lo = mid + 1;
+            else                         hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+double RTimeSeries::first_time(int level)
+{
+    double t = DBL_MAX;
+
+    pthread_mutex_lock(&m_mutex);
+
+    if( level == 0 ) {
+        if( m_n > 0 ) t = m_t[m_head];
+    } else if( level <= m_nLevel ) {
+        // committed buckets, else the partial buckets below
+        if( m_levels[level].n > 0 )
+            t = m_levels[level].buckets[m_levels[level].head].t;
+        else {
+            for(int l=level; l>=1; l--)
+                if( m_levels[l].nMerged > 0 && m_levels[l].pending.t < t )
+                    t = m_levels[l].pending.t;
+        }
+    }
+
+    pthread_mutex_unlock(&m_mutex);
+
+    return t;
+}
+
+int RTimeSeries::query(double t0, double t1, int nBin, std::vector<RTimeSeriesBin> &bins)
+{
+    if( nBin <= 0 || t1 <= t0 ) {
+        bins.clear();
+        return -1;
+    }
+
+    double  dt = (t1 - t0) / nBin;
+    int     lUse = -1, lCover = -1;
+
+    bins.resize(nBin);
+    for(int i=0; i<nBin; i++) {
+        bins[i].t   = t0 + i*dt;
+        bins[i].min = 0;
+        bins[i].max = 0;
+        bins[i].sum = 0;
+        bins[i].n   = 0;
+    }
+
+    // finest level covering t0 with at most 4 items per bin
+    for(int l=0; l<=m_nLevel; l++) {
+        double  tFirst = first_time(l);
+
+        pthread_mutex_lock(&m_mutex);
+        int n = (l == 0 ? m_n : m_levels[l].n);
+        int cnt = lower_bound(l, t1) - lower_bound(l, t0);
+        pthread_mutex_unlock(&m_mutex);
+
+        if( tFirst == DBL_MAX ) break;
+
+        lCover = l;
+        if( tFirst > t0 && l < m_nLevel && n >= m_capacity ) continue;
+
+        if( cnt <= 4*nBin ) {
+            lUse = l;
+            break;
+        }
+    }
+
+    if( lUse < 0 ) lUse = lCover;
+    if( lUse < 0 ) return -1;
+
+    pthread_mutex_lock(&m_mutex);
+
+    if( lUse == 0 ) {
+        int i0 = lower_bound(0, t0), i1 = lower_bound(0, t1);
+
+        for(int i=i0; i<i1; i++) {
+            int             k = (m_head + i) % m_capacity;
+            RTimeSeriesBin  s;
+            int             b = (int)((m_t[k] - t0) / dt);
+
+            if( b >= nBin ) b = nBin - 1;
+
+            s.t   = m_t[k];
+            s.min = m_v[k];
+            s.max = m_v[k];
+            s.sum = m_v[k];
+            s.n   = 1;
+
+            ts_bin_merge(bins[b], s);
+        }
+    } else {
+        int i0 = lower_bound(lUse, t0), i1 = lower_bound(lUse, t1);
+
+        for(int i=i0; i<=i1+lUse; i++) {
+            const RTimeSeriesBin *s;
+
+            // committed buckets, then the partial buckets of this & lower levels
+            if( i < i1 )
+                s = &level_at(lUse, i);
+            else {
+                int l = lUse - (i - i1);
+                if( l < 1 || m_levels[l].nMerged == 0 ) continue;
+                s = &m_levels[l].pending;
+                if( s->t < t0 || s->t >= t1 ) continue;
+            }
+
+            int b = (int)((s->t - t0) / dt);
+            if( b >= nBin ) b = nBin - 1;
+
+            ts_bin_merge(bins[b], *s);
+        }
+    }
+
+    pthread_mutex_unlock(&m_mutex);
+
+    // keep the bin start times
+    for(int i=0; i<nBin; i++) bins[i].t = t0 + i*dt;
+
+    return lUse;
+}
+
+int RTimeSeries::samples(double t0, double t1, std::vector<double> &ts, std::vector<double> &vs)
+{
+    pthread_mutex_lock(&m_mutex);
+
+    int i0 = lower_bound(0, t0), i1 = lower_bound(0, t1);
+
+    ts.resize(i1 - i0);
+    vs.resize(i1 - i0);
+
+    for(int i=i0; i<i1; i++) {
+        int k = (m_head + i) % m_capacity;
+
+        ts[i-i0] = m_t[k];
+        vs[i-i0] = m_v[k];
+    }
+
+    pthread_mutex_unlock(&m_mutex);
+
+    return i1 - i0;
+}
+
+RTimeSeriesStats RTimeSeries::stats(void)
+{
+    RTimeSeriesStats s;
+
+    pthread_mutex_lock(&m_mutex);
+    s = m_stats;
+    pthread_mutex_unlock(&m_mutex);
+
+    return s;
+}
+
+int RTimeSeries::size(void)
+{
+    return m_n;
+}
+
+int RTimeSeries::subscribe(RTimeSeriesCallback cb, void *arg)
+{
+    pthread_mutex_lock(&m_mutex);
+    m_cbs.push_back(cb);
+    m_cbArgs.push_back(arg);
+    pthread_mutex_unlock(&m_mutex);
+
+    return 0;
+}
+
+int RTimeSeries::unsubscribe(RTimeSeriesCallback cb, void *arg)
+{
+    int ret = -1;
+
+    pthread_mutex_lock(&m_mutex);
+
+    for(int i=0; i<(int)m_cbs.size(); i++) {
+        if( m_cbs[i] == cb && m_cbArgs[i] == arg ) {
+            m_cbs.erase(m_cbs.begin() + i);
+            m_cbArgs.erase(m_cbArgs.begin() + i);
+            ret = 0;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&m_mutex);
+
+    return ret;
+}
+
+size_t RTimeSeries::memory_usage(void)
+{
+    return sizeof(*this) + m_name.capacity() +
+           (m_t.capacity() + m_v.capacity()) * sizeof(double) +
+           m_levels.capacity() * sizeof(Level) +
+           (size_t) m_nLevel * m_capacity * sizeof(RTimeSeriesBin);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+RTimeSeriesStore::RTimeSeriesStore(int capacity, int nLevel, int factor)
+{
+    m_capacity = capacity;
+    m_nLevel   = nLevel;
+    m_factor   = factor;
+
+    pthread_mutex_init(&m_mutex, NULL);
+}
+
+RTimeSeriesStore::~RTimeSeriesStore()
+{
+    clear();
+    pthread_mutex_destroy(&m_mutex);
+}
+
+RTimeSeries* RTimeSeriesStore::channel(const std::string &name)
+{
+    RTimeSeries *ch;
+
+    pthread_mutex_lock(&m_mutex);
+
+    ChannelMap::iterator it = m_channels.find(name);
+    if( it != m_channels.end() ) {
+        ch = it->second;
+    } else {
+        ch = new RTimeSeries(name, m_capacity, m_nLevel, m_factor);
+        m_channels[name] = ch;
+    }
+
+    pthread_mutex_unlock(&m_mutex);
+
+    return ch;
+}
+
+RTimeSeries* RTimeSeriesStore::find(const std::string &name)
+{
+    RTimeSeries *ch = NULL;
+
+    pthread_mutex_lock(&m_mutex);
+
+    ChannelMap::iterator it = m_channels.find(name);
+    if( it != m_channels.end() ) ch = it->second;
+
+    pthread_mutex_unlock(&m_mutex);
+
+    return ch;
+}
+
+int RTimeSeriesStore::subscribe(const std::string &name, RTimeSeriesCallback cb, void *arg)
+{
+    return channel(name)->subscribe(cb, arg);
+}
+
+int RTimeSeriesStore::unsubscribe(const std::string &name, RTimeSeriesCallback cb, void *arg)
+{
+    RTimeSeries *ch = find(name);
+
+    if( ch == NULL ) return -1;
+
+    return ch->unsubscribe(cb, arg);
+}
+
+int RTimeSeriesStore::channel_names(std::vector<std::string> &names)
+{
+    pthread_mutex_lock(&m_mutex);
+
+    names.clear();
+    for(ChannelMap::iterator it=m_channels.begin(); it!=m_channels.end(); it++)
+        names.push_back(it->first);
+
+    pthread_mutex_unlock(&m_mutex);
+
+    return names.size();
+}
+
+size_t RTimeSeriesStore::memory_usage(void)
+{
+    size_t m = sizeof(*this);
+
+    pthread_mutex_lock(&m_mutex);
+
+    for(ChannelMap::iterator it=m_channels.begin(); it!=m_channels.end(); it++)
+        m += it->first.capacity() + it->second->memory_usage();
+
+    pthread_mutex_unlock(&m_mutex);
+
+    return m;
+}
+
+void RTimeSeriesStore::print(void)
+{
+    fmt::printf("--------------------");
+    fmt::print_colored(fmt::GREEN, " TimeSeries ");
+    fmt::printf("-------------------------\n");
+
+    size_t m = sizeof(*this);
+
+    pthread_mutex_lock(&m_mutex);
+
+    for(ChannelMap::iterator it=m_channels.begin(); it!=m_channels.end(); it++) {
+        RTimeSeries         *ch = it->second;
+        RTimeSeriesStats    s = ch->stats();
+
+        fmt::printf("%16s: %8d samples, mean = %12g, min = %12g, max = %12g, %8.1f KB\n",
+                    it->first.c_str(), ch->size(), s.mean, s.min, s.max,
+                    ch->memory_usage() / 1024.0);
+        m += it->first.capacity() + ch->memory_usage();
+    }
+
+    pthread_mutex_unlock(&m_mutex);
+
+    fmt::printf("total memory: %.1f KB\n", m / 1024.0);
+    fmt::printf("---------------------------------------------------------\n\n");
+}
+
+void RTimeSeriesStore::clear(void)
+{
+    pthread_mutex_lock(&m_mutex);
+
+    for(ChannelMap::iterator it=m_channels.begin(); it!=m_channels.end(); it++)
+        delete it->second;
+    m_channels.clear();
+
+    pthread_mutex_unlock(&m_mutex);
+}
+
+} // end of namespace rtk
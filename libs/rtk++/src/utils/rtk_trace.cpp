@@ -0,0 +1,265 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "rtk_debug.h"
+#include "rtk_utils.h"
+#include "rtk_trace.h"
+
+using namespace std;
+
+namespace rtk {
+
+#define TRACE_MAGIC             "RTRC"
+#define TRACE_VERSION           1
+
+
+volatile int                    g_traceEnabled = 0;
+
+static pthread_mutex_t          g_traceMutex = PTHREAD_MUTEX_INITIALIZER;
+static RTraceBuffer             *g_traceBuffers = NULL;
+static int                      g_traceThreads = 0;
+static ru32                     g_traceRingSize = 65536;
+static ru64                     g_traceTSC0 = 0;
+
+static __thread RTraceBuffer    *g_traceBuffer = NULL;
+
+
+RTraceBuffer* trace_buffer(void)
+{
+    RTraceBuffer    *b;
+    ru32            n;
+
+    if( g_traceBuffer != NULL ) return g_traceBuffer;
+
+    // ring size must be power of 2
+    n = 1;
+    while( n < g_traceRingSize ) n = n << 1;
+
+    b = new RTraceBuffer;
+    b->events = new RTraceEvent[n];
+    b->size   = n;
+    b->head   = 0;
+    b->threadName[0] = 0;
+
+    pthread_mutex_lock(&g_traceMutex);
+    b->tid  = ++g_traceThreads;
+    b->next = g_traceBuffers;
+    g_traceBuffers = b;
+    pthread_mutex_unlock(&g_traceMutex);
+
+    g_traceBuffer = b;
+
+    return b;
+}
+
+void trace_thread_name(const char *name)
+{
+    RTraceBuffer *b = trace_buffer();
+
+    strncpy(b->threadName, name, sizeof(b->threadName)-1);
+    b->threadName[sizeof(b->threadName)-1] = 0;
+}
+
+int trace_start(int ringSize)
+{
+    if( ringSize > 0 ) g_traceRingSize = ringSize;
+
+    // calibrate TSC before recording
+    tm_tsc_per_us();
+    if( g_traceTSC0 == 0 ) g_traceTSC0 = tm_get_tsc();
+
+    g_traceEnabled = 1;
+
+    return 0;
+}
+
+int trace_stop(void)
+{
+    g_traceEnabled = 0;
+
+    return 0;
+}
+
+int trace_clear(void)
+{
+    pthread_mutex_lock(&g_traceMutex);
+    for(RTraceBuffer *b=g_traceBuffers; b!=NULL; b=b->next) b->head = 0;
+    pthread_mutex_unlock(&g_traceMutex);
+
+    g_traceTSC0 = tm_get_tsc();
+
+    return 0;
+}
+
+// copy events of a buffer in recorded order (oldest first)
+static void trace_get_events(RTraceBuffer *b, vector<RTraceEvent> &ev)
+{
+    ru32    head, n, i;
+
+    head = b->head;
+    n = head < b->size ? head : b->size;
+
+    ev.resize(n);
+    for(i=0; i<n; i++) ev[i] = b->events[(head - n + i) & (b->size-1)];
+}
+
+// write a string as JSON string value
+static void trace_json_str(FILE *fp, const char *s)
+{
+    fputc('"', fp);
+    for(; *s; s++) {
+        if( *s == '"' || *s == '\\' ) fputc('\\', fp);
+        if( (unsigned char) *s < 0x20 ) continue;
+        fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+int trace_save_json(const string &fn)
+{
+    FILE                    *fp;
+    vector<RTraceEvent>     ev;
+    double                  tpu;
+    int                     n = 0, first = 1;
+
+    fp = fopen(fn.c_str(), "wt");
+    if( fp == NULL ) {
+        dbg_pe("Failed to open file: %s\n", fn.c_str());
+        return -1;
+    }
+
+    tpu = tm_tsc_per_us();
+
+    fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    pthread_mutex_lock(&g_traceMutex);
+    for(RTraceBuffer *b=g_traceBuffers; b!=NULL; b=b->next) {
+        // thread name
+        if( b->threadName[0] ) {
+            fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+                        "\"args\":{\"name\":", first ? "" : ",\n", b->tid);
+            trace_json_str(fp, b->threadName);
+            fprintf(fp, "}}");
+            first = 0;
+        }
+
+        // complete events
+        trace_get_events(b, ev);
+        for(size_t i=0; i<ev.size(); i++) {
+            fprintf(fp, "%s{\"name\":", first ? "" : ",\n");
+            trace_json_str(fp, ev[i].name);
+            fprintf(fp, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    b->tid,
+                    ((double)(ri64)(ev[i].t0 - g_traceTSC0)) / tpu,
+                    ((double)(ev[i].t1 - ev[i].t0)) / tpu);
+            first = 0;
+            n++;
+        }
+    }
+    pthread_mutex_unlock(&g_traceMutex);
+
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+
+    return n;
+}
+
+int trace_save_bin(const string &fn)
+{
+    FILE                    *fp;
+    vector<RTraceEvent>     ev;
+    vector<const char*>     names;
+    map<const char*, ru32>  nameIdx;
+    double                  tpu;
+    ru32                    u32;
+    ru16                    u16;
+    int                     n = 0;
+
+    fp = fopen(fn.c_str(), "wb");
+    if( fp == NULL ) {
+        dbg_pe("Failed to open file: %s\n", fn.c_str());
+        return -1;
+    }
+
+    tpu = tm_tsc_per_us();
+
+    pthread_mutex_lock(&g_traceMutex);
+
+    fwrite(TRACE_MAGIC, 1, 4, fp);
+    u32 = TRACE_VERSION;    fwrite(&u32, sizeof(u32), 1, fp);
+    fwrite(&tpu, sizeof(tpu), 1, fp);
+    u32 = g_traceThreads;   fwrite(&u32, sizeof(u32), 1, fp);
+
+    for(RTraceBuffer *b=g_traceBuffers; b!=NULL; b=b->next) {
+        trace_get_events(b, ev);
+
+        // build name table of this thread
+        names.clear();
+        nameIdx.clear();
+        for(size_t i=0; i<ev.size(); i++) {
+            if( nameIdx.find(ev[i].name) == nameIdx.end() ) {
+                nameIdx[ev[i].name] = names.size();
+                names.push_back(ev[i].name);
+            }
+        }
+
+        fwrite(&b->tid, sizeof(b->tid), 1, fp);
+        fwrite(b->threadName, 1, sizeof(b->threadName), fp);
+        u32 = names.size();     fwrite(&u32, sizeof(u32), 1, fp);
+        u32 = ev.size();        fwrite(&u32, sizeof(u32), 1, fp);
+
+        for(size_t i=0; i<names.size(); i++) {
+            u16 = strlen(names[i]);
+            fwrite(&u16, sizeof(u16), 1, fp);
+            fwrite(names[i], 1, u16, fp);
+        }
+
+        for(size_t i=0; i<ev.size(); i++) {
+            u32 = nameIdx[ev[i].name];
+            fwrite(&u32, sizeof(u32), 1, fp);
+            fwrite(&ev[i].t0, sizeof(ru64), 1, fp);
+            fwrite(&ev[i].t1, sizeof(ru64), 1, fp);
+            n++;
+        }
+    }
+
+    pthread_mutex_unlock(&g_traceMutex);
+
+    fclose(fp);
+
+    return n;
+}
+
+} // end of namespace rtk
@@ -137,6 +137,28 @@ ru64 tm_get_us(void)
 #endif
 }
 
+double tm_tsc_per_us(void)
+{
+    static double   tsc_per_us = 0;
+    ru64            t1, t2, c1, c2;
+
+    if( tsc_per_us > 0 ) return tsc_per_us;
+
+#if defined(__i386__) || defined(__x86_64__)
+    t1 = tm_get_us();
+    c1 = tm_get_tsc();
+    tm_sleep(20);
+    t2 = tm_get_us();
+    c2 = tm_get_tsc();
+
+    tsc_per_us = 1.0 * (c2 - c1) / (t2 - t1);
+#else
+    tsc_per_us = 1.0;
+#endif
+
+    return tsc_per_us;
+}
+
 void   tm_sleep(ru32 t)
 {
 #ifdef RTK_LINUX
@@ -539,6 +561,8 @@ int path_lsdir(const string &dir_name, StringArray &dl)
 
     // sort all file name
     std::sort(dl.begin(), dl.end());
+
+    return 0;
 }
 
 int path_isdir(const std::string &p)
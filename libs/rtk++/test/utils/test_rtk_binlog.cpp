@@ -0,0 +1,138 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "rtk_debug.h"
+#include "rtk_utils.h"
+#include "rtk_binlog.h"
+
+using namespace std;
+using namespace rtk;
+
+
+int test_binlog(CParamArray *pa)
+{
+    string  fn = "test_rtk_binlog.blog";
+    int     n;
+
+    pa->s("fn", fn);
+
+    // print directly (log file not opened)
+    blog_pi("not opened: %d %s", 1, "direct");
+
+    blog_open(fn);
+
+    for(int i=0; i<10; i++) {
+        blog_pi("int = %d, hex = %04x, double = %8.3f, str = %s",
+                i, i*17, i*0.25, "hello");
+        blog_pw("long = %ld, llong = %lld, width = %*d|", 123456789L, 1LL << 40, 6, i);
+    }
+    blog_pe("no arguments");
+
+    blog_close();
+
+    printf("\n===== decoded =====\n");
+    n = blog_decode(fn);
+    printf("decoded messages = %d (expected 21)\n", n);
+
+    return n == 21 ? 0 : 1;
+}
+
+int test_binlog_bench(CParamArray *pa)
+{
+    string  fn = "test_rtk_binlog_bench.blog";
+    int     i, n = 100000;
+    ru64    t0, t1, t2, t3;
+    string  s;
+
+    pa->i("n", n);
+
+    blog_open(fn, 1<<22);
+
+    // warm up
+    blog_pw("UART::read %d bytes, ret = %d", 0, 0);
+
+    t0 = tm_get_us();
+    for(i=0; i<n; i++) {
+        blog_pw("UART::read %d bytes, ret = %d", i, -1);
+        if( i % 1000 == 999 ) blog_flush();
+    }
+    t1 = tm_get_us();
+    for(i=0; i<n; i++) {
+        s = fmt::sprintf("UART::read %d bytes, ret = %d", i, -1);
+    }
+    t2 = tm_get_us();
+
+    blog_close();
+
+    // dbg_printf output goes to stderr/stdout, redirect it when running
+    dbg_push_level(2);
+    for(i=0; i<n; i++) {
+        dbg_pw("UART::read %d bytes, ret = %d", i, -1);
+    }
+    t3 = tm_get_us();
+    dbg_pop_level();
+
+    fprintf(stderr, "blog_pw     : %8.1f ns/call (dropped %lld)\n",
+            1000.0*(t1-t0)/n, (long long) blog_dropped());
+    fprintf(stderr, "fmt::sprintf: %8.1f ns/call\n", 1000.0*(t2-t1)/n);
+    fprintf(stderr, "dbg_pw      : %8.1f ns/call\n", 1000.0*(t3-t2)/n);
+
+    return 0;
+}
+
+int test_binlog_decode(CParamArray *pa)
+{
+    string  fn = "test_rtk_binlog.blog";
+
+    pa->s("fn", fn);
+
+    return blog_decode(fn) >= 0 ? 0 : 1;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+struct RTK_TestFunctionArray g_fa[] =
+{
+    RTK_FUNC_TEST_DEF(test_binlog,                  "Test binary logger write & decode"),
+    RTK_FUNC_TEST_DEF(test_binlog_bench,            "Benchmark blog_pw vs fmt::sprintf/dbg_pw"),
+    RTK_FUNC_TEST_DEF(test_binlog_decode,           "Decode a binary log file (-fn)"),
+
+    {NULL,  "NULL",  "NULL"},
+};
+
+
+int main(int argc, char *argv[])
+{
+    CParamArray     pa;
+
+    return rtk_test_main(argc, argv, g_fa, pa);
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "rtk_debug.h"
+#include "rtk_utils.h"
+#include "rtk_paramregistry.h"
+
+using namespace std;
+using namespace rtk;
+
+
+static RParam<int>      g_pInt("test_int", 10);
+static RParam<double>   g_pDouble("test_double", 0.5);
+
+static int              g_nChanged = 0;
+
+static void param_changed(RParamSlot *s, void *arg)
+{
+    g_nChanged ++;
+    printf("changed: %s = %s\n", s->name().c_str(), s->to_s().c_str());
+}
+
+
+int test_paramregistry(CParamArray *pa)
+{
+    CParamArray     pa2;
+    int             err = 0;
+
+    // default values
+    printf("test_int = %d, test_double = %f\n", g_pInt(), g_pDouble());
+    if( g_pInt() != 10 || g_pDouble() != 0.5 ) err++;
+
+    // second key with same name shares the slot
+    RParam<int> pInt2("test_int", 99);
+    if( pInt2() != 10 ) err++;
+
+    // same name with an other type: not bound, keeps its default
+    RParam<float> pFloat("test_int", 2.5f);
+    if( pFloat.slot() != NULL || pFloat() != 2.5f ) err++;
+
+    // callbacks
+    g_pInt.slot()->addCallback(param_changed, NULL);
+    pInt2.set(20);
+    if( g_pInt() != 20 || g_nChanged != 1 ) err++;
+
+    // from/to CParamArray
+    pa2.set_s("test_int", "30");
+    pa2.set_s("test_double", "\"1.25\"");
+    pr_get()->from_pa(pa2);
+    if( g_pInt() != 30 || g_pDouble() != 1.25 || g_nChanged != 2 ) err++;
+
+    pa2.clear();
+    pr_get()->to_pa(pa2);
+    if( pa2.i("test_int") != 30 ) err++;
+
+    // save & load
+    pr_get()->save("test_rtk_paramregistry.ini");
+    g_pInt.set(0);
+    pr_get()->load("test_rtk_paramregistry.ini");
+    if( g_pInt() != 30 ) err++;
+
+    pr_get()->print();
+
+    g_pInt.slot()->delCallback(param_changed, NULL);
+
+    printf("errors = %d\n", err);
+
+    return err;
+}
+
+int test_paramregistry_bench(CParamArray *pa)
+{
+    CParamArray     pa2;
+    int             i, n = 1000000;
+    ru64            t0, t1, t2;
+    volatile int    s = 0;
+
+    pa->i("n", n);
+
+    pa2.set_i("test_int", 10);
+    for(i=0; i<100; i++) pa2.set_i(fmt::format("dummy_{}", i), i);
+
+    t0 = tm_get_us();
+    for(i=0; i<n; i++) s += pa2.i("test_int");
+    t1 = tm_get_us();
+    for(i=0; i<n; i++) s += g_pInt();
+    t2 = tm_get_us();
+
+    printf("CParamArray::i : %8.3f ns/read\n", 1000.0*(t1-t0)/n);
+    printf("RParam<int>()  : %8.3f ns/read\n", 1000.0*(t2-t1)/n);
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+struct RTK_TestFunctionArray g_fa[] =
+{
+    RTK_FUNC_TEST_DEF(test_paramregistry,           "Test RParamRegistry basic usage"),
+    RTK_FUNC_TEST_DEF(test_paramregistry_bench,     "Benchmark RParam vs CParamArray lookup"),
+
+    {NULL,  "NULL",  "NULL"},
+};
+
+
+int main(int argc, char *argv[])
+{
+    CParamArray     pa;
+
+    return rtk_test_main(argc, argv, g_fa, pa);
+}
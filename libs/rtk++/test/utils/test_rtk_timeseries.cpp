@@ -0,0 +1,224 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+
+#include "rtk_debug.h"
+#include "rtk_utils.h"
+#include "rtk_timeseries.h"
+
+using namespace std;
+using namespace rtk;
+
+
+// simulated telemetry: slow drift + oscillation + spikes
+static double ts_gen(int i)
+{
+    double v = 100.0 + 0.001*i + 5.0*sin(i*0.05);
+
+    if( i % 997 == 0 ) v += 50.0;
+
+    return v;
+}
+
+static void ts_cb(RTimeSeries *ch, double t, double v, void *arg)
+{
+    int *n = (int*) arg;
+
+    (*n) ++;
+}
+
+int test_timeseries(CParamArray *pa)
+{
+    int             n = 200000, nBin = 500;
+    double          frq = 50.0;
+    int             err = 0, nCb = 0;
+
+    pa->i("n", n);
+    pa->i("nBin", nBin);
+
+    RTimeSeriesStore    store(4096, 3, 8);
+    RTimeSeries         *ch = store.channel("alt");
+    size_t              mem0 = store.memory_usage();
+
+    store.subscribe("alt", ts_cb, &nCb);
+
+    // reference statistics
+    vector<double>  vs(n);
+    double          sum = 0, vMin = 1e300, vMax = -1e300;
+
+    for(int i=0; i<n; i++) {
+        vs[i] = ts_gen(i);
+        ch->push(i/frq, vs[i]);
+
+        sum += vs[i];
+        if( vs[i] < vMin ) vMin = vs[i];
+        if( vs[i] > vMax ) vMax = vs[i];
+    }
+
+    double mean = sum / n, var = 0;
+    for(int i=0; i<n; i++) var += (vs[i] - mean)*(vs[i] - mean);
+    var /= n - 1;
+
+    // 1. running statistics & callbacks
+    RTimeSeriesStats s = ch->stats();
+    printf("stats: n = %lld, mean = %g (%g), var = %g (%g), min/max = %g/%g\n",
+           (long long) s.n, s.mean, mean, s.var(), var, s.min, s.max);
+    if( (int) s.n != n || fabs(s.mean - mean) > 1e-9*fabs(mean) ||
+        fabs(s.var() - var) > 1e-6*var || s.min != vMin || s.max != vMax ) err ++;
+    if( nCb != n ) {
+        printf("callbacks: %d (expected %d)\n", nCb, n);
+        err ++;
+    }
+
+    // 2. whole history from the pyramid: counts, min & max are exact
+    vector<RTimeSeriesBin>  bins;
+    int                     lvl, cnt = 0;
+    double                  qMin = 1e300, qMax = -1e300;
+
+    lvl = ch->query(-1.0, n/frq + 1.0, nBin, bins);
+    for(int i=0; i<nBin; i++) {
+        if( bins[i].n == 0 ) continue;
+        cnt += bins[i].n;
+        if( bins[i].min < qMin ) qMin = bins[i].min;
+        if( bins[i].max > qMax ) qMax = bins[i].max;
+    }
+    printf("history: level = %d, samples = %d (%d), min/max = %g/%g\n",
+           lvl, cnt, n, qMin, qMax);
+    if( lvl <= 0 || cnt != n || qMin != vMin || qMax != vMax ) err ++;
+
+    // 3. recent range from raw samples equals brute force
+    double  t0 = (n - 2000)/frq, t1 = n/frq;
+    lvl = ch->query(t0, t1, nBin, bins);
+    for(int b=0; b<nBin; b++) {
+        double  bMin = 1e300, bMax = -1e300;
+        int     bn = 0;
+
+        for(int i=n-2000; i<n; i++) {
+            int k = (int)((i/frq - t0) / ((t1 - t0)/nBin));
+            if( k >= nBin ) k = nBin - 1;
+            if( k != b ) continue;
+
+            if( vs[i] < bMin ) bMin = vs[i];
+            if( vs[i] > bMax ) bMax = vs[i];
+            bn ++;
+        }
+
+        if( bn != bins[b].n || (bn > 0 && (bMin != bins[b].min || bMax != bins[b].max)) ) {
+            printf("bin %d: n = %d (%d), min = %g (%g), max = %g (%g)\n",
+                   b, bins[b].n, bn, bins[b].min, bMin, bins[b].max, bMax);
+            err ++;
+            break;
+        }
+    }
+    printf("recent: level = %d\n", lvl);
+    if( lvl != 0 ) err ++;
+
+    // 4. memory is fixed
+    printf("memory: %ld bytes before, %ld bytes after %d samples\n",
+           (long) mem0, (long) store.memory_usage(), n);
+    if( store.memory_usage() != mem0 ) err ++;
+
+    store.print();
+
+    printf("errors = %d\n", err);
+
+    return err;
+}
+
+int test_timeseries_bench(CParamArray *pa)
+{
+    int     n = 3600*50, nBin = 1000, nQuery = 1000;
+    ru64    t0, t1, t2, t3;
+
+    pa->i("n", n);
+    pa->i("nBin", nBin);
+
+    RTimeSeries             ch("alt", n, 3, 16);
+    vector<RTimeSeriesBin>  bins;
+    vector<double>          ts, vs;
+
+    t0 = tm_get_us();
+    for(int i=0; i<n; i++) ch.push(i/50.0, ts_gen(i));
+    t1 = tm_get_us();
+
+    // one hour at screen resolution: pyramid
+    for(int i=0; i<nQuery; i++) ch.query(0, n/50.0, nBin, bins);
+    t2 = tm_get_us();
+
+    // one hour at screen resolution: scan all raw samples
+    for(int i=0; i<nQuery/10; i++) {
+        ch.samples(0, n/50.0, ts, vs);
+
+        for(int b=0; b<nBin; b++) bins[b].n = 0;
+        for(int k=0; k<(int)ts.size(); k++) {
+            int b = (int)(ts[k] / (n/50.0) * nBin);
+            if( b >= nBin ) b = nBin - 1;
+
+            RTimeSeriesBin &d = bins[b];
+            if( d.n == 0 ) { d.min = d.max = d.sum = vs[k]; d.n = 1; }
+            else {
+                if( vs[k] < d.min ) d.min = vs[k];
+                if( vs[k] > d.max ) d.max = vs[k];
+                d.sum += vs[k];
+                d.n ++;
+            }
+        }
+    }
+    t3 = tm_get_us();
+
+    fprintf(stderr, "push          : %8.1f ns/sample\n", 1000.0*(t1-t0)/n);
+    fprintf(stderr, "query pyramid : %8.1f us (%d samples -> %d bins, level %d)\n",
+            1.0*(t2-t1)/nQuery, n, nBin, ch.query(0, n/50.0, nBin, bins));
+    fprintf(stderr, "query raw scan: %8.1f us\n", 1.0*(t3-t2)/(nQuery/10));
+    fprintf(stderr, "memory        : %8.1f KB\n", ch.memory_usage() / 1024.0);
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+struct RTK_TestFunctionArray g_fa[] =
+{
+    RTK_FUNC_TEST_DEF(test_timeseries,              "Test time-series store statistics, pyramid & raw queries"),
+    RTK_FUNC_TEST_DEF(test_timeseries_bench,        "Benchmark push & one hour min/max query"),
+
+    {NULL,  "NULL",  "NULL"},
+};
+
+
+int main(int argc, char *argv[])
+{
+    CParamArray     pa;
+
+    return rtk_test_main(argc, argv, g_fa, pa);
+}
@@ -0,0 +1,146 @@
+/******************************************************************************
+
+  Robot Toolkit ++ (RTK++)
+
+  Copyright (c) 2007-2013 Shuhui Bu <bushuhui@nwpu.edu.cn>
+  http://www.adv-ci.com
+
+  ----------------------------------------------------------------------------
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <string>
+
+// always record zones in this test
+#ifndef RTK_TRACE
+#define RTK_TRACE
+#endif
+
+#include "rtk_debug.h"
+#include "rtk_utils.h"
+#include "rtk_osa++.h"
+#include "rtk_trace.h"
+
+using namespace std;
+using namespace rtk;
+
+
+static double work(int n)
+{
+    RTK_TRACE_FUNC();
+
+    double s = 0;
+    for(int i=0; i<n; i++) s += sin(i*0.001);
+
+    return s;
+}
+
+class TraceWorkThread : public RThread
+{
+public:
+    virtual int thread_func(void *arg=NULL) {
+        RTK_TRACE_THREAD("worker");
+
+        for(int i=0; i<100; i++) {
+            RTK_TRACE_ZONE("worker_loop");
+            work(1000);
+        }
+
+        return 0;
+    }
+};
+
+
+int test_trace(CParamArray *pa)
+{
+    string          fn = "test_rtk_trace.json";
+    string          fn_bin = "test_rtk_trace.rtrc";
+    TraceWorkThread th;
+    int             n1, n2;
+
+    pa->s("fn", fn);
+
+    trace_start();
+    RTK_TRACE_THREAD("main");
+
+    th.start();
+
+    for(int i=0; i<100; i++) {
+        RTK_TRACE_ZONE("main_loop");
+        work(2000);
+    }
+
+    th.wait(1000);
+    trace_stop();
+
+    n1 = trace_save_json(fn);
+    n2 = trace_save_bin(fn_bin);
+    printf("saved %d events to %s, %d events to %s (expected 400)\n",
+           n1, fn.c_str(), n2, fn_bin.c_str());
+
+    return (n1 == 400 && n2 == 400) ? 0 : 1;
+}
+
+int test_trace_bench(CParamArray *pa)
+{
+    int     i, n = 1000000;
+    ru64    t0, t1, t2;
+
+    pa->i("n", n);
+
+    // disabled zones
+    trace_stop();
+    t0 = tm_get_us();
+    for(i=0; i<n; i++) { RTK_TRACE_ZONE("bench"); }
+    t1 = tm_get_us();
+
+    // enabled zones
+    trace_start(1024);
+    for(i=0; i<n; i++) { RTK_TRACE_ZONE("bench"); }
+    t2 = tm_get_us();
+    trace_stop();
+
+    printf("zone (disabled): %8.3f ns\n", 1000.0*(t1-t0)/n);
+    printf("zone (enabled) : %8.3f ns\n", 1000.0*(t2-t1)/n);
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+struct RTK_TestFunctionArray g_fa[] =
+{
+    RTK_FUNC_TEST_DEF(test_trace,                   "Test zone tracing & JSON/binary export"),
+    RTK_FUNC_TEST_DEF(test_trace_bench,             "Benchmark zone overhead"),
+
+    {NULL,  "NULL",  "NULL"},
+};
+
+
+int main(int argc, char *argv[])
+{
+    CParamArray     pa;
+
+    return rtk_test_main(argc, argv, g_fa, pa);
+}
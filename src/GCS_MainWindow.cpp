@@ -8,9 +8,10 @@
 #include <rtk_debug.h>
 #include <rtk_math.h>
 #include <rtk_utils.h>
+#include <rtk_trace.h>
 
 #include "GCS_MainWindow.h"
-#include "utils_GPS.h"
+#include "utils_geodesy.h"
 
 using namespace std;
 using namespace rtk;
@@ -53,7 +54,20 @@ GCS_MainWindow::GCS_MainWindow(QWidget *parent) : QMainWindow(parent)
     // create MainMenu
     createMainMenu();
 
-    startTimer(30);     // 30-millisecond timer
+    // render clients: redraw only after their UAS state changed,
+    //  each at most every minInterval ms
+    m_render = new RenderScheduler(this);
+    m_render->addClient("title",   this, "render_title",
+                        UAS_STATE_MASK(UAS_STATE_LINK));
+    m_render->addClient("ADI",     this, "render_ADI",
+                        UAS_STATE_MASK(UAS_STATE_ATT));
+    m_render->addClient("Compass", this, "render_Compass",
+                        UAS_STATE_MASK(UAS_STATE_ATT) | UAS_STATE_MASK(UAS_STATE_POS), 30);
+    m_render->addClient("map",     this, "render_map",
+                        UAS_STATE_MASK(UAS_STATE_POS) | UAS_STATE_MASK(UAS_STATE_ATT), 100);
+    m_render->addClient("info",    this, "render_info",
+                        UAS_STATE_MASK(UAS_STATE_POS) | UAS_STATE_MASK(UAS_STATE_STATUS) |
+                        UAS_STATE_MASK(UAS_STATE_LINK), 100);
 }
 
 GCS_MainWindow::~GCS_MainWindow()
@@ -93,7 +107,7 @@ int GCS_MainWindow::setupLayout(void)
 
     m_ADI      = new QADI(this);
     m_Compass  = new QCompass(this);
-    m_infoList = new QKeyValueListView(this);
+    m_infoList = new QTelemetryListView(this);
 
     vl->addWidget(m_ADI,      0, Qt::AlignTop|Qt::AlignHCenter);
     vl->addWidget(m_Compass,  0, Qt::AlignTop|Qt::AlignHCenter);
@@ -113,6 +127,32 @@ int GCS_MainWindow::setupLayout(void)
 
     setCentralWidget(wAll);
 
+    /////////////////////////////////////////////
+    /// docks
+    /////////////////////////////////////////////
+    m_msgProfiler = new MsgProfilerWidget(this);
+    addDockWidget(Qt::BottomDockWidgetArea, m_msgProfiler);
+    m_msgProfiler->hide();
+
+    return 0;
+}
+
+int GCS_MainWindow::setActiveUAS(UAS *u)
+{
+    m_uasActive = u;
+
+    // bind info list rows to the fields of the UAS
+    m_infoList->telemetryModel()->clearFields();
+    if( m_uasActive != NULL ) m_uasActive->bind_telemetry(m_infoList->telemetryModel());
+
+    // frames are driven by the state changes of the active UAS
+    m_render->setUAS(m_uasActive);
+
+    // only the data streams the widgets show are requested
+    if( m_uasActive != NULL ) m_uasActive->stream_set_displayed(m_render->stateMask());
+
+    m_msgProfiler->setProfiler(m_uasActive != NULL ? m_uasActive->msg_profiler() : NULL);
+
     return 0;
 }
 
@@ -142,6 +182,11 @@ void GCS_MainWindow::createActions(void)
     connect(actShowHideMenuBar, SIGNAL(triggered()), this, SLOT(action_ShowHideMenuBar()));
     actionList->append(actShowHideMenuBar);
 
+    actShowHideMsgProfiler = m_msgProfiler->toggleViewAction();
+    actShowHideMsgProfiler->setStatusTip(tr("Show/hide bandwidth per message type"));
+    actShowHideMsgProfiler->setShortcut(QKeySequence::fromString(tr("ctrl+b")));
+    actionList->append(actShowHideMsgProfiler);
+
     // add all actions to main window
     foreach(QAction* action, *actionList) {
         //add to MainWindow so they work when menu is hidden
@@ -162,6 +207,7 @@ void GCS_MainWindow::createMainMenu(void)
     QMenu *viewMenu = new QMenu(tr("&View"));
     viewMenu->addAction(actShowHideMenuBar);
     viewMenu->addAction(actShowHideStatusBar);
+    viewMenu->addAction(actShowHideMsgProfiler);
 
     menuBar()->addMenu(fileMenu);
     menuBar()->addMenu(viewMenu);
@@ -215,64 +261,75 @@ void GCS_MainWindow::resizeEvent(QResizeEvent *event)
 {
 }
 
-void GCS_MainWindow::timerEvent(QTimerEvent *event)
+void GCS_MainWindow::render_title(void)
+{
+    if( m_uasActive == NULL ) return;
+
+    // set window title
+    QString ts;
+
+    if( m_uasActive->link_connected() )
+        ts = m_sbTitleString + " - Link Connected";
+    else
+        ts = m_sbTitleString + " - Link Lost";
+    setWindowTitle(ts);
+}
+
+void GCS_MainWindow::render_ADI(void)
+{
+    if( m_uasActive == NULL ) return;
+
+    m_ADI->setData(m_uasActive->roll, m_uasActive->pitch);
+}
+
+void GCS_MainWindow::render_Compass(void)
+{
+    if( m_uasActive == NULL ) return;
+
+    m_Compass->setData(m_uasActive->yaw, m_uasActive->gpAlt, m_uasActive->gpH);
+}
+
+void GCS_MainWindow::render_map(void)
 {
-    static ru64 tmLast = 0, tmNow;
-
-    if( m_uasActive != NULL ) {
-        // get current time
-        tmNow = tm_get_ms();
-
-        // set window title
-        QString ts;
-
-        if( m_uasActive->link_connected() )
-            ts = m_sbTitleString + " - Link Connected";
-        else
-            ts = m_sbTitleString + " - Link Lost";
-        setWindowTitle(ts);
-
-        // update widgets
-        m_ADI->setData(m_uasActive->roll, m_uasActive->pitch);
-        m_Compass->setData(m_uasActive->yaw, m_uasActive->gpAlt, m_uasActive->gpH);
-
-        // add track to 2D/3D plot
-        if( tmNow - tmLast > 100 ) {
-            double      dx, dy, dz;
-
-            // detect new position
-            if( m_uasActive->homeSetCount == 0 && m_uasActive->gpsFixType >= 3 ) {
-                // calc offset from home point
-                calc_earth_offset(m_uasActive->lonHome, m_uasActive->latHome,
-                                  m_uasActive->lon, m_uasActive->lat,
-                                  dx, dy);
-                dz = m_uasActive->gpH - m_uasActive->hHome;
-
-                // set map view
-                if( m_uavItem == NULL )
-                    m_uavItem = m_mapView->AddUAV(0);
-
-                internals::PointLatLng p(m_uasActive->lat, m_uasActive->lon);
-                m_uavItem->SetUAVPos(p, m_uasActive->alt);
-                m_uavItem->SetUAVHeading(m_uasActive->yaw);
-            }
-
-            // set last time
-            tmLast = tmNow;
-        }
-
-        // update list
-        ListMap lm;
-        m_infoList->beginSetData();
-        m_uasActive->gen_listmap_important(lm);
-        m_infoList->getData() = lm;
-        m_infoList->endSetData();
-        m_infoList->listReload();
+    RTK_TRACE_ZONE("GCS_MainWindow::render_map");
+
+    double      dx, dy, dz;
+
+    if( m_uasActive == NULL ) return;
+
+    // detect new position
+    if( m_uasActive->homeSetCount == 0 && m_uasActive->gpsFixType >= 3 ) {
+        // offset from home point
+        m_uasActive->homeFrame.offset(m_uasActive->lat, m_uasActive->lon, dx, dy);
+        dz = m_uasActive->gpH - m_uasActive->hHome;
+
+        // set map view
+        if( m_uavItem == NULL )
+            m_uavItem = m_mapView->AddUAV(0);
+
+        internals::PointLatLng p(m_uasActive->lat, m_uasActive->lon);
+        m_uavItem->SetUAVPos(p, m_uasActive->alt);
+        m_uavItem->SetUAVHeading(m_uasActive->yaw);
     }
 }
 
+void GCS_MainWindow::render_info(void)
+{
+    RTK_TRACE_ZONE("GCS_MainWindow::render_info");
+
+    if( m_uasActive == NULL ) return;
+
+    // update list (only changed rows are formatted & repainted)
+    m_infoList->telemetryModel()->update();
+}
+
 void GCS_MainWindow::closeEvent(QCloseEvent *event)
 {
+    m_render->printStats();
+    m_render->setUAS(NULL);
+
+    if( m_uasActive != NULL ) m_uasActive->timeseries()->print();
+
     m_uasActive = NULL;
 }
 
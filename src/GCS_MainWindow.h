@@ -15,6 +15,8 @@
 #include "qFlightInstruments.h"
 #include "MapWidget.h"
 #include "UAS.h"
+#include "RenderScheduler.h"
+#include "MsgProfilerWidget.h"
 
 
 ///
@@ -31,15 +33,17 @@ public:
     virtual int setupLayout(void);
 
     // set/get UAS
-    virtual int setActiveUAS(UAS *u) { m_uasActive = u; }
+    virtual int setActiveUAS(UAS *u);
     virtual UAS* getActiveUAS(void) { return m_uasActive; }
 
+    // render scheduler (frame & per-widget statistics)
+    RenderScheduler* getRenderScheduler(void) { return m_render; }
+
 
 protected:
     void keyPressEvent(QKeyEvent *event);
     void mousePressEvent(QMouseEvent *event);
     void resizeEvent(QResizeEvent *event);
-    void timerEvent(QTimerEvent *event);
     void closeEvent(QCloseEvent *event);
 
 protected:
@@ -51,7 +55,10 @@ protected:
     // right-panel
     QADI                *m_ADI;
     QCompass            *m_Compass;
-    QKeyValueListView   *m_infoList;
+    QTelemetryListView  *m_infoList;
+
+    // dock: bytes per message type
+    MsgProfilerWidget   *m_msgProfiler;
 
     // left-pannel
     MapWidget           *m_mapView;
@@ -63,6 +70,8 @@ protected:
     UAS                     *m_uasActive;
     mapcontrol::UAVItem     *m_uavItem;
 
+    RenderScheduler         *m_render;
+
 
     rtk::RMutex         *m_mutex;
     QSettings           *m_conf;
@@ -75,11 +84,20 @@ public slots:
     void    mw_onMapDrag(void);
     void    mw_zoomChanged(int newZoom);
 
+protected slots:
+    // render clients, called by m_render if their UAS state changed
+    void    render_title(void);
+    void    render_ADI(void);
+    void    render_Compass(void);
+    void    render_map(void);
+    void    render_info(void);
+
 protected:
     QList<QAction*>     *actionList;
     QAction             *actClearPos;
     QAction             *actShowHideStatusBar;
     QAction             *actShowHideMenuBar;
+    QAction             *actShowHideMsgProfiler;
 
     QToolBar            *menuToolBar;
 };
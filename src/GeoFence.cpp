@@ -0,0 +1,813 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <ctype.h>
+
+#include <algorithm>
+
+#include <rtk_utils.h>
+#include <rtk_debug.h>
+#include <rtk_paramarray.h>
+
+#include "GeoFence.h"
+
+using namespace rtk;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// geometry
+////////////////////////////////////////////////////////////////////////////////
+
+static inline double gf_seg_dis2(double px, double py,
+                                 double x1, double y1, double x2, double y2)
+{
+    double  dx = x2 - x1, dy = y2 - y1;
+    double  l2 = dx*dx + dy*dy, t = 0;
+
+    if( l2 > 0 ) {
+        t = ((px - x1)*dx + (py - y1)*dy) / l2;
+        if( t < 0 ) t = 0;
+        else if( t > 1 ) t = 1;
+    }
+
+    dx = x1 + t*dx - px;
+    dy = y1 + t*dy - py;
+    return dx*dx + dy*dy;
+}
+
+static inline double gf_box_dis2(double px, double py,
+                                 double x0, double y0, double x1, double y1)
+{
+    double  dx = px < x0 ? x0 - px : (px > x1 ? px - x1 : 0);
+    double  dy = py < y0 ? y0 - py : (py > y1 ? py - y1 : 0);
+
+    return dx*dx + dy*dy;
+}
+
+// segment touches the box (Liang-Barsky)
+static int gf_seg_box(double x1, double y1, double x2, double y2,
+                      double x0, double y0, double xb, double yb)
+{
+    double  p[4] = { -(x2 - x1), x2 - x1, -(y2 - y1), y2 - y1 };
+    double  q[4] = { x1 - x0, xb - x1, y1 - y0, yb - y1 };
+    double  t0 = 0, t1 = 1;
+
+    for(int i=0; i<4; i++) {
+        if( p[i] == 0 ) {
+            if( q[i] < 0 ) return 0;
+        } else {
+            double t = q[i] / p[i];
+            if( p[i] < 0 ) { if( t > t1 ) return 0; if( t > t0 ) t0 = t; }
+            else           { if( t < t0 ) return 0; if( t < t1 ) t1 = t; }
+        }
+    }
+
+    return 1;
+}
+
+static double gf_seg_box_dis2(double x1, double y1, double x2, double y2,
+                              double x0, double y0, double xb, double yb)
+{
+    if( gf_seg_box(x1, y1, x2, y2, x0, y0, xb, yb) ) return 0;
+
+    double d = std::min(gf_box_dis2(x1, y1, x0, y0, xb, yb), gf_box_dis2(x2, y2, x0, y0, xb, yb));
+    d = std::min(d, gf_seg_dis2(x0, y0, x1, y1, x2, y2));
+    d = std::min(d, gf_seg_dis2(xb, y0, x1, y1, x2, y2));
+    d = std::min(d, gf_seg_dis2(x0, yb, x1, y1, x2, y2));
+    d = std::min(d, gf_seg_dis2(xb, yb, x1, y1, x2, y2));
+    return d;
+}
+
+// crossing number of a ray to +x
+static int gf_pip(const double *x, const double *y, int n, double px, double py)
+{
+    int     c = 0;
+
+    for(int i=0; i<n; i++) {
+        if( (y[i] > py) != (y[i+1] > py) &&
+            px < x[i] + (py - y[i]) * (x[i+1] - x[i]) / (y[i+1] - y[i]) )
+            c = !c;
+    }
+
+    return c;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// GeoFencePolygon
+////////////////////////////////////////////////////////////////////////////////
+
+GeoFencePolygon::GeoFencePolygon()
+{
+    m_type = GEOFENCE_INCLUSION;
+    m_margin = 0;
+    m_nx = m_ny = 0;
+    m_candAvg = 0;
+    m_gx0 = m_gy0 = m_gx1 = m_gy1 = 0;
+    m_cs = m_ics = 1;
+}
+
+GeoFencePolygon::~GeoFencePolygon()
+{
+}
+
+int GeoFencePolygon::set(const double *e, const double *n, int nVertex, int type, double margin)
+{
+    int     j, ix, iy, G;
+    double  w, h, g;
+
+    if( nVertex < 3 ) return -1;
+
+    m_type   = type;
+    m_margin = margin;
+
+    // vertices, closed
+    m_x.assign(e, e + nVertex);
+    m_y.assign(n, n + nVertex);
+    m_x.push_back(e[0]);
+    m_y.push_back(n[0]);
+
+    // grid over the box grown by the margin, about sqrt(n) cells on the long side
+    m_gx0 = *std::min_element(m_x.begin(), m_x.end());
+    m_gx1 = *std::max_element(m_x.begin(), m_x.end());
+    m_gy0 = *std::min_element(m_y.begin(), m_y.end());
+    m_gy1 = *std::max_element(m_y.begin(), m_y.end());
+
+    g = margin + GEOFENCE_HYST + 1.0;
+    m_gx0 -= g; m_gy0 -= g; m_gx1 += g; m_gy1 += g;
+
+    w = m_gx1 - m_gx0;
+    h = m_gy1 - m_gy0;
+    G = std::max(4, (int) ceil(sqrt((double) nVertex)));
+
+    m_cs  = std::max(w, h) / G;
+    m_ics = 1.0 / m_cs;
+    m_nx  = std::max(1, (int) ceil(w * m_ics));
+    m_ny  = std::max(1, (int) ceil(h * m_ics));
+    m_gx1 = m_gx0 + m_nx * m_cs;
+    m_gy1 = m_gy0 + m_ny * m_cs;
+
+    // per cell: center inside, edges that can be the nearest
+    m_cells.resize(m_nx * m_ny);
+    m_cand.clear();
+
+    std::vector<double> dmin(nVertex);
+
+    for(iy=0; iy<m_ny; iy++) {
+        for(ix=0; ix<m_nx; ix++) {
+            Cell    &c = m_cells[iy*m_nx + ix];
+            double  x0 = m_gx0 + ix*m_cs, y0 = m_gy0 + iy*m_cs;
+            double  x1 = x0 + m_cs, y1 = y0 + m_cs;
+            double  U = DBL_MAX;
+
+            c.inside = gf_pip(&m_x[0], &m_y[0], nVertex, x0 + 0.5*m_cs, y0 + 0.5*m_cs);
+
+            for(j=0; j<nVertex; j++) {
+                double ax = m_x[j], ay = m_y[j], bx = m_x[j+1], by = m_y[j+1];
+                double dmax = std::max(std::max(gf_seg_dis2(x0, y0, ax, ay, bx, by),
+                                                gf_seg_dis2(x1, y0, ax, ay, bx, by)),
+                                       std::max(gf_seg_dis2(x0, y1, ax, ay, bx, by),
+                                                gf_seg_dis2(x1, y1, ax, ay, bx, by)));
+                U = std::min(U, dmax);
+                dmin[j] = gf_seg_box_dis2(ax, ay, bx, by, x0, y0, x1, y1);
+            }
+
+            c.beg = m_cand.size();
+            for(j=0; j<nVertex; j++)
+                if( dmin[j] <= U ) m_cand.push_back(j);
+            c.end = m_cand.size();
+        }
+    }
+
+    m_candAvg = 1.0 * m_cand.size() / m_cells.size();
+
+    return 0;
+}
+
+int GeoFencePolygon::query(double e, double n, double &dis)
+{
+    // off the grid: outside, distance to the box of the polygon (lower bound)
+    if( e < m_gx0 || e > m_gx1 || n < m_gy0 || n > m_gy1 ) {
+        double g = m_margin + GEOFENCE_HYST + 1.0;
+        dis = sqrt(gf_box_dis2(e, n, m_gx0 + g, m_gy0 + g, m_gx1 - g, m_gy1 - g));
+        return 0;
+    }
+
+    int ix = std::min((int) ((e - m_gx0) * m_ics), m_nx - 1);
+    int iy = std::min((int) ((n - m_gy0) * m_ics), m_ny - 1);
+
+    const Cell  &c = m_cells[iy*m_nx + ix];
+    const double *x = &m_x[0], *y = &m_y[0];
+    double      cx = m_gx0 + (ix + 0.5)*m_cs, cy = m_gy0 + (iy + 0.5)*m_cs;
+    double      xLo = std::min(e, cx), xHi = std::max(e, cx);
+    double      yLo = std::min(n, cy), yHi = std::max(n, cy);
+    double      d2 = DBL_MAX;
+    int         inside = c.inside;
+
+    // the center's flag, flipped by the edges between the point & the center
+    //  (along y = n to x = cx, then along x = cx to the center)
+    for(int k=c.beg; k<c.end; k++) {
+        int     i = m_cand[k];
+        double  x1 = x[i], y1 = y[i], x2 = x[i+1], y2 = y[i+1];
+
+        if( (y1 > n) != (y2 > n) ) {
+            double xi = x1 + (n - y1) * (x2 - x1) / (y2 - y1);
+            if( xi > xLo && xi <= xHi ) inside = !inside;
+        }
+        if( (x1 > cx) != (x2 > cx) ) {
+            double yi = y1 + (cx - x1) * (y2 - y1) / (x2 - x1);
+            if( yi > yLo && yi <= yHi ) inside = !inside;
+        }
+
+        d2 = std::min(d2, gf_seg_dis2(e, n, x1, y1, x2, y2));
+    }
+
+    dis = sqrt(d2);
+    return inside;
+}
+
+int GeoFencePolygon::queryBrute(double e, double n, double &dis)
+{
+    int     nv = m_x.size() - 1;
+    double  d2 = DBL_MAX;
+
+    for(int i=0; i<nv; i++)
+        d2 = std::min(d2, gf_seg_dis2(e, n, m_x[i], m_y[i], m_x[i+1], m_y[i+1]));
+
+    dis = sqrt(d2);
+    return gf_pip(&m_x[0], &m_y[0], nv, e, n);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// GeoFenceEngine
+////////////////////////////////////////////////////////////////////////////////
+
+const char* geofence_level_name(int level)
+{
+    static const char *names[] = { "OK", "WARN", "BREACH" };
+
+    if( level >= 0 && level <= 2 ) return names[level];
+    return "?";
+}
+
+GeoFenceEngine::GeoFenceEngine()
+{
+    m_alertFunc = NULL;
+    m_alertArg  = NULL;
+
+    clear();
+}
+
+GeoFenceEngine::~GeoFenceEngine()
+{
+}
+
+void GeoFenceEngine::clear(void)
+{
+    m_mutex.lock();
+
+    m_frame.clear();
+    m_polys.clear();
+
+    m_hMin = 0;
+    m_hMax = 0;
+    m_hMargin = 0;
+    m_cMin = 0;
+    m_cMargin = 0;
+
+    for(int i=0; i<GEOFENCE_VEHICLES; i++) m_level[i].clear();
+
+    m_nCheck = 0;
+    m_nAlert = 0;
+
+    m_mutex.unlock();
+}
+
+void GeoFenceEngine::setOrigin(double lat, double lng)
+{
+    m_mutex.lock();
+
+    m_frame.setOrigin(lat, lng, 0);
+    m_polys.clear();
+    for(int i=0; i<GEOFENCE_VEHICLES; i++) m_level[i].clear();
+
+    m_mutex.unlock();
+}
+
+int GeoFenceEngine::addPolygon(const double *lat, const double *lng, int n, int type, double margin)
+{
+    GeoFencePolygon     p;
+    std::vector<double> e(n), nn(n);
+    int                 ret;
+
+    if( n < 3 ) return -1;
+
+    if( !m_frame.valid() ) setOrigin(lat[0], lng[0]);
+    m_frame.offsetBatch(lat, lng, n, &e[0], &nn[0]);
+
+    // prepared before taking the lock, checks go on meanwhile
+    if( 0 != p.set(&e[0], &nn[0], n, type, margin) ) return -1;
+
+    m_mutex.lock();
+    m_polys.push_back(p);
+    ret = m_polys.size() - 1;
+    for(int i=0; i<GEOFENCE_VEHICLES; i++) m_level[i].clear();
+    m_mutex.unlock();
+
+    return ret;
+}
+
+void GeoFenceEngine::setAltitude(double hMin, double hMax, double margin)
+{
+    m_mutex.lock();
+    m_hMin = hMin;
+    m_hMax = hMax;
+    m_hMargin = margin;
+    m_mutex.unlock();
+}
+
+void GeoFenceEngine::setClearance(double hMin, double margin)
+{
+    m_mutex.lock();
+    m_cMin = hMin;
+    m_cMargin = margin;
+    m_mutex.unlock();
+}
+
+void GeoFenceEngine::setAlertFunc(GeoFenceAlertFunc f, void *arg)
+{
+    m_mutex.lock();
+    m_alertFunc = f;
+    m_alertArg  = arg;
+    m_mutex.unlock();
+}
+
+int GeoFenceEngine::update(int sysid, int fence, int slot, int breach, double dis, double margin,
+                           uint64_t tUs, GeoFenceAlert *alerts, int &nAlert)
+{
+    std::vector<int>    &lv = m_level[sysid];
+    int                 cur = lv[slot], lvl;
+
+    lvl = breach ? GEOFENCE_BREACH : (dis <= margin ? GEOFENCE_WARN : GEOFENCE_OK);
+
+    // down only with some distance to spare
+    if( lvl < cur ) {
+        int lvlH = dis < GEOFENCE_HYST ? GEOFENCE_BREACH :
+                   (dis <= margin + GEOFENCE_HYST ? GEOFENCE_WARN : GEOFENCE_OK);
+        lvl = std::max(lvl, std::min(cur, lvlH));
+    }
+
+    if( lvl != cur ) {
+        lv[slot] = lvl;
+        m_nAlert ++;
+
+        if( nAlert < 32 ) {
+            GeoFenceAlert &a = alerts[nAlert++];
+            a.sysid     = sysid;
+            a.fence     = fence;
+            a.level     = lvl;
+            a.prevLevel = cur;
+            a.dis       = breach ? -dis : dis;
+            a.tUs       = tUs;
+        }
+    }
+
+    return lvl;
+}
+
+int GeoFenceEngine::check(int sysid, double lat, double lng, double h, uint64_t tUs)
+{
+    GeoFenceAlert       alerts[32];
+    int                 nAlert = 0, worst = GEOFENCE_OK, i, np;
+    double              e, n, dis;
+    GeoFenceAlertFunc   f;
+    void                *arg;
+
+    sysid &= GEOFENCE_VEHICLES - 1;
+
+    m_mutex.lock();
+
+    m_nCheck ++;
+    np = m_polys.size();
+    if( m_level[sysid].size() != np + 2 ) m_level[sysid].assign(np + 2, GEOFENCE_OK);
+
+    if( np > 0 ) {
+        m_frame.offset(lat, lng, e, n);
+
+        for(i=0; i<np; i++) {
+            GeoFencePolygon &p = m_polys[i];
+            int inside = p.query(e, n, dis);
+            int breach = p.type() == GEOFENCE_INCLUSION ? !inside : inside;
+
+            worst = std::max(worst, update(sysid, i, i, breach, dis, p.margin(), tUs, alerts, nAlert));
+        }
+    }
+
+    if( m_hMax > m_hMin ) {
+        dis = std::min(h - m_hMin, m_hMax - h);
+        worst = std::max(worst, update(sysid, GEOFENCE_ALT, np, dis < 0, fabs(dis), m_hMargin,
+                                       tUs, alerts, nAlert));
+    }
+    worst = std::max(worst, m_level[sysid][np + 1]);
+
+    f   = m_alertFunc;
+    arg = m_alertArg;
+
+    m_mutex.unlock();
+
+    if( f != NULL ) for(i=0; i<nAlert; i++) f(arg, alerts[i]);
+
+    return worst;
+}
+
+int GeoFenceEngine::terrain(int sysid, double clearance, uint64_t tUs)
+{
+    GeoFenceAlert       alerts[1];
+    int                 nAlert = 0, lvl = GEOFENCE_OK, np;
+    double              dis;
+    GeoFenceAlertFunc   f;
+    void                *arg;
+
+    sysid &= GEOFENCE_VEHICLES - 1;
+
+    m_mutex.lock();
+
+    np = m_polys.size();
+    if( m_level[sysid].size() != np + 2 ) m_level[sysid].assign(np + 2, GEOFENCE_OK);
+
+    if( m_cMin > 0 ) {
+        dis = clearance - m_cMin;
+        lvl = update(sysid, GEOFENCE_TERRAIN, np + 1, dis < 0, fabs(dis), m_cMargin,
+                     tUs, alerts, nAlert);
+    }
+
+    f   = m_alertFunc;
+    arg = m_alertArg;
+
+    m_mutex.unlock();
+
+    if( f != NULL && nAlert > 0 ) f(arg, alerts[0]);
+
+    return lvl;
+}
+
+int GeoFenceEngine::level(int sysid)
+{
+    int     lvl = GEOFENCE_OK;
+
+    sysid &= GEOFENCE_VEHICLES - 1;
+
+    m_mutex.lock();
+    for(size_t i=0; i<m_level[sysid].size(); i++) lvl = std::max(lvl, m_level[sysid][i]);
+    m_mutex.unlock();
+
+    return lvl;
+}
+
+struct GeoFenceFilePoly
+{
+    int                 type;
+    double              margin;
+    std::vector<double> lat, lng;
+};
+
+int GeoFenceEngine::load(const std::string &fn)
+{
+    FILE                    *fp;
+    char                    line[256], key[32];
+    double                  a, b, c;
+    int                     hasOrigin = 0, nPoly = 0;
+    double                  oLat = 0, oLng = 0;
+    std::vector<GeoFenceFilePoly> polys;
+
+    fp = fopen(fn.c_str(), "rt");
+    if( fp == NULL ) {
+        dbg_pe("Can not open fence file: %s\n", fn.c_str());
+        return -1;
+    }
+
+    clear();
+
+    while( fgets(line, sizeof(line), fp) != NULL ) {
+        if( line[0] == '#' ) continue;
+
+        a = b = c = 0;
+        if( 1 <= sscanf(line, "%31s %lf %lf %lf", key, &a, &b, &c) && isalpha(key[0]) ) {
+            if( strcmp(key, "origin") == 0 ) {
+                hasOrigin = 1;
+                oLat = a;
+                oLng = b;
+            } else if( strcmp(key, "altitude") == 0 ) {
+                setAltitude(a, b, c);
+            } else if( strcmp(key, "clearance") == 0 ) {
+                setClearance(a, b);
+            } else if( strcmp(key, "inclusion") == 0 || strcmp(key, "exclusion") == 0 ) {
+                polys.push_back(GeoFenceFilePoly());
+                polys.back().type   = key[0] == 'i' ? GEOFENCE_INCLUSION : GEOFENCE_EXCLUSION;
+                polys.back().margin = a;
+            } else {
+                dbg_pw("fence file %s: unknown line: %s", fn.c_str(), line);
+            }
+        } else if( 2 == sscanf(line, "%lf %lf", &a, &b) && polys.size() > 0 ) {
+            polys.back().lat.push_back(a);
+            polys.back().lng.push_back(b);
+        }
+    }
+
+    fclose(fp);
+
+    if( hasOrigin ) setOrigin(oLat, oLng);
+
+    for(size_t i=0; i<polys.size(); i++) {
+        GeoFenceFilePoly &p = polys[i];
+        if( p.lat.size() < 3 ) continue;
+        if( addPolygon(&p.lat[0], &p.lng[0], p.lat.size(), p.type, p.margin) >= 0 ) nPoly ++;
+    }
+
+    dbg_pi("fence file %s: %d polygons\n", fn.c_str(), nPoly);
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// test & benchmark
+////////////////////////////////////////////////////////////////////////////////
+
+static double gf_rand(double a, double b)
+{
+    return a + (b - a) * rand() / RAND_MAX;
+}
+
+///
+/// \brief star-shaped polygon (simple, concave), radius r0 ~ r1 around (e0, n0)
+///
+static void gf_star(double e0, double n0, double r0, double r1, int nv,
+                    std::vector<double> &e, std::vector<double> &n)
+{
+    double  ph[3] = { gf_rand(0, 6.28), gf_rand(0, 6.28), gf_rand(0, 6.28) };
+
+    e.resize(nv);
+    n.resize(nv);
+
+    for(int i=0; i<nv; i++) {
+        double  a = 2.0 * M_PI * i / nv;
+        double  s = 0.5 + 0.2*sin(3*a + ph[0]) + 0.15*sin(7*a + ph[1]) + 0.1*sin(23*a + ph[2]);
+        double  r = r0 + (r1 - r0) * std::min(1.0, std::max(0.0, s + gf_rand(-0.05, 0.05)));
+
+        e[i] = e0 + r*cos(a);
+        n[i] = n0 + r*sin(a);
+    }
+}
+
+struct GeoFenceTestLog
+{
+    std::vector<GeoFenceAlert>  alerts;
+};
+
+static void gf_test_alert(void *arg, const GeoFenceAlert &a)
+{
+    ((GeoFenceTestLog*) arg)->alerts.push_back(a);
+}
+
+int test_geofence(CParamArray *pa)
+{
+    int             nVertex = 1000, nVehicle = 50, rateHz = 10, seconds = 60, nExcl = 4;
+    double          lat0 = 34.257287, lng0 = 108.888931;
+    std::string     fn_fence = "geofence_test.txt";
+    int             err = 0;
+    int             i, k;
+
+    pa->i("nVertex", nVertex);
+    pa->i("nVehicle", nVehicle);
+    pa->i("rateHz", rateHz);
+    pa->i("seconds", seconds);
+    pa->i("nExcl", nExcl);
+
+    srand(5);
+
+    // indexed query against all edges
+    {
+        GeoFencePolygon     p;
+        std::vector<double> e, n;
+        double              d1, d2, eDis = 0;
+        int                 nBad = 0, nIn = 0, nOff = 0;
+        double              t0;
+
+        gf_star(0, 0, 3000, 5000, nVertex, e, n);
+
+        // the grid covers the box of the vertices, the distance is exact there
+        double  bx0 = *std::min_element(e.begin(), e.end()), bx1 = *std::max_element(e.begin(), e.end());
+        double  by0 = *std::min_element(n.begin(), n.end()), by1 = *std::max_element(n.begin(), n.end());
+
+        t0 = tm_get_millis();
+        p.set(&e[0], &n[0], nVertex, GEOFENCE_INCLUSION, 100);
+        printf("polygon: %d vertices, grid %dx%d, %.1f edges/cell, prepared in %.1f ms\n",
+               nVertex, p.m_nx, p.m_ny, p.m_candAvg, tm_get_millis() - t0);
+
+        for(i=0; i<200000; i++) {
+            double  x = gf_rand(-6000, 6000), y = gf_rand(-6000, 6000);
+
+            // some points on vertices & edges' lines
+            if( i % 100 == 0 ) { k = rand() % nVertex; x = e[k]; y = gf_rand(-6000, 6000); }
+
+            int in1 = p.query(x, y, d1);
+            int in2 = p.queryBrute(x, y, d2);
+
+            if( in1 != in2 && d2 > 1e-9 ) nBad ++;
+            nIn += in2;
+
+            if( x < bx0 || x > bx1 || y < by0 || y > by1 ) {
+                nOff ++;
+                if( d1 > d2 + 1e-9 ) nBad ++;
+            } else {
+                eDis = std::max(eDis, fabs(d1 - d2));
+            }
+        }
+
+        printf("query vs brute force: %d mismatches, distance error %.2e m (%d inside, %d off the box)\n",
+               nBad, eDis, nIn, nOff);
+        if( nBad > 0 || eDis > 1e-6 ) err ++;
+
+        // small polygons: a square & a triangle
+        double  sx[4] = { 0, 10, 10, 0 }, sy[4] = { 0, 0, 10, 10 };
+        p.set(sx, sy, 4, GEOFENCE_INCLUSION, 2);
+        if( !p.query(5, 5, d1) || fabs(d1 - 5) > 1e-9 ) err ++;
+        if( p.query(11, 5, d1) || fabs(d1 - 1) > 1e-9 ) err ++;
+        if( p.query(-100, 5, d1) || d1 > 100 ) err ++;
+    }
+
+    // alerts: across the boundary & back, over the altitude limit, low terrain
+    {
+        GeoFenceEngine      ge;
+        GeoFenceTestLog     log;
+        double              la[4] = { 0, 0, 0.01, 0.01 }, ln[4] = { 0, 0.01, 0.01, 0 };
+
+        for(k=0; k<4; k++) { la[k] += lat0; ln[k] += lng0; }
+
+        ge.setOrigin(lat0, lng0);
+        ge.addPolygon(la, ln, 4, GEOFENCE_INCLUSION, 50);
+        ge.setAltitude(0, 120, 10);
+        ge.setClearance(20, 5);
+        ge.setAlertFunc(gf_test_alert, &log);
+
+        // east along the middle: inside, near, out, and back with jitter on the line
+        double  latM = lat0 + 0.005;
+        for(i=0; i<=300; i++) {
+            double lng = lng0 + 0.005 + i * 0.00003;
+            ge.check(7, latM, lng, 50, i * 100000);
+        }
+        for(i=300; i>=0; i--) {
+            double lng = lng0 + 0.005 + i * 0.00003 + (i % 2 ? 0.000005 : -0.000005);
+            ge.check(7, latM, lng, 50, (600 - i) * 100000);
+        }
+
+        int want[4][2] = { { GEOFENCE_OK, GEOFENCE_WARN }, { GEOFENCE_WARN, GEOFENCE_BREACH },
+                           { GEOFENCE_BREACH, GEOFENCE_WARN }, { GEOFENCE_WARN, GEOFENCE_OK } };
+        int bad = log.alerts.size() != 4;
+        for(k=0; k<4 && !bad; k++)
+            if( log.alerts[k].prevLevel != want[k][0] || log.alerts[k].level != want[k][1] ||
+                log.alerts[k].fence != 0 ) bad = 1;
+        printf("fence alerts: %d (OK>WARN>BREACH>WARN>OK expected)\n", (int) log.alerts.size());
+        for(k=0; k<log.alerts.size(); k++)
+            printf("  %s -> %s, %.1f m\n", geofence_level_name(log.alerts[k].prevLevel),
+                   geofence_level_name(log.alerts[k].level), log.alerts[k].dis);
+        if( bad ) err ++;
+
+        // altitude & terrain
+        log.alerts.clear();
+        ge.check(7, latM, lng0 + 0.005, 115, 0);
+        ge.check(7, latM, lng0 + 0.005, 125, 0);
+        ge.terrain(7, 22, 0);
+        ge.terrain(7, 15, 0);
+        if( log.alerts.size() != 4 || log.alerts[0].fence != GEOFENCE_ALT ||
+            log.alerts[1].level != GEOFENCE_BREACH || log.alerts[3].fence != GEOFENCE_TERRAIN ||
+            log.alerts[3].level != GEOFENCE_BREACH || ge.level(7) != GEOFENCE_BREACH ) {
+            printf("altitude/terrain alerts: %d\n", (int) log.alerts.size());
+            err ++;
+        }
+        if( ge.level(8) != GEOFENCE_OK ) err ++;
+    }
+
+    // fence file
+    {
+        GeoFenceEngine  ge;
+        FILE            *fp = fopen(fn_fence.c_str(), "wt");
+        double          d;
+
+        fprintf(fp, "# test fence\norigin %f %f\naltitude 0 120 10\ninclusion 50\n", lat0, lng0);
+        fprintf(fp, "%f %f\n%f %f\n%f %f\n", lat0, lng0, lat0, lng0 + 0.01, lat0 + 0.01, lng0);
+        fprintf(fp, "exclusion 10\n%f %f\n%f %f\n%f %f\n%f %f\n",
+                lat0 + 0.001, lng0 + 0.001, lat0 + 0.001, lng0 + 0.002,
+                lat0 + 0.002, lng0 + 0.002, lat0 + 0.002, lng0 + 0.001);
+        fclose(fp);
+
+        if( 0 != ge.load(fn_fence) || ge.polygonNum() != 2 ) err ++;
+        else {
+            double e, n;
+            ge.frame()->offset(lat0 + 0.0015, lng0 + 0.0015, e, n);
+            if( !ge.polygon(1)->query(e, n, d) || ge.polygon(1)->type() != GEOFENCE_EXCLUSION ) err ++;
+        }
+        remove(fn_fence.c_str());
+    }
+
+    // benchmark: vehicles at rateHz for 'seconds', an inclusion & nExcl exclusion
+    //  fences of nVertex vertices, indexed engine against all edges
+    {
+        GeoFenceEngine          ge;
+        GeoLocalFrame           lf;
+        std::vector<double>     e, n, la, ln;
+        std::vector<double>     px(nVehicle), py(nVehicle), vx(nVehicle), vy(nVehicle);
+        std::vector<double>     sLat, sLng;
+        double                  t0, tPrep, tIdx, tBrute, d;
+        uint64_t                nAlert;
+        int                     nSample = nVehicle * rateHz * seconds, j;
+
+        lf.setOrigin(lat0, lng0, 0);
+        ge.setOrigin(lat0, lng0);
+
+        t0 = tm_get_millis();
+        for(k=0; k<=nExcl; k++) {
+            if( k == 0 ) gf_star(0, 0, 4000, 6000, nVertex, e, n);
+            else         gf_star(gf_rand(-2500, 2500), gf_rand(-2500, 2500), 300, 700, nVertex, e, n);
+
+            la.resize(nVertex);
+            ln.resize(nVertex);
+            for(i=0; i<nVertex; i++) lf.enu2lla(e[i], n[i], 0, la[i], ln[i], d);
+
+            ge.addPolygon(&la[0], &ln[0], nVertex, k == 0 ? GEOFENCE_INCLUSION : GEOFENCE_EXCLUSION,
+                          k == 0 ? 100 : 30);
+        }
+        tPrep = tm_get_millis() - t0;
+
+        // vehicle tracks: 15 m/s, turning at random
+        for(j=0; j<nVehicle; j++) {
+            px[j] = gf_rand(-4000, 4000);
+            py[j] = gf_rand(-4000, 4000);
+            double a = gf_rand(0, 6.28);
+            vx[j] = 15*cos(a);
+            vy[j] = 15*sin(a);
+        }
+        sLat.resize(nSample);
+        sLng.resize(nSample);
+        for(i=0; i<rateHz*seconds; i++) {
+            for(j=0; j<nVehicle; j++) {
+                if( rand() % 50 == 0 || fabs(px[j]) > 6500 || fabs(py[j]) > 6500 ) {
+                    double a = atan2(-py[j], -px[j]) + gf_rand(-1, 1);
+                    vx[j] = 15*cos(a);
+                    vy[j] = 15*sin(a);
+                }
+                px[j] += vx[j] / rateHz;
+                py[j] += vy[j] / rateHz;
+                lf.enu2lla(px[j], py[j], 0, sLat[i*nVehicle + j], sLng[i*nVehicle + j], d);
+            }
+        }
+
+        t0 = tm_get_millis();
+        for(i=0; i<nSample; i++) ge.check(1 + i % nVehicle, sLat[i], sLng[i], 50, i);
+        tIdx = tm_get_millis() - t0;
+        nAlert = ge.m_nAlert;
+
+        // every edge of every fence, the same samples (one pass of 10 s)
+        int nBrute = std::min(nSample, nVehicle * rateHz * 10), mismatch = 0;
+        double sum = 0;
+
+        t0 = tm_get_millis();
+        for(i=0; i<nBrute; i++) {
+            double x, y, d2;
+            ge.frame()->offset(sLat[i], sLng[i], x, y);
+            for(k=0; k<ge.polygonNum(); k++) {
+                int in = ge.polygon(k)->queryBrute(x, y, d2);
+                sum += d2 + in;
+            }
+        }
+        tBrute = tm_get_millis() - t0;
+
+        for(i=0; i<nBrute; i += 7) {
+            double x, y, d1, d2;
+            ge.frame()->offset(sLat[i], sLng[i], x, y);
+            for(k=0; k<ge.polygonNum(); k++)
+                if( ge.polygon(k)->query(x, y, d1) != ge.polygon(k)->queryBrute(x, y, d2) ) mismatch ++;
+        }
+
+        double usIdx = 1000.0 * tIdx / nSample, usBrute = 1000.0 * tBrute / nBrute;
+        double need = nVehicle * rateHz;
+
+        printf("%d fences x %d vertices, prepared in %.0f ms\n", nExcl + 1, nVertex, tPrep);
+        printf("%d vehicles x %d Hz: %d samples, indexed %.2f us/sample, all edges %.2f us/sample "
+               "(x%.0f), %llu alerts, %d mismatches [%.0f]\n",
+               nVehicle, rateHz, nSample, usIdx, usBrute, usBrute / usIdx,
+               (unsigned long long) nAlert, mismatch, fmod(sum, 10.0));
+        printf("one core: %.3f%% for %.0f samples/s (all edges: %.2f%%)\n",
+               need * usIdx * 1e-4, need, need * usBrute * 1e-4);
+
+        if( mismatch > 0 ) err ++;
+    }
+
+    printf("errors = %d\n", err);
+
+    return err;
+}
@@ -0,0 +1,217 @@
+#ifndef __GEOFENCE_H__
+#define __GEOFENCE_H__
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <rtk_osa++.h>
+
+#include "utils_geodesy.h"
+
+
+#define GEOFENCE_VEHICLES       256             ///< by sysid
+
+#define GEOFENCE_ALT            -1              ///< fence index of the altitude limits
+#define GEOFENCE_TERRAIN        -2              ///< fence index of the terrain clearance
+
+#define GEOFENCE_HYST           1.0             ///< m, going back to a lower level
+
+enum GeoFenceType
+{
+    GEOFENCE_INCLUSION = 0,                     ///< stay inside
+    GEOFENCE_EXCLUSION = 1                      ///< stay outside
+};
+
+enum GeoFenceLevel
+{
+    GEOFENCE_OK     = 0,
+    GEOFENCE_WARN   = 1,                        ///< allowed side, closer than the margin
+    GEOFENCE_BREACH = 2
+};
+
+
+///
+/// \brief one polygon, prepared for fast point queries
+///
+///     The vertices are taken to the ENU frame of the engine once. A grid
+///     over the bounding box (grown by the margin) keeps for each cell
+///     whether its center is inside, and the edges that can be the nearest
+///     one to a point of the cell: all edges closer to the cell than the
+///     smallest "farthest corner" distance of any edge. They include the
+///     edges crossing the cell, so inside is the center's flag flipped by
+///     the edges crossed on the way from the point to the center, and the
+///     distance is the nearest of the same edges. Points off the grid are
+///     outside, their distance is the one to the box (a lower bound).
+///
+class GeoFencePolygon
+{
+public:
+    GeoFencePolygon();
+    ~GeoFencePolygon();
+
+    ///
+    /// \param e, n - vertices in the ENU frame (m), not closed
+    /// \return 0 - success, -1 - less than 3 vertices
+    ///
+    int set(const double *e, const double *n, int nVertex, int type, double margin);
+
+    ///
+    /// \brief point (ENU, m) inside or not, distance (m) to the boundary
+    ///
+    int query(double e, double n, double &dis);
+
+    ///
+    /// \brief same by testing all edges (for tests)
+    ///
+    int queryBrute(double e, double n, double &dis);
+
+    int     type(void)      { return m_type; }
+    double  margin(void)    { return m_margin; }
+    int     vertexNum(void) { return m_x.size(); }
+
+    // statistics of the grid
+    int     m_nx, m_ny;
+    double  m_candAvg;                          ///< edges per cell
+
+protected:
+    struct Cell {
+        int         inside;                     ///< cell center inside
+        int         beg, end;                   ///< range of m_cand
+    };
+
+    int     m_type;
+    double  m_margin;
+
+    std::vector<double>     m_x, m_y;           ///< vertices, edge i is i -> i+1
+    std::vector<Cell>       m_cells;
+    std::vector<int>        m_cand;
+
+    double  m_gx0, m_gy0, m_gx1, m_gy1;         ///< grid box
+    double  m_cs, m_ics;                        ///< cell size (m) & its inverse
+};
+
+
+///
+/// \brief level change of one vehicle for one fence
+///
+struct GeoFenceAlert
+{
+    int         sysid;
+    int         fence;                          ///< polygon index, GEOFENCE_ALT or GEOFENCE_TERRAIN
+    int         level, prevLevel;               ///< GeoFenceLevel
+    double      dis;                            ///< m to the limit, negative when breached
+    uint64_t    tUs;
+};
+
+typedef void (*GeoFenceAlertFunc)(void *arg, const GeoFenceAlert &a);
+
+
+///
+/// \brief Geofences & terrain clearance of all vehicles
+///
+///     check() is called for every position of every vehicle (by sysid),
+///     it evaluates all polygons, the altitude limits (relative to home)
+///     and keeps the level of each (vehicle, fence). A level change calls
+///     the alert function (outside the lock). Going back to a lower level
+///     needs GEOFENCE_HYST metres more, a vehicle on the line does not
+///     toggle.
+///
+class GeoFenceEngine
+{
+public:
+    GeoFenceEngine();
+    ~GeoFenceEngine();
+
+    ///
+    /// \brief frame of the polygons (clears them), default: first vertex
+    ///
+    void setOrigin(double lat, double lng);
+
+    ///
+    /// \return polygon index, -1 - less than 3 vertices
+    ///
+    int addPolygon(const double *lat, const double *lng, int n, int type, double margin);
+
+    ///
+    /// \brief altitude limits relative to home (hMax <= hMin: none)
+    ///
+    void setAltitude(double hMin, double hMax, double margin);
+
+    ///
+    /// \brief minimum height above terrain (<= 0: none)
+    ///
+    void setClearance(double hMin, double margin);
+
+    void clear(void);
+
+    ///
+    /// \brief load a fence file
+    ///
+    ///     # comment
+    ///     origin     <lat> <lng>
+    ///     altitude   <min> <max> <margin>
+    ///     clearance  <min> <margin>
+    ///     inclusion  <margin>             followed by "<lat> <lng>" lines
+    ///     exclusion  <margin>
+    ///
+    /// \return 0 - success, -1 - can not open the file
+    ///
+    int load(const std::string &fn);
+
+    void setAlertFunc(GeoFenceAlertFunc f, void *arg);
+
+    ///
+    /// \brief evaluate a position (h: relative to home)
+    /// \return worst level of the vehicle
+    ///
+    int check(int sysid, double lat, double lng, double h, uint64_t tUs);
+
+    ///
+    /// \brief evaluate the height above terrain (TERRAIN_REPORT)
+    ///
+    int terrain(int sysid, double clearance, uint64_t tUs);
+
+    ///
+    /// \brief worst current level of a vehicle
+    ///
+    int level(int sysid);
+
+    int polygonNum(void) { return m_polys.size(); }
+    GeoFencePolygon* polygon(int i) { return &m_polys[i]; }
+    rtk::GeoLocalFrame* frame(void) { return &m_frame; }
+
+    // statistics
+    uint64_t    m_nCheck, m_nAlert;
+
+protected:
+    int  update(int sysid, int fence, int slot, int breach, double dis, double margin,
+                uint64_t tUs, GeoFenceAlert *alerts, int &nAlert);
+
+    rtk::RMutex                     m_mutex;
+    rtk::GeoLocalFrame              m_frame;
+    std::vector<GeoFencePolygon>    m_polys;
+
+    double              m_hMin, m_hMax, m_hMargin;
+    double              m_cMin, m_cMargin;
+
+    std::vector<int>    m_level[GEOFENCE_VEHICLES];     ///< polygons, altitude, terrain
+
+    GeoFenceAlertFunc   m_alertFunc;
+    void                *m_alertArg;
+};
+
+///
+/// \brief "OK" / "WARN" / "BREACH"
+///
+const char* geofence_level_name(int level);
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_geofence(rtk::CParamArray *pa);
+
+#endif // end of __GEOFENCE_H__
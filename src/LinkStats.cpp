@@ -0,0 +1,534 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include <rtk_utils.h>
+#include <rtk_debug.h>
+#include <rtk_paramarray.h>
+
+#include "LinkStats.h"
+
+using namespace rtk;
+
+
+// one writer: plain stores are enough, the readers only must not see torn words
+#define LS_LOAD(x)          __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define LS_STORE(x, v)      __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#define LS_INC(x, v)        LS_STORE(x, LS_LOAD(x) + (v))
+
+
+LinkStats::LinkStats()
+{
+    reset();
+}
+
+LinkStats::~LinkStats()
+{
+}
+
+void LinkStats::reset(void)
+{
+    memset(m_peers, 0, sizeof(m_peers));
+    memset(m_msgs, 0, sizeof(m_msgs));
+    m_nPeer = 0;
+
+    m_frames    = 0;
+    m_bytes     = 0;
+    m_lost      = 0;
+    m_crcErrors = 0;
+    m_skipped   = 0;
+    m_unknown   = 0;
+    m_rejected  = 0;
+
+    m_srttUs    = 0;
+    m_rttvarUs  = 0;
+    m_rttMinUs  = 0;
+    m_rttN      = 0;
+
+    m_mutex.lock();
+    m_prev = LinkStatsSnapshot();
+    m_prev.tUs = 0;
+    m_prevMsgFrames.assign(LINK_STATS_MSGIDS + 1, 0);
+    m_prevMsgBytes.assign(LINK_STATS_MSGIDS + 1, 0);
+    m_mutex.unlock();
+}
+
+void LinkStats::frame(const uint8_t *p, int len, uint64_t tNowUs)
+{
+    uint32_t    seq, key, msgid;
+
+    if( p[0] == MAVLINK_STX_V2 ) {
+        seq   = p[4];
+        key   = p[5] << 8 | p[6];
+        msgid = p[7] | p[8] << 8 | p[9] << 16;
+    } else {
+        seq   = p[2];
+        key   = p[3] << 8 | p[4];
+        msgid = p[5];
+    }
+
+    LS_INC(m_frames, 1);
+    LS_INC(m_bytes, len);
+
+    // sequence numbers of the sender
+    uint32_t i, n = m_nPeer;
+    for(i=0; i<n; i++) if( m_peers[i].key == key ) break;
+
+    if( i < n ) {
+        Peer        &pr = m_peers[i];
+        uint32_t    d = (seq - pr.lastSeq) & 0xFF;
+
+        if( d == 0 )            LS_INC(pr.dup, 1);
+        else if( d > 128 )      LS_INC(pr.late, 1);
+        else if( d > 1 ) {
+            LS_INC(pr.lost, d - 1);
+            LS_INC(m_lost, d - 1);
+        }
+
+        if( d != 0 && d <= 128 ) pr.lastSeq = seq;
+        LS_INC(pr.frames, 1);
+    } else if( n < LINK_STATS_PEERS ) {
+        // new sender, published after it is filled
+        Peer &pr = m_peers[n];
+        pr.key     = key;
+        pr.lastSeq = seq;
+        LS_STORE(pr.frames, 1);
+        __atomic_store_n(&m_nPeer, n + 1, __ATOMIC_RELEASE);
+    }
+
+    // messages: count, bytes & inter-arrival jitter
+    Msg &m = m_msgs[msgid < LINK_STATS_MSGIDS ? msgid : LINK_STATS_MSGIDS];
+
+    LS_INC(m.frames, 1);
+    LS_INC(m.bytes, len);
+
+    if( m.tLast != 0 && tNowUs > m.tLast ) {
+        int64_t d = tNowUs - m.tLast;
+
+        if( m.intervalUs == 0 ) {
+            LS_STORE(m.intervalUs, (uint32_t) d);
+        } else {
+            int64_t dev = d - (int64_t) m.intervalUs;
+            if( dev < 0 ) dev = -dev;
+
+            LS_STORE(m.intervalUs, (uint32_t) (m.intervalUs + (d - (int64_t) m.intervalUs) / 16));
+            LS_STORE(m.jitterUs,   (uint32_t) (m.jitterUs + (dev - (int64_t) m.jitterUs) / 16));
+        }
+    }
+    m.tLast = tNowUs;
+}
+
+void LinkStats::scanStats(const mavlink_scan_stats &st)
+{
+    LS_STORE(m_crcErrors, st.crcErrors);
+    LS_STORE(m_skipped,   st.skipped);
+    LS_STORE(m_unknown,   st.unknown);
+}
+
+void LinkStats::rejected(void)
+{
+    LS_INC(m_rejected, 1);
+}
+
+void LinkStats::rttSample(uint64_t rttUs)
+{
+    // smoothed as TCP does (RFC 6298)
+    if( m_rttN == 0 ) {
+        LS_STORE(m_srttUs,   rttUs);
+        LS_STORE(m_rttvarUs, rttUs / 2);
+        LS_STORE(m_rttMinUs, rttUs);
+    } else {
+        int64_t dev = (int64_t) rttUs - (int64_t) m_srttUs;
+        if( dev < 0 ) dev = -dev;
+
+        LS_STORE(m_rttvarUs, (uint64_t) ((3 * m_rttvarUs + dev) / 4));
+        LS_STORE(m_srttUs,   (uint64_t) ((7 * m_srttUs + rttUs) / 8));
+        if( rttUs < m_rttMinUs ) LS_STORE(m_rttMinUs, rttUs);
+    }
+
+    LS_INC(m_rttN, 1);
+}
+
+uint64_t LinkStats::frames(void)    { return LS_LOAD(m_frames); }
+uint64_t LinkStats::bytes(void)     { return LS_LOAD(m_bytes); }
+uint64_t LinkStats::lost(void)      { return LS_LOAD(m_lost); }
+uint64_t LinkStats::crcErrors(void) { return LS_LOAD(m_crcErrors); }
+uint64_t LinkStats::unknown(void)   { return LS_LOAD(m_unknown); }
+double   LinkStats::rttMs(void)     { return LS_LOAD(m_srttUs) / 1000.0; }
+
+void LinkStats::snapshot(LinkStatsSnapshot &s, uint64_t tNowUs)
+{
+    m_mutex.lock();
+
+    s.tUs       = tNowUs;
+    s.period    = m_prev.tUs != 0 && tNowUs > m_prev.tUs ? (tNowUs - m_prev.tUs) * 1e-6 : 0;
+
+    s.frames    = LS_LOAD(m_frames);
+    s.bytes     = LS_LOAD(m_bytes);
+    s.lost      = LS_LOAD(m_lost);
+    s.crcErrors = LS_LOAD(m_crcErrors);
+    s.skipped   = LS_LOAD(m_skipped);
+    s.unknown   = LS_LOAD(m_unknown);
+    s.rejected  = LS_LOAD(m_rejected);
+
+    double  dt = s.period > 0 ? s.period : 1;
+    int64_t nRx = s.frames - m_prev.frames, nLost = s.lost - m_prev.lost;
+
+    s.fps     = s.period > 0 ? nRx / dt : 0;
+    s.bps     = s.period > 0 ? (s.bytes - m_prev.bytes) / dt : 0;
+    s.lossPct = nRx + nLost > 0 ? 100.0 * nLost / (nRx + nLost) : 0;
+
+    s.rttN      = LS_LOAD(m_rttN);
+    s.rttMs     = LS_LOAD(m_srttUs) / 1000.0;
+    s.rttVarMs  = LS_LOAD(m_rttvarUs) / 1000.0;
+    s.rttMinMs  = LS_LOAD(m_rttMinUs) / 1000.0;
+
+    // senders (only appended, in the order of the previous snapshot)
+    uint32_t n = __atomic_load_n(&m_nPeer, __ATOMIC_ACQUIRE);
+
+    s.peers.resize(n);
+    for(uint32_t i=0; i<n; i++) {
+        Peer                &pr = m_peers[i];
+        LinkPeerSnapshot    &ps = s.peers[i];
+
+        ps.sysid  = pr.key >> 8;
+        ps.compid = pr.key & 0xFF;
+        ps.frames = LS_LOAD(pr.frames);
+        ps.lost   = LS_LOAD(pr.lost);
+        ps.dup    = LS_LOAD(pr.dup);
+        ps.late   = LS_LOAD(pr.late);
+
+        uint64_t f0 = 0, l0 = 0;
+        if( i < m_prev.peers.size() ) {
+            f0 = m_prev.peers[i].frames;
+            l0 = m_prev.peers[i].lost;
+        }
+
+        ps.fps     = s.period > 0 ? (ps.frames - f0) / dt : 0;
+        ps.lossPct = ps.frames - f0 + ps.lost - l0 > 0 ?
+                        100.0 * (ps.lost - l0) / (ps.frames - f0 + ps.lost - l0) : 0;
+    }
+
+    // messages received so far
+    s.msgs.clear();
+    for(int i=0; i<=LINK_STATS_MSGIDS; i++) {
+        Msg         &m = m_msgs[i];
+        uint64_t    nf = LS_LOAD(m.frames);
+
+        if( nf == 0 ) continue;
+
+        LinkMsgSnapshot ms;
+        ms.msgid      = i < LINK_STATS_MSGIDS ? i : 0xFFFF;
+        ms.frames     = nf;
+        ms.bytes      = LS_LOAD(m.bytes);
+        ms.fps        = s.period > 0 ? (nf - m_prevMsgFrames[i]) / dt : 0;
+        ms.bps        = s.period > 0 ? (ms.bytes - m_prevMsgBytes[i]) / dt : 0;
+        ms.intervalMs = LS_LOAD(m.intervalUs) / 1000.0;
+        ms.jitterMs   = LS_LOAD(m.jitterUs) / 1000.0;
+        s.msgs.push_back(ms);
+
+        m_prevMsgFrames[i] = nf;
+        m_prevMsgBytes[i]  = ms.bytes;
+    }
+
+    m_prev = s;
+
+    m_mutex.unlock();
+}
+
+void LinkStats::lastSnapshot(LinkStatsSnapshot &s)
+{
+    m_mutex.lock();
+    s = m_prev;
+    m_mutex.unlock();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// Test
+////////////////////////////////////////////////////////////////////////////////
+
+static int link_frame(uint8_t *buf, int sysid, int compid, int seq, int msgid)
+{
+    mavlink_message_t msg;
+
+    if( msgid == MAVLINK_MSG_ID_HEARTBEAT )
+        mavlink_msg_heartbeat_pack(sysid, compid, &msg, MAV_TYPE_QUADROTOR,
+                                   MAV_AUTOPILOT_ARDUPILOTMEGA, 0, 0, MAV_STATE_ACTIVE);
+    else
+        mavlink_msg_attitude_pack(sysid, compid, &msg, seq, 0.1f, 0.2f, 0.3f, 0, 0, 0);
+
+    // own sequence number, checksum again
+    static const uint8_t crcExtra[256] = MAVLINK_MESSAGE_CRCS;
+    int         len = mavlink_msg_to_send_buffer(buf, &msg);
+    uint16_t    crc;
+
+    buf[2] = seq & 0xFF;
+    crc = mavlink_crc_block(buf + 1, len - 3);
+    crc_accumulate(crcExtra[buf[5]], &crc);
+    buf[len - 2] = crc & 0xFF;
+    buf[len - 1] = crc >> 8;
+
+    return len;
+}
+
+/**
+ *  frames of other dialects: MEMINFO (ardupilotmega, msgid 152) as MAVLink 1,
+ *  ESC_TELEMETRY_1_TO_4 (msgid 11030) as MAVLink 2
+ */
+static int link_frame_other(uint8_t *buf, int sysid, int compid, int seq, int v2)
+{
+    int         pl, hl;
+    uint16_t    crc;
+
+    if( v2 ) {
+        pl = 44;
+        hl = MAVLINK_V2_HEADER_LEN;
+        buf[0] = MAVLINK_STX_V2; buf[1] = pl;     buf[2] = 0;      buf[3] = 0;
+        buf[4] = seq & 0xFF;     buf[5] = sysid;  buf[6] = compid;
+        buf[7] = 11030 & 0xFF;   buf[8] = 11030 >> 8;              buf[9] = 0;
+    } else {
+        pl = 4;
+        hl = MAVLINK_NUM_HEADER_BYTES;
+        buf[0] = MAVLINK_STX;    buf[1] = pl;     buf[2] = seq & 0xFF;
+        buf[3] = sysid;          buf[4] = compid; buf[5] = 152;
+    }
+
+    for(int i=0; i<pl; i++) buf[hl + i] = (uint8_t) (seq * 7 + i);
+
+    crc = mavlink_crc_block(buf + 1, hl - 1 + pl);
+    crc_accumulate(v2 ? 144 : 208, &crc);
+    buf[hl + pl]     = crc & 0xFF;
+    buf[hl + pl + 1] = crc >> 8;
+
+    return hl + pl + 2;
+}
+
+class LinkStatsWriter : public RThread
+{
+public:
+    LinkStatsWriter() {
+        m_ls = NULL;
+        m_n  = 0;
+    }
+    virtual ~LinkStatsWriter() {}
+
+    virtual int thread_func(void *arg=NULL) {
+        uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+        int     len = link_frame(buf, 1, 1, 0, MAVLINK_MSG_ID_ATTITUDE);
+
+        // only the sequence number changes (the checksum is not looked at)
+        for(int i=0; i<m_n; i++) {
+            buf[2] = i & 0xFF;
+            m_ls->frame(buf, len, (i + 1) * 1000);
+        }
+
+        return 0;
+    }
+
+    LinkStats   *m_ls;
+    int         m_n;
+};
+
+static const LinkMsgSnapshot* link_msg(const LinkStatsSnapshot &s, int msgid)
+{
+    for(size_t i=0; i<s.msgs.size(); i++)
+        if( s.msgs[i].msgid == msgid ) return &s.msgs[i];
+
+    return NULL;
+}
+
+int test_link_stats(CParamArray *pa)
+{
+    int         nFrames = 2000000;
+    int         err = 0;
+    uint8_t     buf[MAVLINK_MAX_PACKET_LEN];
+    int         len;
+
+    pa->i("nFrames", nFrames);
+
+    // sequence gaps of two senders, across the wrap, a duplicate & a late frame
+    {
+        LinkStats           ls;
+        LinkStatsSnapshot   s;
+        int                 nSent = 0, nLost = 0;
+
+        for(int i=0; i<1000; i++) {
+            if( i % 10 == 3 ) { nLost ++; continue; }
+
+            len = link_frame(buf, 1, 1, i, MAVLINK_MSG_ID_ATTITUDE);
+            ls.frame(buf, len, i * 100000);
+            nSent ++;
+
+            if( i % 100 == 0 ) {
+                len = link_frame(buf, 1, 154, i / 100, MAVLINK_MSG_ID_HEARTBEAT);
+                ls.frame(buf, len, i * 100000);
+            }
+        }
+
+        len = link_frame(buf, 1, 1, 999, MAVLINK_MSG_ID_ATTITUDE);
+        ls.frame(buf, len, 100000000);                  // again
+        len = link_frame(buf, 1, 1, 990, MAVLINK_MSG_ID_ATTITUDE);
+        ls.frame(buf, len, 100000000);                  // behind
+
+        ls.snapshot(s, 100000000);
+
+        if( s.peers.size() != 2 ||
+            s.peers[0].lost != nLost || s.peers[0].frames != nSent + 2 ||
+            s.peers[0].dup != 1 || s.peers[0].late != 1 ||
+            s.peers[1].sysid != 1 || s.peers[1].compid != 154 ||
+            s.peers[1].lost != 0 || s.peers[1].frames != 10 ) {
+            printf("sequence: %d peers, lost %llu (%d), frames %llu (%d), dup %llu, late %llu\n",
+                   (int) s.peers.size(), (unsigned long long) s.peers[0].lost, nLost,
+                   (unsigned long long) s.peers[0].frames, nSent + 2,
+                   (unsigned long long) s.peers[0].dup, (unsigned long long) s.peers[0].late);
+            err ++;
+        }
+    }
+
+    // CRC errors counted by the scanner
+    {
+        MavlinkFrameScanner scanner;
+        mavlink_frame_spans frames;
+        LinkStats           ls;
+        std::vector<uint8_t> stream;
+        int                 nBad = 0;
+
+        for(int i=0; i<200; i++) {
+            len = link_frame(buf, 1, 1, i, MAVLINK_MSG_ID_ATTITUDE);
+            if( i % 20 == 7 ) { buf[len - 1] ^= 0x55; nBad ++; }
+            stream.insert(stream.end(), buf, buf + len);
+        }
+
+        scanner.push(stream.data(), stream.size(), frames);
+        for(size_t i=0; i<frames.size(); i++) ls.frame(frames[i], i * 1000);
+        ls.scanStats(scanner.stats);
+
+        if( ls.crcErrors() != nBad || ls.frames() != 200 - nBad ) {
+            printf("crc: %llu errors (%d), %llu frames\n",
+                   (unsigned long long) ls.crcErrors(), nBad, (unsigned long long) ls.frames());
+            err ++;
+        }
+    }
+
+    // messages of other dialects (ardupilotmega, MAVLink 2 msgid >= 256):
+    //  not checksummed, but their sequence numbers are no gaps
+    {
+        MavlinkFrameScanner scanner;
+        mavlink_frame_spans frames;
+        LinkStats           ls;
+        LinkStatsSnapshot   s;
+        std::vector<uint8_t> stream;
+        uint8_t             fb[MAVLINK_V2_MAX_PACKET_LEN];
+        int                 nOther = 0;
+
+        // (the last one checked: frames of other dialects wait for it)
+        for(int i=0; i<=300; i++) {
+            if( i % 3 == 0 ) len = link_frame(fb, 1, 1, i, MAVLINK_MSG_ID_ATTITUDE);
+            else           { len = link_frame_other(fb, 1, 1, i, i % 3 == 2); nOther ++; }
+            stream.insert(stream.end(), fb, fb + len);
+        }
+
+        // pushed in pieces, as read from the link
+        ls.snapshot(s, 1);
+        for(size_t i=0; i<stream.size(); i+=64) {
+            scanner.push(stream.data() + i, std::min((int) (stream.size() - i), 64), frames);
+            for(size_t j=0; j<frames.size(); j++) ls.frame(frames[j], 1 + i * 1000);
+            ls.scanStats(scanner.stats);
+        }
+        ls.snapshot(s, 1 + stream.size() * 1000);
+
+        if( s.frames != 301 || s.lost != 0 || s.lossPct != 0 ||
+            s.crcErrors != 0 || s.unknown != (uint64_t) nOther ||
+            link_msg(s, 152) == NULL || link_msg(s, 0xFFFF) == NULL ) {
+            printf("other dialects: %llu frames, lost %llu (%.1f%%), crc %llu, unknown %llu (%d)\n",
+                   (unsigned long long) s.frames, (unsigned long long) s.lost, s.lossPct,
+                   (unsigned long long) s.crcErrors, (unsigned long long) s.unknown, nOther);
+            err ++;
+        }
+    }
+
+    // rates, inter-arrival jitter & round trip
+    {
+        LinkStats           ls;
+        LinkStatsSnapshot   s;
+        int                 jitterUs = 4000;
+
+        srand(3);
+        ls.snapshot(s, 1);
+
+        for(int i=0; i<100; i++) {
+            uint64_t t = 1 + i * 100000 + rand() % jitterUs;
+            len = link_frame(buf, 1, 1, i, MAVLINK_MSG_ID_ATTITUDE);
+            ls.frame(buf, len, t);
+
+            if( i % 10 == 0 ) {
+                len = link_frame(buf, 1, 1, i, MAVLINK_MSG_ID_HEARTBEAT);
+                ls.frame(buf, len, t);
+                ls.rttSample(120000 + rand() % 20000);
+            }
+        }
+
+        ls.snapshot(s, 10000001);
+
+        const LinkMsgSnapshot *att = link_msg(s, MAVLINK_MSG_ID_ATTITUDE);
+        const LinkMsgSnapshot *hb  = link_msg(s, MAVLINK_MSG_ID_HEARTBEAT);
+
+        // uniform arrival offsets in [0, 4) ms: mean |interval - 100 ms| is 4/3 ms
+        printf("rates: ATTITUDE %.1f Hz, %.0f B/s, interval %.1f ms, jitter %.2f ms; "
+               "HEARTBEAT %.1f Hz; rtt %.1f ms (min %.1f, var %.1f)\n",
+               att ? att->fps : 0, att ? att->bps : 0, att ? att->intervalMs : 0, att ? att->jitterMs : 0,
+               hb ? hb->fps : 0, s.rttMs, s.rttMinMs, s.rttVarMs);
+
+        if( att == NULL || hb == NULL || fabs(att->fps - 10) > 0.01 || fabs(hb->fps - 1) > 0.01 ||
+            fabs(att->intervalMs - 100) > 1 || att->jitterMs < 0.7 || att->jitterMs > 2.2 ||
+            s.rttMs < 120 || s.rttMs > 140 || s.rttMinMs < 120 || s.lossPct != 0 ) {
+            printf("rates: wrong\n");
+            err ++;
+        }
+    }
+
+    // lock-free readers while the writer runs
+    {
+        LinkStats           ls;
+        LinkStatsSnapshot   s;
+        LinkStatsWriter     w;
+        uint64_t            last = 0, nRead = 0, nBack = 0;
+        double              t0 = tm_get_millis();
+
+        w.m_ls = &ls;
+        w.m_n  = nFrames;
+        w.start();
+
+        while( ls.frames() < (uint64_t) nFrames ) {
+            uint64_t f = ls.frames();
+            if( f < last ) nBack ++;
+            last = f;
+            nRead ++;
+
+            if( nRead % 1000 == 0 ) ls.snapshot(s, (uint64_t) (tm_get_millis() * 1000));
+        }
+        w.wait();
+
+        double dt = tm_get_millis() - t0;
+        ls.snapshot(s, (uint64_t) (tm_get_millis() * 1000));
+
+        printf("concurrent: %d frames in %.1f ms (%.1f ns/frame), %llu reads, lost %llu\n",
+               nFrames, dt, dt * 1e6 / nFrames, (unsigned long long) nRead,
+               (unsigned long long) s.lost);
+
+        if( nBack != 0 || s.frames != (uint64_t) nFrames || s.lost != 0 ||
+            s.peers.size() != 1 || s.peers[0].frames != (uint64_t) nFrames ) {
+            printf("concurrent: %llu counters going back, %llu frames\n",
+                   (unsigned long long) nBack, (unsigned long long) s.frames);
+            err ++;
+        }
+    }
+
+    printf("\nerrors = %d\n", err);
+
+    return err;
+}
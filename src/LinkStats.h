@@ -0,0 +1,160 @@
+#ifndef __LINKSTATS_H__
+#define __LINKSTATS_H__
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <rtk_osa++.h>
+
+#include "utils_mavlink.h"
+
+
+#define LINK_STATS_PEERS        16              ///< (sysid, compid) pairs tracked
+#define LINK_STATS_MSGIDS       256             ///< msgid >= 256 are counted as msgid 0xFFFF
+
+
+///
+/// \brief one (sysid, compid) of the snapshot
+///
+struct LinkPeerSnapshot
+{
+    int         sysid, compid;
+    uint64_t    frames;                         ///< received
+    uint64_t    lost;                           ///< sequence gaps
+    uint64_t    dup;                            ///< same sequence number again
+    uint64_t    late;                           ///< sequence number behind (reordered / restarted)
+    double      fps;                            ///< frames/s in the period
+    double      lossPct;                        ///< lost / (received + lost) in the period
+};
+
+///
+/// \brief one msgid of the snapshot (only msgids received)
+///
+struct LinkMsgSnapshot
+{
+    int         msgid;
+    uint64_t    frames, bytes;
+    double      fps, bps;                       ///< in the period
+    double      intervalMs, jitterMs;           ///< smoothed inter-arrival time & its deviation
+};
+
+///
+/// \brief link statistics at one time, rates over the period since the last snapshot
+///
+struct LinkStatsSnapshot
+{
+    uint64_t    tUs;
+    double      period;                         ///< s, 0 for the first snapshot
+
+    uint64_t    frames, bytes, lost;
+    uint64_t    crcErrors, skipped;             ///< from the frame scanner
+    uint64_t    unknown;                        ///< msgid not in the dialect (not checksummed)
+    uint64_t    rejected;                       ///< signature check failed
+    double      fps, bps, lossPct;
+
+    double      rttMs, rttVarMs, rttMinMs;      ///< TIMESYNC round trip (0: no sample)
+    uint64_t    rttN;
+
+    std::vector<LinkPeerSnapshot>   peers;
+    std::vector<LinkMsgSnapshot>    msgs;
+};
+
+
+///
+/// \brief Statistics of one MAVLink link
+///
+///     frame() is called by the reading thread for every good frame, with
+///     the raw bytes, so MAVLink 2 frames with large msgids and frames of
+///     other dialects are counted too (the scanner counts them as unknown,
+///     apart from the checksum errors).
+///     Per (sysid, compid): sequence gaps, duplicates, late frames. Per msgid:
+///     frames, bytes, smoothed inter-arrival time and jitter (mean deviation,
+///     as RFC 3550). Round trip from TIMESYNC answers (rttSample).
+///
+///     There is one writer (the reading thread). The counters are plain
+///     words written & read with relaxed atomics, so the GUI reads them any
+///     time without a lock; snapshot() adds the rates since the previous one.
+///
+class LinkStats
+{
+public:
+    LinkStats();
+    ~LinkStats();
+
+    ///
+    /// \brief count a good frame (writer)
+    ///
+    void frame(const uint8_t *p, int len, uint64_t tNowUs);
+    void frame(const mavlink_frame_span &f, uint64_t tNowUs) { frame(f.p, f.len, tNowUs); }
+
+    ///
+    /// \brief scanner counters (absolute), rejected frames (writer)
+    ///
+    void scanStats(const mavlink_scan_stats &st);
+    void rejected(void);
+
+    ///
+    /// \brief round trip of a TIMESYNC answer (writer)
+    ///
+    void rttSample(uint64_t rttUs);
+
+    // lock-free readers
+    uint64_t frames(void);
+    uint64_t bytes(void);
+    uint64_t lost(void);
+    uint64_t crcErrors(void);
+    uint64_t unknown(void);
+    double   rttMs(void);
+
+    ///
+    /// \brief counters & rates since the previous snapshot
+    ///
+    void snapshot(LinkStatsSnapshot &s, uint64_t tNowUs);
+
+    ///
+    /// \brief copy of the last snapshot (taken periodically by someone else)
+    ///
+    void lastSnapshot(LinkStatsSnapshot &s);
+
+    ///
+    /// \brief clear (no frame() at the same time)
+    ///
+    void reset(void);
+
+protected:
+    struct Peer {
+        uint32_t    key;                        ///< sysid << 8 | compid
+        uint32_t    lastSeq;
+        uint64_t    frames, lost, dup, late;
+    };
+
+    struct Msg {
+        uint64_t    frames, bytes;
+        uint64_t    tLast;                      ///< us
+        uint32_t    intervalUs, jitterUs;
+    };
+
+    Peer                m_peers[LINK_STATS_PEERS];
+    uint32_t            m_nPeer;
+    Msg                 m_msgs[LINK_STATS_MSGIDS + 1];
+
+    uint64_t            m_frames, m_bytes, m_lost;
+    uint64_t            m_crcErrors, m_skipped, m_unknown, m_rejected;
+
+    uint64_t            m_srttUs, m_rttvarUs, m_rttMinUs, m_rttN;
+
+    // previous snapshot (for the rates)
+    rtk::RMutex         m_mutex;
+    LinkStatsSnapshot   m_prev;
+    std::vector<uint64_t>   m_prevMsgFrames, m_prevMsgBytes;
+};
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_link_stats(rtk::CParamArray *pa);
+
+#endif // end of __LINKSTATS_H__
@@ -1,10 +1,32 @@
 
+#include <math.h>
+
 #include <QtCore>
 #include <QtGui>
 #include <QMenu>
+#include <QBuffer>
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLPaintDevice>
+#include <QOffscreenSurface>
+
+#include <rtk_utils.h>
+#include <rtk_paramarray.h>
+
+#include "trailitem.h"
+#include "traillineitem.h"
+#include "trailpathitem.h"
+#include "glmapcompositor.h"
+#include "pureimage.h"
+#include "projections/mercatorprojection.h"
+#include "tilematrix.h"
+#include "spatialindex.h"
 
 #include "MapWidget.h"
 
+using namespace rtk;
+
 
 MapWidget::MapWidget(QWidget *parent) :
     mapcontrol::OPMapWidget(parent)
@@ -36,6 +58,7 @@ void MapWidget::setConf(QSettings *conf)
         MapType::Types              mapType;
         core::AccessMode::Types     accessMode;
         QString                     cacheLocation;
+        bool                        useOpenGL;
 
         // load settings
         accessMode    = (core::AccessMode::Types) m_conf->value("mapWidget_accessMode",
@@ -43,16 +66,19 @@ void MapWidget::setConf(QSettings *conf)
         mapType       = (MapType::Types) m_conf->value("mapWidget_mapType",
                                           (int)(MapType::GoogleSatellite)).toInt();
         cacheLocation = m_conf->value("mapWidget_cacheLocation", "./data/").toString();
+        useOpenGL     = m_conf->value("mapWidget_useOpenGL", false).toBool();
 
         // set configurations
         configuration->SetAccessMode(accessMode);
         configuration->SetCacheLocation(cacheLocation);
+        if( useOpenGL ) SetUseOpenGL(true);
         //SetMapType(mapType);
 
         // sync to file
         m_conf->setValue("mapWidget_mapType", (int)(mapType));
         m_conf->setValue("mapWidget_accessMode", (int)(accessMode));
         m_conf->setValue("mapWidget_cacheLocation", cacheLocation);
+        m_conf->setValue("mapWidget_useOpenGL", useOpenGL);
         m_conf->sync();
 
         // set accessMode actions
@@ -208,3 +234,592 @@ void MapWidget::actMapAccess_Cache(void)
         m_conf->sync();
     }
 }
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// trail rendering benchmark
+////////////////////////////////////////////////////////////////////////////////
+
+// lawnmower survey pattern: 1 km legs, 30 m apart, one trail point each 20 m
+static void trail_gen_survey(int n, QVector<internals::PointLatLng> &pts)
+{
+    double  lat0 = 34.0, lng0 = 108.9;
+    double  mLat = 1.0/111320.0;
+    double  mLng = 1.0/(111320.0*cos(lat0*M_PI/180.0));
+    int     nLeg = 50;
+
+    pts.clear();
+    for(int i=0; i<n; i++) {
+        int     leg = i / nLeg, k = i % nLeg;
+        double  x = (leg % 2 == 0) ? k*20.0 : (nLeg-1-k)*20.0;
+        double  y = leg*30.0;
+
+        pts.push_back(internals::PointLatLng(lat0 + y*mLat, lng0 + x*mLng));
+    }
+}
+
+int test_trail_bench(CParamArray *pa)
+{
+    int     argc;
+    char**  argv;
+    int     nFrame = 20, nOldMax = 50000;
+
+    int     ns[] = {1000, 10000, 50000, 100000};
+    int     zs[] = {12, 15, 18};
+
+    argc = pa->i("argc");
+    argv = (char**) pa->p("argv");
+    pa->i("nFrame", nFrame);
+    pa->i("nOldMax", nOldMax);
+
+    QApplication app(argc, argv);
+
+    projections::MercatorProjection proj;
+    QImage  img(1024, 768, QImage::Format_ARGB32_Premultiplied);
+    QRectF  view(0, 0, img.width(), img.height());
+
+    printf("%8s %5s %14s %14s %14s %8s\n",
+           "points", "zoom", "items ms/frame", "path build ms", "path ms/frame", "vertex");
+
+    for(int ni=0; ni<4; ni++) {
+        int                                 n = ns[ni];
+        QVector<internals::PointLatLng>     pts;
+        QGraphicsScene                      sOld, sNew;
+        QGraphicsItemGroup                  *gDot = NULL, *gLine = NULL;
+        mapcontrol::TrailPathItem           *trail;
+
+        trail_gen_survey(n, pts);
+
+        // previous implementation: one item per trail point & segment
+        if( n <= nOldMax ) {
+            gDot  = new QGraphicsItemGroup;
+            gLine = new QGraphicsItemGroup;
+            sOld.addItem(gDot);
+            sOld.addItem(gLine);
+
+            for(int i=0; i<n; i++) {
+                gDot->addToGroup(new mapcontrol::TrailItem(pts[i], 100, QBrush(Qt::red), NULL));
+                if( i > 0 )
+                    gLine->addToGroup(new mapcontrol::TrailLineItem(pts[i-1], pts[i], QBrush(Qt::red), NULL));
+            }
+        }
+
+        trail = new mapcontrol::TrailPathItem(NULL, NULL, n);
+        sNew.addItem(trail);
+        for(int i=0; i<n; i++) trail->AddPoint(pts[i], 100, QColor(Qt::red));
+
+        for(int zi=0; zi<3; zi++) {
+            int         zoom = zs[zi];
+            core::Point c = proj.FromLatLngToPixel(pts[n-1], zoom);
+            double      tOld = -1, tBuild, tNew;
+            ru64        t0;
+
+            // map follows the UAV (last point), pan by one pixel each frame
+            if( gDot != NULL ) {
+                t0 = tm_get_us();
+                for(int f=0; f<nFrame; f++) {
+                    int ox = img.width()/2 - c.X() + f, oy = img.height()/2 - c.Y();
+
+                    // UAVItem::RefreshPos of the previous implementation
+                    foreach(QGraphicsItem* i, gDot->childItems()) {
+                        mapcontrol::TrailItem *w = qgraphicsitem_cast<mapcontrol::TrailItem*>(i);
+                        core::Point p = proj.FromLatLngToPixel(w->coord, zoom);
+                        w->setPos(p.X()+ox, p.Y()+oy);
+                    }
+                    foreach(QGraphicsItem* i, gLine->childItems()) {
+                        mapcontrol::TrailLineItem *w = qgraphicsitem_cast<mapcontrol::TrailLineItem*>(i);
+                        core::Point p1 = proj.FromLatLngToPixel(w->coord1, zoom);
+                        core::Point p2 = proj.FromLatLngToPixel(w->coord2, zoom);
+                        w->setLine(p1.X()+ox, p1.Y()+oy, p2.X()+ox, p2.Y()+oy);
+                    }
+
+                    img.fill(0);
+                    QPainter painter(&img);
+                    sOld.render(&painter, view, view);
+                }
+                tOld = (tm_get_us() - t0) / 1000.0 / nFrame;
+            }
+
+            // new implementation: first frame at a zoom builds the cache
+            t0 = tm_get_us();
+            trail->SetProjection(&proj, zoom);
+            tBuild = (tm_get_us() - t0) / 1000.0;
+
+            t0 = tm_get_us();
+            for(int f=0; f<nFrame; f++) {
+                int ox = img.width()/2 - c.X() + f, oy = img.height()/2 - c.Y();
+
+                trail->setTransform(QTransform::fromTranslate(ox, oy));
+
+                img.fill(0);
+                QPainter painter(&img);
+                sNew.render(&painter, view, view);
+            }
+            tNew = (tm_get_us() - t0) / 1000.0 / nFrame;
+
+            printf("%8d %5d %14.3f %14.3f %14.3f %8d\n",
+                   n, zoom, tOld, tBuild, tNew, trail->VertexCount());
+        }
+    }
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// map tile compositing benchmark: QPainter (raster) vs GL texture atlas
+////////////////////////////////////////////////////////////////////////////////
+
+static void map_gen_tiles(int n, QVector<QByteArray> &tiles)
+{
+    tiles.resize(n);
+
+    for(int i=0; i<n; i++) {
+        QImage      img(256, 256, QImage::Format_RGB32);
+        QPainter    p(&img);
+        QBuffer     buf(&tiles[i]);
+
+        img.fill(QColor::fromHsv((i*37) % 360, 120, 200));
+        for(int k=0; k<40; k++) {
+            p.setPen(QColor::fromHsv((i*37 + k*11) % 360, 200, 120));
+            p.drawLine(k*7, 0, 255 - k*5, 255);
+        }
+        p.drawText(QRect(0, 0, 256, 256), Qt::AlignCenter, QString("tile %1").arg(i));
+        p.end();
+
+        buf.open(QIODevice::WriteOnly);
+        img.save(&buf, "PNG");
+    }
+}
+
+// draw the visible tiles of a w x h view, rotated by angle around the center
+static void map_draw_tiles(QPainter &painter, mapcontrol::GLMapCompositor *gl,
+                           QVector<QByteArray> &tiles, int w, int h,
+                           double angle, double scale, int ox)
+{
+    QTransform  tr;
+    int         nx = w/256 + 3, ny = h/256 + 3;
+
+    tr.translate(w/2, h/2);
+    tr.rotate(angle);
+    tr.scale(scale, scale);
+    tr.translate(-w/2, -h/2);
+    painter.setWorldTransform(tr);
+
+    if( gl != NULL && gl->Begin(&painter) ) {
+        for(int j=0; j<ny; j++) {
+            for(int i=0; i<nx; i++) {
+                core::Point p(i, j);
+                QRectF      r(i*256 - 256 - ox, j*256 - 256, 256, 256);
+
+                gl->AddTile(p, 15, 0, tiles[(j*nx + i) % tiles.size()], r);
+            }
+        }
+        gl->End(&painter);
+    } else {
+        painter.setRenderHint(QPainter::SmoothPixmapTransform, true);
+        painter.setRenderHint(QPainter::HighQualityAntialiasing, true);
+
+        for(int j=0; j<ny; j++) {
+            for(int i=0; i<nx; i++) {
+                painter.drawPixmap(i*256 - 256 - ox, j*256 - 256, 256, 256,
+                                   core::PureImageProxy::FromStream(tiles[(j*nx + i) % tiles.size()]));
+            }
+        }
+    }
+
+    painter.resetTransform();
+}
+
+int test_map_gl_bench(CParamArray *pa)
+{
+    int     argc;
+    char**  argv;
+    int     nFrame = 60;
+
+    int     ws[] = {1920, 3840};
+    int     hs[] = {1080, 2160};
+
+    argc = pa->i("argc");
+    argv = (char**) pa->p("argv");
+    pa->i("nFrame", nFrame);
+
+    QApplication app(argc, argv);
+
+    QVector<QByteArray> tiles;
+    map_gen_tiles(256, tiles);
+
+    // offscreen GL context (llvmpipe without a GPU)
+    QSurfaceFormat      fmt;
+    QOpenGLContext      ctx;
+    QOffscreenSurface   surface;
+
+    surface.setFormat(fmt);
+    surface.create();
+    ctx.setFormat(fmt);
+    bool glOK = ctx.create() && ctx.makeCurrent(&surface);
+
+    if( glOK )
+        printf("GL: %s / %s\n",
+               (const char*) ctx.functions()->glGetString(GL_RENDERER),
+               (const char*) ctx.functions()->glGetString(GL_VERSION));
+    else
+        printf("GL: not available, only the raster path is measured\n");
+
+    printf("%6s %6s %16s %16s %10s\n", "width", "height", "raster ms/frame", "GL ms/frame", "uploads");
+
+    for(int k=0; k<2; k++) {
+        int     w = ws[k], h = hs[k];
+        double  tRaster, tGL = -1;
+        ru64    t0;
+        int     nUpload = 0;
+
+        // current path: QPainter on a raster image, rotation & zoom animation
+        {
+            QImage img(w, h, QImage::Format_ARGB32_Premultiplied);
+
+            t0 = tm_get_us();
+            for(int f=0; f<nFrame; f++) {
+                img.fill(0);
+                QPainter painter(&img);
+                map_draw_tiles(painter, NULL, tiles, w, h, f*0.5, 1.0 + f*0.005, f);
+            }
+            tRaster = (tm_get_us() - t0) / 1000.0 / nFrame;
+        }
+
+        // GL compositor on a framebuffer object
+        if( glOK ) {
+            QOpenGLFramebufferObject        fbo(w, h);
+            QOpenGLPaintDevice              dev(w, h);
+            mapcontrol::GLMapCompositor     gl;
+
+            fbo.bind();
+
+            t0 = tm_get_us();
+            for(int f=0; f<nFrame; f++) {
+                QPainter painter(&dev);
+                painter.fillRect(0, 0, w, h, Qt::black);
+                map_draw_tiles(painter, &gl, tiles, w, h, f*0.5, 1.0 + f*0.005, f);
+                painter.end();
+                ctx.functions()->glFinish();
+            }
+            tGL = (tm_get_us() - t0) / 1000.0 / nFrame;
+
+            fbo.release();
+            nUpload = gl.Uploads();
+        }
+
+        printf("%6d %6d %16.3f %16.3f %10d\n", w, h, tRaster, tGL, nUpload);
+    }
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// batched projection benchmark
+////////////////////////////////////////////////////////////////////////////////
+
+int test_projection_bench(CParamArray *pa)
+{
+    int     n = 1000000, nLoop = 10, zMax = 22;
+    int     err = 0;
+
+    pa->i("n", n);
+    pa->i("nLoop", nLoop);
+
+    projections::MercatorProjection proj;
+    internals::LatLngArray          a;
+    double                          errMax = 0;
+    int                             nRound = 0;
+    ru64                            t0, t1, t2;
+    long                            sum = 0;
+
+    // whole world, including the clipped latitudes near the poles
+    srand(4321);
+    a.lat.resize(n);
+    a.lng.resize(n);
+    for(int i=0; i<n; i++) {
+        a.lat[i] = (rand() * 1.0 / RAND_MAX - 0.5) * 180.0;
+        a.lng[i] = (rand() * 1.0 / RAND_MAX - 0.5) * 360.0;
+    }
+
+    // accuracy against sin/log, in pixels at each zoom
+    for(int z=0; z<=zMax; z++) {
+        a.Project(&proj, z);
+
+        core::Size s = proj.GetTileMatrixSizePixel(z);
+        for(int i=0; i<n; i+=7) {
+            double la = qMin(qMax(a.lat[i], -85.05112878), 85.05112878);
+            double ln = qMin(qMax(a.lng[i], -177.0), 177.0);
+            double sl = sin(la * M_PI / 180);
+            double x  = qMin(qMax((ln + 180) / 360 * s.Width(), 0.0), s.Width() - 1.0);
+            double y  = qMin(qMax((0.5 - log((1 + sl) / (1 - sl)) / (4 * M_PI)) * s.Height(), 0.0),
+                             s.Height() - 1.0);
+
+            errMax = qMax(errMax, qMax(fabs(a.x[i] - x), fabs(a.y[i] - y)));
+
+            core::Point p = proj.FromLatLngToPixel(a.lat[i], a.lng[i], z);
+            if( p.X() != (int) (a.x[i] + 0.5) || p.Y() != (int) (a.y[i] + 0.5) ) nRound ++;
+        }
+    }
+    if( errMax > 0.01 ) err ++;
+
+    // throughput at zoom 22
+    t0 = tm_get_us();
+    for(int k=0; k<nLoop; k++) a.Project(&proj, zMax);
+    t1 = tm_get_us();
+    for(int k=0; k<nLoop; k++)
+        for(int i=0; i<n; i++) sum += proj.FromLatLngToPixel(a.lat[i], a.lng[i], zMax).X();
+    t2 = tm_get_us();
+
+    printf("max error %.2g px (zoom 0-%d), rounding differs %d of %d\n",
+           errMax, zMax, nRound, (n/7 + 1) * (zMax + 1));
+    printf("batch %.1f Mpoints/s, scalar %.1f Mpoints/s (%ld)\n",
+           1.0 * n * nLoop / (t1 - t0), 1.0 * n * nLoop / (t2 - t1), sum & 1);
+    printf("errors = %d\n", err);
+
+    return err;
+}
+
+
+// loader thread of test_tilematrix_stress: fill the view around the
+// (moving) center, evict what left it now and then like Core::run
+class TileLoaderSim : public QThread
+{
+public:
+    internals::TileMatrix   *matrix;
+    QAtomicInt              *cx, *cy, *stop;
+    int                     zoom, w, h, seed;
+    long                    nSet, nEvict;
+
+    void run()
+    {
+        nSet = nEvict = 0;
+        srand(seed);
+
+        while( stop->loadAcquire() == 0 ) {
+            int         x = cx->loadAcquire(), y = cy->loadAcquire();
+            core::Point p(x + rand() % (2*w+1) - w, y + rand() % (2*h+1) - h);
+            bool        empty;
+
+            {
+                internals::TileMatrix::ReadGuard guard(*matrix);
+                empty = matrix->TileAt(p) == 0;
+            }
+
+            if( empty ) {
+                internals::Tile *t = new internals::Tile(zoom, p);
+                t->Overlays.append(QByteArray(256, (char) (p.X() ^ p.Y())));
+                matrix->SetTileAt(p, t);
+                nSet ++;
+            }
+
+            if( rand() % 32 == 0 ) {
+                QList<core::Point> list;
+                for(int i=-w; i<=w; i++)
+                    for(int j=-h; j<=h; j++) list.append(core::Point(x+i, y+j));
+                matrix->ClearPointsNotIn(list);
+                nEvict ++;
+            }
+        }
+    }
+};
+
+int test_tilematrix_stress(CParamArray *pa)
+{
+    int     nLoader = 3, tmRun = 3000, zoom = 18, w = 5, h = 4, n = 4096;
+    int     err = 0;
+
+    pa->i("nLoader", nLoader);
+    pa->i("tmRun", tmRun);
+    pa->i("zoom", zoom);
+    pa->i("n", n);
+
+    internals::TileMatrix       matrix;
+    QAtomicInt                  cx(1 << (zoom-1)), cy(1 << (zoom-1)), stop(0);
+    QList<TileLoaderSim*>        loaders;
+    ru64                        t0, t1;
+    long                        nFrame = 0, nLookup = 0, nHit = 0, nSet = 0, nEvict = 0;
+    int                         retiredMax = 0;
+
+    // eviction cost grows with the tiles kept, not with kept x present
+    {
+        QList<core::Point> keep;
+        for(int i=0; i<n; i++) {
+            matrix.SetTileAt(core::Point(i, 0), new internals::Tile(zoom, core::Point(i, 0)));
+            if( i % 2 == 0 ) keep.append(core::Point(i, 0));
+        }
+
+        t0 = tm_get_us();
+        matrix.ClearPointsNotIn(keep);
+        t1 = tm_get_us();
+
+        if( matrix.count() != n / 2 ) { printf("evict: %d tiles left\n", matrix.count()); err ++; }
+        printf("evict %d of %d tiles: %.3f ms\n", n - n/2, n, (t1 - t0) / 1000.0);
+        matrix.Clear();
+    }
+
+    for(int k=0; k<nLoader; k++) {
+        TileLoaderSim *l = new TileLoaderSim;
+        l->matrix = &matrix;
+        l->cx = &cx; l->cy = &cy; l->stop = &stop;
+        l->zoom = zoom; l->w = w; l->h = h; l->seed = 1234 + k;
+        l->start();
+        loaders.append(l);
+    }
+
+    // the paint side: drag one tile every 4 frames, zig-zag, and check
+    // every tile found still is the tile of that position
+    t0 = tm_get_us();
+    while( tm_get_us() - t0 < (ru64) tmRun * 1000 ) {
+        int dx = (nFrame / 256) % 2 ? -1 : 1;
+
+        if( nFrame % 4 == 0 )  cx.fetchAndAddOrdered(dx);
+        if( nFrame % 12 == 0 ) cy.fetchAndAddOrdered(1);
+
+        {
+            internals::TileMatrix::ReadGuard guard(matrix);
+            int x = cx.loadAcquire(), y = cy.loadAcquire();
+
+            for(int i=-w; i<=w; i++) {
+                for(int j=-h; j<=h; j++) {
+                    core::Point p(x+i, y+j);
+                    internals::Tile *t = matrix.TileAt(p);
+
+                    nLookup ++;
+                    if( t == 0 ) continue;
+                    nHit ++;
+
+                    if( t->GetPos() != p || t->Overlays.count() != 1 ||
+                        t->Overlays[0].size() != 256 || t->Overlays[0][255] != (char) (p.X() ^ p.Y()) )
+                        err ++;
+                }
+            }
+        }
+
+        retiredMax = qMax(retiredMax, matrix.retired());
+        nFrame ++;
+        if( nFrame % 16 == 0 ) QThread::yieldCurrentThread();
+    }
+    t1 = tm_get_us();
+
+    stop.storeRelease(1);
+    for(int k=0; k<loaders.count(); k++) {
+        loaders[k]->wait();
+        nSet   += loaders[k]->nSet;
+        nEvict += loaders[k]->nEvict;
+        delete loaders[k];
+    }
+
+    if( matrix.count() > 4 * (2*w+1) * (2*h+1) + nLoader * 32 ) {
+        printf("%d tiles kept after eviction\n", matrix.count());
+        err ++;
+    }
+
+    printf("%ld frames (%.0f/s), %ld lookups %.1f%% hit, %ld tiles set, %ld evictions, "
+           "retired max %d, %d tiles at end\n",
+           nFrame, 1e6 * nFrame / (t1 - t0), nLookup, 100.0 * nHit / qMax(nLookup, 1L),
+           nSet, nEvict, retiredMax, matrix.count());
+    printf("errors = %d\n", err);
+
+    return err;
+}
+
+int test_overlay_index_bench(CParamArray *pa)
+{
+    int     n = 100000, nQuery = 2000, err = 0;
+
+    pa->i("n", n);
+    pa->i("nQuery", nQuery);
+
+    internals::SpatialIndex         idx;
+    QVector<internals::PointLatLng> pts(n);
+    QVector<void*>                  found;
+    ru64                            t0, t1, t2;
+    long                            nIdx = 0, nScan = 0;
+
+    // half in a 10 km survey area, half spread over a country
+    srand(2468);
+    for(int i=0; i<n; i++) {
+        double r = i % 2 ? 0.1 : 5.0;
+        pts[i] = internals::PointLatLng(34.0 + (rand() * 1.0 / RAND_MAX - 0.5) * r,
+                                        108.0 + (rand() * 1.0 / RAND_MAX - 0.5) * r);
+    }
+
+    t0 = tm_get_us();
+    for(int i=0; i<n; i++) idx.Insert(&pts[i], pts[i]);
+    t1 = tm_get_us();
+    printf("insert %d points: %.1f ms, %d nodes\n", n, (t1 - t0) / 1000.0, idx.Nodes());
+
+    // viewport queries, about a 1080p view at zoom 15, against a scan
+    QVector<internals::RectLatLng> views(nQuery);
+    for(int k=0; k<nQuery; k++) {
+        double r = k % 2 ? 0.1 : 5.0;
+        views[k] = internals::RectLatLng(34.0 + (rand() * 1.0 / RAND_MAX - 0.5) * r,
+                                         108.0 + (rand() * 1.0 / RAND_MAX - 0.5) * r, 0.06, 0.04);
+    }
+
+    t0 = tm_get_us();
+    for(int k=0; k<nQuery; k++) {
+        found.clear();
+        nIdx += idx.Query(views[k], found);
+    }
+    t1 = tm_get_us();
+    for(int k=0; k<nQuery; k++) {
+        internals::RectLatLng& v = views[k];
+        for(int i=0; i<n; i++)
+            if( pts[i].Lat() <= v.Top() && pts[i].Lat() >= v.Bottom() &&
+                pts[i].Lng() >= v.Left() && pts[i].Lng() <= v.Right() ) nScan ++;
+    }
+    t2 = tm_get_us();
+    if( nIdx != nScan ) { printf("query: %ld found, %ld by scan\n", nIdx, nScan); err ++; }
+    printf("viewport query: %.2f us (%.1f items), scan %.1f us\n",
+           1.0 * (t1 - t0) / nQuery, 1.0 * nIdx / nQuery, 1.0 * (t2 - t1) / nQuery);
+
+    // nearest item (hit-testing), against a scan
+    int nDiff = 0;
+    t0 = tm_get_us();
+    for(int k=0; k<nQuery; k++) found.append(idx.Nearest(views[k].LocationTopLeft(), 0.01));
+    t1 = tm_get_us();
+    for(int k=0; k<nQuery; k++) {
+        internals::PointLatLng p = views[k].LocationTopLeft();
+        double kx = cos(p.Lat() * M_PI / 180), best = 0.01 * 0.01;
+        void *ret = 0;
+        for(int i=0; i<n; i++) {
+            double dx = (pts[i].Lng() - p.Lng()) * kx, dy = pts[i].Lat() - p.Lat();
+            if( dx*dx + dy*dy <= best ) { best = dx*dx + dy*dy; ret = &pts[i]; }
+        }
+        if( ret != found[found.size() - nQuery + k] ) nDiff ++;
+    }
+    t2 = tm_get_us();
+    if( nDiff > 0 ) { printf("nearest: %d differ from scan\n", nDiff); err ++; }
+    printf("nearest: %.2f us, scan %.1f us\n", 1.0 * (t1 - t0) / nQuery, 1.0 * (t2 - t1) / nQuery);
+
+    // moving targets (UAVs, ADS-B): re-register a tenth of the points
+    t0 = tm_get_us();
+    for(int i=0; i<n; i+=10) {
+        pts[i] = internals::PointLatLng(pts[i].Lat() + 0.001, pts[i].Lng() - 0.001);
+        idx.Insert(&pts[i], pts[i]);
+    }
+    t1 = tm_get_us();
+    printf("move: %.2f us/item\n", 10.0 * (t1 - t0) / n);
+
+    found.clear();
+    if( idx.Query(internals::RectLatLng(90, -180, 360, 180), found) != n ) {
+        printf("after move: %d items\n", found.size());
+        err ++;
+    }
+
+    // removal merges the quadrants back
+    t0 = tm_get_us();
+    for(int i=0; i<n; i++)
+        if( !idx.Remove(&pts[i]) ) err ++;
+    t1 = tm_get_us();
+    if( idx.Count() != 0 || idx.Nodes() != 1 ) { printf("after remove: %d items, %d nodes\n", idx.Count(), idx.Nodes()); err ++; }
+    printf("remove: %.2f us/item\n", 1.0 * (t1 - t0) / n);
+
+    printf("errors = %d\n", err);
+
+    return err;
+}
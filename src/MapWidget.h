@@ -39,4 +39,16 @@ protected:
     void mousePressEvent(QMouseEvent *event);
 };
 
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_trail_bench(rtk::CParamArray *pa);
+int test_map_gl_bench(rtk::CParamArray *pa);
+int test_projection_bench(rtk::CParamArray *pa);
+int test_tilematrix_stress(rtk::CParamArray *pa);
+int test_overlay_index_bench(rtk::CParamArray *pa);
+
+
 #endif // end of __MAP_WIDGET_H__
@@ -0,0 +1,908 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include <rtk_utils.h>
+#include <rtk_debug.h>
+#include <rtk_paramarray.h>
+
+#include "MissionTransfer.h"
+#include "utils_simlink.h"
+
+using namespace rtk;
+
+
+MissionTransfer::MissionTransfer()
+{
+    m_send      = NULL;
+    m_sendArg   = NULL;
+    m_notify    = NULL;
+    m_notifyArg = NULL;
+    m_doneResult = 1;
+
+    m_sysID     = 254;
+    m_compID    = 1;
+    m_targetSys = 1;
+    m_targetComp = 1;
+
+    m_windowMax = 8;
+    m_pushAhead = 0;
+    m_rtoMinUs  = 50000;
+    m_rtoMaxUs  = 5000000;
+    m_maxRetry  = 5;
+
+    m_state     = MT_IDLE;
+    m_result    = MT_OK;
+    m_tStart    = 0;
+    m_nItem     = 0;
+    m_nDone     = 0;
+
+    m_srtt      = -1;
+    m_rttvar    = 0;
+    m_rto       = 1000000;
+
+    m_lastReq   = -1;
+    m_pushed    = -1;
+    m_rttSeq    = -1;
+    m_dupSeq    = -1;
+    m_tSent     = 0;
+    m_sentRetx  = 0;
+    m_retry     = 0;
+    m_next      = 0;
+    m_window    = 1;
+
+    m_tmTransferUs = 0;
+    m_nSent     = 0;
+    m_nRetx     = 0;
+    m_nDup      = 0;
+    m_srttMs    = 0;
+    m_rtoMs     = m_rto / 1000.0;
+}
+
+MissionTransfer::~MissionTransfer()
+{
+}
+
+void MissionTransfer::setIDs(int sysID, int compID, int targetSys, int targetComp)
+{
+    m_mutex.lock();
+    m_sysID      = sysID;
+    m_compID     = compID;
+    m_targetSys  = targetSys;
+    m_targetComp = targetComp;
+    m_mutex.unlock();
+}
+
+void MissionTransfer::setWindow(int window, int pushAhead)
+{
+    m_mutex.lock();
+    m_windowMax = window < 1 ? 1 : window;
+    m_pushAhead = pushAhead < 0 ? 0 : pushAhead;
+    m_mutex.unlock();
+}
+
+void MissionTransfer::setTimeout(int rtoMin, int rtoMax, int maxRetry)
+{
+    m_mutex.lock();
+    m_rtoMinUs = (uint64_t) rtoMin * 1000;
+    m_rtoMaxUs = (uint64_t) std::max(rtoMin, rtoMax) * 1000;
+    m_maxRetry = maxRetry;
+    m_rto      = std::min(std::max(m_rto, m_rtoMinUs), m_rtoMaxUs);
+    m_mutex.unlock();
+}
+
+void MissionTransfer::progress(int *done, int *total)
+{
+    m_mutex.lock();
+    *done  = m_nDone;
+    *total = m_nItem;
+    m_mutex.unlock();
+}
+
+void MissionTransfer::items(MissionItems &items)
+{
+    m_mutex.lock();
+    items = m_items;
+    m_mutex.unlock();
+}
+
+
+void MissionTransfer::send(mavlink_message_t &msg)
+{
+    m_nSent ++;
+    if( m_send != NULL ) m_send(m_sendArg, msg);
+}
+
+void MissionTransfer::sendItem(int seq, uint64_t tNowUs)
+{
+    mavlink_message_t           msg;
+    mavlink_mission_item_int_t  it = m_items[seq];
+
+    it.seq              = seq;
+    it.target_system    = m_targetSys;
+    it.target_component = m_targetComp;
+    it.current          = seq == 0 ? 1 : 0;
+
+    mavlink_msg_mission_item_int_encode(m_sysID, m_compID, &msg, &it);
+    send(msg);
+
+    m_tReq[seq] = tNowUs;
+    if( m_nReq[seq] < 255 ) m_nReq[seq] ++;
+}
+
+void MissionTransfer::sendRequest(int seq, uint64_t tNowUs, int retx)
+{
+    mavlink_message_t msg;
+
+    mavlink_msg_mission_request_pack(m_sysID, m_compID, &msg, m_targetSys, m_targetComp, seq);
+    send(msg);
+
+    m_tReq[seq] = tNowUs;
+    if( m_nReq[seq] < 255 ) m_nReq[seq] ++;
+    if( !retx ) m_inflight.push_back(seq);
+}
+
+void MissionTransfer::fillWindow(uint64_t tNowUs)
+{
+    while( (int) m_inflight.size() < (int) m_window && m_next < m_nItem ) {
+        if( !m_got[m_next] ) sendRequest(m_next, tNowUs, 0);
+        m_next ++;
+    }
+}
+
+void MissionTransfer::rttSample(uint64_t rttUs)
+{
+    double r = rttUs;
+
+    if( m_srtt < 0 ) {
+        m_srtt   = r;
+        m_rttvar = r / 2;
+    } else {
+        m_rttvar = 0.75 * m_rttvar + 0.25 * fabs(m_srtt - r);
+        m_srtt   = 0.875 * m_srtt + 0.125 * r;
+    }
+
+    m_rto = (uint64_t) (m_srtt + 4 * m_rttvar);
+    m_rto = std::min(std::max(m_rto, m_rtoMinUs), m_rtoMaxUs);
+}
+
+void MissionTransfer::rttBackoff(void)
+{
+    m_rto = std::min(m_rto * 2, m_rtoMaxUs);
+}
+
+void MissionTransfer::finish(int result, uint64_t tNowUs)
+{
+    m_result        = result;
+    m_state         = MT_IDLE;
+    m_tmTransferUs  = tNowUs - m_tStart;
+    m_srttMs        = m_srtt / 1000.0;
+    m_rtoMs         = m_rto / 1000.0;
+    m_doneResult    = result;
+
+    m_inflight.clear();
+}
+
+
+int MissionTransfer::upload(const MissionItems &items, uint64_t tNowUs)
+{
+    mavlink_message_t msg;
+
+    m_mutex.lock();
+
+    if( m_state != MT_IDLE ) {
+        m_mutex.unlock();
+        return MT_BUSY;
+    }
+
+    m_items     = items;
+    m_nItem     = items.size();
+    m_nDone     = 0;
+    m_lastReq   = -1;
+    m_pushed    = -1;
+    m_rttSeq    = -1;
+    m_dupSeq    = -1;
+    m_retry     = 0;
+    m_tReq.assign(m_nItem, 0);
+    m_nReq.assign(m_nItem, 0);
+    m_nSent     = m_nRetx = m_nDup = 0;
+    m_tStart    = tNowUs;
+    m_state     = MT_UP_COUNT;
+
+    mavlink_msg_mission_count_pack(m_sysID, m_compID, &msg, m_targetSys, m_targetComp, m_nItem);
+    send(msg);
+    m_tSent     = tNowUs;
+    m_sentRetx  = 0;
+
+    m_mutex.unlock();
+
+    return 0;
+}
+
+int MissionTransfer::download(uint64_t tNowUs)
+{
+    mavlink_message_t msg;
+
+    m_mutex.lock();
+
+    if( m_state != MT_IDLE ) {
+        m_mutex.unlock();
+        return MT_BUSY;
+    }
+
+    m_items.clear();
+    m_nItem     = 0;
+    m_nDone     = 0;
+    m_retry     = 0;
+    m_nSent     = m_nRetx = m_nDup = 0;
+    m_tStart    = tNowUs;
+    m_state     = MT_DOWN_LIST;
+
+    mavlink_msg_mission_request_list_pack(m_sysID, m_compID, &msg, m_targetSys, m_targetComp);
+    send(msg);
+    m_tSent     = tNowUs;
+    m_sentRetx  = 0;
+
+    m_mutex.unlock();
+
+    return 0;
+}
+
+int MissionTransfer::cancel(void)
+{
+    int r = -1;
+
+    m_mutex.lock();
+    if( m_state != MT_IDLE ) {
+        finish(MT_CANCELLED, m_tStart);
+        r = 0;
+    }
+    m_doneResult = 1;
+    m_mutex.unlock();
+
+    return r;
+}
+
+// MISSION_ITEM x/y scale of MISSION_ITEM_INT for the frame
+static double mission_xy_scale(int frame)
+{
+    switch( frame ) {
+    case MAV_FRAME_GLOBAL:
+    case MAV_FRAME_GLOBAL_RELATIVE_ALT:
+    case MAV_FRAME_GLOBAL_INT:
+    case MAV_FRAME_GLOBAL_RELATIVE_ALT_INT:
+    case MAV_FRAME_GLOBAL_TERRAIN_ALT:
+    case MAV_FRAME_GLOBAL_TERRAIN_ALT_INT:
+        return 1e7;
+
+    case MAV_FRAME_MISSION:
+        return 1;
+
+    default:
+        return 1e4;
+    }
+}
+
+static void mission_item_to_int(const mavlink_mission_item_t &a, mavlink_mission_item_int_t &b)
+{
+    double k = mission_xy_scale(a.frame);
+
+    b.param1            = a.param1;
+    b.param2            = a.param2;
+    b.param3            = a.param3;
+    b.param4            = a.param4;
+    b.x                 = (int32_t) lround(a.x * k);
+    b.y                 = (int32_t) lround(a.y * k);
+    b.z                 = a.z;
+    b.seq               = a.seq;
+    b.command           = a.command;
+    b.target_system     = a.target_system;
+    b.target_component  = a.target_component;
+    b.frame             = a.frame;
+    b.current           = a.current;
+    b.autocontinue      = a.autocontinue;
+}
+
+int MissionTransfer::handle(const mavlink_message_t &msg, uint64_t tNowUs)
+{
+    switch( msg.msgid ) {
+    case MAVLINK_MSG_ID_MISSION_REQUEST:
+    case MAVLINK_MSG_ID_MISSION_ACK:
+    case MAVLINK_MSG_ID_MISSION_COUNT:
+    case MAVLINK_MSG_ID_MISSION_ITEM:
+    case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+        break;
+
+    default:
+        return 0;
+    }
+
+    m_mutex.lock();
+
+    if( msg.sysid != m_targetSys || m_state == MT_IDLE ) {
+        m_mutex.unlock();
+        return 1;
+    }
+
+    switch( msg.msgid ) {
+    case MAVLINK_MSG_ID_MISSION_REQUEST:
+    {
+        int seq = mavlink_msg_mission_request_get_seq(&msg);
+
+        if( (m_state != MT_UP_COUNT && m_state != MT_UP_ITEMS) || seq >= m_nItem ) {
+            m_nDup ++;
+            break;
+        }
+
+        // RTT: count or the last requested item sent -> request of a later one
+        // (pushed items may wait in the autopilot, they are not timed)
+        if( m_state == MT_UP_COUNT ) {
+            if( !m_sentRetx ) rttSample(tNowUs - m_tSent);
+        } else if( m_rttSeq >= 0 && seq > m_rttSeq && m_nReq[m_rttSeq] == 1 ) {
+            rttSample(tNowUs - m_tReq[m_rttSeq]);
+        }
+        m_rttSeq = -1;
+
+        m_state = MT_UP_ITEMS;
+        if( seq > m_lastReq ) {
+            m_lastReq = seq;
+            m_nDone   = seq;
+            m_retry   = 0;
+            m_tSent   = tNowUs;
+        }
+
+        // an item pushed ahead or sent less than one round trip ago is still
+        // on its way, the request answers an older copy: repeating it would
+        // double every following item. A second request for it is served.
+        double  tFly = m_srtt < 0 ? m_rto : m_srtt + 2 * m_rttvar;
+        int     onWay = m_nReq[seq] > 0 &&
+                        ((seq <= m_pushed && m_nReq[seq] == 1) || tNowUs - m_tReq[seq] < tFly);
+
+        if( !onWay || seq == m_dupSeq ) {
+            if( m_nReq[seq] > 0 ) m_nRetx ++;
+
+            sendItem(seq, tNowUs);
+            m_tSent    = tNowUs;
+            m_sentRetx = m_nReq[seq] > 1;
+            m_rttSeq   = seq;
+            m_dupSeq   = -1;
+        } else {
+            m_nDup ++;
+            m_dupSeq   = seq;
+        }
+
+        for(int k=std::max(seq, m_pushed)+1; k<=seq+m_pushAhead && k<m_nItem; k++) {
+            sendItem(k, tNowUs);
+            m_pushed = k;
+        }
+        break;
+    }
+
+    case MAVLINK_MSG_ID_MISSION_ACK:
+    {
+        int type = mavlink_msg_mission_ack_get_type(&msg);
+
+        if( m_state != MT_UP_COUNT && m_state != MT_UP_ITEMS ) break;
+
+        if( type != MAV_MISSION_ACCEPTED ) {
+            dbg_pw("Mission upload rejected (%d)\n", type);
+            finish(MT_REJECTED, tNowUs);
+        } else if( m_nItem == 0 || m_lastReq == m_nItem - 1 || m_pushed == m_nItem - 1 ) {
+            m_nDone = m_nItem;
+            finish(MT_OK, tNowUs);
+        } else {
+            m_nDup ++;
+        }
+        break;
+    }
+
+    case MAVLINK_MSG_ID_MISSION_COUNT:
+    {
+        mavlink_message_t   ack;
+        int                 n = mavlink_msg_mission_count_get_count(&msg);
+
+        if( m_state != MT_DOWN_LIST ) {
+            m_nDup ++;
+            break;
+        }
+
+        if( !m_sentRetx ) rttSample(tNowUs - m_tSent);
+
+        m_nItem = n;
+        m_items.assign(n, mavlink_mission_item_int_t());
+        m_got.assign(n, 0);
+        m_tReq.assign(n, 0);
+        m_nReq.assign(n, 0);
+        m_inflight.clear();
+        m_next   = 0;
+        m_window = m_windowMax;
+
+        if( n == 0 ) {
+            mavlink_msg_mission_ack_pack(m_sysID, m_compID, &ack, m_targetSys, m_targetComp,
+                                         MAV_MISSION_ACCEPTED);
+            send(ack);
+            finish(MT_OK, tNowUs);
+            break;
+        }
+
+        m_state = MT_DOWN_ITEMS;
+        fillWindow(tNowUs);
+        break;
+    }
+
+    case MAVLINK_MSG_ID_MISSION_ITEM:
+    case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+    {
+        mavlink_mission_item_int_t  it;
+        mavlink_message_t           ack;
+
+        if( msg.msgid == MAVLINK_MSG_ID_MISSION_ITEM ) {
+            mavlink_mission_item_t  fi;
+            mavlink_msg_mission_item_decode(&msg, &fi);
+            mission_item_to_int(fi, it);
+        } else {
+            mavlink_msg_mission_item_int_decode(&msg, &it);
+        }
+
+        if( m_state != MT_DOWN_ITEMS || it.seq >= m_nItem || m_got[it.seq] ) {
+            m_nDup ++;
+            break;
+        }
+
+        m_items[it.seq] = it;
+        m_got[it.seq]   = 1;
+        m_nDone ++;
+        m_retry = 0;
+
+        if( m_nReq[it.seq] == 1 ) rttSample(tNowUs - m_tReq[it.seq]);
+        m_tReq[it.seq] = 0;
+
+        std::vector<int>::iterator p = std::find(m_inflight.begin(), m_inflight.end(), (int) it.seq);
+        if( p != m_inflight.end() ) m_inflight.erase(p);
+
+        m_window = std::min(m_window + 1, (double) m_windowMax);
+
+        if( m_nDone == m_nItem ) {
+            mavlink_msg_mission_ack_pack(m_sysID, m_compID, &ack, m_targetSys, m_targetComp,
+                                         MAV_MISSION_ACCEPTED);
+            send(ack);
+            finish(MT_OK, tNowUs);
+            break;
+        }
+
+        fillWindow(tNowUs);
+        break;
+    }
+    }
+
+    int done = m_doneResult;
+    m_doneResult = 1;
+    m_mutex.unlock();
+
+    if( done <= 0 && m_notify != NULL ) m_notify(m_notifyArg, done);
+
+    return 1;
+}
+
+void MissionTransfer::tick(uint64_t tNowUs)
+{
+    mavlink_message_t msg;
+
+    m_mutex.lock();
+
+    switch( m_state ) {
+    case MT_UP_COUNT:
+    case MT_UP_ITEMS:
+    case MT_DOWN_LIST:
+        if( tNowUs - m_tSent < m_rto ) break;
+
+        if( ++m_retry > m_maxRetry ) {
+            dbg_pw("Mission transfer timeout (state %d, %d/%d)\n", m_state, m_nDone, m_nItem);
+            finish(MT_TIMEOUT, tNowUs);
+            break;
+        }
+
+        rttBackoff();
+        m_nRetx ++;
+
+        if( m_state == MT_UP_COUNT ) {
+            mavlink_msg_mission_count_pack(m_sysID, m_compID, &msg, m_targetSys, m_targetComp, m_nItem);
+            send(msg);
+        } else if( m_state == MT_UP_ITEMS ) {
+            // all pushed: the last item gets an answer from the autopilot
+            // (request of a missing one, or the ACK again)
+            sendItem(m_pushed == m_nItem - 1 ? m_pushed : m_lastReq, tNowUs);
+        } else {
+            mavlink_msg_mission_request_list_pack(m_sysID, m_compID, &msg, m_targetSys, m_targetComp);
+            send(msg);
+        }
+
+        m_tSent    = tNowUs;
+        m_sentRetx = 1;
+        break;
+
+    case MT_DOWN_ITEMS:
+    {
+        int nLate = 0;
+
+        // only the outstanding requests which timed out are repeated
+        for(size_t i=0; i<m_inflight.size(); i++) {
+            int seq = m_inflight[i];
+
+            if( tNowUs - m_tReq[seq] < m_rto ) continue;
+
+            if( nLate++ == 0 ) {
+                if( ++m_retry > m_maxRetry ) {
+                    dbg_pw("Mission download timeout (item %d, %d/%d)\n", seq, m_nDone, m_nItem);
+                    finish(MT_TIMEOUT, tNowUs);
+                    break;
+                }
+
+                m_window = std::max(m_window / 2, 1.0);
+            }
+
+            sendRequest(seq, tNowUs, 1);
+            m_nRetx ++;
+        }
+
+        if( nLate > 0 ) rttBackoff();
+        break;
+    }
+
+    default:
+        break;
+    }
+
+    int done = m_doneResult;
+    m_doneResult = 1;
+    m_mutex.unlock();
+
+    if( done <= 0 && m_notify != NULL ) m_notify(m_notifyArg, done);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// QGC WPL 110 files
+////////////////////////////////////////////////////////////////////////////////
+
+int mission_load_wpl(const std::string &fn, MissionItems &items)
+{
+    FILE    *fp;
+    char    line[512];
+    int     seq, cur, frame, cmd, ac;
+    double  p1, p2, p3, p4, x, y, z;
+
+    items.clear();
+
+    fp = fopen(fn.c_str(), "rt");
+    if( fp == NULL ) {
+        dbg_pe("Can not open mission file: %s\n", fn.c_str());
+        return -1;
+    }
+
+    if( fgets(line, sizeof(line), fp) == NULL || strncmp(line, "QGC WPL 110", 11) != 0 ) {
+        dbg_pe("Not a QGC WPL 110 file: %s\n", fn.c_str());
+        fclose(fp);
+        return -2;
+    }
+
+    while( fgets(line, sizeof(line), fp) != NULL ) {
+        if( 12 != sscanf(line, "%d %d %d %d %lf %lf %lf %lf %lf %lf %lf %d",
+                         &seq, &cur, &frame, &cmd, &p1, &p2, &p3, &p4, &x, &y, &z, &ac) )
+            continue;
+
+        mavlink_mission_item_int_t it;
+        double k = mission_xy_scale(frame);
+
+        memset(&it, 0, sizeof(it));
+        it.seq          = items.size();
+        it.current      = cur;
+        it.frame        = frame;
+        it.command      = cmd;
+        it.param1       = p1;
+        it.param2       = p2;
+        it.param3       = p3;
+        it.param4       = p4;
+        it.x            = (int32_t) lround(x * k);
+        it.y            = (int32_t) lround(y * k);
+        it.z            = z;
+        it.autocontinue = ac;
+
+        items.push_back(it);
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+int mission_save_wpl(const std::string &fn, const MissionItems &items)
+{
+    FILE    *fp;
+
+    fp = fopen(fn.c_str(), "wt");
+    if( fp == NULL ) {
+        dbg_pe("Can not open mission file: %s\n", fn.c_str());
+        return -1;
+    }
+
+    fprintf(fp, "QGC WPL 110\n");
+    for(size_t i=0; i<items.size(); i++) {
+        const mavlink_mission_item_int_t &it = items[i];
+        double k = mission_xy_scale(it.frame);
+
+        fprintf(fp, "%d\t%d\t%d\t%d\t%.8g\t%.8g\t%.8g\t%.8g\t%.8f\t%.8f\t%.6f\t%d\n",
+                (int) i, it.current, it.frame, it.command,
+                it.param1, it.param2, it.param3, it.param4,
+                it.x / k, it.y / k, it.z, it.autocontinue);
+    }
+
+    fclose(fp);
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// test & benchmark on a simulated link
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// autopilot side: serves any requested item, asks for the uploaded items in
+// order (optionally keeping items sent ahead), asks again for the expected
+// item when an old one is repeated and after its own timeout
+//
+struct SimVehicle
+{
+    SimLink         *link;
+    MissionItems    items, rx;
+    std::vector<uint8_t> have;
+    int             receiving, n, expect, retry, bufferAhead;
+    uint64_t        tReq;
+
+    SimVehicle(SimLink *l, int ahead) {
+        link        = l;
+        receiving   = 0;
+        n = expect  = retry = 0;
+        bufferAhead = ahead;
+        tReq        = 0;
+    }
+
+    void request(int seq) {
+        mavlink_message_t msg;
+        mavlink_msg_mission_request_pack(1, 1, &msg, 254, 1, seq);
+        link->send(1, msg);
+        tReq = link->tNow;
+    }
+
+    void ack(void) {
+        mavlink_message_t msg;
+        mavlink_msg_mission_ack_pack(1, 1, &msg, 254, 1, MAV_MISSION_ACCEPTED);
+        link->send(1, msg);
+    }
+
+    void handle(const mavlink_message_t &msg) {
+        mavlink_message_t r;
+
+        switch( msg.msgid ) {
+        case MAVLINK_MSG_ID_MISSION_COUNT:
+            n = mavlink_msg_mission_count_get_count(&msg);
+            rx.assign(n, mavlink_mission_item_int_t());
+            have.assign(n, 0);
+            expect = retry = 0;
+            receiving = n > 0;
+            if( n == 0 ) { items.clear(); ack(); }
+            else request(0);
+            break;
+
+        case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+        {
+            mavlink_mission_item_int_t it;
+            mavlink_msg_mission_item_int_decode(&msg, &it);
+
+            if( !receiving ) {
+                if( n > 0 && it.seq == n - 1 ) ack();      // our ACK was lost
+                break;
+            }
+            if( it.seq >= n ) break;
+            if( it.seq < expect || have[it.seq] ) { request(expect); break; }
+            if( it.seq != expect && !bufferAhead ) break;
+
+            int e0 = expect;
+
+            rx[it.seq] = it;
+            have[it.seq] = 1;
+            while( expect < n && have[expect] ) expect ++;
+            retry = 0;
+
+            if( expect == n ) {
+                items = rx;
+                receiving = 0;
+                ack();
+            } else if( expect != e0 ) {
+                request(expect);
+            }
+            break;
+        }
+
+        case MAVLINK_MSG_ID_MISSION_REQUEST_LIST:
+            mavlink_msg_mission_count_pack(1, 1, &r, 254, 1, items.size());
+            link->send(1, r);
+            break;
+
+        case MAVLINK_MSG_ID_MISSION_REQUEST:
+        {
+            int seq = mavlink_msg_mission_request_get_seq(&msg);
+            if( seq >= (int) items.size() ) break;
+
+            mavlink_mission_item_int_t it = items[seq];
+            it.target_system = 254;
+            it.target_component = 1;
+            mavlink_msg_mission_item_int_encode(1, 1, &r, &it);
+            link->send(1, r);
+            break;
+        }
+        }
+    }
+
+    void tick(void) {
+        if( receiving && link->tNow - tReq > 1500000 ) {
+            if( ++retry > 8 ) receiving = 0;
+            else request(expect);
+        }
+    }
+};
+
+static int sim_send(void *arg, mavlink_message_t &msg)
+{
+    ((SimLink*) arg)->send(0, msg);
+    return 0;
+}
+
+// run a transfer on the simulated link, return its result
+static int sim_run(MissionTransfer &mt, SimLink &link, SimVehicle &veh, int up,
+                   const MissionItems &items)
+{
+    uint64_t        tTick = 0;
+    SimLink::Pkt    p;
+
+    link.reset();
+
+    mt.setSend(sim_send, &link);
+    if( up ) mt.upload(items, 0);
+    else     mt.download(0);
+
+    while( mt.busy() && link.tNow < 1200000000ULL ) {
+        if( link.poll(tTick, p) ) {
+            if( p.dir == 0 ) veh.handle(p.msg);
+            else             mt.handle(p.msg, link.tNow);
+            continue;
+        }
+
+        mt.tick(link.tNow);
+        veh.tick();
+        tTick += 10000;
+    }
+
+    return mt.busy() ? MT_TIMEOUT : mt.result();
+}
+
+static int mission_equal(const MissionItems &a, const MissionItems &b)
+{
+    if( a.size() != b.size() ) return 0;
+
+    for(size_t i=0; i<a.size(); i++) {
+        if( a[i].x != b[i].x || a[i].y != b[i].y || a[i].z != b[i].z ||
+            a[i].command != b[i].command || a[i].frame != b[i].frame ||
+            a[i].param1 != b[i].param1 || a[i].autocontinue != b[i].autocontinue )
+            return 0;
+    }
+
+    return 1;
+}
+
+int test_mission(CParamArray *pa)
+{
+    int     nItem = 700, baud = 57600, latencyMs = 50, jitterMs = 20;
+    int     err = 0;
+    std::string fn_wpl = "";
+
+    pa->i("nItem", nItem);
+    pa->i("baud", baud);
+    pa->i("latencyMs", latencyMs);
+    pa->i("jitterMs", jitterMs);
+    pa->s("fn_wpl", fn_wpl);
+
+    MissionItems items;
+
+    // a survey grid, or the given file
+    if( fn_wpl.size() > 0 ) {
+        if( 0 != mission_load_wpl(fn_wpl, items) ) return 1;
+        nItem = items.size();
+    } else {
+        for(int i=0; i<nItem; i++) {
+            mavlink_mission_item_int_t it;
+
+            memset(&it, 0, sizeof(it));
+            it.seq          = i;
+            it.frame        = MAV_FRAME_GLOBAL_RELATIVE_ALT;
+            it.command      = i == 0 ? 22 : 16;         // NAV_TAKEOFF, NAV_WAYPOINT
+            it.x            = (int32_t) ((34.0 + (i / 20) * 0.0005) * 1e7);
+            it.y            = (int32_t) ((108.0 + ((i / 20) % 2 ? 19 - i % 20 : i % 20) * 0.0005) * 1e7);
+            it.z            = 60;
+            it.autocontinue = 1;
+            items.push_back(it);
+        }
+    }
+
+    // WPL round trip
+    {
+        MissionItems    rd;
+        std::string     fn = fmt::sprintf("/tmp/SimpGCS_test_%d.waypoints", getpid());
+
+        mission_save_wpl(fn, items);
+        if( 0 != mission_load_wpl(fn, rd) || !mission_equal(items, rd) ) {
+            printf("WPL: %d of %d items read back differ\n", (int) rd.size(), nItem);
+            err ++;
+        }
+        unlink(fn.c_str());
+    }
+
+    struct Mode {
+        const char  *name;
+        int         window, push, rtoMin, rtoMax, ahead;
+    } modes[] = {
+        { "stop & wait, fixed 1.5 s timeout", 1, 0, 1500, 1500, 0 },
+        { "adaptive timeout, window 8",       8, 0,   50, 5000, 0 },
+        { "adaptive, push 8 (buffering AP)",  8, 8,   50, 5000, 1 },
+    };
+    double losses[] = { 0, 0.05, 0.2 };
+
+    printf("%d items, %d baud, latency %d+%d ms\n", nItem, baud, latencyMs, jitterMs);
+
+    for(int l=0; l<3; l++) {
+        for(int m=0; m<3; m++) {
+            SimLink         link(baud / 10.0, latencyMs, jitterMs, losses[l]);
+            SimVehicle      veh(&link, modes[m].ahead);
+            MissionTransfer mt;
+            MissionItems    got;
+            double          tUp, tDown;
+            int             rUp, rDown, nRetxUp;
+
+            srand(1000 + l);
+            mt.setIDs(254, 1, 1, 1);
+            mt.setWindow(modes[m].window, modes[m].push);
+            mt.setTimeout(modes[m].rtoMin, modes[m].rtoMax, 10);
+
+            rUp     = sim_run(mt, link, veh, 1, items);
+            tUp     = mt.m_tmTransferUs * 1e-6;
+            nRetxUp = mt.m_nRetx;
+            if( rUp != MT_OK || !mission_equal(items, veh.items) ) {
+                printf("upload failed (%d), %d items on the vehicle\n", rUp, (int) veh.items.size());
+                err ++;
+            }
+
+            rDown = sim_run(mt, link, veh, 0, items);
+            tDown = mt.m_tmTransferUs * 1e-6;
+            mt.items(got);
+            if( rDown != MT_OK || !mission_equal(items, got) ) {
+                printf("download failed (%d), %d items\n", rDown, (int) got.size());
+                err ++;
+            }
+
+            printf("loss %2.0f%%  %-34s up %6.1f s (%3d retx)  down %6.1f s (%3d retx), "
+                   "srtt %.0f ms, rto %.0f ms\n",
+                   losses[l] * 100, modes[m].name, tUp, nRetxUp, tDown, mt.m_nRetx,
+                   mt.m_srttMs, mt.m_rtoMs);
+        }
+    }
+
+    printf("errors = %d\n", err);
+
+    return err;
+}
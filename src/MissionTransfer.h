@@ -0,0 +1,195 @@
+#ifndef __MISSIONTRANSFER_H__
+#define __MISSIONTRANSFER_H__
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <rtk_osa++.h>
+
+#include "utils_mavlink.h"
+
+
+typedef std::vector<mavlink_mission_item_int_t> MissionItems;
+
+///
+/// \brief mission transfer state & results
+///
+enum MissionTransferState
+{
+    MT_IDLE         = 0,
+    MT_UP_COUNT     = 1,                ///< MISSION_COUNT sent, waiting for the first request
+    MT_UP_ITEMS     = 2,                ///< serving MISSION_REQUEST, waiting for MISSION_ACK
+    MT_DOWN_LIST    = 3,                ///< MISSION_REQUEST_LIST sent, waiting for MISSION_COUNT
+    MT_DOWN_ITEMS   = 4,                ///< requesting items
+};
+
+enum MissionTransferResult
+{
+    MT_OK           = 0,
+    MT_TIMEOUT      = -1,               ///< no answer after the retries
+    MT_REJECTED     = -2,               ///< vehicle answered with a MISSION_ACK error
+    MT_CANCELLED    = -3,
+    MT_BUSY         = -4,               ///< another transfer is running
+};
+
+///
+/// \brief send function (the UAS send buffer, or a simulated link)
+///
+typedef int (*MissionSendFunc)(void *arg, mavlink_message_t &msg);
+
+///
+/// \brief transfer finished notify (result: MissionTransferResult)
+///
+typedef void (*MissionDoneNotify)(void *arg, int result);
+
+
+///
+/// \brief Mission (waypoint) upload & download engine
+///
+///     Upload: MISSION_COUNT, then MISSION_ITEM_INT for every MISSION_REQUEST
+///     of the vehicle, until MISSION_ACK. Download: MISSION_REQUEST_LIST,
+///     MISSION_COUNT, then a window of outstanding MISSION_REQUESTs
+///     (MISSION_ITEM and MISSION_ITEM_INT answers are accepted).
+///
+///     The timeout follows the measured round trip time (SRTT + 4 RTTVAR,
+///     doubled on each timeout, samples of repeated requests are not used).
+///     Only the missing items are requested again. The download window
+///     grows by one per answered request and halves on a timeout, so an
+///     autopilot which serves one request at a time ends up at window 1.
+///
+///     handle() is called from the receiving thread, tick() periodically
+///     (10-50 ms), upload()/download() from anywhere; all take the time so
+///     a simulated clock can drive them.
+///
+class MissionTransfer
+{
+public:
+    MissionTransfer();
+    ~MissionTransfer();
+
+    void setSend(MissionSendFunc fn, void *arg) {
+        m_send    = fn;
+        m_sendArg = arg;
+    }
+
+    void setNotify(MissionDoneNotify fn, void *arg) {
+        m_notify    = fn;
+        m_notifyArg = arg;
+    }
+
+    void setIDs(int sysID, int compID, int targetSys, int targetComp);
+
+    ///
+    /// \param window - maximum outstanding download requests (1: stop & wait)
+    /// \param pushAhead - upload items sent before they are requested (0: off,
+    ///                    only for autopilots which buffer out of order items)
+    ///
+    void setWindow(int window, int pushAhead = 0);
+
+    ///
+    /// \param rtoMin, rtoMax - timeout bounds (ms)
+    /// \param maxRetry - timeouts in a row without progress before giving up
+    ///
+    void setTimeout(int rtoMin, int rtoMax, int maxRetry);
+
+    int upload(const MissionItems &items, uint64_t tNowUs);
+    int download(uint64_t tNowUs);
+    int cancel(void);
+
+    ///
+    /// \brief process a received message
+    /// \return 1 if it was a mission message
+    ///
+    int handle(const mavlink_message_t &msg, uint64_t tNowUs);
+    void tick(uint64_t tNowUs);
+
+    int state(void) { return m_state; }
+    int result(void) { return m_result; }
+    int busy(void) { return m_state != MT_IDLE; }
+
+    ///
+    /// \brief items transferred / total of the running (or last) transfer
+    ///
+    void progress(int *done, int *total);
+
+    ///
+    /// \brief copy of the downloaded (or uploaded) mission
+    ///
+    void items(MissionItems &items);
+
+    // statistics of the last transfer
+    uint64_t    m_tmTransferUs;             ///< start to finish
+    int         m_nSent;                    ///< messages sent
+    int         m_nRetx;                    ///< repeated messages
+    int         m_nDup;                     ///< duplicated or unexpected answers
+    double      m_srttMs, m_rtoMs;          ///< round trip estimate & timeout (ms)
+
+protected:
+    void send(mavlink_message_t &msg);
+    void sendItem(int seq, uint64_t tNowUs);
+    void sendRequest(int seq, uint64_t tNowUs, int retx);
+    void fillWindow(uint64_t tNowUs);
+
+    void rttSample(uint64_t rttUs);
+    void rttBackoff(void);
+
+    void finish(int result, uint64_t tNowUs);
+
+    rtk::RMutex         m_mutex;
+
+    MissionSendFunc     m_send;
+    void                *m_sendArg;
+    MissionDoneNotify   m_notify;
+    void                *m_notifyArg;
+    int                 m_doneResult;       ///< notify pending (outside the lock)
+
+    int                 m_sysID, m_compID;
+    int                 m_targetSys, m_targetComp;
+
+    int                 m_windowMax, m_pushAhead;
+    uint64_t            m_rtoMinUs, m_rtoMaxUs;
+    int                 m_maxRetry;
+
+    int                 m_state, m_result;
+    uint64_t            m_tStart;
+    MissionItems        m_items;
+    int                 m_nItem, m_nDone;
+
+    // round trip estimate
+    double              m_srtt, m_rttvar;   ///< us, m_srtt < 0: no sample yet
+    uint64_t            m_rto;
+
+    // upload: last request served, last item pushed, item timed for RTT,
+    // last request not served, count/item (re)send time
+    int                 m_lastReq, m_pushed, m_rttSeq, m_dupSeq;
+    uint64_t            m_tSent;
+    int                 m_sentRetx, m_retry;
+
+    // per item: request (download) or send (upload) time & count
+    std::vector<uint64_t>   m_tReq;
+    std::vector<uint8_t>    m_nReq;
+
+    // download: items received, outstanding requests
+    std::vector<uint8_t>    m_got;
+    std::vector<int>        m_inflight;
+    int                     m_next;
+    double                  m_window;
+};
+
+
+///
+/// \brief QGroundControl WPL 110 text files ("QGC WPL 110", one item per line)
+///
+int mission_load_wpl(const std::string &fn, MissionItems &items);
+int mission_save_wpl(const std::string &fn, const MissionItems &items);
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_mission(rtk::CParamArray *pa);
+
+#endif // end of __MISSIONTRANSFER_H__
@@ -0,0 +1,562 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include <rtk_utils.h>
+#include <rtk_debug.h>
+#include <rtk_paramarray.h>
+
+#include "MsgProfiler.h"
+
+using namespace rtk;
+
+
+// one writer, the readers only must not see torn words (same as LinkStats)
+#define MP_LOAD(x)          __atomic_load_n(&(x), __ATOMIC_RELAXED)
+#define MP_STORE(x, v)      __atomic_store_n(&(x), (v), __ATOMIC_RELAXED)
+#define MP_INC(x, v)        MP_STORE(x, MP_LOAD(x) + (v))
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// message names
+////////////////////////////////////////////////////////////////////////////////
+
+///
+/// \brief names of MAVLINK_MESSAGE_INFO, filled before main()
+///
+class MsgProfilerNames
+{
+public:
+    MsgProfilerNames() {
+        static const mavlink_message_info_t info[256] = MAVLINK_MESSAGE_INFO;
+
+        for(int i=0; i<256; i++) {
+            if( strcmp(info[i].name, "EMPTY") == 0 ) {
+                sprintf(m_unknown[i], "MSG_%d", i);
+                m_name[i] = m_unknown[i];
+            } else {
+                m_name[i] = info[i].name;
+            }
+        }
+    }
+
+    const char  *m_name[256];
+    char        m_unknown[256][8];
+};
+
+static MsgProfilerNames g_msgProfilerNames;
+
+const char* MsgProfiler::msgName(int msgid)
+{
+    if( msgid >= 0 && msgid < 256 ) return g_msgProfilerNames.m_name[msgid];
+
+    return "MSGID>255";
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+MsgProfiler::MsgProfiler()
+{
+    m_buckets = new Cell[MSGPROF_BUCKETS * NCELL];
+
+    reset();
+}
+
+MsgProfiler::~MsgProfiler()
+{
+    delete [] m_buckets;
+}
+
+void MsgProfiler::reset(void)
+{
+    memset(m_buckets, 0, sizeof(Cell) * MSGPROF_BUCKETS * NCELL);
+    memset(m_tStart, 0, sizeof(m_tStart));
+    memset(m_slotOf, 0, sizeof(m_slotOf));
+    memset(m_srcKey, 0, sizeof(m_srcKey));
+
+    m_head  = 0;
+    m_cur   = m_buckets;
+    m_tNext = 0;
+    m_nSrc  = 0;
+}
+
+void MsgProfiler::frame(const uint8_t *p, int len, uint64_t tNowUs)
+{
+    uint32_t    key, msgid, slot;
+
+    if( tNowUs >= m_tNext ) rotate(tNowUs);
+
+    if( p[0] == MAVLINK_STX_V2 ) {
+        key   = p[5] << 8 | p[6];
+        msgid = p[7] | p[8] << 8 | p[9] << 16;
+        if( msgid >= MSGPROF_MSGIDS ) msgid = MSGPROF_MSGIDS;
+    } else {
+        key   = p[3] << 8 | p[4];
+        msgid = p[5];
+    }
+
+    slot = m_slotOf[key];
+    if( slot == 0 ) slot = newSource(key);
+
+    Cell &c = m_cur[(slot - 1) * (MSGPROF_MSGIDS + 1) + msgid];
+    MP_INC(c.count, 1);
+    MP_INC(c.bytes, len);
+}
+
+void MsgProfiler::rotate(uint64_t tNowUs)
+{
+    uint64_t    tb = tNowUs - tNowUs % MSGPROF_BUCKET_US;
+    uint64_t    steps = 1, k;
+    uint32_t    b = m_head;
+
+    // seconds without frames get empty buckets (at most the whole ring)
+    if( m_tNext != 0 ) steps = (tb - m_tStart[m_head]) / MSGPROF_BUCKET_US;
+    if( steps > MSGPROF_BUCKETS ) steps = MSGPROF_BUCKETS;
+
+    for(k=1; k<=steps; k++) {
+        b = (m_head + k) % MSGPROF_BUCKETS;
+
+        // hide the bucket while it is cleared
+        __atomic_store_n(&m_tStart[b], 0, __ATOMIC_RELEASE);
+        memset(m_buckets + b * NCELL, 0, sizeof(Cell) * NCELL);
+        __atomic_store_n(&m_tStart[b], tb - (steps - k) * MSGPROF_BUCKET_US, __ATOMIC_RELEASE);
+    }
+
+    m_head  = b;
+    m_cur   = m_buckets + b * NCELL;
+    m_tNext = tb + MSGPROF_BUCKET_US;
+}
+
+int MsgProfiler::newSource(uint32_t key)
+{
+    int     slot = MSGPROF_SOURCES;
+
+    if( m_nSrc < MSGPROF_SOURCES ) {
+        slot = m_nSrc;
+        m_srcKey[slot] = key;
+        __atomic_store_n(&m_nSrc, m_nSrc + 1, __ATOMIC_RELEASE);
+    }
+
+    m_slotOf[key] = slot + 1;
+    return slot + 1;
+}
+
+
+static bool msgprof_row_cmp(const MsgProfileRow &a, const MsgProfileRow &b)
+{
+    if( a.bytes != b.bytes ) return a.bytes > b.bytes;
+    if( a.msgid != b.msgid ) return a.msgid < b.msgid;
+    return a.sysid < b.sysid || (a.sysid == b.sysid && a.compid < b.compid);
+}
+
+int MsgProfiler::top(std::vector<MsgProfileRow> &rows, int n, int windowS, int perSource,
+                     uint64_t tNowUs, MsgProfileRow *total)
+{
+    std::vector<uint64_t>   cnt(NCELL, 0), byt(NCELL, 0);
+    uint64_t                tEnd, tBeg, ts, totalCount = 0, totalBytes = 0;
+    int                     b, i, s, m, nSrc;
+
+    if( windowS < 1 ) windowS = 1;
+    if( windowS > MSGPROF_WINDOW_MAX ) windowS = MSGPROF_WINDOW_MAX;
+
+    // complete seconds only, the current one is still counted
+    tEnd = tNowUs - tNowUs % MSGPROF_BUCKET_US;
+    tBeg = tEnd - std::min(tEnd, (uint64_t) windowS * MSGPROF_BUCKET_US);
+
+    nSrc = __atomic_load_n(&m_nSrc, __ATOMIC_ACQUIRE);
+
+    for(b=0; b<MSGPROF_BUCKETS; b++) {
+        ts = __atomic_load_n(&m_tStart[b], __ATOMIC_ACQUIRE);
+        if( ts == 0 || ts < tBeg || ts >= tEnd ) continue;
+
+        Cell *c = m_buckets + b * NCELL;
+        for(i=0; i<NCELL; i++) {
+            cnt[i] += MP_LOAD(c[i].count);
+            byt[i] += MP_LOAD(c[i].bytes);
+        }
+    }
+
+    // rows of (source, msgid), or summed over the sources
+    rows.clear();
+
+    for(s=0; s<=MSGPROF_SOURCES; s++) {
+        if( s >= nSrc && s < MSGPROF_SOURCES ) continue;
+
+        for(m=0; m<=MSGPROF_MSGIDS; m++) {
+            i = s * (MSGPROF_MSGIDS + 1) + m;
+            if( cnt[i] == 0 ) continue;
+
+            totalCount += cnt[i];
+            totalBytes += byt[i];
+
+            if( !perSource && s > 0 ) {
+                cnt[m] += cnt[i];
+                byt[m] += byt[i];
+            }
+        }
+    }
+
+    for(s=0; s<=(perSource ? MSGPROF_SOURCES : 0); s++) {
+        if( s >= nSrc && s < MSGPROF_SOURCES ) continue;
+
+        for(m=0; m<=MSGPROF_MSGIDS; m++) {
+            i = s * (MSGPROF_MSGIDS + 1) + m;
+            if( cnt[i] == 0 ) continue;
+
+            MsgProfileRow r;
+
+            r.sysid  = -1;
+            r.compid = -1;
+            if( perSource && s < MSGPROF_SOURCES ) {
+                r.sysid  = m_srcKey[s] >> 8;
+                r.compid = m_srcKey[s] & 0xFF;
+            }
+
+            r.msgid = m < MSGPROF_MSGIDS ? m : 0xFFFF;
+            r.name  = msgName(r.msgid);
+            r.count = cnt[i];
+            r.bytes = byt[i];
+            r.hz    = 1.0 * r.count / windowS;
+            r.bps   = 1.0 * r.bytes / windowS;
+            r.share = 100.0 * r.bytes / totalBytes;
+
+            rows.push_back(r);
+        }
+    }
+
+    std::sort(rows.begin(), rows.end(), msgprof_row_cmp);
+    if( n > 0 && rows.size() > n ) rows.resize(n);
+
+    if( total != NULL ) {
+        total->sysid  = -1;
+        total->compid = -1;
+        total->msgid  = -1;
+        total->name   = "total";
+        total->count  = totalCount;
+        total->bytes  = totalBytes;
+        total->hz     = 1.0 * totalCount / windowS;
+        total->bps    = 1.0 * totalBytes / windowS;
+        total->share  = totalBytes > 0 ? 100.0 : 0.0;
+    }
+
+    return rows.size();
+}
+
+int MsgProfiler::saveCSV(const std::string &fn, int windowS, int perSource, uint64_t tNowUs)
+{
+    std::vector<MsgProfileRow>  rows;
+    MsgProfileRow               total;
+    FILE                        *fp;
+
+    top(rows, 0, windowS, perSource, tNowUs, &total);
+
+    fp = fopen(fn.c_str(), "wt");
+    if( fp == NULL ) {
+        dbg_pe("Can not open file: %s\n", fn.c_str());
+        return -1;
+    }
+
+    fprintf(fp, "window_s,sysid,compid,msgid,name,count,bytes,hz,bytes_per_s,share_pct\n");
+    for(size_t i=0; i<rows.size(); i++) {
+        const MsgProfileRow &r = rows[i];
+        fprintf(fp, "%d,%d,%d,%d,%s,%llu,%llu,%.2f,%.1f,%.2f\n",
+                windowS, r.sysid, r.compid, r.msgid, r.name,
+                (unsigned long long) r.count, (unsigned long long) r.bytes,
+                r.hz, r.bps, r.share);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// test & replay benchmark
+////////////////////////////////////////////////////////////////////////////////
+
+///
+/// \brief header of a frame (the profiler reads nothing else)
+///
+static int msgprof_frame(uint8_t *buf, int v2, int sysid, int compid, int msgid, int plen)
+{
+    int     hl = v2 ? 10 : 6;
+
+    memset(buf, 0, hl + plen + 2);
+
+    buf[0] = v2 ? MAVLINK_STX_V2 : MAVLINK_STX;
+    buf[1] = plen;
+    if( v2 ) {
+        buf[5] = sysid;
+        buf[6] = compid;
+        buf[7] = msgid & 0xFF;
+        buf[8] = (msgid >> 8) & 0xFF;
+        buf[9] = (msgid >> 16) & 0xFF;
+    } else {
+        buf[3] = sysid;
+        buf[4] = compid;
+        buf[5] = msgid;
+    }
+
+    return hl + plen + 2;
+}
+
+struct MsgProfEvent
+{
+    uint64_t    t;
+    int         sysid, compid, msgid, len;
+};
+
+///
+/// \brief brute force table of a window, compared with MsgProfiler::top
+///
+static int msgprof_check(MsgProfiler &mp, const std::vector<MsgProfEvent> &ev,
+                         uint64_t tNow, int windowS, int perSource, int nSrcMax)
+{
+    std::vector<MsgProfileRow>  rows;
+    MsgProfileRow               total;
+    uint64_t                    tEnd = tNow - tNow % MSGPROF_BUCKET_US;
+    uint64_t                    tBeg = tEnd - std::min(tEnd, (uint64_t) windowS * MSGPROF_BUCKET_US);
+    std::vector<int>            srcs;
+    uint64_t                    refCount = 0, refBytes = 0;
+    int                         err = 0;
+
+    mp.top(rows, 0, windowS, perSource, tNow, &total);
+
+    // sources get their slot in the order they are seen
+    for(size_t i=0; i<ev.size(); i++) {
+        int key = ev[i].sysid << 8 | ev[i].compid;
+        if( std::find(srcs.begin(), srcs.end(), key) == srcs.end() ) srcs.push_back(key);
+    }
+
+    for(size_t r=0; r<rows.size(); r++) {
+        uint64_t    c = 0, by = 0;
+
+        for(size_t i=0; i<ev.size(); i++) {
+            const MsgProfEvent &e = ev[i];
+            if( e.t < tBeg || e.t >= tEnd ) continue;
+
+            int msgid = e.msgid < MSGPROF_MSGIDS ? e.msgid : 0xFFFF;
+            if( msgid != rows[r].msgid ) continue;
+
+            if( perSource ) {
+                int si = std::find(srcs.begin(), srcs.end(), e.sysid << 8 | e.compid) - srcs.begin();
+                if( si < nSrcMax ) {
+                    if( e.sysid != rows[r].sysid || e.compid != rows[r].compid ) continue;
+                } else if( rows[r].sysid != -1 ) continue;
+            }
+
+            c  += 1;
+            by += e.len;
+        }
+
+        if( c != rows[r].count || by != rows[r].bytes ) {
+            printf("  window %d s, source %d:%d, %s: %llu/%llu frames, %llu/%llu bytes\n",
+                   windowS, rows[r].sysid, rows[r].compid, rows[r].name,
+                   (unsigned long long) rows[r].count, (unsigned long long) c,
+                   (unsigned long long) rows[r].bytes, (unsigned long long) by);
+            err ++;
+        }
+    }
+
+    for(size_t i=0; i<ev.size(); i++) {
+        if( ev[i].t < tBeg || ev[i].t >= tEnd ) continue;
+        refCount ++;
+        refBytes += ev[i].len;
+    }
+
+    if( total.count != refCount || total.bytes != refBytes ) {
+        printf("  window %d s: total %llu/%llu frames\n", windowS,
+               (unsigned long long) total.count, (unsigned long long) refCount);
+        err ++;
+    }
+
+    return err;
+}
+
+int test_msg_profiler(CParamArray *pa)
+{
+    std::string     fn = "", fn_csv = "msg_profile.csv";
+    int             seconds = 600, rep = 5;
+    double          nsMax = 20;
+    int             err = 0;
+    uint8_t         buf[MAVLINK_V2_MAX_PACKET_LEN];
+
+    pa->s("fn", fn);
+    pa->s("fn_csv", fn_csv);
+    pa->i("seconds", seconds);
+    pa->i("rep", rep);
+    pa->d("nsMax", nsMax);
+
+    // names from the MAVLink headers
+    if( strcmp(MsgProfiler::msgName(MAVLINK_MSG_ID_HEARTBEAT), "HEARTBEAT") != 0 ||
+        strcmp(MsgProfiler::msgName(MAVLINK_MSG_ID_ATTITUDE), "ATTITUDE") != 0 ||
+        strcmp(MsgProfiler::msgName(3), "MSG_3") != 0 ) {
+        printf("names: %s %s %s\n", MsgProfiler::msgName(0), MsgProfiler::msgName(30),
+               MsgProfiler::msgName(3));
+        err ++;
+    }
+
+    // random frames of 12 sources (the last 4 share a slot), MAVLink 1 & 2,
+    //  windows compared with brute force while the frames come in
+    {
+        MsgProfiler                 mp;
+        std::vector<MsgProfEvent>   ev;
+        uint64_t                    t = 5000000;
+        int                         nCheck = 0, e0 = err;
+
+        srand(7);
+
+        for(int i=0; i<200000; i++) {
+            MsgProfEvent e;
+
+            t += rand() % 1500;
+            if( i == 100000 ) t += 20 * MSGPROF_BUCKET_US;      // link silent for 20 s
+
+            int src  = rand() % 12;
+            e.t      = t;
+            e.sysid  = 1 + src / 3;
+            e.compid = 1 + src % 3;
+            e.msgid  = rand() % 40;
+            if( rand() % 50 == 0 ) e.msgid = 300 + rand() % 3;
+
+            int v2   = e.msgid >= 256 || rand() % 2;
+            e.len    = msgprof_frame(buf, v2, e.sysid, e.compid, e.msgid, 9 + e.msgid % 20);
+
+            mp.frame(buf, e.len, e.t);
+            ev.push_back(e);
+
+            if( i % 20000 == 19999 ) {
+                int w[3] = { 1, 10, 60 };
+                for(int k=0; k<3; k++) {
+                    err += msgprof_check(mp, ev, t, w[k], 1, MSGPROF_SOURCES);
+                    err += msgprof_check(mp, ev, t, w[k], 0, MSGPROF_SOURCES);
+                    nCheck += 2;
+                }
+            }
+        }
+
+        // nothing received for a while: the window is empty
+        std::vector<MsgProfileRow>  rows;
+        MsgProfileRow               total;
+
+        mp.top(rows, 0, 10, 0, t + 12 * MSGPROF_BUCKET_US, &total);
+        if( rows.size() != 0 || total.count != 0 ) {
+            printf("  idle: %d rows, %llu frames\n", (int) rows.size(), (unsigned long long) total.count);
+            err ++;
+        }
+
+        // top-N & CSV
+        mp.top(rows, 5, 60, 1, t, &total);
+        if( rows.size() != 5 || rows[0].bytes < rows[4].bytes ) err ++;
+
+        if( 0 == mp.saveCSV(fn_csv, 60, 1, t) ) {
+            FILE *fp = fopen(fn_csv.c_str(), "rt");
+            char line[256];
+            int  nLine = 0;
+            while( fp != NULL && fgets(line, sizeof(line), fp) != NULL ) nLine ++;
+            if( fp != NULL ) fclose(fp);
+
+            mp.top(rows, 0, 60, 1, t);
+            if( nLine != rows.size() + 1 ) {
+                printf("  CSV: %d lines, %d rows\n", nLine, (int) rows.size());
+                err ++;
+            }
+        } else {
+            err ++;
+        }
+
+        printf("windows: %d tables checked, %d errors\n", nCheck, err - e0);
+    }
+
+    // replay benchmark: frames of a capture (tlog or raw bytes) or a generated
+    //  ArduCopter stream, scanned in 512-byte blocks as the reading thread does
+    {
+        std::vector<uint8_t>            s;
+        std::vector<mavlink_frame_span> spans;
+        std::vector<uint64_t>           ts;
+        mavlink_frame_spans             blk;
+        MavlinkFrameScanner             sc;
+        ru64                            t0, t1;
+        double                          nsScan = 1e9, nsBase = 1e9, nsProf = 1e9;
+        uint64_t                        sum = 0;
+        int                             i, j, n;
+
+        if( fn.size() > 0 ) {
+            FILE *fp = fopen(fn.c_str(), "rb");
+            if( fp == NULL ) {
+                printf("can not open capture: %s\n", fn.c_str());
+                return -1;
+            }
+            while( (n = fread(buf, 1, sizeof(buf), fp)) > 0 ) s.insert(s.end(), buf, buf+n);
+            fclose(fp);
+        } else {
+            std::vector<mavlink_message_t>  msgs;
+
+            mavlink_gen_copter_msgs(msgs, seconds);
+            for(i=0; i<msgs.size(); i++) {
+                n = mavlink_msg_to_send_buffer(buf, &msgs[i]);
+                s.insert(s.end(), buf, buf+n);
+            }
+        }
+
+        // frames & the time of their block (the stream spread over 'seconds')
+        for(i=0; i<s.size(); i+=512) {
+            sc.push(&s[i], std::min((int)(s.size()-i), 512), blk);
+            for(j=0; j<blk.size(); j++) {
+                spans.push_back(blk[j]);
+                ts.push_back(1000000 + (uint64_t) ((double) i / s.size() * seconds * 1e6));
+            }
+        }
+        n = spans.size();
+
+        for(int r=0; r<rep; r++) {
+            MsgProfiler         mp;
+            MavlinkFrameScanner sc2;
+
+            // scanning alone (the ingest path without the profiler)
+            t0 = tm_get_us();
+            for(i=0; i<s.size(); i+=512) {
+                sc2.push(&s[i], std::min((int)(s.size()-i), 512), blk);
+                sum += blk.size();
+            }
+            t1 = tm_get_us();
+            nsScan = std::min(nsScan, 1000.0*(t1-t0)/n);
+
+            // the same loop over the frames, without & with the profiler
+            t0 = tm_get_us();
+            for(i=0; i<n; i++) sum += spans[i].len + ts[i];
+            t1 = tm_get_us();
+            nsBase = std::min(nsBase, 1000.0*(t1-t0)/n);
+
+            t0 = tm_get_us();
+            for(i=0; i<n; i++) { mp.frame(spans[i], ts[i]); sum += spans[i].len; }
+            t1 = tm_get_us();
+            nsProf = std::min(nsProf, 1000.0*(t1-t0)/n);
+
+            if( r == rep - 1 ) {
+                std::vector<MsgProfileRow>  rows;
+                MsgProfileRow               total;
+
+                mp.top(rows, 8, 60, 0, ts[n-1], &total);
+                printf("top 8 of the last 60 s (%.0f B/s, %.1f msg/s):\n", total.bps, total.hz);
+                for(j=0; j<rows.size(); j++)
+                    printf("  %-28s %7.1f Hz %8.1f B/s %5.1f%%\n",
+                           rows[j].name, rows[j].hz, rows[j].bps, rows[j].share);
+            }
+        }
+
+        printf("%s: %d frames, scan %.1f ns/frame, profiler +%.1f ns/frame (limit %.0f) [%llu]\n",
+               fn.size() ? fn.c_str() : "generated ArduCopter stream", n,
+               nsScan, nsProf - nsBase, nsMax, (unsigned long long) (sum & 1));
+
+        if( nsProf - nsBase >= nsMax ) err ++;
+    }
+
+    printf("errors = %d\n", err);
+
+    return err;
+}
@@ -0,0 +1,119 @@
+#ifndef __MSGPROFILER_H__
+#define __MSGPROFILER_H__
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "utils_mavlink.h"
+
+
+#define MSGPROF_SOURCES         8               ///< (sysid, compid) pairs, the others share one slot
+#define MSGPROF_MSGIDS          256             ///< msgid >= 256 are counted as msgid 0xFFFF
+#define MSGPROF_BUCKETS         64              ///< ring of one-second buckets
+#define MSGPROF_BUCKET_US       1000000
+#define MSGPROF_WINDOW_MAX      60              ///< s, longest window
+
+
+///
+/// \brief one line of the top-N table
+///
+struct MsgProfileRow
+{
+    int         sysid, compid;                  ///< -1: all sources (or the sources over MSGPROF_SOURCES)
+    int         msgid;                          ///< -1: total of the window
+    const char  *name;
+
+    uint64_t    count, bytes;
+    double      hz, bps;                        ///< per second of the window
+    double      share;                          ///< % of the bytes of the window
+};
+
+
+///
+/// \brief Bandwidth used by each message type
+///
+///     frame() is called by the reading thread for every accepted frame, it
+///     adds one to the counters of (source, msgid) in the bucket of the
+///     current second. The table of a window is the sum of the last complete
+///     buckets, so rates over 1, 10 or 60 s come from the same counters and
+///     a window without frames reads as zero, not as the last rate.
+///
+///     There is one writer, which also moves to the next bucket (cleared
+///     before it is published). Readers sum the buckets without a lock; the
+///     bucket being reused is older than any window.
+///
+class MsgProfiler
+{
+public:
+    MsgProfiler();
+    ~MsgProfiler();
+
+    ///
+    /// \brief count a frame (writer)
+    ///
+    void frame(const uint8_t *p, int len, uint64_t tNowUs);
+    void frame(const mavlink_frame_span &f, uint64_t tNowUs) { frame(f.p, f.len, tNowUs); }
+
+    ///
+    /// \brief largest messages of a window (reader)
+    ///
+    /// \param rows - sorted by bytes, largest first
+    /// \param n - rows kept (0: all)
+    /// \param windowS - seconds (1 ~ MSGPROF_WINDOW_MAX), ending at the start of the current second
+    /// \param perSource - one row per (source, msgid), else per msgid
+    /// \param total - totals of the window (optional)
+    ///
+    /// \return number of rows
+    ///
+    int top(std::vector<MsgProfileRow> &rows, int n, int windowS, int perSource,
+            uint64_t tNowUs, MsgProfileRow *total = NULL);
+
+    ///
+    /// \brief write the table of a window as CSV
+    /// \return 0 - success, -1 - can not open the file
+    ///
+    int saveCSV(const std::string &fn, int windowS, int perSource, uint64_t tNowUs);
+
+    ///
+    /// \brief clear (no frame() at the same time)
+    ///
+    void reset(void);
+
+    ///
+    /// \brief message name from the MAVLink headers ("MSG_<id>" if unknown)
+    ///
+    static const char* msgName(int msgid);
+
+protected:
+    struct Cell {
+        uint32_t    count, bytes;
+    };
+
+    enum {
+        NCELL = (MSGPROF_SOURCES + 1) * (MSGPROF_MSGIDS + 1)
+    };
+
+    void rotate(uint64_t tNowUs);
+    int  newSource(uint32_t key);
+
+    Cell                *m_buckets;                 ///< MSGPROF_BUCKETS x NCELL
+    uint64_t            m_tStart[MSGPROF_BUCKETS];  ///< us, start of each bucket (0: never used)
+    uint32_t            m_head;                     ///< bucket of the current second
+    Cell                *m_cur;
+    uint64_t            m_tNext;                    ///< us, end of the current bucket
+
+    uint8_t             m_slotOf[65536];            ///< sysid << 8 | compid -> slot + 1
+    uint32_t            m_srcKey[MSGPROF_SOURCES];
+    uint32_t            m_nSrc;
+};
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_msg_profiler(rtk::CParamArray *pa);
+
+#endif // end of __MSGPROFILER_H__
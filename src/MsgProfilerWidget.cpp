@@ -0,0 +1,134 @@
+#include <QtGui>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QHeaderView>
+#include <QPushButton>
+#include <QFileDialog>
+#include <QMessageBox>
+
+#include <rtk_utils.h>
+
+#include "MsgProfilerWidget.h"
+
+using namespace rtk;
+
+
+MsgProfilerWidget::MsgProfilerWidget(QWidget *parent) : QDockWidget(tr("Message bandwidth"), parent)
+{
+    m_profiler = NULL;
+    m_topN = 20;
+
+    setObjectName("MsgProfilerWidget");
+
+    QWidget *w = new QWidget(this);
+    QVBoxLayout *vl = new QVBoxLayout(w);
+    QHBoxLayout *hl = new QHBoxLayout();
+
+    m_cbWindow = new QComboBox(w);
+    m_cbWindow->addItem(tr("1 s"),  1);
+    m_cbWindow->addItem(tr("10 s"), 10);
+    m_cbWindow->addItem(tr("60 s"), 60);
+    m_cbWindow->setCurrentIndex(1);
+
+    m_chkSource = new QCheckBox(tr("per sender"), w);
+
+    QPushButton *btSave = new QPushButton(tr("Save CSV..."), w);
+
+    m_lbTotal = new QLabel(w);
+
+    hl->addWidget(m_cbWindow);
+    hl->addWidget(m_chkSource);
+    hl->addWidget(m_lbTotal, 1);
+    hl->addWidget(btSave);
+
+    m_table = new QTableWidget(0, 7, w);
+    QStringList hdr;
+    hdr << tr("Sender") << tr("ID") << tr("Message") << tr("Hz") << tr("B/s") << tr("%") << tr("Bytes");
+    m_table->setHorizontalHeaderLabels(hdr);
+    m_table->verticalHeader()->hide();
+    m_table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_table->setSelectionMode(QAbstractItemView::NoSelection);
+    m_table->horizontalHeader()->setStretchLastSection(true);
+
+    vl->addLayout(hl);
+    vl->addWidget(m_table, 1);
+    vl->setMargin(2);
+    vl->setSpacing(2);
+    setWidget(w);
+
+    connect(m_cbWindow,  SIGNAL(currentIndexChanged(int)), this, SLOT(refresh()));
+    connect(m_chkSource, SIGNAL(toggled(bool)),            this, SLOT(refresh()));
+    connect(btSave,      SIGNAL(clicked()),                this, SLOT(saveCSV()));
+
+    // the table changes once per second (one bucket)
+    m_timer = new QTimer(this);
+    connect(m_timer, SIGNAL(timeout()), this, SLOT(refresh()));
+    m_timer->start(1000);
+}
+
+MsgProfilerWidget::~MsgProfilerWidget()
+{
+}
+
+void MsgProfilerWidget::setProfiler(MsgProfiler *p)
+{
+    m_profiler = p;
+    refresh();
+}
+
+int MsgProfilerWidget::windowS(void)
+{
+    return m_cbWindow->itemData(m_cbWindow->currentIndex()).toInt();
+}
+
+void MsgProfilerWidget::refresh(void)
+{
+    MsgProfileRow   total;
+    int             i, n;
+
+    if( m_profiler == NULL || !isVisible() ) return;
+
+    n = m_profiler->top(m_rows, m_topN, windowS(), m_chkSource->isChecked(),
+                        tm_get_us(), &total);
+
+    m_lbTotal->setText(QString("%1 B/s, %2 msg/s")
+                       .arg(total.bps, 0, 'f', 0).arg(total.hz, 0, 'f', 1));
+
+    m_table->setRowCount(n);
+    for(i=0; i<n; i++) {
+        const MsgProfileRow &r = m_rows[i];
+        QString src = r.sysid < 0 ? QString("*") : QString("%1:%2").arg(r.sysid).arg(r.compid);
+
+        QString v[7];
+        v[0] = src;
+        v[1] = QString::number(r.msgid);
+        v[2] = r.name;
+        v[3] = QString::number(r.hz, 'f', 1);
+        v[4] = QString::number(r.bps, 'f', 0);
+        v[5] = QString::number(r.share, 'f', 1);
+        v[6] = QString::number((qulonglong) r.bytes);
+
+        for(int c=0; c<7; c++) {
+            QTableWidgetItem *it = m_table->item(i, c);
+            if( it == NULL ) {
+                it = new QTableWidgetItem();
+                if( c != 0 && c != 2 ) it->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+                m_table->setItem(i, c, it);
+            }
+            it->setText(v[c]);
+        }
+    }
+}
+
+void MsgProfilerWidget::saveCSV(void)
+{
+    if( m_profiler == NULL ) return;
+
+    QString fn = QFileDialog::getSaveFileName(this, tr("Save message bandwidth"),
+                                              "msg_profile.csv", tr("CSV (*.csv)"));
+    if( fn.isEmpty() ) return;
+
+    if( 0 != m_profiler->saveCSV(fn.toStdString(), windowS(), m_chkSource->isChecked(),
+                                 tm_get_us()) )
+        QMessageBox::warning(this, tr("Save message bandwidth"), tr("Can not write ") + fn);
+}
@@ -0,0 +1,56 @@
+#ifndef __MSGPROFILERWIDGET_H__
+#define __MSGPROFILERWIDGET_H__
+
+#include <vector>
+
+#include <QtCore>
+#include <QtGui>
+#include <QDockWidget>
+#include <QTableWidget>
+#include <QComboBox>
+#include <QCheckBox>
+#include <QLabel>
+#include <QTimer>
+
+#include "MsgProfiler.h"
+
+
+///
+/// \brief Dockable top-N table of the bytes per message type
+///
+///     Refreshed once a second while visible, from the complete seconds of
+///     the chosen window. The whole table (not only the top rows) can be
+///     saved as CSV.
+///
+class MsgProfilerWidget : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit MsgProfilerWidget(QWidget *parent = 0);
+    virtual ~MsgProfilerWidget();
+
+    void setProfiler(MsgProfiler *p);
+
+    void setTopN(int n) { m_topN = n; }
+
+public slots:
+    void refresh(void);
+    void saveCSV(void);
+
+protected:
+    int windowS(void);
+
+    MsgProfiler                 *m_profiler;
+    int                         m_topN;
+
+    QComboBox                   *m_cbWindow;
+    QCheckBox                   *m_chkSource;
+    QLabel                      *m_lbTotal;
+    QTableWidget                *m_table;
+    QTimer                      *m_timer;
+
+    std::vector<MsgProfileRow>  m_rows;
+};
+
+#endif // end of __MSGPROFILERWIDGET_H__
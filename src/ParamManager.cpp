@@ -0,0 +1,872 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+
+#include <rtk_utils.h>
+#include <rtk_debug.h>
+#include <rtk_paramarray.h>
+
+#include "ParamManager.h"
+#include "utils_simlink.h"
+
+using namespace rtk;
+
+
+#define PM_HASH_ID          "_HASH_CHECK"
+#define PM_STALL_MIN_US     200000          ///< stream silence taken as stalled (at least)
+
+
+ParamManager::ParamManager()
+{
+    m_send      = NULL;
+    m_sendArg   = NULL;
+    m_notify    = NULL;
+    m_notifyArg = NULL;
+    m_readyPending = 0;
+
+    m_sysID     = 254;
+    m_compID    = 1;
+    m_targetSys = 1;
+    m_targetComp = 1;
+
+    m_windowMax = 8;
+    m_maxRetry  = 8;
+    m_earlyGaps = 1;
+    m_rtoMinUs  = 50000;
+    m_rtoMaxUs  = 5000000;
+
+    m_state     = PM_IDLE;
+    m_ready     = 0;
+    m_tStart    = 0;
+    m_nParam    = 0;
+    m_nGot      = 0;
+
+    m_cacheHash = 0;
+    m_vehHash   = 0;
+    m_gotParam0 = 0;
+
+    m_srtt      = -1;
+    m_rttvar    = 0;
+    m_rto       = 1000000;
+
+    m_expect    = 0;
+    m_streaming = 0;
+    m_tLastRx   = 0;
+    m_tSent     = 0;
+    m_retry     = 0;
+
+    m_tmReadyUs    = 0;
+    m_tmDownloadUs = 0;
+    m_fromCache = 0;
+    m_nRead     = 0;
+    m_nRetx     = 0;
+    m_nDup      = 0;
+    m_nChanged  = 0;
+}
+
+ParamManager::~ParamManager()
+{
+}
+
+void ParamManager::setIDs(int sysID, int compID, int targetSys, int targetComp)
+{
+    m_mutex.lock();
+    m_sysID      = sysID;
+    m_compID     = compID;
+    m_targetSys  = targetSys;
+    m_targetComp = targetComp;
+    m_mutex.unlock();
+}
+
+void ParamManager::setTransfer(int window, int rtoMin, int rtoMax, int maxRetry, int earlyGaps)
+{
+    m_mutex.lock();
+    m_windowMax = window < 1 ? 1 : window;
+    m_rtoMinUs  = (uint64_t) rtoMin * 1000;
+    m_rtoMaxUs  = (uint64_t) std::max(rtoMin, rtoMax) * 1000;
+    m_maxRetry  = maxRetry;
+    m_earlyGaps = earlyGaps;
+    m_rto       = std::min(std::max(m_rto, m_rtoMinUs), m_rtoMaxUs);
+    m_mutex.unlock();
+}
+
+void ParamManager::setCacheDir(const std::string &dir)
+{
+    m_mutex.lock();
+    m_cacheDir = dir;
+    m_mutex.unlock();
+}
+
+void ParamManager::progress(int *done, int *total)
+{
+    m_mutex.lock();
+    *done  = m_nGot;
+    *total = m_nParam;
+    m_mutex.unlock();
+}
+
+int ParamManager::get(const std::string &id, float &v)
+{
+    int ret = -1;
+
+    m_mutex.lock();
+    std::map<std::string, int>::iterator it = m_index.find(id);
+    if( m_ready && it != m_index.end() ) {
+        v = m_params[it->second].value;
+        ret = 0;
+    }
+    m_mutex.unlock();
+
+    return ret;
+}
+
+void ParamManager::params(ParamList &pl)
+{
+    m_mutex.lock();
+    if( m_ready ) pl = m_params;
+    else          pl.clear();
+    m_mutex.unlock();
+}
+
+
+uint32_t ParamManager::hash(const ParamList &pl)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    for(size_t i=0; i<pl.size(); i++) {
+        const uint8_t   *p[2] = { (const uint8_t*) pl[i].id, (const uint8_t*) &pl[i].value };
+        size_t          n[2]  = { strlen(pl[i].id), sizeof(float) };
+
+        for(int k=0; k<2; k++) {
+            for(size_t j=0; j<n[k]; j++) {
+                crc ^= p[k][j];
+                for(int b=0; b<8; b++) crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+            }
+        }
+    }
+
+    return ~crc;
+}
+
+int ParamManager::loadCache(int sysID, ParamList &pl, uint32_t *vehHash)
+{
+    std::string fn = fmt::sprintf("%s/params_%d.txt", m_cacheDir.c_str(), sysID);
+    FILE        *fp;
+    char        line[256], id[64];
+    int         sid, n, idx, type;
+    uint32_t    crc;
+    float       v;
+
+    pl.clear();
+    if( m_cacheDir.size() == 0 ) return -1;
+
+    fp = fopen(fn.c_str(), "rt");
+    if( fp == NULL ) return -1;
+
+    if( fgets(line, sizeof(line), fp) == NULL || fgets(line, sizeof(line), fp) == NULL ||
+        4 != sscanf(line, "# sysid %d count %d vehicle_hash %x crc %x", &sid, &n, vehHash, &crc) ||
+        sid != sysID ) {
+        fclose(fp);
+        return -2;
+    }
+
+    while( fgets(line, sizeof(line), fp) != NULL ) {
+        if( 4 != sscanf(line, "%d %63s %f %d", &idx, id, &v, &type) ) continue;
+        if( idx != (int) pl.size() || strlen(id) > 16 ) break;
+
+        ParamItem p;
+        memset(&p, 0, sizeof(p));
+        strcpy(p.id, id);
+        p.value = v;
+        p.type  = type;
+        pl.push_back(p);
+    }
+
+    fclose(fp);
+
+    if( (int) pl.size() != n || hash(pl) != crc ) {
+        dbg_pw("Parameter cache %s is damaged\n", fn.c_str());
+        pl.clear();
+        return -3;
+    }
+
+    return 0;
+}
+
+int ParamManager::saveCache(int sysID, const ParamList &pl, uint32_t vehHash)
+{
+    std::string fn = fmt::sprintf("%s/params_%d.txt", m_cacheDir.c_str(), sysID);
+    std::string fnTmp = fn + ".tmp";
+    FILE        *fp;
+
+    if( m_cacheDir.size() == 0 ) return -1;
+    mkdir(m_cacheDir.c_str(), 0755);
+
+    fp = fopen(fnTmp.c_str(), "wt");
+    if( fp == NULL ) {
+        dbg_pe("Can not write parameter cache: %s\n", fnTmp.c_str());
+        return -1;
+    }
+
+    fprintf(fp, "# SimpGCS parameter cache: index, id, value, MAV_PARAM_TYPE\n");
+    fprintf(fp, "# sysid %d count %d vehicle_hash %08x crc %08x\n",
+            sysID, (int) pl.size(), vehHash, hash(pl));
+    for(size_t i=0; i<pl.size(); i++)
+        fprintf(fp, "%d\t%s\t%.9g\t%d\n", (int) i, pl[i].id, pl[i].value, pl[i].type);
+
+    fclose(fp);
+
+    // readers never see a half written file
+    return rename(fnTmp.c_str(), fn.c_str());
+}
+
+
+void ParamManager::send(mavlink_message_t &msg)
+{
+    if( m_send != NULL ) m_send(m_sendArg, msg);
+}
+
+void ParamManager::sendList(uint64_t tNowUs)
+{
+    mavlink_message_t msg;
+
+    mavlink_msg_param_request_list_pack(m_sysID, m_compID, &msg, m_targetSys, m_targetComp);
+    send(msg);
+    m_tSent = tNowUs;
+}
+
+void ParamManager::sendRead(int idx, const char *id, uint64_t tNowUs)
+{
+    mavlink_message_t   msg;
+    char                buf[17];
+
+    memset(buf, 0, sizeof(buf));
+    if( id != NULL ) strncpy(buf, id, 16);
+
+    mavlink_msg_param_request_read_pack(m_sysID, m_compID, &msg, m_targetSys, m_targetComp, buf, idx);
+    send(msg);
+
+    if( idx >= 0 && idx < m_nParam ) {
+        m_tReq[idx] = tNowUs;
+        if( m_nReq[idx] < 255 ) m_nReq[idx] ++;
+        m_nRead ++;
+    }
+}
+
+void ParamManager::fillWindow(uint64_t tNowUs)
+{
+    // gaps wait for the end of the stream if not requested early
+    if( !m_earlyGaps && m_expect < m_nParam ) return;
+
+    while( (int) m_inflight.size() < m_windowMax && !m_gaps.empty() ) {
+        int i = m_gaps.front();
+        m_gaps.erase(m_gaps.begin());
+        if( got(i) ) continue;
+
+        sendRead(i, NULL, tNowUs);
+        m_inflight.push_back(i);
+    }
+}
+
+void ParamManager::rttSample(uint64_t rttUs)
+{
+    double r = rttUs;
+
+    if( m_srtt < 0 ) {
+        m_srtt   = r;
+        m_rttvar = r / 2;
+    } else {
+        m_rttvar = 0.75 * m_rttvar + 0.25 * fabs(m_srtt - r);
+        m_srtt   = 0.875 * m_srtt + 0.125 * r;
+    }
+
+    m_rto = (uint64_t) (m_srtt + 4 * m_rttvar);
+    m_rto = std::min(std::max(m_rto, m_rtoMinUs), m_rtoMaxUs);
+}
+
+
+int ParamManager::start(uint64_t tNowUs)
+{
+    m_mutex.lock();
+
+    m_ready     = 0;
+    m_tStart    = tNowUs;
+    m_params.clear();
+    m_index.clear();
+    m_got.clear();
+    m_nParam    = 0;
+    m_nGot      = 0;
+    m_vehHash   = 0;
+    m_gotParam0 = 0;
+    m_retry     = 0;
+
+    m_tmReadyUs    = 0;
+    m_tmDownloadUs = 0;
+    m_fromCache = 0;
+    m_nRead     = m_nRetx = m_nDup = m_nChanged = 0;
+
+    // a cached set is checked first: param 0 & count, and the vehicle hash
+    if( 0 == loadCache(m_targetSys, m_cache, &m_cacheHash) && m_cache.size() > 0 ) {
+        m_state = PM_CHECK;
+        sendRead(-1, PM_HASH_ID, tNowUs);
+        sendRead(0, NULL, tNowUs);
+        m_tSent = tNowUs;
+    } else {
+        m_cache.clear();
+        beginList(tNowUs);
+    }
+
+    m_mutex.unlock();
+
+    return 0;
+}
+
+int ParamManager::stop(void)
+{
+    m_mutex.lock();
+    m_state = PM_IDLE;
+    m_inflight.clear();
+    m_gaps.clear();
+    m_mutex.unlock();
+
+    return 0;
+}
+
+void ParamManager::beginList(uint64_t tNowUs)
+{
+    m_state   = PM_LIST;
+    m_expect  = 0;
+    m_nGot    = 0;
+    m_retry   = 0;
+    m_gaps.clear();
+    m_inflight.clear();
+    m_got.clear();
+    m_streaming = 0;
+
+    // the vehicle hash is kept with the set (ignored if there is none)
+    if( m_vehHash == 0 ) sendRead(-1, PM_HASH_ID, tNowUs);
+
+    sendList(tNowUs);
+    m_tLastRx = tNowUs;
+}
+
+void ParamManager::setReady(uint64_t tNowUs)
+{
+    if( m_ready ) return;
+
+    m_ready        = 1;
+    m_tmReadyUs    = tNowUs - m_tStart;
+    m_readyPending = 1;
+}
+
+void ParamManager::finishList(uint64_t tNowUs)
+{
+    m_state        = PM_IDLE;
+    m_tmDownloadUs = tNowUs - m_tStart;
+    m_inflight.clear();
+    m_gaps.clear();
+
+    // download behind a cached set: count what changed
+    if( m_fromCache ) {
+        m_nChanged = 0;
+        for(int i=0; i<m_nParam; i++) {
+            if( i >= (int) m_cache.size() || m_cache[i].value != m_params[i].value ||
+                strcmp(m_cache[i].id, m_params[i].id) != 0 )
+                m_nChanged ++;
+        }
+        if( m_nChanged > 0 ) dbg_pw("%d parameters differ from the cache\n", m_nChanged);
+    }
+    m_cache.clear();
+
+    setReady(tNowUs);
+    saveCache(m_targetSys, m_params, m_vehHash);
+
+    // saved again with the hash if it comes
+    if( m_vehHash == 0 ) sendRead(-1, PM_HASH_ID, tNowUs);
+}
+
+int ParamManager::handle(const mavlink_message_t &msg, uint64_t tNowUs)
+{
+    mavlink_param_value_t   pv;
+    char                    id[17];
+
+    if( msg.msgid != MAVLINK_MSG_ID_PARAM_VALUE ) return 0;
+
+    mavlink_msg_param_value_decode(&msg, &pv);
+    memcpy(id, pv.param_id, 16);
+    id[16] = 0;
+
+    m_mutex.lock();
+
+    if( msg.sysid != m_targetSys ) {
+        m_mutex.unlock();
+        return 1;
+    }
+
+    // vehicle hash of its set
+    if( strcmp(id, PM_HASH_ID) == 0 ) {
+        memcpy(&m_vehHash, &pv.param_value, 4);
+
+        if( m_state == PM_CHECK ) {
+            if( m_vehHash == m_cacheHash && m_cacheHash != 0 ) {
+                m_params = m_cache;
+                m_nParam = m_nGot = m_params.size();
+                for(int i=0; i<m_nParam; i++) m_index[m_params[i].id] = i;
+
+                m_fromCache = 1;
+                m_state     = PM_IDLE;
+                m_cache.clear();
+                setReady(tNowUs);
+            } else {
+                beginList(tNowUs);
+            }
+        } else if( m_state == PM_IDLE && m_tmDownloadUs > 0 ) {
+            saveCache(m_targetSys, m_params, m_vehHash);
+        }
+    }
+
+    // answer of the param 0 read: the cached set has the same count & first value
+    else if( m_state == PM_CHECK ) {
+        if( pv.param_index == 0 ) {
+            rttSample(tNowUs - m_tSent);
+
+            if( pv.param_count != m_cache.size() || strcmp(id, m_cache[0].id) != 0 ||
+                pv.param_value != m_cache[0].value )
+                beginList(tNowUs);
+            else
+                m_gotParam0 = 1;
+        }
+    }
+
+    else if( m_state == PM_LIST ) {
+        int i = pv.param_index;
+
+        // first value: the count is known
+        if( m_got.empty() ) {
+            m_nParam = pv.param_count;
+            if( (int) m_params.size() != m_nParam ) {
+                m_params.assign(m_nParam, ParamItem());
+                m_index.clear();
+            }
+            m_got.assign((m_nParam + 31) / 32, 0);
+            m_tReq.assign(m_nParam, 0);
+            m_nReq.assign(m_nParam, 0);
+        }
+
+        if( i < m_nParam ) {
+            if( got(i) ) {
+                m_nDup ++;
+            } else {
+                ParamItem &p = m_params[i];
+
+                memcpy(p.id, id, sizeof(p.id));
+                p.value = pv.param_value;
+                p.type  = pv.param_type;
+                m_index[p.id] = i;
+
+                m_got[i >> 5] |= 1u << (i & 31);
+                m_nGot ++;
+                m_retry = 0;
+
+                // a late answer of the param 0 check is no sign of the stream
+                if( i > 0 && m_nReq[i] == 0 ) m_streaming = 1;
+
+                if( m_nReq[i] > 0 ) {
+                    std::vector<int>::iterator it = std::find(m_inflight.begin(), m_inflight.end(), i);
+                    if( it != m_inflight.end() ) m_inflight.erase(it);
+                    if( m_nReq[i] == 1 ) rttSample(tNowUs - m_tReq[i]);
+                }
+            }
+
+            // the stream is in index order: skipped indices are lost
+            if( i >= m_expect ) {
+                for(int j=m_expect; j<i; j++)
+                    if( !got(j) && m_nReq[j] == 0 ) m_gaps.push_back(j);
+                m_expect = i + 1;
+            }
+
+            m_tLastRx = tNowUs;
+
+            if( m_nGot == m_nParam ) finishList(tNowUs);
+            else                     fillWindow(tNowUs);
+        }
+    }
+
+    // value changed on the vehicle (PARAM_SET by anyone)
+    else if( m_ready && pv.param_index < m_params.size() &&
+             strcmp(id, m_params[pv.param_index].id) == 0 ) {
+        m_params[pv.param_index].value = pv.param_value;
+    }
+
+    int notify = m_readyPending;
+    m_readyPending = 0;
+    m_mutex.unlock();
+
+    if( notify && m_notify != NULL ) m_notify(m_notifyArg);
+
+    return 1;
+}
+
+void ParamManager::tick(uint64_t tNowUs)
+{
+    m_mutex.lock();
+
+    switch( m_state ) {
+    case PM_CHECK:
+        if( tNowUs - m_tSent < m_rto ) break;
+
+        // asked again (twice without any answer, once with param 0), then:
+        // param 0 matched but no hash, the autopilot has none, the cached
+        // set is used now and downloaded behind
+        if( ++m_retry <= (m_gotParam0 ? 1 : 2) ) {
+            if( !m_gotParam0 ) m_rto = std::min(m_rto * 2, m_rtoMaxUs);
+            sendRead(-1, PM_HASH_ID, tNowUs);
+            if( !m_gotParam0 ) sendRead(0, NULL, tNowUs);
+            m_tSent = tNowUs;
+            m_nRetx ++;
+        } else if( m_gotParam0 ) {
+            m_params = m_cache;
+            m_nParam = m_params.size();
+            for(int i=0; i<m_nParam; i++) m_index[m_params[i].id] = i;
+
+            m_fromCache = 1;
+            setReady(tNowUs);
+            beginList(tNowUs);
+        } else {
+            beginList(tNowUs);
+        }
+        break;
+
+    case PM_LIST:
+        // no stream yet: the list request is repeated
+        if( !m_streaming ) {
+            if( tNowUs - m_tSent < m_rto ) break;
+
+            if( ++m_retry > m_maxRetry ) {
+                dbg_pw("No parameters from the vehicle\n");
+                m_state = PM_IDLE;
+                break;
+            }
+            m_rto = std::min(m_rto * 2, m_rtoMaxUs);
+            sendList(tNowUs);
+            m_nRetx ++;
+            break;
+        }
+
+        // stalled stream: everything left is a gap
+        if( m_expect < m_nParam && tNowUs - m_tLastRx >= std::max(m_rto, (uint64_t) PM_STALL_MIN_US) ) {
+            for(int j=m_expect; j<m_nParam; j++)
+                if( !got(j) && m_nReq[j] == 0 ) m_gaps.push_back(j);
+            m_expect = m_nParam;
+        }
+
+        // timed out reads are repeated
+        {
+            int nLate = 0;
+
+            for(size_t k=0; k<m_inflight.size(); k++) {
+                int i = m_inflight[k];
+
+                if( tNowUs - m_tReq[i] < m_rto ) continue;
+
+                if( nLate++ == 0 && ++m_retry > m_maxRetry ) {
+                    dbg_pw("Parameter download timeout (%d/%d)\n", m_nGot, m_nParam);
+                    m_state = PM_IDLE;
+                    m_inflight.clear();
+                    break;
+                }
+
+                sendRead(i, NULL, tNowUs);
+                m_nRetx ++;
+            }
+
+            if( nLate > 0 ) m_rto = std::min(m_rto * 2, m_rtoMaxUs);
+        }
+
+        if( m_state == PM_LIST ) fillWindow(tNowUs);
+        break;
+
+    default:
+        break;
+    }
+
+    int notify = m_readyPending;
+    m_readyPending = 0;
+    m_mutex.unlock();
+
+    if( notify && m_notify != NULL ) m_notify(m_notifyArg);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// test & benchmark on a simulated link
+////////////////////////////////////////////////////////////////////////////////
+
+//
+// autopilot side: streams the list in index order when its send queue is
+// short (telemetry takes a share of the link), answers reads at once, and
+// the _HASH_CHECK read if it has a hash (it also ends the list with it)
+//
+struct SimParamVehicle
+{
+    SimLink     *link;
+    ParamList   params;
+    int         hasHash, telemBytesPerSec;
+    int         streamNext;
+    uint64_t    tTelem;
+
+    SimParamVehicle(SimLink *l, int n, int withHash, int telemBps) {
+        link        = l;
+        hasHash     = withHash;
+        telemBytesPerSec = telemBps;
+        streamNext  = -1;
+        tTelem      = 0;
+
+        const char *grp[] = { "ATC_RAT_RLL", "ATC_RAT_PIT", "ATC_RAT_YAW", "PSC_POSXY",
+                              "INS_ACC", "COMPASS_OFS", "SERVO", "RC", "BATT", "EK3_SRC" };
+        for(int i=0; i<n; i++) {
+            ParamItem p;
+            memset(&p, 0, sizeof(p));
+            snprintf(p.id, sizeof(p.id), "%s_%d", grp[i % 10], i / 10);
+            p.value = (i % 7) * 0.125f + i;
+            p.type  = i % 3 == 0 ? MAV_PARAM_TYPE_INT8 : MAV_PARAM_TYPE_REAL32;
+            params.push_back(p);
+        }
+    }
+
+    void sendValue(int i) {
+        mavlink_message_t msg;
+
+        if( i < 0 ) {
+            uint32_t h = ParamManager::hash(params);
+            float    v;
+            memcpy(&v, &h, 4);
+            mavlink_msg_param_value_pack(1, 1, &msg, PM_HASH_ID, v, MAV_PARAM_TYPE_UINT32,
+                                         params.size(), 0xFFFF);
+        } else {
+            mavlink_msg_param_value_pack(1, 1, &msg, params[i].id, params[i].value, params[i].type,
+                                         params.size(), i);
+        }
+        link->send(1, msg);
+    }
+
+    void handle(const mavlink_message_t &msg) {
+        switch( msg.msgid ) {
+        case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
+            streamNext = 0;
+            break;
+
+        case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+        {
+            mavlink_param_request_read_t r;
+            mavlink_msg_param_request_read_decode(&msg, &r);
+
+            if( r.param_index >= 0 && r.param_index < (int) params.size() ) {
+                sendValue(r.param_index);
+            } else if( hasHash && strncmp(r.param_id, PM_HASH_ID, 16) == 0 ) {
+                sendValue(-1);
+            }
+            break;
+        }
+        }
+    }
+
+    void tick(void) {
+        mavlink_message_t msg;
+
+        // telemetry share of the link
+        while( tTelem < link->tNow ) {
+            mavlink_msg_attitude_pack(1, 1, &msg, tTelem / 1000, 0, 0, 0, 0, 0, 0);
+            link->send(1, msg);
+            tTelem += (uint64_t) ((msg.len + MAVLINK_NUM_NON_PAYLOAD_BYTES) * 1e6 / telemBytesPerSec);
+        }
+
+        // the list is sent while the queue is shorter than one tick
+        while( streamNext >= 0 && link->busy[1] < link->tNow + 10000 ) {
+            if( streamNext < (int) params.size() ) {
+                sendValue(streamNext++);
+            } else {
+                if( hasHash ) sendValue(-1);
+                streamNext = -1;
+            }
+        }
+    }
+};
+
+static int sim_param_send(void *arg, mavlink_message_t &msg)
+{
+    ((SimLink*) arg)->send(0, msg);
+    return 0;
+}
+
+// run until the download is done (or ready, if readyOnly), return 0 if complete
+static int sim_param_run(ParamManager &pm, SimLink &link, SimParamVehicle &veh, int readyOnly)
+{
+    uint64_t        tTick = 0;
+    SimLink::Pkt    p;
+
+    link.reset();
+    veh.tTelem = 0;
+    veh.streamNext = -1;
+
+    pm.setSend(sim_param_send, &link);
+    pm.start(0);
+
+    while( link.tNow < 600000000ULL ) {
+        if( (pm.state() == PM_IDLE && link.q.empty()) || (readyOnly && pm.ready()) ) break;
+
+        if( link.poll(tTick, p) ) {
+            if( p.dir == 0 ) veh.handle(p.msg);
+            else             pm.handle(p.msg, link.tNow);
+            continue;
+        }
+
+        pm.tick(link.tNow);
+        veh.tick();
+        tTick += 10000;
+    }
+
+    return pm.ready() ? 0 : -1;
+}
+
+static int param_equal(const ParamList &a, const ParamList &b)
+{
+    if( a.size() != b.size() ) return 0;
+
+    for(size_t i=0; i<a.size(); i++)
+        if( strcmp(a[i].id, b[i].id) != 0 || a[i].value != b[i].value || a[i].type != b[i].type )
+            return 0;
+
+    return 1;
+}
+
+int test_params(CParamArray *pa)
+{
+    int         nParam = 800, baud = 57600, latencyMs = 50, jitterMs = 20, telemBps = 2000;
+    int         err = 0;
+    std::string dir = fmt::sprintf("/tmp/SimpGCS_params_%d", getpid());
+
+    pa->i("nParam", nParam);
+    pa->i("baud", baud);
+    pa->i("latencyMs", latencyMs);
+    pa->i("jitterMs", jitterMs);
+    pa->i("telemBps", telemBps);
+
+    // cache file round trip & damage detection
+    {
+        SimLink         link(baud / 10.0, latencyMs, jitterMs, 0);
+        SimParamVehicle veh(&link, nParam, 1, telemBps);
+        ParamManager    pm;
+        ParamList       rd;
+        uint32_t        h = 0;
+
+        pm.setCacheDir(dir);
+        if( 0 != pm.saveCache(7, veh.params, 0x12345678) ||
+            0 != pm.loadCache(7, rd, &h) || h != 0x12345678 || !param_equal(rd, veh.params) ) {
+            printf("cache: %d of %d read back\n", (int) rd.size(), nParam);
+            err ++;
+        }
+
+        std::string fn = dir + "/params_7.txt";
+        FILE *fp = fopen(fn.c_str(), "at");
+        if( fp ) { fprintf(fp, "%d\tEXTRA\t1\t9\n", nParam); fclose(fp); }
+        if( 0 == pm.loadCache(7, rd, &h) ) { printf("cache: damage not detected\n"); err ++; }
+        unlink(fn.c_str());
+    }
+
+    struct Mode {
+        const char  *name;
+        int         window, rtoMin, rtoMax, early, cache, hash;
+    } modes[] = {
+        { "list, then reads 1 by 1 (1 s timeout)", 1, 1000, 1000, 0, 0, 0 },
+        { "gap reads during the list, window 8",   8,   50, 5000, 1, 0, 0 },
+        { "cache, vehicle hash matches",           8,   50, 5000, 1, 1, 1 },
+        { "cache, no hash (download behind)",      8,   50, 5000, 1, 1, 0 },
+    };
+    double losses[] = { 0, 0.05, 0.2 };
+
+    printf("%d params, %d baud, latency %d+%d ms, telemetry %d B/s\n",
+           nParam, baud, latencyMs, jitterMs, telemBps);
+
+    for(int l=0; l<3; l++) {
+        for(int m=0; m<4; m++) {
+            SimLink         link(baud / 10.0, latencyMs, jitterMs, losses[l]);
+            SimParamVehicle veh(&link, nParam, modes[m].hash, telemBps);
+            ParamManager    pm;
+            ParamList       pl;
+            std::string     dirMode = fmt::sprintf("%s/%d", dir.c_str(), m);
+
+            srand(2000 + l);
+            mkdir(dir.c_str(), 0755);
+            pm.setIDs(254, 1, 1, 1);
+            pm.setTransfer(modes[m].window, modes[m].rtoMin, modes[m].rtoMax, 10, modes[m].early);
+            pm.setCacheDir(modes[m].cache ? dirMode : "");
+
+            // first connection fills the cache; without the hash one value
+            // changes before the second
+            if( modes[m].cache ) {
+                if( 0 != sim_param_run(pm, link, veh, 0) ) err ++;
+                if( !modes[m].hash ) veh.params[nParam / 2].value += 1;
+            }
+
+            int r = sim_param_run(pm, link, veh, 0);
+            pm.params(pl);
+
+            if( r != 0 || pm.state() != PM_IDLE ) {
+                printf("%s: not finished\n", modes[m].name);
+                err ++;
+            } else if( !param_equal(pl, veh.params) ) {
+                printf("%s: parameters differ\n", modes[m].name);
+                err ++;
+            }
+            if( modes[m].cache && !modes[m].hash && pm.m_nChanged != 1 ) {
+                printf("%s: %d changed (1 expected)\n", modes[m].name, pm.m_nChanged);
+                err ++;
+            }
+            if( modes[m].cache && modes[m].hash && !pm.m_fromCache ) {
+                printf("%s: hash changed, cache not used\n", modes[m].name);
+                err ++;
+            }
+
+            printf("loss %2.0f%%  %-40s ready %6.2f s  download %6.2f s  "
+                   "(%3d reads, %3d retx, %3d dup)\n",
+                   losses[l] * 100, modes[m].name, pm.m_tmReadyUs * 1e-6, pm.m_tmDownloadUs * 1e-6,
+                   pm.m_nRead, pm.m_nRetx, pm.m_nDup);
+
+            unlink((dirMode + fmt::sprintf("/params_%d.txt", 1)).c_str());
+            rmdir(dirMode.c_str());
+        }
+    }
+
+    // hash vehicle: a changed value changes the hash, the set is downloaded
+    {
+        SimLink         link(baud / 10.0, latencyMs, jitterMs, 0.05);
+        SimParamVehicle veh(&link, nParam, 1, telemBps);
+        ParamManager    pm;
+        ParamList       pl;
+
+        pm.setCacheDir(dir);
+        sim_param_run(pm, link, veh, 0);
+        veh.params[3].value = -1;
+        sim_param_run(pm, link, veh, 0);
+        pm.params(pl);
+
+        printf("reconnect, hash changed: ready %.2f s, from cache %d (%d reads, %d retx)\n",
+               pm.m_tmReadyUs * 1e-6, pm.m_fromCache, pm.m_nRead, pm.m_nRetx);
+        if( pm.m_fromCache || !param_equal(pl, veh.params) ) err ++;
+
+        unlink((dir + "/params_1.txt").c_str());
+    }
+
+    rmdir(dir.c_str());
+
+    printf("errors = %d\n", err);
+
+    return err;
+}
@@ -0,0 +1,201 @@
+#ifndef __PARAMMANAGER_H__
+#define __PARAMMANAGER_H__
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include <rtk_osa++.h>
+
+#include "utils_mavlink.h"
+
+
+///
+/// \brief one onboard parameter (value as sent, integer types keep their bits)
+///
+struct ParamItem
+{
+    char        id[17];
+    float       value;
+    uint8_t     type;                   ///< MAV_PARAM_TYPE
+};
+
+typedef std::vector<ParamItem> ParamList;
+
+enum ParamManagerState
+{
+    PM_IDLE         = 0,
+    PM_CHECK        = 1,                ///< cached set loaded, asking for the vehicle hash
+    PM_LIST         = 2,                ///< PARAM_REQUEST_LIST stream & gap requests
+};
+
+///
+/// \brief send function (the UAS send buffer, or a simulated link)
+///
+typedef int (*ParamSendFunc)(void *arg, mavlink_message_t &msg);
+
+///
+/// \brief parameters ready notify (from cache or downloaded)
+///
+typedef void (*ParamReadyNotify)(void *arg);
+
+
+///
+/// \brief Parameter download with gap requests and an on-disk cache
+///
+///     Download: PARAM_REQUEST_LIST, the received indices are kept in a
+///     bitmap. The stream comes in index order, so a skipped index is known
+///     lost as soon as a later one arrives and is requested again right away
+///     with PARAM_REQUEST_READ (a window of outstanding reads, timeout from
+///     the measured round trip). A stalled stream turns the rest into gaps.
+///
+///     Cache: "<dir>/params_<sysid>.txt", with the parameter count, the
+///     vehicle hash (_HASH_CHECK, if the autopilot answers it) and a CRC of
+///     the set. On start the cached set is checked with the vehicle hash
+///     and used without a download if it matches. An autopilot without the
+///     hash gets the cached set at once (param 0 and the count are checked)
+///     and a download in the background, which replaces it.
+///
+///     handle() is called from the receiving thread, tick() periodically
+///     (10-50 ms); all take the time so a simulated clock can drive them.
+///
+class ParamManager
+{
+public:
+    ParamManager();
+    ~ParamManager();
+
+    void setSend(ParamSendFunc fn, void *arg) {
+        m_send    = fn;
+        m_sendArg = arg;
+    }
+
+    void setNotify(ParamReadyNotify fn, void *arg) {
+        m_notify    = fn;
+        m_notifyArg = arg;
+    }
+
+    void setIDs(int sysID, int compID, int targetSys, int targetComp);
+
+    ///
+    /// \param window - outstanding gap requests
+    /// \param rtoMin, rtoMax - timeout bounds (ms)
+    /// \param maxRetry - timeouts in a row without progress before giving up
+    /// \param earlyGaps - request gaps during the stream (0: after it ended)
+    ///
+    void setTransfer(int window, int rtoMin, int rtoMax, int maxRetry, int earlyGaps = 1);
+
+    ///
+    /// \param dir - cache directory ("": no cache)
+    ///
+    void setCacheDir(const std::string &dir);
+
+    ///
+    /// \brief get the parameters of the target system (cache or download)
+    ///
+    int start(uint64_t tNowUs);
+    int stop(void);
+
+    ///
+    /// \brief process a received message
+    /// \return 1 if it was a PARAM_VALUE
+    ///
+    int handle(const mavlink_message_t &msg, uint64_t tNowUs);
+    void tick(uint64_t tNowUs);
+
+    int state(void) { return m_state; }
+    int ready(void) { return m_ready; }
+
+    ///
+    /// \brief parameters received / total
+    ///
+    void progress(int *done, int *total);
+
+    int get(const std::string &id, float &v);
+    void params(ParamList &pl);
+
+    ///
+    /// \brief CRC-32 of the ids & values in index order
+    ///
+    static uint32_t hash(const ParamList &pl);
+
+    int loadCache(int sysID, ParamList &pl, uint32_t *vehHash);
+    int saveCache(int sysID, const ParamList &pl, uint32_t vehHash);
+
+    // statistics (us from start)
+    uint64_t    m_tmReadyUs;                ///< parameters usable
+    uint64_t    m_tmDownloadUs;             ///< download finished (0: none)
+    int         m_fromCache;                ///< ready from the cache
+    int         m_nRead;                    ///< PARAM_REQUEST_READ sent for gaps
+    int         m_nRetx;                    ///< repeated requests
+    int         m_nDup;                     ///< values received twice
+    int         m_nChanged;                 ///< download differs from the cached set
+
+protected:
+    void send(mavlink_message_t &msg);
+    void sendList(uint64_t tNowUs);
+    void sendRead(int idx, const char *id, uint64_t tNowUs);
+    void fillWindow(uint64_t tNowUs);
+
+    void beginList(uint64_t tNowUs);
+    void setReady(uint64_t tNowUs);
+    void finishList(uint64_t tNowUs);
+
+    void rttSample(uint64_t rttUs);
+
+    int got(int i) { return (m_got[i >> 5] >> (i & 31)) & 1; }
+
+    rtk::RMutex         m_mutex;
+
+    ParamSendFunc       m_send;
+    void                *m_sendArg;
+    ParamReadyNotify    m_notify;
+    void                *m_notifyArg;
+    int                 m_readyPending;     ///< notify pending (outside the lock)
+
+    int                 m_sysID, m_compID;
+    int                 m_targetSys, m_targetComp;
+
+    int                 m_windowMax, m_maxRetry, m_earlyGaps;
+    uint64_t            m_rtoMinUs, m_rtoMaxUs;
+    std::string         m_cacheDir;
+
+    int                 m_state, m_ready;
+    uint64_t            m_tStart;
+
+    ParamList                   m_params;
+    std::map<std::string, int>  m_index;    ///< id -> index
+    std::vector<uint32_t>       m_got;      ///< received bitmap
+    int                         m_nParam, m_nGot;
+
+    // cache check
+    ParamList           m_cache;
+    uint32_t            m_cacheHash;        ///< vehicle hash of the cached set (0: unknown)
+    uint32_t            m_vehHash;          ///< vehicle hash (0: not answered)
+    int                 m_gotParam0;
+
+    // round trip estimate
+    double              m_srtt, m_rttvar;   ///< us, m_srtt < 0: no sample yet
+    uint64_t            m_rto;
+
+    // stream & gap requests
+    int                     m_expect;       ///< next index of the stream
+    int                     m_streaming;    ///< the list stream has started
+    uint64_t                m_tLastRx, m_tSent;
+    int                     m_retry;
+    std::vector<int>        m_gaps;         ///< lost indices, not requested yet
+    std::vector<int>        m_inflight;
+    std::vector<uint64_t>   m_tReq;         ///< per index: last read request
+    std::vector<uint8_t>    m_nReq;         ///< per index: read requests sent
+};
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_params(rtk::CParamArray *pa);
+
+#endif // end of __PARAMMANAGER_H__
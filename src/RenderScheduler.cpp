@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <QApplication>
+#include <QScreen>
+
+#include <rtk_debug.h>
+#include <rtk_utils.h>
+#include <rtk_osa++.h>
+#include <rtk_paramarray.h>
+#include <rtk_trace.h>
+
+#include "RenderScheduler.h"
+
+using namespace rtk;
+
+
+static void RenderScheduler_notify(void *arg)
+{
+    RenderScheduler *s = (RenderScheduler*) arg;
+
+    s->wake();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+RenderScheduler::RenderScheduler(QObject *parent) : QObject(parent)
+{
+    m_uas     = NULL;
+    m_pending = 0;
+    m_tmFrameUs = 0;
+
+    // coalesce to the display refresh
+    QScreen *screen = QGuiApplication::primaryScreen();
+    if( screen != NULL && screen->refreshRate() > 1.0 )
+        m_frameInterval = 1000.0 / screen->refreshRate();
+    else
+        m_frameInterval = 1000.0 / 60.0;
+
+    m_frameBudget = 8000;
+
+    clearStats();
+
+    m_timer.setSingleShot(true);
+    m_timer.setTimerType(Qt::PreciseTimer);
+    connect(&m_timer, SIGNAL(timeout()), this, SLOT(frame_slot()));
+}
+
+RenderScheduler::~RenderScheduler()
+{
+    setUAS(NULL);
+}
+
+void RenderScheduler::setUAS(UAS *u)
+{
+    if( m_uas != NULL ) m_uas->set_state_notify(NULL, NULL);
+
+    m_uas = u;
+    if( m_uas != NULL ) m_uas->set_state_notify(RenderScheduler_notify, this);
+
+    invalidate(UAS_STATE_ALL);
+}
+
+int RenderScheduler::addClient(const char *name, QObject *obj, const char *member,
+                               int stateMask, int minInterval)
+{
+    Client c;
+
+    c.name        = name;
+    c.obj         = obj;
+    c.member      = member;
+    c.stateMask   = stateMask;
+    c.minInterval = minInterval;
+
+    c.gen         = m_uas != NULL ? m_uas->state_gen_mask(stateMask) : 0;
+    c.dirty       = 1;
+    c.tmRunUs     = 0;
+
+    memset(&c.stats, 0, sizeof(c.stats));
+
+    m_clients.push_back(c);
+    schedule(0);
+
+    return m_clients.size() - 1;
+}
+
+void RenderScheduler::invalidate(int stateMask)
+{
+    for(int i=0; i<m_clients.size(); i++)
+        if( m_clients[i].stateMask & stateMask ) m_clients[i].dirty = 1;
+
+    schedule(0);
+}
+
+void RenderScheduler::wake(void)
+{
+    // only the first change after a frame posts an event
+    if( m_pending.testAndSetOrdered(0, 1) )
+        QMetaObject::invokeMethod(this, "wake_slot", Qt::QueuedConnection);
+}
+
+void RenderScheduler::wake_slot(void)
+{
+    m_stats.wakeups ++;
+    schedule(0);
+}
+
+void RenderScheduler::schedule(uint64_t tmDue)
+{
+    uint64_t    tmNow = tm_get_us();
+    uint64_t    tmNext = m_tmFrameUs + (uint64_t)(m_frameInterval*1000.0);
+    int         delay;
+
+    m_pending = 1;
+
+    if( tmDue > tmNext ) tmNext = tmDue;
+    delay = tmNext > tmNow ? (tmNext - tmNow + 999) / 1000 : 0;
+
+    if( !m_timer.isActive() || m_timer.remainingTime() > delay )
+        m_timer.start(delay);
+}
+
+void RenderScheduler::frame_slot(void)
+{
+    RTK_TRACE_ZONE("RenderScheduler::frame");
+
+    uint64_t    tmNow = tm_get_us(), t0, t1;
+    uint64_t    tmDue = 0;
+    int         nRun = 0;
+
+    // changes from now on need another frame
+    m_pending = 0;
+
+    if( m_tmFrameUs > 0 ) {
+        double dt = (tmNow - m_tmFrameUs) / 1000.0;
+
+        if( m_stats.intervalAvg <= 0 ) m_stats.intervalAvg = dt;
+        else                           m_stats.intervalAvg = 0.9*m_stats.intervalAvg + 0.1*dt;
+    }
+    m_tmFrameUs = tmNow;
+
+    for(int i=0; i<m_clients.size(); i++) {
+        Client      &c = m_clients[i];
+        uint32_t    gen = m_uas != NULL ? m_uas->state_gen_mask(c.stateMask) : c.gen;
+
+        if( gen == c.gen && !c.dirty ) continue;
+
+        // update budget of the client
+        uint64_t tmNext = c.tmRunUs + (uint64_t) c.minInterval*1000;
+        if( c.tmRunUs > 0 && tmNext > tmNow ) {
+            if( tmDue == 0 || tmNext < tmDue ) tmDue = tmNext;
+            continue;
+        }
+
+        // frame budget used up, update it at the next frame
+        if( nRun > 0 && tm_get_us() - tmNow > (uint64_t) m_frameBudget ) {
+            c.stats.deferred ++;
+            if( tmDue == 0 || tmNow < tmDue ) tmDue = tmNow;
+            continue;
+        }
+
+        c.gen   = gen;
+        c.dirty = 0;
+        c.tmRunUs = tmNow;
+
+        t0 = tm_get_us();
+        QMetaObject::invokeMethod(c.obj, c.member, Qt::DirectConnection);
+        t1 = tm_get_us();
+
+        c.stats.runs ++;
+        c.stats.tmLast   = t1 - t0;
+        c.stats.tmTotal += t1 - t0;
+        if( t1 - t0 > c.stats.tmMax ) c.stats.tmMax = t1 - t0;
+
+        nRun ++;
+    }
+
+    // frame statistics
+    t1 = tm_get_us() - tmNow;
+
+    m_stats.frames ++;
+    m_stats.tmLast   = t1;
+    m_stats.tmTotal += t1;
+    if( t1 > m_stats.tmMax ) m_stats.tmMax = t1;
+    if( t1 > (uint64_t) m_frameBudget ) m_stats.overBudget ++;
+
+    // clients waiting for their budget or deferred
+    if( tmDue > 0 ) schedule(tmDue);
+}
+
+void RenderScheduler::clearStats(void)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    for(int i=0; i<m_clients.size(); i++)
+        memset(&m_clients[i].stats, 0, sizeof(RenderClientStats));
+}
+
+void RenderScheduler::printStats(void)
+{
+    dbg_pi("render: wakeups = %lld, frames = %lld, over budget = %lld, "
+           "frame avg/max = %.1f/%lld us, interval = %.2f ms\n",
+           (long long) m_stats.wakeups, (long long) m_stats.frames,
+           (long long) m_stats.overBudget,
+           m_stats.frames > 0 ? 1.0*m_stats.tmTotal/m_stats.frames : 0.0,
+           (long long) m_stats.tmMax, m_stats.intervalAvg);
+
+    for(int i=0; i<m_clients.size(); i++) {
+        RenderClientStats &s = m_clients[i].stats;
+
+        dbg_pi("  %-12s runs = %8lld, deferred = %6lld, avg/max = %8.1f/%6lld us\n",
+               m_clients[i].name, (long long) s.runs, (long long) s.deferred,
+               s.runs > 0 ? 1.0*s.tmTotal/s.runs : 0.0, (long long) s.tmMax);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// scheduler test: simulated telemetry, then link lost
+////////////////////////////////////////////////////////////////////////////////
+
+class SimTelemetryThread : public RThread
+{
+public:
+    SimTelemetryThread() {
+        m_uas = NULL;
+        m_duration = 2000;
+    }
+    virtual ~SimTelemetryThread() {}
+
+    virtual int thread_func(void *arg=NULL) {
+        uint64_t    t0 = tm_get_ms();
+        int         i = 0;
+
+        // ATTITUDE at 200 Hz, position at 10 Hz, status at 2 Hz
+        while( m_isAlive && tm_get_ms() - t0 < (uint64_t) m_duration ) {
+            m_uas->state_changed(UAS_STATE_ATT);
+            if( i % 20  == 0 ) m_uas->state_changed(UAS_STATE_POS);
+            if( i % 100 == 0 ) m_uas->state_changed(UAS_STATE_STATUS);
+
+            i ++;
+            tm_sleep(5);
+        }
+
+        return 0;
+    }
+
+    UAS     *m_uas;
+    int     m_duration;
+};
+
+static void run_event_loop(int ms)
+{
+    QEventLoop  loop;
+
+    QTimer::singleShot(ms, &loop, SLOT(quit()));
+    loop.exec();
+}
+
+int test_render_scheduler(CParamArray *pa)
+{
+    int         argc;
+    char**      argv;
+    int         duration = 2000;
+    clock_t     c0, c1, c2;
+    uint64_t    framesActive, framesIdle;
+
+    argc = pa->i("argc");
+    argv = (char**) pa->p("argv");
+    pa->i("duration", duration);
+
+    QApplication app(argc, argv);
+
+    UAS                 uas;
+    RenderScheduler     sched;
+    QADI                adi;
+    QCompass            compass;
+    QTelemetryListView  list;
+
+    uas.bind_telemetry(list.telemetryModel());
+
+    sched.setUAS(&uas);
+    sched.addClient("ADI",     &adi,     "canvasReplot_slot", UAS_STATE_MASK(UAS_STATE_ATT));
+    sched.addClient("Compass", &compass, "canvasReplot_slot",
+                    UAS_STATE_MASK(UAS_STATE_ATT) | UAS_STATE_MASK(UAS_STATE_POS), 33);
+    sched.addClient("InfoList", list.telemetryModel(), "update",
+                    UAS_STATE_MASK(UAS_STATE_POS) | UAS_STATE_MASK(UAS_STATE_STATUS), 100);
+
+    // initial frame
+    run_event_loop(100);
+    sched.clearStats();
+
+    // link connected
+    SimTelemetryThread  sim;
+    sim.m_uas      = &uas;
+    sim.m_duration = duration;
+
+    c0 = clock();
+    sim.start();
+    run_event_loop(duration);
+    sim.setAlive(0);
+    sim.wait();
+
+    c1 = clock();
+    framesActive = sched.frameStats().frames;
+    sched.printStats();
+
+    // link lost: no frame should run
+    run_event_loop(duration);
+
+    c2 = clock();
+    framesIdle = sched.frameStats().frames - framesActive;
+
+    printf("active: %lld frames in %d ms (frame interval %.2f ms), CPU %.1f%%\n",
+           (long long) framesActive, duration, sched.frameInterval(),
+           100.0*(c1-c0)/CLOCKS_PER_SEC/(duration/1000.0));
+    printf("idle  : %lld frames in %d ms, CPU %.1f%%\n",
+           (long long) framesIdle, duration,
+           100.0*(c2-c1)/CLOCKS_PER_SEC/(duration/1000.0));
+
+    return framesIdle <= 1 ? 0 : 1;
+}
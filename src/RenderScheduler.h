@@ -0,0 +1,165 @@
+#ifndef __RENDERSCHEDULER_H__
+#define __RENDERSCHEDULER_H__
+
+#include <stdint.h>
+
+#include <QtCore>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+#include <QAtomicInt>
+
+#include "UAS.h"
+
+
+///
+/// \brief Per-client render statistics
+///
+struct RenderClientStats
+{
+    uint64_t    runs;                       ///< number of updates
+    uint64_t    deferred;                   ///< updates moved to a later frame
+    uint64_t    tmTotal;                    ///< total update time (us)
+    uint64_t    tmMax;                      ///< max update time (us)
+    uint64_t    tmLast;                     ///< last update time (us)
+};
+
+///
+/// \brief Per-frame render statistics
+///
+struct RenderFrameStats
+{
+    uint64_t    wakeups;                    ///< wake-ups from the UAS side
+    uint64_t    frames;                     ///< frames run
+    uint64_t    overBudget;                 ///< frames exceeding the frame budget
+    uint64_t    tmTotal;                    ///< total frame time (us)
+    uint64_t    tmMax;                      ///< max frame time (us)
+    uint64_t    tmLast;                     ///< last frame time (us)
+    double      intervalAvg;                ///< average frame interval (ms, EWMA)
+};
+
+
+///
+/// \brief Render scheduler driven by UAS state generations
+///
+///     Each client (a slot of a widget) depends on some UAS state groups.
+///     When the receiving thread changes a group the scheduler is woken
+///     once and runs a frame at the next display refresh; only clients whose
+///     groups changed are updated, each one at most every minInterval ms.
+///     Clients after the frame budget is used up are moved to the next frame.
+///     Without new telemetry nothing is scheduled, no timer runs.
+///
+class RenderScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RenderScheduler(QObject *parent = 0);
+    virtual ~RenderScheduler();
+
+    ///
+    /// \brief Set the UAS whose state generations drive the frames (can be NULL)
+    ///
+    void setUAS(UAS *u);
+
+    ///
+    /// \brief Add a client
+    ///
+    /// \param name         - client name (for statistics)
+    /// \param obj, member  - slot called to update the client, e.g. "render_ADI"
+    /// \param stateMask    - UAS state groups the client depends on (UAS_STATE_MASK)
+    /// \param minInterval  - update budget, minimum interval between updates (ms)
+    ///
+    /// \return client id
+    ///
+    int addClient(const char *name, QObject *obj, const char *member,
+                  int stateMask, int minInterval = 0);
+
+    ///
+    /// \brief Force the clients in stateMask to update at the next frame (GUI thread)
+    ///
+    void invalidate(int stateMask = UAS_STATE_ALL);
+
+    ///
+    /// \brief Request a frame (thread safe, coalesced until the frame runs)
+    ///
+    void wake(void);
+
+    ///
+    /// \brief Frame interval, default is the refresh interval of the primary screen (ms)
+    ///
+    void   setFrameInterval(double ms) { m_frameInterval = ms; }
+    double frameInterval(void) { return m_frameInterval; }
+
+    ///
+    /// \brief Time budget of one frame (us)
+    ///
+    void setFrameBudget(int us) { m_frameBudget = us; }
+    int  frameBudget(void) { return m_frameBudget; }
+
+    ///
+    /// \brief Frame & client statistics
+    ///
+    const RenderFrameStats& frameStats(void) { return m_stats; }
+    int clientNum(void) { return m_clients.size(); }
+
+    ///
+    /// \brief UAS state groups of all clients (what the UI shows)
+    ///
+    int stateMask(void) {
+        int m = 0;
+        for(int i=0; i<m_clients.size(); i++) m |= m_clients[i].stateMask;
+        return m;
+    }
+    const char* clientName(int id) { return m_clients[id].name; }
+    const RenderClientStats& clientStats(int id) { return m_clients[id].stats; }
+    void clearStats(void);
+
+    ///
+    /// \brief Print statistics with dbg_pi
+    ///
+    void printStats(void);
+
+protected slots:
+    void wake_slot(void);
+    void frame_slot(void);
+
+protected:
+    struct Client
+    {
+        const char          *name;
+        QObject             *obj;
+        const char          *member;
+        int                 stateMask;
+        int                 minInterval;
+
+        uint32_t            gen;            ///< generation at the last update
+        int                 dirty;          ///< forced update
+        uint64_t            tmRunUs;        ///< time of the last update (us, tm_get_us)
+
+        RenderClientStats   stats;
+    };
+
+    void schedule(uint64_t tmDue);          ///< tmDue: tm_get_us time
+
+    UAS                 *m_uas;
+    QVector<Client>     m_clients;
+
+    QTimer              m_timer;            ///< single-shot frame timer
+    QAtomicInt          m_pending;          ///< a frame is requested/scheduled
+    uint64_t            m_tmFrameUs;        ///< time of the last frame (us, tm_get_us)
+
+    double              m_frameInterval;    ///< frame interval (ms)
+    int                 m_frameBudget;      ///< time budget of one frame (us)
+
+    RenderFrameStats    m_stats;
+};
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_render_scheduler(rtk::CParamArray *pa);
+
+#endif // end of __RENDERSCHEDULER_H__
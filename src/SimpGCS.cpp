@@ -26,6 +26,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
+#include <poll.h>
 
 #include <string>
 #include <set>
@@ -35,10 +37,25 @@
 
 #include <rtk_utils.h>
 #include <rtk_paramarray.h>
+#include <rtk_paramregistry.h>
 #include <rtk_debug.h>
+#include <rtk_binlog.h>
+#include <rtk_trace.h>
 #include <rtk_osa++.h>
 
 #include "utils_UART.h"
+#include "utils_mavlink.h"
+#include "utils_filter.h"
+#include "utils_format.h"
+#include "utils_geodesy.h"
+#include "TelemetryRelay.h"
+#include "TelemetryShm.h"
+#include "MissionTransfer.h"
+#include "ParamManager.h"
+#include "StreamRate.h"
+#include "LinkStats.h"
+#include "MsgProfiler.h"
+#include "GeoFence.h"
 #include "GCS_MainWindow.h"
 
 using namespace std;
@@ -54,36 +71,76 @@ public:
     MAVLINK_ReadThread() {
         m_UAS = NULL;
         m_uart = NULL;
+        m_tlog = NULL;
+        m_fwd = NULL;
     }
     virtual ~MAVLINK_ReadThread() {}
 
     virtual int thread_func(void *arg=NULL) {
-        unsigned char       ub;
-        int                 ret;
+        uint8_t             rbuf[512];
+        int                 ret, i;
+        uint64_t            tNow;
         mavlink_message_t   msg;
-        mavlink_status_t    status;
+
+        MavlinkFrameScanner frameScanner;
+        mavlink_frame_spans frames;
 
         uint8_t             buff[1024];
         int                 buff_len;
 
+        RTK_TRACE_THREAD("mavlink_read");
+
         while( m_isAlive ) {
-            // read a char
-            ret = m_uart->read(&ub, 1);
-            if( ret < 0 ) goto THREAD_MAVLINK_WRITE;
+            // read available bytes (at least one)
+            ret = m_uart->read(rbuf, sizeof(rbuf));
+            if( ret <= 0 ) goto THREAD_MAVLINK_WRITE;
+
+            // find all complete frames in the block
+            frameScanner.push(rbuf, ret, frames);
+            tNow = tm_get_us();
+
+            m_UAS->link_stats()->scanStats(frameScanner.stats);
+
+            for(i=0; i<frames.size(); i++) {
+                // record every frame as received
+                if( m_tlog != NULL ) m_tlog->write(frames[i].p, frames[i].len, tNow);
+
+                // drop frames failing the signature check (if a key is set)
+                if( 0 != mavlink_frame_check_signature(frames[i], &m_UAS->signing) ) {
+                    m_UAS->link_stats()->rejected();
+                    continue;
+                }
 
-            // parse received data
-            if( mavlink_parse_char(MAVLINK_COMM_0, ub, &msg, &status) ) {
+                m_UAS->link_stats()->frame(frames[i], tNow);
+                m_UAS->msg_profiler()->frame(frames[i], tNow);
+
+                // forward accepted frames
+                if( m_fwd != NULL ) m_fwd->send(frames[i].p, frames[i].len);
+
+                // publish accepted frames for local consumers
+                if( m_UAS->shm() != NULL )
+                    m_UAS->shm()->publishPacket(frames[i].p, frames[i].len, tNow);
+
+                // msgids of other dialects are only counted (sequence numbers),
+                //  msgid >= 256 (MAVLink 2 only) can not be handled
+                if( !mavlink_frame_known(frames[i]) ) continue;
+                if( 0 != mavlink_frame_to_msg(frames[i], &msg) ) continue;
 
                 //printf("sysid = %3d, compid = %3d, msgid = %3d, len = %3d, seq = %3d\n",
                 //       msg.sysid, msg.compid, msg.msgid, msg.len, msg.seq);
 
+                RTK_TRACE_ZONE("UAS::parse_mavlink_msg");
                 m_UAS->parse_mavlink_msg(msg);
             }
 
 THREAD_MAVLINK_WRITE:
             // write message
+            buff_len = sizeof(buff);
             m_UAS->get_msg_buff(buff, &buff_len);
-            if( buff_len > 0 ) m_uart->write(buff, buff_len);
+            if( buff_len > 0 ) {
+                RTK_TRACE_ZONE("UART::write");
+                m_uart->write(buff, buff_len);
+            }
         }
 
         return 0;
@@ -92,9 +149,160 @@ THREAD_MAVLINK_WRITE:
 public:
     UAS                 *m_UAS;
     UART                *m_uart;
+    TLogWriter          *m_tlog;                ///< record received frames (optional)
+    UDPForwarder        *m_fwd;                 ///< forward accepted frames (optional)
 };
 
 
+///
+/// \brief Serves the forwarding peer (commands back to the UAV) & the state socket
+///
+class Relay_Thread : public RThread
+{
+public:
+    Relay_Thread() {
+        m_UAS = NULL;
+        m_fwd = NULL;
+        m_state = NULL;
+    }
+    virtual ~Relay_Thread() {}
+
+    virtual int thread_func(void *arg=NULL) {
+        struct pollfd       fds[2];
+        int                 nfds;
+        uint8_t             buf[2048];
+        int                 len;
+
+        RTK_TRACE_THREAD("relay");
+
+        while( m_isAlive ) {
+            nfds = 0;
+            if( m_fwd != NULL )   { fds[nfds].fd = m_fwd->fd();   fds[nfds].events = POLLIN; nfds++; }
+            if( m_state != NULL ) { fds[nfds].fd = m_state->fd(); fds[nfds].events = POLLIN; nfds++; }
+
+            if( poll(fds, nfds, 100) <= 0 ) continue;
+
+            // the peer GCS talks to the UAV through us
+            if( m_fwd != NULL ) {
+                while( (len = m_fwd->recv(buf, sizeof(buf))) > 0 )
+                    m_UAS->put_msg_buff(buf, len);
+            }
+
+            if( m_state != NULL ) m_state->serve();
+        }
+
+        return 0;
+    }
+
+public:
+    UAS                 *m_UAS;
+    UDPForwarder        *m_fwd;
+    StateServer         *m_state;
+};
+
+static int uas_state_snapshot(void *obj, char *buf, int len)
+{
+    return ((UAS*) obj)->state_json(buf, len);
+}
+
+
+static volatile int g_headlessQuit = 0;
+static ru64         g_tmStart = 0;              ///< process start (ms)
+
+static void headless_signal(int sig)
+{
+    g_headlessQuit = 1;
+}
+
+///
+/// \brief Run without any widget until SIGINT/SIGTERM
+///
+///     fn_mission_up: mission file uploaded once the link is up,
+///     fn_mission_down: the vehicle mission is saved to it
+///
+static int FastGCS_headless(UAS &uas, TLogWriter &tlog, UDPForwarder &fwd,
+                            const string &fn_mission_up, const string &fn_mission_down,
+                            const string &fn_msgprof, int msgprof_window)
+{
+    ru64            tmLast = tm_get_ms();
+    MissionItems    items;
+    int             missionStep = 0;            // 0: upload, 1: download, 2: done
+    int             missionStarted = 0;
+    int             paramReady = 0;
+
+    signal(SIGINT,  headless_signal);
+    signal(SIGTERM, headless_signal);
+
+    if( fn_mission_up.size() == 0 ) missionStep = 1;
+    else if( 0 != mission_load_wpl(fn_mission_up, items) ) missionStep = 1;
+    if( missionStep == 1 && fn_mission_down.size() == 0 ) missionStep = 2;
+
+    while( !g_headlessQuit ) {
+        tm_sleep(100);
+
+        // parameters (started by the UAS when the link comes up)
+        ParamManager *pm = uas.params();
+        if( pm->ready() != paramReady ) {
+            paramReady = pm->ready();
+            if( paramReady ) {
+                int n, total;
+                pm->progress(&n, &total);
+                printf("parameters: %d, ready in %.2f s, from cache %d\n",
+                       total, pm->m_tmReadyUs * 1e-6, pm->m_fromCache);
+                fflush(stdout);
+            }
+        }
+
+        // mission transfer, one after the other
+        MissionTransfer *mt = uas.mission();
+        if( missionStep < 2 && uas.link_connected() && !mt->busy() ) {
+            if( !missionStarted ) {
+                if( missionStep == 0 ) uas.mission_upload(items);
+                else                   uas.mission_download();
+                missionStarted = 1;
+            } else if( missionStep == 0 ) {
+                printf("mission upload: %d items, result %d, %.1f s, %d retx\n",
+                       (int) items.size(), mt->result(), mt->m_tmTransferUs * 1e-6, mt->m_nRetx);
+                missionStep = fn_mission_down.size() > 0 ? 1 : 2;
+                missionStarted = 0;
+            } else {
+                mt->items(items);
+                printf("mission download: %d items, result %d, %.1f s, %d retx\n",
+                       (int) items.size(), mt->result(), mt->m_tmTransferUs * 1e-6, mt->m_nRetx);
+                if( mt->result() == MT_OK ) mission_save_wpl(fn_mission_down, items);
+                missionStep = 2;
+            }
+            fflush(stdout);
+        }
+
+        // one status line every 10 s
+        if( tm_get_ms() - tmLast >= 10000 ) {
+            tmLast = tm_get_ms();
+
+            LinkStatsSnapshot ls;
+            uas.link_stats()->lastSnapshot(ls);
+
+            printf("link = %d, %.0f B/s, lost %.1f%%, crc %llu, unknown msgid %llu, rtt %.0f ms, "
+                   "alt = %.1f, batt = %.2f V, "
+                   "streams = %.0f B/s, tlog = %llu frames, fwd = %llu/%llu bytes, RSS = %ld KB\n",
+                   uas.link_connected(), ls.bps, ls.lossPct, (unsigned long long) ls.crcErrors,
+                   (unsigned long long) ls.unknown, ls.rttMs,
+                   uas.gpAlt, uas.battVolt, uas.stream_rate()->load(),
+                   (unsigned long long) tlog.frames(),
+                   (unsigned long long) fwd.sentBytes(), (unsigned long long) fwd.recvBytes(),
+                   proc_rss_kb());
+            fflush(stdout);
+
+            // message bandwidth table, rewritten with the status line
+            if( fn_msgprof.size() > 0 )
+                uas.msg_profiler()->saveCSV(fn_msgprof, msgprof_window, 1, tm_get_us());
+        }
+    }
+
+    return 0;
+}
+
+
 int FastGCS(CParamArray *pa)
 {
     int     argc;
@@ -104,11 +312,36 @@ int FastGCS(CParamArray *pa)
     string  port;
     int     baud = 115200;
     string  fn_conf = "./data/FastGCS_conf.ini";
+    string  fn_blog = "";
+    string  fn_trace = "";
+    string  mavlink_key = "";
+    int     headless = 0;
+    string  fn_tlog = "";
+    string  fwd_udp = "";
+    int     fwd_port = 0;
+    string  fwd_bind = "127.0.0.1";
+    int     fwd_uplink = 0;
+    string  state_sock = "";
+    string  shm_name = "";
+    int     shm_slots = 1024;
+    string  fn_mission_up = "";
+    string  fn_mission_down = "";
+    string  param_cache_dir = "./data/params";
+    string  fn_msgprof = "";
+    int     msgprof_window = 10;
+    string  fn_fence = "";
 
     UART    uart;
     UAS     uas;
 
+    TLogWriter      tlog;
+    UDPForwarder    fwd;
+    StateServer     state;
+    TelemetryShm    shm;
+    GeoFenceEngine  fence;
+
     MAVLINK_ReadThread     mavlink_rt;
+    Relay_Thread           relay_rt;
 
     // parse input arguments
     argc = pa->i("argc");
@@ -121,6 +354,62 @@ int FastGCS(CParamArray *pa)
 
     pa->s("fn_conf", fn_conf);
 
+    // load registered tunables from arguments
+    pr_get()->from_pa(*pa);
+
+    // binary log file (decode it by test_rtk_binlog -act test_binlog_decode)
+    pa->s("fn_blog", fn_blog);
+    if( fn_blog.size() > 0 ) blog_open(fn_blog);
+
+    // zone trace file (only recorded if built with RTK_TRACE)
+    pa->s("fn_trace", fn_trace);
+    if( fn_trace.size() > 0 ) {
+        trace_start();
+        RTK_TRACE_THREAD("main");
+    }
+
+    // MAVLink 2 signing passphrase
+    pa->s("mavlink_key", mavlink_key);
+    if( mavlink_key.size() > 0 ) uas.setSigningKey(mavlink_key);
+
+    // headless: no Qt GUI, state is served on a local socket
+    pa->i("headless", headless);
+    if( headless ) state_sock = "/tmp/SimpGCS.sock";
+    pa->s("state_sock", state_sock);
+    pa->s("fn_mission_up", fn_mission_up);
+    pa->s("fn_mission_down", fn_mission_down);
+    pa->s("param_cache_dir", param_cache_dir);
+    uas.params()->setCacheDir(param_cache_dir);
+    pa->s("msgprof_csv", fn_msgprof);
+    pa->i("msgprof_window", msgprof_window);
+
+    // geofences & terrain clearance of all vehicles
+    pa->s("fn_fence", fn_fence);
+    if( fn_fence.size() > 0 && 0 == fence.load(fn_fence) ) uas.set_geofence(&fence);
+
+    // recording & forwarding
+    pa->s("fn_tlog", fn_tlog);
+    if( fn_tlog.size() > 0 && 0 == tlog.open(fn_tlog) ) mavlink_rt.m_tlog = &tlog;
+
+    pa->s("fwd_udp", fwd_udp);
+    pa->i("fwd_port", fwd_port);
+    pa->s("fwd_bind", fwd_bind);
+    pa->i("fwd_uplink", fwd_uplink);
+    if( fwd_udp.size() > 0 && 0 == fwd.open(fwd_udp, fwd_port, fwd_bind) ) {
+        mavlink_rt.m_fwd = &fwd;
+
+        // the peer's datagrams go to the UAV as they are (no signing)
+        if( fwd_uplink ) relay_rt.m_fwd = &fwd;
+    }
+
+    if( state_sock.size() > 0 && 0 == state.open(state_sock, uas_state_snapshot, &uas) )
+        relay_rt.m_state = &state;
+
+    // shared-memory publication
+    pa->s("shm_name", shm_name);
+    pa->i("shm_slots", shm_slots);
+    if( shm_name.size() > 0 && 0 == shm.open(shm_name, shm_slots) ) uas.set_shm(&shm);
+
     // open UART port
     strcpy(uart.port_name, port.c_str());
     uart.baud_rate = baud;
@@ -130,35 +419,72 @@ int FastGCS(CParamArray *pa)
         return -1;
     }
 
-    // begin Qt
-    QApplication app(argc, argv);
-
-    // create setting object
-    QSettings *conf = new QSettings(QString::fromStdString(fn_conf), QSettings::IniFormat);
-    pa->set_p("settings", conf);
-
-    // create main window
-    GCS_MainWindow gcs(NULL);
-
     // start mavlink reader thread
     mavlink_rt.m_uart = &uart;
     mavlink_rt.m_UAS = &uas;
     uas.beginRecv();
     mavlink_rt.start();
 
-    // load mesh & show
-    gcs.setActiveUAS(&uas);
-    gcs.show();
+    relay_rt.m_UAS = &uas;
+    if( relay_rt.m_fwd != NULL || relay_rt.m_state != NULL ) relay_rt.start();
+
+    if( headless ) {
+        dbg_pi("headless: startup %d ms, RSS %ld KB, state socket: %s\n",
+               (int) (tm_get_ms() - g_tmStart), proc_rss_kb(), state_sock.c_str());
+
+        FastGCS_headless(uas, tlog, fwd, fn_mission_up, fn_mission_down,
+                         fn_msgprof, msgprof_window);
+    } else {
+        // begin Qt
+        QApplication app(argc, argv);
+
+        // create setting object
+        QSettings *conf = new QSettings(QString::fromStdString(fn_conf), QSettings::IniFormat);
+        pa->set_p("settings", conf);
+
+        // create main window
+        GCS_MainWindow gcs(NULL);
+
+        // load mesh & show
+        gcs.setActiveUAS(&uas);
+        gcs.show();
+        app.processEvents();
+
+        dbg_pi("GUI: startup %d ms, RSS %ld KB\n",
+               (int) (tm_get_ms() - g_tmStart), proc_rss_kb());
 
-    // begin Qt thread
-    app.exec();
+        // begin Qt thread
+        app.exec();
+    }
+
+    // close relay & mavlink reading thread
+    if( relay_rt.m_fwd != NULL || relay_rt.m_state != NULL ) {
+        relay_rt.setAlive(0);
+        relay_rt.wait(200);
+        relay_rt.kill();
+    }
 
-    // close mavlink reading thread
     uas.stopRecv();
     mavlink_rt.setAlive(0);
     mavlink_rt.wait(20);
     mavlink_rt.kill();
 
+    tlog.close();
+    fwd.close();
+    state.close();
+
+    uas.set_shm(NULL);
+    shm.close();
+
+    uas.set_geofence(NULL);
+
+    if( fn_blog.size() > 0 ) blog_close();
+
+    if( fn_trace.size() > 0 ) {
+        trace_stop();
+        trace_save_json(fn_trace);
+    }
+
     return 0;
 }
 
@@ -169,6 +495,32 @@ int FastGCS(CParamArray *pa)
 struct RTK_TestFunctionArray g_fa[] =
 {
     RTK_FUNC_TEST_DEF(FastGCS,                  "FastGCS"),
+    RTK_FUNC_TEST_DEF(test_mavlink_scan,        "Test MAVLink frame scanner against mavlink_parse_char"),
+    RTK_FUNC_TEST_DEF(test_mavlink_scan_bench,  "Benchmark MAVLink frame scanner"),
+    RTK_FUNC_TEST_DEF(test_mavlink_v2,          "Test MAVLink 2 framing & signing"),
+    RTK_FUNC_TEST_DEF(test_mavlink_v2_bench,    "Compare MAVLink 1/2 bytes & parse cost (-fn capture)"),
+    RTK_FUNC_TEST_DEF(test_filters,             "Test streaming filters against brute force"),
+    RTK_FUNC_TEST_DEF(test_filters_bench,       "Benchmark streaming filters against window sums"),
+    RTK_FUNC_TEST_DEF(test_trail_bench,         "Benchmark map trail redraw against trail length"),
+    RTK_FUNC_TEST_DEF(test_map_gl_bench,        "Benchmark map tiles, QPainter vs GL compositor (1080p/4K)"),
+    RTK_FUNC_TEST_DEF(test_projection_bench,    "Test & benchmark batched lat/lng to pixel projection"),
+    RTK_FUNC_TEST_DEF(test_tilematrix_stress,   "Stress tile matrix: loader threads while dragging the view"),
+    RTK_FUNC_TEST_DEF(test_overlay_index_bench, "Test & benchmark overlay spatial index (100k points)"),
+    RTK_FUNC_TEST_DEF(test_telemetry_bench,     "Benchmark info list update, ListMap vs bound fields"),
+    RTK_FUNC_TEST_DEF(test_listmap_alloc,       "Count operator new per gen_listmap_important frame"),
+    RTK_FUNC_TEST_DEF(test_uas_shm_link,        "Shared-memory link state drops after a timeout"),
+    RTK_FUNC_TEST_DEF(test_format,              "Test fixed-buffer formatting against snprintf"),
+    RTK_FUNC_TEST_DEF(test_relay,               "Test tlog writer, UDP forwarding & state socket"),
+    RTK_FUNC_TEST_DEF(test_shm,                 "Test shared-memory telemetry & reader latency"),
+    RTK_FUNC_TEST_DEF(test_mission,             "Benchmark mission upload/download on a simulated lossy link"),
+    RTK_FUNC_TEST_DEF(test_params,              "Test parameter cache & benchmark download on a lossy link"),
+    RTK_FUNC_TEST_DEF(test_stream_rate,         "Test stream rate controller on a simulated congested radio"),
+    RTK_FUNC_TEST_DEF(test_link_stats,          "Test link statistics: gaps, CRC errors, jitter, concurrent readers"),
+    RTK_FUNC_TEST_DEF(test_msg_profiler,        "Test message bandwidth windows & benchmark on a replay (-fn capture)"),
+    RTK_FUNC_TEST_DEF(test_geodesy,             "Test & benchmark WGS-84 geodesy: Vincenty, haversine, ENU frame"),
+    RTK_FUNC_TEST_DEF(test_geofence,            "Test geofence alerts & benchmark 50 vehicles x 10 Hz, 1000-vertex fences"),
+    RTK_FUNC_TEST_DEF(test_instruments_bench,   "Benchmark QADI/QCompass painting with/without layer cache"),
+    RTK_FUNC_TEST_DEF(test_render_scheduler,    "Test render scheduler frames with/without telemetry"),
 
     {NULL,  "NULL",  "NULL"},
 };
@@ -180,6 +532,8 @@ int main(int argc, char *argv[])
     CParamArray *pa;
     int         ret;
 
+    g_tmStart = tm_get_ms();
+
     // setup debug trace
     dbg_stacktrace_setup();
 
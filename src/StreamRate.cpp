@@ -0,0 +1,431 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <deque>
+#include <algorithm>
+
+#include <rtk_utils.h>
+#include <rtk_debug.h>
+#include <rtk_paramarray.h>
+
+#include "StreamRate.h"
+#include "utils_mavlink.h"
+
+using namespace rtk;
+
+
+StreamRateController::StreamRateController()
+{
+    m_txbufLow  = 40;
+    m_txbufHigh = 80;
+    m_lossHigh  = 0.15;
+    m_cut       = 0.7;
+
+    m_budget    = 0;
+    m_hold      = 0;
+
+    m_nCut      = 0;
+    m_nGrow     = 0;
+}
+
+StreamRateController::~StreamRateController()
+{
+}
+
+int StreamRateController::addStream(int id, int rateNominal, int rateMin, int prio, int bytes)
+{
+    StreamConf s;
+
+    s.id          = id;
+    s.rateNominal = rateNominal;
+    s.rateMin     = std::min(rateMin, rateNominal);
+    s.prio        = prio;
+    s.bytes       = bytes;
+    s.wanted      = 1;
+
+    m_streams.push_back(s);
+    m_rate.push_back(rateNominal);
+    m_budget = budgetNominal();
+
+    return m_streams.size() - 1;
+}
+
+void StreamRateController::setWanted(int idx, int wanted)
+{
+    if( idx < 0 || idx >= m_streams.size() ) return;
+
+    m_streams[idx].wanted = wanted;
+    m_budget = std::min(m_budget, budgetNominal());
+    allocate();
+}
+
+void StreamRateController::setControl(int txbufLow, int txbufHigh, double lossHigh, double cut)
+{
+    m_txbufLow  = txbufLow;
+    m_txbufHigh = txbufHigh;
+    m_lossHigh  = lossHigh;
+    m_cut       = cut;
+}
+
+void StreamRateController::reset(void)
+{
+    m_budget = budgetNominal();
+    m_hold   = 0;
+    allocate();
+}
+
+double StreamRateController::budgetNominal(void)
+{
+    double b = 0;
+
+    for(size_t i=0; i<m_streams.size(); i++)
+        if( m_streams[i].wanted ) b += m_streams[i].rateNominal * m_streams[i].bytes;
+
+    return b;
+}
+
+double StreamRateController::load(void)
+{
+    double b = 0;
+
+    for(size_t i=0; i<m_streams.size(); i++) b += m_rate[i] * m_streams[i].bytes;
+
+    return b;
+}
+
+int StreamRateController::update(const StreamLinkSample &s)
+{
+    std::vector<int> old = m_rate;
+
+    double bMin = 0, bNom = budgetNominal();
+    for(size_t i=0; i<m_streams.size(); i++)
+        if( m_streams[i].wanted ) bMin += m_streams[i].rateMin * m_streams[i].bytes;
+
+    int     nAll = s.nRecv + s.nLost;
+    double  loss = nAll > 0 ? (double) (s.nLost + s.rxErrors) / nAll : 0;
+    int     full = s.hasRadio && s.txbuf < m_txbufLow;
+
+    if( full || loss > m_lossHigh ) {
+        // cut from what is sent, the budget can be above it by the rounding
+        double f = m_cut;
+        if( s.hasRadio && s.txbuf < m_txbufLow / 2 ) f *= m_cut;
+
+        m_budget = std::max(bMin, std::min(m_budget, load()) * f);
+        m_hold   = 3;
+        m_nCut ++;
+    } else if( m_hold > 0 ) {
+        m_hold --;
+    } else if( (!s.hasRadio || s.txbuf >= m_txbufHigh) && loss < m_lossHigh / 2 &&
+               m_budget < bNom ) {
+        m_budget = std::min(bNom, m_budget + 0.05 * bNom);
+        m_nGrow ++;
+    }
+
+    allocate();
+
+    return m_rate != old;
+}
+
+void StreamRateController::allocate(void)
+{
+    int     pMax = 0;
+    double  rest = m_budget;
+
+    for(size_t i=0; i<m_streams.size(); i++) pMax = std::max(pMax, m_streams[i].prio);
+
+    for(int p=0; p<=pMax; p++) {
+        double bMin = 0, bNom = 0, bLower = 0;
+
+        for(size_t i=0; i<m_streams.size(); i++) {
+            StreamConf &s = m_streams[i];
+            if( !s.wanted ) continue;
+
+            if( s.prio == p ) {
+                bMin += s.rateMin * s.bytes;
+                bNom += s.rateNominal * s.bytes;
+            } else if( s.prio > p ) {
+                bLower += s.rateMin * s.bytes;
+            }
+        }
+
+        // the whole class, or its minimum and the rest scaled over it (the
+        // minimum of the lower classes is kept for them)
+        double avail = rest - bLower, f = 1;
+        if( avail < bNom ) f = bNom > bMin ? std::max(0.0, avail - bMin) / (bNom - bMin) : 0;
+
+        for(size_t i=0; i<m_streams.size(); i++) {
+            StreamConf &s = m_streams[i];
+            if( s.prio != p ) continue;
+
+            if( !s.wanted ) {
+                m_rate[i] = 0;
+                continue;
+            }
+
+            m_rate[i] = s.rateMin + (int) floor((s.rateNominal - s.rateMin) * f + 1e-9);
+            rest -= m_rate[i] * s.bytes;
+        }
+
+        rest = std::max(0.0, rest);
+    }
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// Test: ArduPilot streams over an air radio with a buffer, link capacity
+///     and errors change during the run
+////////////////////////////////////////////////////////////////////////////////
+
+struct SimStream
+{
+    int         id;
+    const char  *name;
+    int         rate, rateMin, prio;
+    int         nMsg;                       ///< messages of one burst
+    int         bytes;                      ///< bytes of one burst (MAVLink 1 frames)
+};
+
+// ArduPilot stream contents (see UAS::init), priorities for the map & instruments
+static SimStream g_simStreams[] = {
+    { MAV_DATA_STREAM_EXTRA1,          "EXTRA1 (attitude)",   10, 2, 0, 1,  36 },
+    { MAV_DATA_STREAM_POSITION,        "POSITION",            10, 2, 0, 2,  72 },
+    { MAV_DATA_STREAM_EXTENDED_STATUS, "EXT_STATUS (GPS)",    10, 1, 1, 5, 150 },
+    { MAV_DATA_STREAM_EXTRA2,          "EXTRA2 (VFR_HUD)",     1, 1, 1, 1,  28 },
+    { MAV_DATA_STREAM_RC_CHANNELS,     "RC_CHANNELS",          5, 0, 2, 2,  80 },
+    { MAV_DATA_STREAM_EXTRA3,          "EXTRA3",               2, 0, 2, 4, 120 },
+    { MAV_DATA_STREAM_RAW_CONTROLLER,  "RAW_CONTROLLER",       2, 0, 2, 1,  30 },
+    { MAV_DATA_STREAM_RAW_SENSORS,     "RAW_SENSORS (IMU)",   10, 0, 3, 3, 108 },
+};
+
+static const int g_simStreamN = sizeof(g_simStreams) / sizeof(g_simStreams[0]);
+
+struct SimPhase
+{
+    const char  *name;
+    int         sec;
+    double      capBps;                     ///< air capacity (bytes/s)
+    double      loss;                       ///< message errors over the air
+};
+
+struct SimStreamResult
+{
+    double      hz[g_simStreamN];           ///< delivered bursts per second
+    double      latPosMs;                   ///< mean buffer delay of POSITION
+    double      lossPct;                    ///< lost messages (overflow & errors)
+    int         rateEnd[g_simStreamN];      ///< requested rates at the end
+};
+
+struct SimBurst
+{
+    int         s, bytes, nMsg;
+    double      t;                          ///< queued
+};
+
+///
+/// \param adapt - 0: fixed nominal rates, 1: controller
+///
+static void sim_stream_run(const SimPhase *phases, int nPhase, int bufBytes, int adapt,
+                           const int *wanted, SimStreamResult *res, StreamRateController *ctl)
+{
+    const double    dt = 0.01;
+    std::deque<SimBurst> buf;
+    int             bufUsed = 0;
+
+    int             rate[g_simStreamN];
+    double          tNext[g_simStreamN];
+
+    for(int i=0; i<g_simStreamN; i++) {
+        ctl->addStream(g_simStreams[i].id, g_simStreams[i].rate, g_simStreams[i].rateMin,
+                       g_simStreams[i].prio, g_simStreams[i].bytes);
+        ctl->setWanted(i, wanted[i]);
+        rate[i]  = adapt ? ctl->rate(i) : (wanted[i] ? g_simStreams[i].rate : 0);
+        tNext[i] = 0;
+    }
+
+    srand(11);
+
+    double  t = 0;
+    for(int ph=0; ph<nPhase; ph++) {
+        const SimPhase  &P = phases[ph];
+        SimStreamResult &R = res[ph];
+
+        int     nDel[g_simStreamN] = {0};
+        double  latSum = 0, drain = 0;
+        int     latN = 0, nMsgAll = 0, nMsgLost = 0;
+
+        for(int sec=0; sec<P.sec; sec++) {
+            StreamLinkSample ls;
+            memset(&ls, 0, sizeof(ls));
+
+            for(int k=0; k<100; k++, t+=dt) {
+                // the autopilot queues the due bursts, the radio drops them if full
+                for(int i=0; i<g_simStreamN; i++) {
+                    if( rate[i] <= 0 || t < tNext[i] ) continue;
+                    tNext[i] = std::max(tNext[i] + 1.0 / rate[i], t);
+
+                    SimBurst b = { i, g_simStreams[i].bytes, g_simStreams[i].nMsg, t };
+                    nMsgAll += b.nMsg;
+                    if( bufUsed + b.bytes > bufBytes ) {
+                        nMsgLost += b.nMsg;
+                        ls.nLost += b.nMsg;
+                        continue;
+                    }
+                    buf.push_back(b);
+                    bufUsed += b.bytes;
+                }
+
+                // the air link drains the buffer, messages can be lost on the way
+                drain += P.capBps * dt;
+                while( !buf.empty() && buf.front().bytes <= drain ) {
+                    SimBurst b = buf.front();
+                    buf.pop_front();
+                    bufUsed -= b.bytes;
+                    drain   -= b.bytes;
+
+                    int nOk = 0;
+                    for(int m=0; m<b.nMsg; m++) {
+                        if( rand() < P.loss * RAND_MAX ) { ls.rxErrors ++; ls.nLost ++; nMsgLost ++; }
+                        else nOk ++;
+                    }
+                    ls.nRecv += nOk;
+                    if( nOk == 0 ) continue;
+
+                    nDel[b.s] ++;
+                    if( g_simStreams[b.s].id == MAV_DATA_STREAM_POSITION ) {
+                        latSum += t + dt - b.t;
+                        latN ++;
+                    }
+                }
+                if( buf.empty() ) drain = 0;
+            }
+
+            // RADIO_STATUS once per second
+            ls.hasRadio = 1;
+            ls.txbuf    = 100 - 100 * bufUsed / bufBytes;
+            ls.rxErrors = 0;                // counted as lost messages above
+
+            if( adapt && ctl->update(ls) )
+                for(int i=0; i<g_simStreamN; i++) rate[i] = ctl->rate(i);
+        }
+
+        for(int i=0; i<g_simStreamN; i++) {
+            R.hz[i]      = (double) nDel[i] / P.sec;
+            R.rateEnd[i] = rate[i];
+        }
+        R.latPosMs = latN > 0 ? latSum / latN * 1000 : 0;
+        R.lossPct  = nMsgAll > 0 ? 100.0 * nMsgLost / nMsgAll : 0;
+    }
+}
+
+int test_stream_rate(CParamArray *pa)
+{
+    int     bufBytes = 2048;
+    int     err = 0;
+
+    pa->i("bufBytes", bufBytes);
+
+    SimPhase phases[] = {
+        { "good link (6 kB/s)",              60, 6000, 0.01 },
+        { "marginal 900 MHz (1.8 kB/s, 5%)", 120, 1800, 0.05 },
+        { "recovered (6 kB/s)",              90, 6000, 0.01 },
+    };
+    int nPhase = sizeof(phases) / sizeof(phases[0]);
+
+    // allocation by priority
+    {
+        StreamRateController c;
+        for(int i=0; i<g_simStreamN; i++)
+            c.addStream(g_simStreams[i].id, g_simStreams[i].rate, g_simStreams[i].rateMin,
+                        g_simStreams[i].prio, g_simStreams[i].bytes);
+
+        StreamLinkSample full;
+        memset(&full, 0, sizeof(full));
+        full.hasRadio = 1;
+        full.txbuf    = 5;
+        full.nRecv    = 100;
+        for(int k=0; k<20; k++) c.update(full);
+
+        for(int i=0; i<g_simStreamN; i++) {
+            if( c.rate(i) != g_simStreams[i].rateMin ) {
+                printf("congested: %s at %d Hz, minimum %d\n",
+                       g_simStreams[i].name, c.rate(i), g_simStreams[i].rateMin);
+                err ++;
+            }
+        }
+
+        StreamLinkSample good = full;
+        good.txbuf = 100;
+        for(int k=0; k<60; k++) c.update(good);
+
+        if( c.load() != c.budgetNominal() ) {
+            printf("not back to nominal: %.0f of %.0f B/s\n", c.load(), c.budgetNominal());
+            err ++;
+        }
+
+        // a stream not shown is stopped
+        c.setWanted(g_simStreamN - 1, 0);
+        if( c.rate(g_simStreamN - 1) != 0 ) { printf("unwanted stream still requested\n"); err ++; }
+    }
+
+    // fixed rates against the controller, all streams / what the map & instruments show
+    int wantAll[g_simStreamN], wantUI[g_simStreamN];
+    for(int i=0; i<g_simStreamN; i++) {
+        wantAll[i] = 1;
+        wantUI[i]  = g_simStreams[i].prio <= 1;
+    }
+
+    struct Mode {
+        const char  *name;
+        int         adapt;
+        int         *wanted;
+    } modes[] = {
+        { "fixed nominal rates",         0, wantAll },
+        { "adaptive, all streams",       1, wantAll },
+        { "adaptive, streams shown",     1, wantUI  },
+    };
+    int nMode = sizeof(modes) / sizeof(modes[0]);
+
+    double bNom = 0;
+    for(int i=0; i<g_simStreamN; i++) bNom += g_simStreams[i].rate * g_simStreams[i].bytes;
+    printf("\nair radio buffer %d bytes, nominal %.0f B/s\n", bufBytes, bNom);
+
+    SimStreamResult res[3][3];
+
+    for(int m=0; m<nMode; m++) {
+        StreamRateController c;
+        sim_stream_run(phases, nPhase, bufBytes, modes[m].adapt, modes[m].wanted, res[m], &c);
+
+        printf("\n%s (%d cuts, %d steps up)\n", modes[m].name, c.m_nCut, c.m_nGrow);
+        for(int ph=0; ph<nPhase; ph++) {
+            SimStreamResult &R = res[m][ph];
+            printf("  %-32s att %5.1f Hz  pos %5.1f Hz  GPS %5.1f Hz  IMU %5.1f Hz  "
+                   "pos delay %6.0f ms  lost %5.1f%%\n",
+                   phases[ph].name, R.hz[0], R.hz[1], R.hz[2], R.hz[7], R.latPosMs, R.lossPct);
+        }
+    }
+
+    // the controller keeps position & attitude on the marginal link, with less delay
+    for(int m=1; m<nMode; m++) {
+        SimStreamResult &F = res[0][1], &A = res[m][1];
+
+        if( A.hz[1] < 0.95 * F.hz[1] || A.hz[0] < 0.95 * F.hz[0] ||
+            A.latPosMs > 0.5 * F.latPosMs || A.lossPct > 0.5 * F.lossPct ) {
+            printf("%s: marginal link not better than fixed rates\n", modes[m].name);
+            err ++;
+        }
+        for(int i=0; i<g_simStreamN; i++) {
+            int r = modes[m].wanted[i] ? g_simStreams[i].rate : 0;
+            if( res[m][nPhase - 1].rateEnd[i] != r ) {
+                printf("%s: %s at %d Hz after recovery\n", modes[m].name,
+                       g_simStreams[i].name, res[m][nPhase - 1].rateEnd[i]);
+                err ++;
+            }
+        }
+    }
+
+    printf("\nerrors = %d\n", err);
+
+    return err;
+}
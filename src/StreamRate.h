@@ -0,0 +1,121 @@
+#ifndef __STREAMRATE_H__
+#define __STREAMRATE_H__
+
+#include <stdint.h>
+
+#include <vector>
+
+
+///
+/// \brief one data stream (MAV_DATA_STREAM) of the autopilot
+///
+struct StreamConf
+{
+    int         id;                     ///< MAV_DATA_STREAM
+    int         rateNominal;            ///< Hz, requested on a good link
+    int         rateMin;                ///< Hz, kept under congestion (0: may stop)
+    int         prio;                   ///< 0 is the most important
+    int         bytes;                  ///< bytes of one burst of the stream (all its messages)
+    int         wanted;                 ///< shown by the UI (0: stopped)
+};
+
+///
+/// \brief link quality of one period, from RADIO_STATUS & the sequence numbers
+///
+struct StreamLinkSample
+{
+    int         hasRadio;               ///< RADIO_STATUS received in the period
+    int         txbuf;                  ///< free tx buffer of the air radio (%)
+    int         rssi, remrssi;
+    int         rxErrors;               ///< radio rx errors in the period
+    int         nRecv, nLost;           ///< frames received / lost (sequence gaps)
+};
+
+
+///
+/// \brief Data stream rates following the link quality
+///
+///     The downlink budget (bytes/s) is adapted once per period: it is cut
+///     by a factor when the air radio buffer fills (RADIO_STATUS txbuf) or
+///     frames are lost (sequence gaps, radio rx errors), and grows by a
+///     small step while the buffer is empty and nothing is lost, up to the
+///     nominal rates. After a cut it is held a few periods, the buffer of
+///     the air radio needs time to drain.
+///
+///     The budget is given to the wanted streams by priority: each class
+///     gets its nominal rates if the budget allows, else the rest of the
+///     budget scaled over its streams, never below their minimum rates.
+///     Lower classes go down to their minimum (0: stopped) first.
+///
+class StreamRateController
+{
+public:
+    StreamRateController();
+    ~StreamRateController();
+
+    ///
+    /// \brief add a stream
+    /// \return stream index
+    ///
+    int addStream(int id, int rateNominal, int rateMin, int prio, int bytes);
+
+    ///
+    /// \brief stream shown by the UI or not (index of addStream)
+    ///
+    void setWanted(int idx, int wanted);
+
+    ///
+    /// \param txbufLow - txbuf (%) below which the budget is cut
+    /// \param txbufHigh - txbuf (%) above which the budget can grow
+    /// \param lossHigh - lost fraction cutting the budget
+    /// \param cut - budget factor of a cut (e.g. 0.7)
+    ///
+    void setControl(int txbufLow, int txbufHigh, double lossHigh, double cut);
+
+    ///
+    /// \brief back to the nominal rates (link lost / reconnected)
+    ///
+    void reset(void);
+
+    ///
+    /// \brief feed the link quality of one period
+    /// \return 1 if some rates changed
+    ///
+    int update(const StreamLinkSample &s);
+
+    int streamNum(void) { return m_streams.size(); }
+    const StreamConf& stream(int idx) { return m_streams[idx]; }
+    int rate(int idx) { return m_rate[idx]; }
+
+    double budget(void) { return m_budget; }
+    double budgetNominal(void);
+
+    ///
+    /// \brief bytes/s of the current rates
+    ///
+    double load(void);
+
+    // statistics
+    int         m_nCut, m_nGrow;
+
+protected:
+    void allocate(void);
+
+    std::vector<StreamConf>     m_streams;
+    std::vector<int>            m_rate;
+
+    int                 m_txbufLow, m_txbufHigh;
+    double              m_lossHigh, m_cut;
+
+    double              m_budget;           ///< bytes/s
+    int                 m_hold;             ///< periods without growth after a cut
+};
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_stream_rate(rtk::CParamArray *pa);
+
+#endif // end of __STREAMRATE_H__
@@ -0,0 +1,440 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <vector>
+
+#include <rtk_utils.h>
+#include <rtk_debug.h>
+#include <rtk_paramarray.h>
+
+#include "TelemetryRelay.h"
+
+using namespace rtk;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// TLogWriter
+////////////////////////////////////////////////////////////////////////////////
+
+TLogWriter::TLogWriter()
+{
+    m_fp     = NULL;
+    m_nFrame = 0;
+    m_nByte  = 0;
+}
+
+TLogWriter::~TLogWriter()
+{
+    close();
+}
+
+int TLogWriter::open(const std::string &fn)
+{
+    close();
+
+    m_fp = fopen(fn.c_str(), "wb");
+    if( m_fp == NULL ) {
+        dbg_pe("TLogWriter: can not open file: %s\n", fn.c_str());
+        return -1;
+    }
+
+    m_nFrame = 0;
+    m_nByte  = 0;
+
+    return 0;
+}
+
+int TLogWriter::close(void)
+{
+    if( m_fp != NULL ) fclose(m_fp);
+    m_fp = NULL;
+
+    return 0;
+}
+
+int TLogWriter::write(const uint8_t *frame, int len, uint64_t tmUnixUs)
+{
+    uint8_t     ts[8];
+
+    if( m_fp == NULL ) return -1;
+
+    for(int i=0; i<8; i++) ts[i] = (uint8_t) (tmUnixUs >> (56 - 8*i));
+
+    fwrite(ts, 1, 8, m_fp);
+    fwrite(frame, 1, len, m_fp);
+
+    m_nFrame ++;
+    m_nByte += 8 + len;
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// UDPForwarder
+////////////////////////////////////////////////////////////////////////////////
+
+UDPForwarder::UDPForwarder()
+{
+    m_fd    = -1;
+    m_nSent = 0;
+    m_nRecv = 0;
+    memset(m_peer, 0, sizeof(m_peer));
+}
+
+UDPForwarder::~UDPForwarder()
+{
+    close();
+}
+
+int UDPForwarder::open(const std::string &peer, int localPort, const std::string &localAddr)
+{
+    struct sockaddr_in  addr, *pa = (struct sockaddr_in*) m_peer;
+    struct addrinfo     hints, *res = NULL;
+    std::string         host, port;
+    size_t              p;
+
+    close();
+
+    // parse "host:port"
+    p = peer.rfind(':');
+    if( p == std::string::npos ) {
+        dbg_pe("UDPForwarder: peer must be host:port (%s)\n", peer.c_str());
+        return -1;
+    }
+    host = peer.substr(0, p);
+    port = peer.substr(p + 1);
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    if( 0 != getaddrinfo(host.c_str(), port.c_str(), &hints, &res) || res == NULL ) {
+        dbg_pe("UDPForwarder: can not resolve %s\n", peer.c_str());
+        return -1;
+    }
+    memcpy(pa, res->ai_addr, sizeof(struct sockaddr_in));
+    freeaddrinfo(res);
+
+    m_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if( m_fd < 0 ) {
+        dbg_pe("UDPForwarder: socket failed (%s)\n", strerror(errno));
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(localPort);
+    if( 1 != inet_pton(AF_INET, localAddr.c_str(), &addr.sin_addr) ) {
+        dbg_pe("UDPForwarder: bad local address (%s)\n", localAddr.c_str());
+        close();
+        return -1;
+    }
+    if( 0 != bind(m_fd, (struct sockaddr*) &addr, sizeof(addr)) ) {
+        dbg_pe("UDPForwarder: bind %s:%d failed (%s)\n",
+               localAddr.c_str(), localPort, strerror(errno));
+        close();
+        return -1;
+    }
+
+    // only the peer may talk to us: its datagrams go to the UAV unsigned
+    if( 0 != connect(m_fd, (struct sockaddr*) pa, sizeof(struct sockaddr_in)) ) {
+        dbg_pe("UDPForwarder: connect %s failed (%s)\n", peer.c_str(), strerror(errno));
+        close();
+        return -1;
+    }
+
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    m_nSent = 0;
+    m_nRecv = 0;
+
+    return 0;
+}
+
+int UDPForwarder::close(void)
+{
+    if( m_fd >= 0 ) ::close(m_fd);
+    m_fd = -1;
+
+    return 0;
+}
+
+int UDPForwarder::send(const uint8_t *buf, int len)
+{
+    int ret;
+
+    if( m_fd < 0 ) return -1;
+
+    ret = ::send(m_fd, buf, len, 0);
+    if( ret > 0 ) m_nSent += ret;
+
+    return ret;
+}
+
+int UDPForwarder::recv(uint8_t *buf, int len)
+{
+    int ret;
+
+    if( m_fd < 0 ) return -1;
+
+    // connected: nothing but the peer's datagrams (ICMP errors give < 0)
+    ret = ::recv(m_fd, buf, len, 0);
+    if( ret < 0 ) return 0;
+
+    m_nRecv += ret;
+
+    return ret;
+}
+
+int UDPForwarder::localPort(void)
+{
+    struct sockaddr_in  addr;
+    socklen_t           l = sizeof(addr);
+
+    if( m_fd < 0 || 0 != getsockname(m_fd, (struct sockaddr*) &addr, &l) ) return -1;
+
+    return ntohs(addr.sin_port);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// StateServer
+////////////////////////////////////////////////////////////////////////////////
+
+StateServer::StateServer()
+{
+    m_fd   = -1;
+    m_func = NULL;
+    m_obj  = NULL;
+}
+
+StateServer::~StateServer()
+{
+    close();
+}
+
+int StateServer::open(const std::string &path, StateSnapshotFunc func, void *obj)
+{
+    struct sockaddr_un  addr;
+
+    close();
+
+    if( path.size() >= sizeof(addr.sun_path) ) {
+        dbg_pe("StateServer: socket path too long (%s)\n", path.c_str());
+        return -1;
+    }
+
+    m_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if( m_fd < 0 ) {
+        dbg_pe("StateServer: socket failed (%s)\n", strerror(errno));
+        return -1;
+    }
+
+    // remove a stale socket of a previous run
+    unlink(path.c_str());
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+
+    if( 0 != bind(m_fd, (struct sockaddr*) &addr, sizeof(addr)) || 0 != listen(m_fd, 8) ) {
+        dbg_pe("StateServer: can not listen on %s (%s)\n", path.c_str(), strerror(errno));
+        ::close(m_fd);
+        m_fd = -1;
+        return -1;
+    }
+
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL, 0) | O_NONBLOCK);
+
+    m_path = path;
+    m_func = func;
+    m_obj  = obj;
+
+    return 0;
+}
+
+int StateServer::close(void)
+{
+    if( m_fd >= 0 ) {
+        ::close(m_fd);
+        unlink(m_path.c_str());
+    }
+
+    m_fd = -1;
+    m_path = "";
+
+    return 0;
+}
+
+int StateServer::serve(void)
+{
+    char    buf[4096];
+    int     n = 0, c, len;
+
+    if( m_fd < 0 ) return 0;
+
+    while( (c = accept(m_fd, NULL, NULL)) >= 0 ) {
+        len = m_func(m_obj, buf, sizeof(buf) - 1);
+        if( len > 0 ) {
+            if( buf[len-1] != '\n' ) buf[len++] = '\n';
+            ::send(c, buf, len, MSG_NOSIGNAL);
+        }
+
+        ::close(c);
+        n ++;
+    }
+
+    return n;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+long proc_rss_kb(void)
+{
+    FILE    *fp;
+    long    pages = -1, rss = -1;
+
+    fp = fopen("/proc/self/statm", "rt");
+    if( fp == NULL ) return -1;
+
+    if( 2 == fscanf(fp, "%ld %ld", &pages, &rss) )
+        rss = rss * (sysconf(_SC_PAGESIZE) / 1024);
+    else
+        rss = -1;
+
+    fclose(fp);
+
+    return rss;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// test
+////////////////////////////////////////////////////////////////////////////////
+
+static int relay_test_snapshot(void *obj, char *buf, int len)
+{
+    return snprintf(buf, len, "{\"n\": %d}", *((int*) obj));
+}
+
+int test_relay(CParamArray *pa)
+{
+    std::string fn_tlog = "/tmp/test_relay.tlog";
+    std::string fn_sock = "/tmp/test_relay.sock";
+    int         err = 0;
+
+    pa->s("fn_tlog", fn_tlog);
+    pa->s("fn_sock", fn_sock);
+
+    // tlog round trip
+    {
+        TLogWriter  tw;
+        uint8_t     f[20];
+
+        for(int i=0; i<20; i++) f[i] = i;
+
+        tw.open(fn_tlog);
+        tw.write(f, 20, 0x0102030405060708ULL);
+        tw.write(f, 10, 1500000000000000ULL);
+        tw.close();
+
+        uint8_t     b[64];
+        FILE        *fp = fopen(fn_tlog.c_str(), "rb");
+        int         n = fp ? fread(b, 1, sizeof(b), fp) : 0;
+        if( fp ) fclose(fp);
+
+        if( n != 8+20+8+10 || b[0] != 1 || b[7] != 8 || b[8] != 0 || b[27] != 19 ) {
+            printf("tlog: %d bytes, unexpected content\n", n);
+            err ++;
+        }
+    }
+
+    // UDP forwarding between two local ends
+    {
+        UDPForwarder    a, b;
+        uint8_t         buf[300], r[300];
+        int             n = 0;
+
+        for(int i=0; i<(int) sizeof(buf); i++) buf[i] = i & 0xff;
+
+        b.open("127.0.0.1:9", 0);
+        a.open(fmt::sprintf("127.0.0.1:%d", b.localPort()), 0);
+        b.open(fmt::sprintf("127.0.0.1:%d", a.localPort()), b.localPort());
+
+        a.send(buf, 263);
+        for(int i=0; i<100 && n == 0; i++) { n = b.recv(r, sizeof(r)); if( n == 0 ) tm_sleep(1); }
+        if( n != 263 || memcmp(buf, r, n) != 0 ) { printf("udp a->b: %d bytes\n", n); err ++; }
+
+        n = 0;
+        b.send(buf, 17);
+        for(int i=0; i<100 && n == 0; i++) { n = a.recv(r, sizeof(r)); if( n == 0 ) tm_sleep(1); }
+        if( n != 17 ) { printf("udp b->a: %d bytes\n", n); err ++; }
+
+        // a third socket is not the peer of a: dropped, b still gets through
+        UDPForwarder    c;
+
+        c.open(fmt::sprintf("127.0.0.1:%d", a.localPort()), 0);
+        c.send(buf, 33);
+        tm_sleep(10);
+        b.send(buf, 21);
+
+        n = 0;
+        for(int i=0; i<100 && n == 0; i++) { n = a.recv(r, sizeof(r)); if( n == 0 ) tm_sleep(1); }
+        if( n != 21 || a.recv(r, sizeof(r)) != 0 ) { printf("udp c->a: not dropped (%d)\n", n); err ++; }
+
+        // bound to the loopback address by default
+        struct sockaddr_in  la;
+        socklen_t           ll = sizeof(la);
+
+        if( 0 != getsockname(a.fd(), (struct sockaddr*) &la, &ll) ||
+            la.sin_addr.s_addr != htonl(INADDR_LOOPBACK) ) {
+            printf("udp: not bound to 127.0.0.1\n");
+            err ++;
+        }
+    }
+
+    // state socket
+    {
+        StateServer         ss;
+        int                 v = 42, c, n = 0;
+        char                line[256];
+        struct sockaddr_un  addr;
+
+        if( 0 != ss.open(fn_sock, relay_test_snapshot, &v) ) err ++;
+
+        c = socket(AF_UNIX, SOCK_STREAM, 0);
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, fn_sock.c_str());
+
+        if( 0 == connect(c, (struct sockaddr*) &addr, sizeof(addr)) ) {
+            ss.serve();
+            n = ::recv(c, line, sizeof(line)-1, 0);
+        }
+        ::close(c);
+
+        if( n > 0 ) line[n] = 0;
+        if( n <= 0 || strcmp(line, "{\"n\": 42}\n") != 0 ) {
+            printf("state socket: %d bytes\n", n);
+            err ++;
+        }
+    }
+
+    printf("RSS = %ld KB\n", proc_rss_kb());
+    printf("errors = %d\n", err);
+
+    return err;
+}
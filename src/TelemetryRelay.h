@@ -0,0 +1,134 @@
+#ifndef __TELEMETRYRELAY_H__
+#define __TELEMETRYRELAY_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+
+
+///
+/// \brief Telemetry log writer (.tlog, as written by MAVProxy/QGroundControl)
+///
+///     Each received frame is stored as a big-endian 64-bit UNIX time in
+///     microseconds followed by the raw frame bytes.
+///
+class TLogWriter
+{
+public:
+    TLogWriter();
+    ~TLogWriter();
+
+    int open(const std::string &fn);
+    int close(void);
+
+    int write(const uint8_t *frame, int len, uint64_t tmUnixUs);
+
+    int isOpened(void) { return m_fp != NULL; }
+
+    uint64_t frames(void) { return m_nFrame; }
+    uint64_t bytes(void)  { return m_nByte; }
+
+protected:
+    FILE            *m_fp;
+    uint64_t        m_nFrame, m_nByte;
+};
+
+
+///
+/// \brief UDP forwarding of the received frames (e.g. to another GCS)
+///
+///     Frames are sent to the peer given by "host:port". Datagrams coming
+///     back from the peer (commands of the other GCS) can be read by recv()
+///     and put into the UAS send buffer, so the process acts as a relay.
+///     The socket is connected to the peer: datagrams from any other source
+///     are dropped by the kernel, and it is bound to the loopback address
+///     unless told otherwise.
+///
+class UDPForwarder
+{
+public:
+    UDPForwarder();
+    ~UDPForwarder();
+
+    ///
+    /// \param peer - "host:port" frames are sent to
+    /// \param localPort - bound local port (0: any)
+    /// \param localAddr - bound local address ("0.0.0.0": all interfaces,
+    ///                    needed for a peer on another host)
+    ///
+    int open(const std::string &peer, int localPort = 0,
+             const std::string &localAddr = "127.0.0.1");
+    int close(void);
+
+    int send(const uint8_t *buf, int len);
+
+    ///
+    /// \brief receive one datagram of the peer (non-blocking)
+    /// \return datagram length, 0 if none
+    ///
+    int recv(uint8_t *buf, int len);
+
+    int fd(void) { return m_fd; }
+    int localPort(void);
+
+    uint64_t sentBytes(void) { return m_nSent; }
+    uint64_t recvBytes(void) { return m_nRecv; }
+
+protected:
+    int             m_fd;
+    uint8_t         m_peer[16];             ///< struct sockaddr_in
+    uint64_t        m_nSent, m_nRecv;
+};
+
+
+///
+/// \brief state snapshot function, writes one text line into buf
+/// \return text length
+///
+typedef int (*StateSnapshotFunc)(void *obj, char *buf, int len);
+
+///
+/// \brief Local (UNIX domain) socket serving state snapshots
+///
+///     Every client connection receives one snapshot line and is closed,
+///     e.g. "socat - UNIX-CONNECT:/tmp/simpgcs.sock".
+///
+class StateServer
+{
+public:
+    StateServer();
+    ~StateServer();
+
+    int open(const std::string &path, StateSnapshotFunc func, void *obj);
+    int close(void);
+
+    ///
+    /// \brief serve pending connections
+    /// \return number of clients served
+    ///
+    int serve(void);
+
+    int fd(void) { return m_fd; }
+
+protected:
+    int                 m_fd;
+    std::string         m_path;
+    StateSnapshotFunc   m_func;
+    void                *m_obj;
+};
+
+
+///
+/// \brief resident set size of this process (KB), -1 if unknown
+///
+long proc_rss_kb(void);
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_relay(rtk::CParamArray *pa);
+
+#endif // end of __TELEMETRYRELAY_H__
@@ -0,0 +1,358 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include <vector>
+#include <algorithm>
+
+#include <rtk_utils.h>
+#include <rtk_debug.h>
+#include <rtk_paramarray.h>
+
+#include "TelemetryShm.h"
+
+using namespace rtk;
+
+
+TelemetryShm::TelemetryShm()
+{
+    m_fd     = -1;
+    m_size   = 0;
+    m_hdr    = NULL;
+    m_slots  = NULL;
+    m_head   = 0;
+    m_nState = 0;
+}
+
+TelemetryShm::~TelemetryShm()
+{
+    close();
+}
+
+int TelemetryShm::open(const std::string &name, int nSlots)
+{
+    uint32_t    n = 1;
+    void        *p;
+
+    close();
+
+    while( (int) n < nSlots ) n <<= 1;
+
+    // a new segment each run, readers still mapping the old one keep it
+    shm_unlink(name.c_str());
+    m_fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+    if( m_fd < 0 ) {
+        dbg_pe("TelemetryShm: shm_open %s failed (%s)\n", name.c_str(), strerror(errno));
+        return -1;
+    }
+
+    m_size = sizeof(tshm_header_t) + (size_t) n * sizeof(tshm_slot_t);
+    if( 0 != ftruncate(m_fd, m_size) ) {
+        dbg_pe("TelemetryShm: ftruncate failed (%s)\n", strerror(errno));
+        ::close(m_fd);
+        shm_unlink(name.c_str());
+        m_fd = -1;
+        return -1;
+    }
+
+    p = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if( p == MAP_FAILED ) {
+        dbg_pe("TelemetryShm: mmap failed (%s)\n", strerror(errno));
+        ::close(m_fd);
+        shm_unlink(name.c_str());
+        m_fd = -1;
+        return -1;
+    }
+
+    m_name   = name;
+    m_hdr    = (tshm_header_t*) p;
+    m_slots  = (tshm_slot_t*) ((uint8_t*) p + sizeof(tshm_header_t));
+    m_head   = 0;
+    m_nState = 0;
+
+    // the segment is zero filled, the magic is written last
+    m_hdr->version     = TSHM_VERSION;
+    m_hdr->header_size = sizeof(tshm_header_t);
+    m_hdr->slot_size   = sizeof(tshm_slot_t);
+    m_hdr->state_size  = sizeof(tshm_state_t);
+    m_hdr->n_slots     = n;
+    m_hdr->pid         = getpid();
+    TSHM_WMB();
+    m_hdr->magic       = TSHM_MAGIC;
+
+    return 0;
+}
+
+int TelemetryShm::close(void)
+{
+    if( m_hdr != NULL ) munmap(m_hdr, m_size);
+    if( m_fd >= 0 ) {
+        ::close(m_fd);
+        shm_unlink(m_name.c_str());
+    }
+
+    m_fd    = -1;
+    m_hdr   = NULL;
+    m_slots = NULL;
+    m_name  = "";
+
+    return 0;
+}
+
+void TelemetryShm::publishState(const tshm_state_t &st)
+{
+    if( m_hdr == NULL ) return;
+
+    m_hdr->state_seq = m_hdr->state_seq + 1;
+    TSHM_WMB();
+
+    m_hdr->state = st;
+    m_hdr->state.n_update = ++m_nState;
+
+    TSHM_WMB();
+    m_hdr->state_seq = m_hdr->state_seq + 1;
+}
+
+void TelemetryShm::publishPacket(const uint8_t *p, int len, uint64_t tmUnixUs)
+{
+    tshm_slot_t *s;
+
+    if( m_hdr == NULL ) return;
+    if( len > TSHM_SLOT_DATA ) len = TSHM_SLOT_DATA;
+
+    s = &m_slots[m_head & (m_hdr->n_slots - 1)];
+
+    s->seq = 0;
+    TSHM_WMB();
+
+    s->time_us = tmUnixUs;
+    s->len     = len;
+    memcpy(s->data, p, len);
+
+    TSHM_WMB();
+    s->seq = m_head + 1;
+
+    m_head ++;
+    TSHM_WMB();
+    m_hdr->head = m_head;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// test & latency benchmark
+////////////////////////////////////////////////////////////////////////////////
+
+static inline uint64_t shm_now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+struct ShmBenchResult
+{
+    uint64_t    n, lost, gap;
+    double      avg, p50, p99, max;
+};
+
+// reader process: consume nPkg packets in place, latency from the embedded stamp
+static void shm_bench_reader(const char *name, int nPkg, int fdReady, int fdRes)
+{
+    tshm_reader_t           r;
+    const tshm_slot_t       *s;
+    std::vector<uint64_t>   lat;
+    ShmBenchResult          res;
+    uint64_t                t, seq, seqLast = 0;
+    char                    c = 1;
+
+    memset(&res, 0, sizeof(res));
+    lat.reserve(nPkg);
+
+    if( 0 != tshm_open(&r, name) ) c = 0;
+    if( write(fdReady, &c, 1) != 1 || c == 0 ) _exit(1);
+
+    while( (int) (res.n + r.lost) < nPkg ) {
+        s = tshm_packet_peek(&r);
+        if( s == NULL ) { sched_yield(); continue; }
+
+        memcpy(&t,   s->data,     8);
+        memcpy(&seq, s->data + 8, 8);
+        if( 0 != tshm_packet_done(&r, s) ) continue;
+
+        lat.push_back(shm_now_ns() - t);
+        if( res.n > 0 && seq != seqLast + 1 ) res.gap ++;
+        seqLast = seq;
+        res.n ++;
+    }
+
+    std::sort(lat.begin(), lat.end());
+    for(size_t i=0; i<lat.size(); i++) res.avg += lat[i];
+    if( lat.size() > 0 ) {
+        res.avg /= lat.size();
+        res.p50  = lat[lat.size() / 2];
+        res.p99  = lat[lat.size() * 99 / 100];
+        res.max  = lat.back();
+    }
+    res.lost = r.lost;
+
+    tshm_close(&r);
+
+    if( write(fdRes, &res, sizeof(res)) != sizeof(res) ) _exit(1);
+    _exit(0);
+}
+
+int test_shm(CParamArray *pa)
+{
+    std::string     name = fmt::sprintf("/SimpGCS_test_%d", getpid());
+    int             nSlots = 256, nPkg = 100000, nReader = 2, intervalNs = 20000;
+    int             err = 0;
+
+    pa->i("nSlots", nSlots);
+    pa->i("nPkg", nPkg);
+    pa->i("nReader", nReader);
+    pa->i("intervalNs", intervalNs);
+
+    TelemetryShm    w;
+    tshm_reader_t   r;
+    uint8_t         f[TSHM_FRAME_MAX], b[TSHM_FRAME_MAX];
+    uint64_t        tm;
+    int             n;
+
+    for(int i=0; i<TSHM_FRAME_MAX; i++) f[i] = i & 0xff;
+
+    if( 0 != w.open(name, nSlots) ) return 1;
+
+    // readers refuse a missing segment
+    if( tshm_open(&r, "/SimpGCS_test_none") != -1 ) { printf("opened missing segment\n"); err ++; }
+
+    if( 0 != tshm_open(&r, name.c_str()) ) { printf("can not open %s\n", name.c_str()); return 1; }
+
+    // state snapshot
+    {
+        tshm_state_t    st, rs;
+
+        memset(&st, 0, sizeof(st));
+        st.time_us = 123456789;
+        st.lat     = 34.2;
+        st.roll    = -3.5f;
+        st.n_sat   = 9;
+        strcpy(st.status, "PreArm: RC not calibrated");
+        w.publishState(st);
+        w.publishState(st);
+
+        if( 0 != tshm_read_state(&r, &rs) || rs.n_update != 2 || rs.lat != 34.2 ||
+            rs.roll != -3.5f || rs.n_sat != 9 || strcmp(rs.status, st.status) != 0 ) {
+            printf("state: n_update %d, lat %f\n", (int) rs.n_update, rs.lat);
+            err ++;
+        }
+    }
+
+    // packets in order, then an overrun
+    {
+        for(int i=0; i<10; i++) { f[0] = i; w.publishPacket(f, 10 + i, 1000 + i); }
+        for(int i=0; i<10; i++) {
+            n = tshm_read_packet(&r, b, sizeof(b), &tm);
+            if( n != 10 + i || b[0] != i || tm != (uint64_t) (1000 + i) || b[9] != 9 ) {
+                printf("packet %d: %d bytes, b[0] = %d\n", i, n, b[0]);
+                err ++;
+                break;
+            }
+        }
+        if( tshm_read_packet(&r, b, sizeof(b), &tm) != 0 ) { printf("extra packet\n"); err ++; }
+
+        for(int i=0; i<3*nSlots; i++) { f[0] = i & 0xff; w.publishPacket(f, 20, i); }
+
+        uint64_t tLast = 0, nRead = 0;
+        while( (n = tshm_read_packet(&r, b, sizeof(b), &tm)) > 0 ) {
+            if( nRead > 0 && tm != tLast + 1 ) { printf("overrun: not contiguous\n"); err ++; break; }
+            tLast = tm;
+            nRead ++;
+        }
+        if( r.lost == 0 || r.lost + nRead != (uint64_t) (3*nSlots) || tLast != (uint64_t) (3*nSlots - 1) ) {
+            printf("overrun: lost %d, read %d\n", (int) r.lost, (int) nRead);
+            err ++;
+        }
+    }
+
+    tshm_close(&r);
+
+    // publishing cost
+    uint64_t t0 = tm_get_us();
+    for(int i=0; i<nPkg; i++) w.publishPacket(f, 40, i);
+    double tPub = 1000.0 * (tm_get_us() - t0) / nPkg;
+
+    // reader processes
+    std::vector<pid_t>  pids;
+    std::vector<int>    fdRes;
+
+    for(int k=0; k<nReader; k++) {
+        int     pr[2], pd[2];
+        char    c = 0;
+
+        if( 0 != pipe(pr) || 0 != pipe(pd) ) { err ++; break; }
+
+        pid_t pid = fork();
+        if( pid == 0 ) {
+            ::close(pr[0]); ::close(pd[0]);
+            shm_bench_reader(name.c_str(), nPkg, pr[1], pd[1]);
+        }
+
+        ::close(pr[1]); ::close(pd[1]);
+        if( read(pr[0], &c, 1) != 1 || c != 1 ) { printf("reader %d failed\n", k); err ++; }
+        ::close(pr[0]);
+
+        pids.push_back(pid);
+        fdRes.push_back(pd[0]);
+    }
+
+    // paced publishing, the stamp & sequence number in the frame
+    uint64_t seq = 0, tNext = shm_now_ns();
+    for(int i=0; i<nPkg; i++) {
+        while( shm_now_ns() < tNext ) sched_yield();
+        tNext += intervalNs;
+
+        uint64_t t = shm_now_ns();
+        seq ++;
+        memcpy(f, &t, 8);
+        memcpy(f + 8, &seq, 8);
+        w.publishPacket(f, 40, t / 1000);
+    }
+
+    printf("publish %.1f ns/packet, %d slots, %d packets every %d ns\n",
+           tPub, nSlots, nPkg, intervalNs);
+
+    for(size_t k=0; k<pids.size(); k++) {
+        ShmBenchResult  res;
+        int             st = 0;
+
+        if( read(fdRes[k], &res, sizeof(res)) != sizeof(res) ) {
+            printf("reader %d: no result\n", (int) k);
+            err ++;
+        } else {
+            printf("reader %d: %llu packets, lost %llu, latency avg %.0f ns, "
+                   "p50 %.0f ns, p99 %.0f ns, max %.0f ns\n",
+                   (int) k, (unsigned long long) res.n, (unsigned long long) res.lost,
+                   res.avg, res.p50, res.p99, res.max);
+            if( res.gap > res.lost ) { printf("reader %d: %d gaps\n", (int) k, (int) res.gap); err ++; }
+        }
+
+        ::close(fdRes[k]);
+        waitpid(pids[k], &st, 0);
+    }
+
+    w.close();
+
+    printf("errors = %d\n", err);
+
+    return err;
+}
@@ -0,0 +1,55 @@
+#ifndef __TELEMETRYSHM_H__
+#define __TELEMETRYSHM_H__
+
+#include <stdint.h>
+
+#include <string>
+
+#include "telemetry_shm.h"
+
+
+///
+/// \brief Shared-memory telemetry writer (layout in telemetry_shm.h)
+///
+///     One writer thread: publishState() and publishPacket() are called from
+///     the MAVLink receiving thread, they never block and never allocate.
+///
+class TelemetryShm
+{
+public:
+    TelemetryShm();
+    ~TelemetryShm();
+
+    ///
+    /// \param name - POSIX shm name, e.g. "/SimpGCS"
+    /// \param nSlots - packet ring size (rounded up to a power of 2)
+    ///
+    int open(const std::string &name, int nSlots = 1024);
+    int close(void);
+
+    int isOpened(void) { return m_hdr != NULL; }
+
+    void publishState(const tshm_state_t &st);
+    void publishPacket(const uint8_t *p, int len, uint64_t tmUnixUs);
+
+    uint64_t packets(void) { return m_head; }
+
+protected:
+    int                 m_fd;
+    size_t              m_size;
+    std::string         m_name;
+
+    tshm_header_t       *m_hdr;
+    tshm_slot_t         *m_slots;
+    uint64_t            m_head;
+    uint64_t            m_nState;
+};
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_shm(rtk::CParamArray *pa);
+
+#endif // end of __TELEMETRYSHM_H__
@@ -3,13 +3,41 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <QApplication>
 
 #include <rtk_utils.h>
+#include <rtk_paramarray.h>
+#include <rtk_paramregistry.h>
 
+#include "utils_format.h"
 #include "UAS.h"
 
 using namespace rtk;
 
+// runtime tunables (can be overridden by command line or config file)
+static RParam<int>      g_uasRSSIMin("uas_rssi_min", 90);
+static RParam<int>      g_uasRSSIMax("uas_rssi_max", 220);
+
+static RParam<int>      g_missionWindow("mission_window", 8);       ///< outstanding download requests
+static RParam<int>      g_missionPush("mission_push", 0);           ///< upload items sent ahead
+static RParam<int>      g_missionRtoMin("mission_rto_min", 50);     ///< ms
+static RParam<int>      g_missionRtoMax("mission_rto_max", 5000);   ///< ms
+static RParam<int>      g_missionRetry("mission_retry", 8);
+
+static RParam<int>      g_streamAdapt("stream_adapt", 1);           ///< stream rates follow the link quality
+static RParam<int>      g_streamShown("stream_shown", 1);           ///< GUI: only the streams shown are requested
+static RParam<int>      g_streamTxbufLow("stream_txbuf_low", 40);   ///< RADIO_STATUS txbuf (%) cutting the rates
+static RParam<int>      g_streamTxbufHigh("stream_txbuf_high", 80); ///< txbuf (%) the rates can grow above
+
+static RParam<int>      g_paramAuto("param_auto", 1);               ///< get the parameters when the link is up
+static RParam<int>      g_paramWindow("param_window", 8);           ///< outstanding gap requests
+static RParam<int>      g_paramRtoMin("param_rto_min", 50);         ///< ms
+static RParam<int>      g_paramRtoMax("param_rto_max", 3000);       ///< ms
+static RParam<int>      g_paramRetry("param_retry", 8);
+
 void UAS_timerFunc(void *arg)
 {
     UAS *u = (UAS*) arg;
@@ -17,6 +45,41 @@ void UAS_timerFunc(void *arg)
     u->timerFunction(arg);
 }
 
+void UAS_transferTimerFunc(void *arg)
+{
+    UAS         *u = (UAS*) arg;
+    uint64_t    t = tm_get_us();
+
+    u->mission()->tick(t);
+    u->params()->tick(t);
+}
+
+static int UAS_transferSend(void *arg, mavlink_message_t &msg)
+{
+    UAS *u = (UAS*) arg;
+
+    return u->send_mavlink_msg(msg);
+}
+
+static void UAS_fenceAlert(void *arg, const GeoFenceAlert &a)
+{
+    UAS     *u = (UAS*) arg;
+    char    fence[16];
+
+    if( a.fence == GEOFENCE_ALT )           strcpy(fence, "altitude");
+    else if( a.fence == GEOFENCE_TERRAIN )  strcpy(fence, "terrain");
+    else                                    sprintf(fence, "fence %d", a.fence);
+
+    u->fenceLevel = u->geofence()->level(a.sysid);
+    snprintf(u->fenceText, sizeof(u->fenceText), "[%d] %s %s (%.1f m)",
+             a.sysid, fence, geofence_level_name(a.level), a.dis);
+
+    if( a.level > a.prevLevel ) dbg_pw("GEOFENCE %s\n", u->fenceText);
+    else                        dbg_pi("GEOFENCE %s\n", u->fenceText);
+
+    u->state_changed(UAS_STATE_STATUS);
+}
+
 
 UAS::UAS()
 {
@@ -28,8 +91,13 @@ UAS::UAS()
 
     // initialize timer & mutex for msg wirting
     m_timer = 0;
+    m_timerTransfer = 0;
     m_mutexMsgWrite = NULL;
 
+    // mission & parameter transfer
+    m_mission.setSend(UAS_transferSend, this);
+    m_params.setSend(UAS_transferSend, this);
+
     // status message time
     m_uavStatusMsgTime = -1;
     uavStatusText[0] = 0;
@@ -49,6 +117,30 @@ UAS::UAS()
     // received message in one second
     m_recvMessageInSec = 0;
 
+    // state generations & notify
+    for(int i=0; i<UAS_STATE_N; i++) m_stateGen[i] = 0;
+    m_stateNotify    = NULL;
+    m_stateNotifyArg = NULL;
+
+    m_shm            = NULL;
+
+    // smoothing of the displayed link values
+    //  (SYS_STATUS ~2 Hz, RADIO_STATUS ~1 Hz)
+    m_fltDropRate.setAlpha(0.2);
+    m_fltDropRateGCS.setAlpha(0.2);
+    m_fltRSSI.setAlpha(0.3);
+    m_fltRSSIRemote.setAlpha(0.3);
+
+    // telemetry history channels
+    m_tsRoll        = m_ts.channel("roll");
+    m_tsPitch       = m_ts.channel("pitch");
+    m_tsYaw         = m_ts.channel("yaw");
+    m_tsAlt         = m_ts.channel("gp_alt");
+    m_tsH           = m_ts.channel("gp_h");
+    m_tsBattVolt    = m_ts.channel("batt_volt");
+    m_tsBattCurrent = m_ts.channel("batt_current");
+    m_tsRSSI        = m_ts.channel("radio_rssi");
+
     // UAV stream requested
     //  see GCS_MAVLINK::data_stream_send(void)
     m_bStreamRequested = 0;
@@ -94,6 +186,30 @@ UAS::UAS()
     m_frqStreamExtr1 = 10;
     m_frqStreamExtr2 = 1;
     m_frqStreamExtr3 = 2;
+
+    // stream rate controller: nominal rates above, minimum under congestion,
+    //  priority (0: instruments & map) and bytes of one burst (MAVLink 1)
+    if( m_streamRate.streamNum() == 0 ) {
+        m_streamRate.addStream(MAV_DATA_STREAM_EXTRA1,          m_frqStreamExtr1,         2, 0,  36);
+        m_streamRate.addStream(MAV_DATA_STREAM_POSITION,        m_frqStreamPos,           2, 0,  72);
+        m_streamRate.addStream(MAV_DATA_STREAM_EXTENDED_STATUS, m_frqStreamExtStatus,     1, 1, 150);
+        m_streamRate.addStream(MAV_DATA_STREAM_EXTRA2,          m_frqStreamExtr2,         1, 1,  28);
+        m_streamRate.addStream(MAV_DATA_STREAM_RC_CHANNELS,     m_frqStreamRCChannels,    0, 2,  80);
+        m_streamRate.addStream(MAV_DATA_STREAM_EXTRA3,          m_frqStreamExtr3,         0, 2, 120);
+        m_streamRate.addStream(MAV_DATA_STREAM_RAW_CONTROLLER,  m_frqStreamRawController, 0, 2,  30);
+        m_streamRate.addStream(MAV_DATA_STREAM_RAW_SENSORS,     m_frqStreamRawSensors,    0, 3, 108);
+    }
+    m_streamReq.assign(m_streamRate.streamNum(), -1);
+    m_radioStatusN = 0;
+    m_radioRxErrLast = -1;
+    m_linkFramesLast = 0;
+    m_linkLostLast = 0;
+    m_pathE = 0;
+    m_pathN = 0;
+
+    m_fence = NULL;
+    fenceLevel = GEOFENCE_OK;
+    fenceText[0] = 0;
 }
 
 UAS::~UAS()
@@ -116,6 +232,11 @@ void UAS::init(void)
     uavSystemStatus = 0;
     uavMavlinkChan = 0;
 
+    // MAVLink 1 until the vehicle talks MAVLink 2 (or signing is used)
+    m_mavlinkTxVersion = 1;
+    m_hbCount = 0;
+    mavlink_signing_init(&signing);
+
     sensorsPresent = 0;
     sensorsEnabled = 0;
     sensorsHealth = 0;
@@ -233,6 +354,11 @@ int UAS::beginRecv(void)
         dbg_pe("Can not creat timer");
     }
 
+    // mission & parameter transfer timeouts
+    if( 0 != osa_tm_create(&m_timerTransfer, 20, UAS_transferTimerFunc, this) ) {
+        dbg_pe("Can not creat transfer timer");
+    }
+
     return 0;
 }
 
@@ -240,16 +366,30 @@ int UAS::stopRecv(void)
 {
     if( m_timer != 0 )
         osa_tm_delete(m_timer);
+    if( m_timerTransfer != 0 )
+        osa_tm_delete(m_timerTransfer);
+    m_mission.cancel();
+    m_params.stop();
     if( m_mutexMsgWrite != NULL )
         delete m_mutexMsgWrite;
 
     m_timer = 0;
+    m_timerTransfer = 0;
     m_mutexMsgWrite = NULL;
 
     return 0;
 }
 
 
+void UAS::set_geofence(GeoFenceEngine *fence)
+{
+    m_fence = fence;
+    if( m_fence != NULL ) m_fence->setAlertFunc(UAS_fenceAlert, this);
+
+    fenceLevel = GEOFENCE_OK;
+    fenceText[0] = 0;
+}
+
 int UAS::parse_mavlink_msg(mavlink_message_t &msg)
 {
     // FIXME: parse MAVLINK message based on sysid
@@ -257,18 +397,51 @@ int UAS::parse_mavlink_msg(mavlink_message_t &msg)
     //  50  ~ 249: Telemetry
     //  250 ~ 255: GCS
 
-    if( msg.sysid < 50 )
-        return parse_mavlink_msg_mav(msg);
+    int ret = 0;
+
+    if( msg.sysid < 50 ) {
+        ret = parse_mavlink_msg_mav(msg);
+        shm_publish_state();
 
-    if( msg.sysid >= 50 && msg.sysid < 249 )
-        return parse_mavlink_msg_telem(msg);
+        switch( msg.msgid ) {
+        case MAVLINK_MSG_ID_ATTITUDE:
+            state_changed(UAS_STATE_ATT);
+            break;
 
-    if( msg.sysid >= 250 )
-        return parse_mavlink_msg_gcs(msg);
+        case MAVLINK_MSG_ID_GPS_RAW_INT:
+        case MAVLINK_MSG_ID_GLOBAL_POSITION_INT:
+            state_changed(UAS_STATE_POS);
+            break;
+
+        default:
+            state_changed(UAS_STATE_STATUS);
+            break;
+        }
+
+        return ret;
+    }
+
+    if( msg.sysid >= 50 && msg.sysid < 249 ) {
+        ret = parse_mavlink_msg_telem(msg);
+        shm_publish_state();
+        state_changed(UAS_STATE_STATUS);
+        return ret;
+    }
+
+    if( msg.sysid >= 250 ) {
+        ret = parse_mavlink_msg_gcs(msg);
+        shm_publish_state();
+        state_changed(UAS_STATE_STATUS);
+        return ret;
+    }
+
+    return ret;
 }
 
 int UAS::parse_mavlink_msg_mav(mavlink_message_t &msg)
 {
+    double tNow = tm_get_us() * 1e-6;
+
     // count received message in one second
     m_recvMessageInSec ++;
 
@@ -281,8 +454,44 @@ int UAS::parse_mavlink_msg_mav(mavlink_message_t &msg)
     }
     m_pkgLastID = msg.seq;
 
+    // vehicle answered in MAVLink 2, use it for sending too
+    if( msg.magic == MAVLINK_STX_V2 && m_mavlinkTxVersion < 2 ) {
+        m_mavlinkTxVersion = 2;
+        dbg_pi("MAVLink 2 is used for sending\n");
+    }
+
     // for each message type
     switch( msg.msgid ) {
+    case MAVLINK_MSG_ID_MISSION_COUNT:
+    case MAVLINK_MSG_ID_MISSION_REQUEST:
+    case MAVLINK_MSG_ID_MISSION_ITEM:
+    case MAVLINK_MSG_ID_MISSION_ITEM_INT:
+    case MAVLINK_MSG_ID_MISSION_ACK:
+        m_mission.handle(msg, tm_get_us());
+        break;
+
+    case MAVLINK_MSG_ID_PARAM_VALUE:
+        m_params.handle(msg, tm_get_us());
+        break;
+
+    case MAVLINK_MSG_ID_TIMESYNC: {
+        mavlink_timesync_t  ts;
+        int64_t             tNowNs = (int64_t) tm_get_us() * 1000;
+
+        mavlink_msg_timesync_decode(&msg, &ts);
+
+        if( ts.tc1 == 0 ) {
+            // request of the vehicle, answered with our time
+            mavlink_message_t reply;
+            mavlink_msg_timesync_pack(gcsID, gcsCompID, &reply, tNowNs, ts.ts1);
+            send_mavlink_msg(reply);
+        } else if( ts.ts1 > 0 && ts.ts1 < tNowNs && tNowNs - ts.ts1 < 10000000000LL ) {
+            // answer to ours (timerFunction), ts1 is our send time
+            m_linkStats.rttSample((tNowNs - ts.ts1) / 1000);
+        }
+        break;
+    }
+
     case MAVLINK_MSG_ID_HEARTBEAT:
         mavlink_msg_heartbeat_decode(&msg, &msg_hb);
 
@@ -308,7 +517,10 @@ int UAS::parse_mavlink_msg_mav(mavlink_message_t &msg)
         battVolt            = m_avgBatMAV.push(msg_ss.voltage_battery * 1.0 / 1000.0);
         battCurrent         = msg_ss.current_battery * 1.0 / 100.0;
         battRemaining       = msg_ss.battery_remaining;
-        commDropRate        = msg_ss.drop_rate_comm * 1.0 / 100.0;
+        commDropRate        = m_fltDropRate.push(msg_ss.drop_rate_comm * 1.0 / 100.0);
+
+        m_tsBattVolt->push(tNow, battVolt);
+        m_tsBattCurrent->push(tNow, battCurrent);
 
         mavlink_sys_status_sensor_getIDs(sensorsPresent, sensorsPresentList);
         mavlink_sys_status_sensor_getIDs(sensorsEnabled, sensorsEnabledList);
@@ -364,6 +576,12 @@ int UAS::parse_mavlink_msg_mav(mavlink_message_t &msg)
             altHome = alt;
             hHome   = gpH;
 
+            // offsets & distances of the following samples are taken in this frame
+            homeFrame.setOrigin(latHome, lonHome, altHome);
+            pathLen = 0;
+            m_pathE = 0;
+            m_pathN = 0;
+
             if( homeSetCount > 0 ) homeSetCount --;
         }
 
@@ -382,8 +600,39 @@ int UAS::parse_mavlink_msg_mav(mavlink_message_t &msg)
         gpVz                = msg_gp.vz * 1.0 / 100.0;
         gpHeading           = msg_gp.hdg * 1.0 / 100.0;
 
+        // position from home, flown distance (steps below 0.5 m are GPS noise)
+        if( homeFrame.valid() ) {
+            homeFrame.offset(gpLat, gpLon, homeE, homeN);
+            homeDis = sqrt(homeE*homeE + homeN*homeN);
+
+            double dE = homeE - m_pathE, dN = homeN - m_pathN, d = sqrt(dE*dE + dN*dN);
+            if( d >= 0.5 ) {
+                pathLen += d;
+                m_pathE  = homeE;
+                m_pathN  = homeN;
+            }
+        }
+
+        // every vehicle, not only the one shown
+        if( m_fence != NULL )
+            m_fence->check(msg.sysid, gpLat, gpLon, gpH, tm_get_us());
+
+        m_tsAlt->push(tNow, gpAlt);
+        m_tsH->push(tNow, gpH);
+
         break;
 
+    case MAVLINK_MSG_ID_TERRAIN_REPORT: {
+        mavlink_terrain_report_t tr;
+        mavlink_msg_terrain_report_decode(&msg, &tr);
+
+        // spacing 0: no terrain data at the vehicle
+        if( m_fence != NULL && tr.spacing != 0 )
+            m_fence->terrain(msg.sysid, tr.current_height, tm_get_us());
+
+        break;
+    }
+
     case MAVLINK_MSG_ID_RAW_IMU:
         mavlink_msg_raw_imu_decode(&msg, &msg_imu_raw);
 
@@ -425,6 +674,10 @@ int UAS::parse_mavlink_msg_mav(mavlink_message_t &msg)
         pitchSpd            = msg_att.pitchspeed;
         yawSpd              = msg_att.yawspeed;
 
+        m_tsRoll->push(tNow, roll);
+        m_tsPitch->push(tNow, pitch);
+        m_tsYaw->push(tNow, yaw);
+
         break;
 
 
@@ -509,7 +762,7 @@ int UAS::parse_mavlink_msg_gcs(mavlink_message_t &msg)
         gcsBattVolt         = m_avgBatGCS.push(ss.voltage_battery * 1.0 / 1000.0);
         gcsBattCurrent      = ss.current_battery * 1.0 / 100.0;
         gcsBattRemaining    = ss.battery_remaining;
-        gcsCommDropRate     = ss.drop_rate_comm * 1.0 / 100.0;
+        gcsCommDropRate     = m_fltDropRateGCS.push(ss.drop_rate_comm * 1.0 / 100.0);
 
         break;
 
@@ -582,11 +835,14 @@ int UAS::parse_mavlink_msg_telem(mavlink_message_t &msg)
         mavlink_msg_radio_status_decode(&msg, &rs);
         radioRX_errors      = rs.rxerrors;
         radioFixed          = rs.fixed;
-        radioRSSI           = rs.rssi;
-        radioRSSI_remote    = rs.remrssi;
+        radioRSSI           = (int) (m_fltRSSI.push(rs.rssi) + 0.5f);
+        radioRSSI_remote    = (int) (m_fltRSSIRemote.push(rs.remrssi) + 0.5f);
         radioTXBuf          = rs.txbuf;
         radioNoise          = rs.noise;
         radioNoise_remote   = rs.remnoise;
+        m_radioStatusN ++;
+
+        m_tsRSSI->push(tm_get_us() * 1e-6, rs.rssi);
 
         break;
     }
@@ -594,161 +850,266 @@ int UAS::parse_mavlink_msg_telem(mavlink_message_t &msg)
     return 0;
 }
 
-int UAS::gen_listmap_important(ListMap &lm)
+// formatting shared by the info list paths (fixed buffers, no allocation)
+static char* uas_fmt_bootTime(char *p, uint32_t bootTime)
 {
-    char                *name;
+    int bt_msec = bootTime % 1000;
+    int bt_sec  = bootTime / 1000;
 
-    int                 rssi_min = 90, rssi_max = 220;
-    double              rssi_l, rssi_r;
+    p = fmt_int(p, bt_sec / 60);            p = fmt_char(p, ':');
+    p = fmt_int(p, bt_sec % 60, 2, '0');    p = fmt_char(p, '.');
+    p = fmt_int(p, bt_msec, 3, '0');
 
-    int                 bt_min, bt_sec, bt_msec;
+    return p;
+}
 
-    // clear old data
-    lm.clear();
+static char* uas_fmt_status(char *p, int severity, const char *text)
+{
+    if( text[0] == 0 ) return p;
 
+    p = fmt_char(p, '[');
+    p = fmt_int(p, severity);
+    p = fmt_str(p, "] ");
+    p = fmt_str(p, text, MAVLINK_MSG_STATUSTEXT_FIELD_TEXT_LEN);
 
-    bt_msec = bootTime % 1000;
-    bt_sec  = bootTime/1000;
-    bt_min  = bt_sec / 60;
-    bt_sec  = bt_sec % 60;
-    lm["sys_bTime"] = QString::fromStdString(
-                trim(fmt::sprintf("%d:%02d.%03d", bt_min, bt_sec, bt_msec)));
+    return p;
+}
 
+static char* uas_fmt_rssi(char *p, int rssi, int rssi_remote)
+{
+    int     rssi_min = g_uasRSSIMin(), rssi_max = g_uasRSSIMax();
+    double  rssi_l, rssi_r;
 
-    //mavlink_mav_type_name(uavType, &name);
-    //lm["sys_uavType"]   = name;
-    //mavlink_autopilot_name(uavAutopilot, &name);
-    //lm["sys_AP"]        = name;
-    //mavlink_mav_state_name(uavSystemStatus, &name);
-    //lm["sys_state"]     = name;
+    rssi_l = (rssi - rssi_min)*1.0 / (rssi_max - rssi_min) * 100.0;
+    if( rssi_l > 100.0 ) rssi_l = 100.0;
+    if( rssi_l < 0.0 )   rssi_l = 0.0;
+    rssi_r = (rssi_remote - rssi_min)*1.0 / (rssi_max - rssi_min) * 100.0;
+    if( rssi_r > 100.0 ) rssi_r = 100.0;
+    if( rssi_r < 0.0 )   rssi_r = 0.0;
 
-    if( strlen(uavStatusText) > 0 ) {
-        lm["sys_status"] = QString::fromStdString(
-                    trim(fmt::sprintf("[%d] %s", uavSeverity, uavStatusText)));
-    } else {
-        lm["sys_status"] = "";
+    // "%3d(%5.1f%%), %3d(%5.1f%%)"
+    p = fmt_int(p, rssi, 3);            p = fmt_char(p, '(');
+    p = fmt_fixed(p, rssi_l, 1, 5);     p = fmt_str(p, "%), ");
+    p = fmt_int(p, rssi_remote, 3);     p = fmt_char(p, '(');
+    p = fmt_fixed(p, rssi_r, 1, 5);     p = fmt_str(p, "%)");
+
+    return p;
+}
+
+static char* uas_fmt_percent(char *p, double v)
+{
+    return fmt_char(fmt_fixed(p, v, 2), '%');
+}
+
+
+// rows of gen_listmap_important
+enum ListMapImportantRow
+{
+    LMI_SYS_BTIME, LMI_SYS_STATUS,
+    LMI_SYS_BAT_V, LMI_SYS_BAT_C, LMI_SYS_BAT_R, LMI_SYS_CPU,
+    LMI_GP_ALT, LMI_GP_H, LMI_GP_NSAT, LMI_GP_HDOP_H, LMI_GP_HDOP_V, LMI_GP_HEADING, LMI_GP_FIXED,
+    LMI_RSSI,
+    LMI_GCS_STATUS,
+    LMI_GCS_BAT_V, LMI_GCS_BAT_R, LMI_GCS_CPU,
+    LMI_GCS_ALT, LMI_GCS_H, LMI_GCS_NSAT, LMI_GCS_HDOP_H, LMI_GCS_HDOP_V, LMI_GCS_HEADING, LMI_GCS_GPS,
+
+    LMI_N
+};
+
+static const char *g_listmapImportantKeys[LMI_N] =
+{
+    "sys_bTime", "sys_status",
+    "sys_bat_v", "sys_bat_c", "sys_bat_R", "sys_CPU",
+    "gp_alt", "gp_H", "gp_nSat", "gp_HDOP_H", "gp_HDOP_V", "gp_heading", "gp_Fixed",
+    "RSSI",
+    "GCS_status",
+    "GCS_bat_v", "GCS_bat_R", "GCS_CPU",
+    "GCS_alt", "GCS_H", "GCS_nSat", "GCS_HDOP_H", "GCS_HDOP_V", "GCS_heading", "GCS_GPS",
+};
+
+// row keys as QString, created once
+struct ListMapImportantKeys
+{
+    QString     key[LMI_N];
+
+    ListMapImportantKeys() {
+        for(int i=0; i<LMI_N; i++) key[i] = QLatin1String(g_listmapImportantKeys[i]);
     }
+};
+
+///
+/// \brief Set a row text (trimmed like rtk::trim) into the existing QString storage
+///
+///     The storage is reserved once; resize() keeps reserved capacity, so
+///     rewriting a row does not allocate unless the map was copied (shared).
+///
+static void listmap_set(QString &s, const char *b, const char *e)
+{
+    while( b < e && (*b == ' ' || *b == '\t' || *b == '\n' || *b == '\r') ) b++;
+    while( e > b && (e[-1] == ' ' || e[-1] == '\t' || e[-1] == '\n' || e[-1] == '\r') ) e--;
 
-    //lm["sys_pkgLost"] = QString::fromStdString(trim(fmt::sprintf("%d", m_pkgLost)));
+    int n = e - b;
+    if( s.capacity() < n ) s.reserve(n < 64 ? 64 : n);
+    s.resize(n);
 
+    QChar *d = s.data();
+    for(int i=0; i<n; i++) d[i] = QLatin1Char(b[i]);
+}
 
+int UAS::gen_listmap_important(ListMap &lm)
+{
+    static ListMapImportantKeys keys;
+
+    QString     *row[LMI_N];
+    char        buf[128], *p;
 
-    /*
-    mavlink_mav_mode_name(uavBaseMode, nl);
-    for(int i=0; i<nl.size(); i++) {
-        if( i == 0 ) nl_all = nl_all + nl[i];
-        else         nl_all = nl_all + ", " + nl[i];
+    // first call or a foreign map: create the rows, later calls rewrite them
+    if( lm.size() != LMI_N || !lm.contains(keys.key[LMI_N-1]) ) {
+        lm.clear();
+        for(int i=0; i<LMI_N; i++) lm[keys.key[i]].reserve(64);
     }
-    lm["sys_mode"]      = QString::fromStdString(nl_all);
-    */
+    for(int i=0; i<LMI_N; i++) row[i] = &lm[keys.key[i]];
 
+#define LMI_SET(r, expr) p = (expr); listmap_set(*row[r], buf, p)
 
-    //lm["sys_uavID"]     = QString::fromStdString(trim(fmt::sprintf("%d", uavID)));
+    LMI_SET(LMI_SYS_BTIME,  uas_fmt_bootTime(buf, bootTime));
+    LMI_SET(LMI_SYS_STATUS, uas_fmt_status(buf, uavSeverity, uavStatusText));
 
-    lm["sys_bat_v"]     = QString::fromStdString(trim(fmt::sprintf("%6.2f", battVolt)));
-    lm["sys_bat_c"]     = QString::fromStdString(trim(fmt::sprintf("%6.2f", battCurrent)));
-    lm["sys_bat_R"]     = QString::fromStdString(trim(fmt::sprintf("%6.2f%%", battRemaining)));
-    lm["sys_CPU"]       = QString::fromStdString(trim(fmt::sprintf("%6.2f%%", cpuLoad)));
+    LMI_SET(LMI_SYS_BAT_V,  fmt_fixed(buf, battVolt, 2));
+    LMI_SET(LMI_SYS_BAT_C,  fmt_fixed(buf, battCurrent, 2));
+    LMI_SET(LMI_SYS_BAT_R,  uas_fmt_percent(buf, battRemaining));
+    LMI_SET(LMI_SYS_CPU,    uas_fmt_percent(buf, cpuLoad));
 
-    //lm["att_roll"]      = QString::fromStdString(trim(fmt::sprintf("%12f", roll)));
-    //lm["att_pitch"]     = QString::fromStdString(trim(fmt::sprintf("%12f", pitch)));
-    //lm["att_yaw"]       = QString::fromStdString(trim(fmt::sprintf("%12f", yaw)));
+    LMI_SET(LMI_GP_ALT,     fmt_fixed(buf, gpAlt, 2));
+    LMI_SET(LMI_GP_H,       fmt_fixed(buf, gpH, 2));
+    LMI_SET(LMI_GP_NSAT,    fmt_int(buf, nSat));
+    LMI_SET(LMI_GP_HDOP_H,  fmt_fixed(buf, HDOP_h, 2));
+    LMI_SET(LMI_GP_HDOP_V,  fmt_fixed(buf, HDOP_v, 2));
+    LMI_SET(LMI_GP_HEADING, fmt_fixed(buf, gpHeading, 2));
+    LMI_SET(LMI_GP_FIXED,   fmt_str(buf, mavlink_gps_fix_name(gpsFixType)));
 
-    lm["gp_alt"]        = QString::fromStdString(trim(fmt::sprintf("%9.2f", gpAlt)));
-    lm["gp_H"]          = QString::fromStdString(trim(fmt::sprintf("%9.2f", gpH)));
-    lm["gp_nSat"]       = QString::fromStdString(trim(fmt::sprintf("%d", nSat)));
-    lm["gp_HDOP_H"]     = QString::fromStdString(trim(fmt::sprintf("%9.2f", HDOP_h)));
-    lm["gp_HDOP_V"]     = QString::fromStdString(trim(fmt::sprintf("%8.2f", HDOP_v)));
-    lm["gp_heading"]    = QString::fromStdString(trim(fmt::sprintf("%6.2f", gpHeading)));
+    // Telemetry RSSI
+    LMI_SET(LMI_RSSI,       uas_fmt_rssi(buf, radioRSSI, radioRSSI_remote));
 
-    switch( gpsFixType ) {
-    case 0:
-    case 1:
-        lm["gp_Fixed"]  = "Not fixed";
-        break;
+    // GCS
+    LMI_SET(LMI_GCS_STATUS, uas_fmt_status(buf, gcsSeverity, gcsStatusText));
 
-    case 2:
-        lm["gp_Fixed"]  = "2D fixed";
-        break;
+    LMI_SET(LMI_GCS_BAT_V,  fmt_fixed(buf, gcsBattVolt, 2));
+    LMI_SET(LMI_GCS_BAT_R,  uas_fmt_percent(buf, gcsBattRemaining));
+    LMI_SET(LMI_GCS_CPU,    uas_fmt_percent(buf, gcsCPULoad));
 
-    case 3:
-        lm["gp_Fixed"]  = "3D fixed";
-        break;
+    LMI_SET(LMI_GCS_ALT,    fmt_fixed(buf, gcsAlt, 2));
+    LMI_SET(LMI_GCS_H,      fmt_fixed(buf, gcsH, 2));
+    LMI_SET(LMI_GCS_NSAT,   fmt_int(buf, gcsNSat));
+    LMI_SET(LMI_GCS_HDOP_H, fmt_fixed(buf, gcsHDOP_h, 2));
+    LMI_SET(LMI_GCS_HDOP_V, fmt_fixed(buf, gcsHDOP_v, 2));
+    LMI_SET(LMI_GCS_HEADING,fmt_fixed(buf, gcsHeading, 2));
+    LMI_SET(LMI_GCS_GPS,    fmt_str(buf, mavlink_gps_fix_name(gcsGpsFixType)));
 
-    case 4:
-        lm["gp_Fixed"]  = "DGPS";
-        break;
+#undef LMI_SET
 
-    case 5:
-        lm["gp_Fixed"]  = "RTK";
-        break;
-    }
+    return 0;
+}
 
+int UAS::gen_listmap_all(ListMap &lm)
+{
+    return 0;
+}
 
-    // Telemetry RSSI
-    rssi_l = (radioRSSI - rssi_min)*1.0 / (rssi_max - rssi_min) * 100.0;
-    if( rssi_l > 100.0 ) rssi_l = 100.0;
-    if( rssi_l < 0.0 )   rssi_l = 0.0;
-    rssi_r = (radioRSSI_remote - rssi_min)*1.0 / (rssi_max - rssi_min) * 100.0;
-    if( rssi_r > 100.0 ) rssi_r = 100.0;
-    if( rssi_r < 0.0 )   rssi_r = 0.0;
-    lm["RSSI"] = QString::fromStdString(trim(fmt::sprintf("%3d(%5.1f%%), %3d(%5.1f%%)",
-                                                              radioRSSI, rssi_l,
-                                                              radioRSSI_remote, rssi_r)));
+// format functions of the computed info list rows
+static void tf_uav_bootTime(void *obj, char *buf, int len)
+{
+    UAS *u = (UAS*) obj;
 
-    // GCS
-    if( strlen(gcsStatusText) > 0 ) {
-        lm["GCS_status"] = QString::fromStdString(trim(fmt::sprintf("[%d] %s",
-                                                                    gcsSeverity, gcsStatusText)));
-    } else {
-        lm["GCS_status"] = "";
-    }
+    fmt_end(uas_fmt_bootTime(buf, u->bootTime));
+}
 
-    lm["GCS_bat_v"]     = QString::fromStdString(trim(fmt::sprintf("%6.2f", gcsBattVolt)));
-    lm["GCS_bat_R"]     = QString::fromStdString(trim(fmt::sprintf("%6.2f%%", gcsBattRemaining)));
-    lm["GCS_CPU"]       = QString::fromStdString(trim(fmt::sprintf("%6.2f%%", gcsCPULoad)));
+static void tf_uav_status(void *obj, char *buf, int len)
+{
+    UAS *u = (UAS*) obj;
 
-    lm["GCS_alt"]       = QString::fromStdString(trim(fmt::sprintf("%9.2f", gcsAlt)));
-    lm["GCS_H"]         = QString::fromStdString(trim(fmt::sprintf("%9.2f", gcsH)));
-    lm["GCS_nSat"]      = QString::fromStdString(trim(fmt::sprintf("%d",   gcsNSat)));
-    lm["GCS_HDOP_H"]    = QString::fromStdString(trim(fmt::sprintf("%9.2f", gcsHDOP_h)));
-    lm["GCS_HDOP_V"]    = QString::fromStdString(trim(fmt::sprintf("%9.2f", gcsHDOP_v)));
-    lm["GCS_heading"]   = QString::fromStdString(trim(fmt::sprintf("%6.2f", gcsHeading)));
+    fmt_end(uas_fmt_status(buf, u->uavSeverity, u->uavStatusText));
+}
 
-    switch( gcsGpsFixType ) {
-    case 0:
-    case 1:
-        lm["GCS_GPS"]  = "Not fixed";
-        break;
+static void tf_gcs_status(void *obj, char *buf, int len)
+{
+    UAS *u = (UAS*) obj;
 
-    case 2:
-        lm["GCS_GPS"]  = "2D fixed";
-        break;
+    fmt_end(uas_fmt_status(buf, u->gcsSeverity, u->gcsStatusText));
+}
 
-    case 3:
-        lm["GCS_GPS"]  = "3D fixed";
-        break;
+static void tf_gps_fix(void *obj, char *buf, int len)
+{
+    fmt_end(fmt_str(buf, mavlink_gps_fix_name(*((int*) obj)), len - 1));
+}
 
-    case 4:
-        lm["GCS_GPS"]  = "DGPS";
-        break;
+static void tf_fence(void *obj, char *buf, int len)
+{
+    fmt_end(fmt_str(buf, ((UAS*) obj)->fenceText, len - 1));
+}
 
-    case 5:
-        lm["GCS_GPS"]  = "RTK";
-        break;
-    }
+static void tf_rssi(void *obj, char *buf, int len)
+{
+    UAS *u = (UAS*) obj;
 
-    return 0;
+    fmt_end(uas_fmt_rssi(buf, u->radioRSSI, u->radioRSSI_remote));
 }
 
-int UAS::gen_listmap_all(ListMap &lm)
+static void tf_link(void *obj, char *buf, int len)
+{
+    LinkStats   *ls = ((UAS*) obj)->link_stats();
+    uint64_t    nRx = ls->frames(), nLost = ls->lost();
+    char        *p = buf;
+
+    // lost % of all, round trip
+    p = fmt_fixed(p, nRx + nLost > 0 ? 100.0 * nLost / (nRx + nLost) : 0, 1);
+    p = fmt_str(p, "% ");
+    p = fmt_int(p, (long) (ls->rttMs() + 0.5));
+    p = fmt_str(p, " ms");
+    fmt_end(p);
+}
+
+int UAS::bind_telemetry(QTelemetryModel *m)
 {
+    m->addField("sys_bTime",    tf_uav_bootTime, this, 200);
+    m->addField("sys_status",   tf_uav_status, this);
+    m->addField("sys_bat_v",    &battVolt,      "%6.2f");
+    m->addField("sys_bat_c",    &battCurrent,   "%6.2f");
+    m->addField("sys_bat_R",    &battRemaining, "%6.2f%%");
+    m->addField("sys_CPU",      &cpuLoad,       "%6.2f%%");
+
+    m->addField("gp_alt",       &gpAlt,         "%9.2f");
+    m->addField("gp_H",         &gpH,           "%9.2f");
+    m->addField("gp_nSat",      &nSat);
+    m->addField("gp_HDOP_H",    &HDOP_h,        "%9.2f");
+    m->addField("gp_HDOP_V",    &HDOP_v,        "%8.2f");
+    m->addField("gp_heading",   &gpHeading,     "%6.2f");
+    m->addField("home_dis",     &homeDis,       "%9.1f");
+    m->addField("path_len",     &pathLen,       "%9.1f");
+    m->addField("fence",        tf_fence, this);
+    m->addField("gp_Fixed",     tf_gps_fix, &gpsFixType);
+
+    m->addField("RSSI",         tf_rssi, this);
+    m->addField("link",         tf_link, this, 1000);
+
+    m->addField("GCS_status",   tf_gcs_status, this);
+    m->addField("GCS_bat_v",    &gcsBattVolt,       "%6.2f");
+    m->addField("GCS_bat_R",    &gcsBattRemaining,  "%6.2f%%");
+    m->addField("GCS_CPU",      &gcsCPULoad,        "%6.2f%%");
+    m->addField("GCS_alt",      &gcsAlt,            "%9.2f");
+    m->addField("GCS_H",        &gcsH,              "%9.2f");
+    m->addField("GCS_nSat",     &gcsNSat);
+    m->addField("GCS_HDOP_H",   &gcsHDOP_h,         "%9.2f");
+    m->addField("GCS_HDOP_V",   &gcsHDOP_v,         "%9.2f");
+    m->addField("GCS_heading",  &gcsHeading,        "%6.2f");
+    m->addField("GCS_GPS",      tf_gps_fix, &gcsGpsFixType);
+
     return 0;
 }
 
 int UAS::timerFunction(void *arg)
 {
-    mavlink_message_t beat, msg;
+    mavlink_message_t beat;
     static int bRequestDataStream = 0;
 
     // send heartbeat
@@ -757,12 +1118,19 @@ int UAS::timerFunction(void *arg)
                                MAV_MODE_MANUAL_ARMED, 0, MAV_STATE_ACTIVE);
     send_mavlink_msg(beat);
 
+    // probe MAVLink 2 every 5 seconds, the vehicle switches if it supports it
+    if( m_mavlinkTxVersion < 2 && (m_hbCount++) % 5 == 0 )
+        send_mavlink_msg(beat, 2);
+
+    // round trip: the vehicle answers TIMESYNC with our time in ts1
+    mavlink_msg_timesync_pack(gcsID, gcsCompID, &beat, 0, (int64_t) tm_get_us() * 1000);
+    send_mavlink_msg(beat);
+
+    // link statistics of the last second
+    m_linkStats.snapshot(m_linkSnapshot, tm_get_us());
+
     // check connection
-    if( m_recvMessageInSec < 2 ) {
-        m_bLinkConnected = 0;
-    } else {
-        m_bLinkConnected = 1;
-    }
+    link_check();
 
     // auto clean status message
     if( m_uavStatusMsgTime >= 0 ) {
@@ -772,6 +1140,7 @@ int UAS::timerFunction(void *arg)
             m_uavStatusMsgTime = -1;
             uavStatusText[0] = 0;
             uavSeverity = 0;
+            state_changed(UAS_STATE_STATUS);
         }
     }
 
@@ -783,77 +1152,185 @@ int UAS::timerFunction(void *arg)
             m_gcsStatusMsgTime = -1;
             gcsStatusText[0] = 0;
             gcsSeverity = 0;
+            state_changed(UAS_STATE_STATUS);
         }
     }
 
-    // send stream request
+    // stream rates: all requested while the link is down, then only the
+    // changed ones (link quality, streams shown)
     if( m_bLinkConnected == 0 || bRequestDataStream == 0 ) {
         bRequestDataStream = 1;
-        //dbg_pt("request data stream");
-        mavlink_request_data_stream_t packet;
+        stream_request(1);
+    } else {
+        StreamLinkSample ls;
+
+        ls.hasRadio = m_radioStatusN > 0;
+        ls.txbuf    = radioTXBuf;
+        ls.rssi     = radioRSSI;
+        ls.remrssi  = radioRSSI_remote;
+        ls.rxErrors = m_radioRxErrLast >= 0 ? (uint16_t) (radioRX_errors - m_radioRxErrLast) : 0;
+        // raw frames & per (sysid, compid) sequence gaps, counted before
+        //  frames are dropped (msgid >= 256) and not mixing the components
+        ls.nRecv    = m_linkSnapshot.frames >= m_linkFramesLast ?
+                        (int) (m_linkSnapshot.frames - m_linkFramesLast) : 0;
+        ls.nLost    = m_linkSnapshot.lost >= m_linkLostLast ?
+                        (int) (m_linkSnapshot.lost - m_linkLostLast) : 0;
+
+        if( g_streamAdapt() ) {
+            m_streamRate.setControl(g_streamTxbufLow(), g_streamTxbufHigh(), 0.15, 0.7);
+            m_streamRate.update(ls);
+        }
+        stream_request(0);
+    }
 
-        packet.target_system = uavID;
-        packet.target_component = uavCompID;
-        packet.start_stop = 1;
+    m_radioStatusN   = 0;
+    m_radioRxErrLast = radioRX_errors;
+    m_linkFramesLast = m_linkSnapshot.frames;
+    m_linkLostLast   = m_linkSnapshot.lost;
 
-        packet.req_stream_id = MAV_DATA_STREAM_RAW_SENSORS;
-        packet.req_message_rate = m_frqStreamRawSensors;
-        mavlink_msg_request_data_stream_encode(uavID, uavCompID, &msg, &packet);
-        send_mavlink_msg(msg);
+    return 0;
+}
 
-        packet.req_stream_id = MAV_DATA_STREAM_EXTENDED_STATUS;
-        packet.req_message_rate = m_frqStreamExtStatus;
-        mavlink_msg_request_data_stream_encode(uavID, uavCompID, &msg, &packet);
-        send_mavlink_msg(msg);
+int UAS::link_check(void)
+{
+    int linkConnected = m_recvMessageInSec < 2 ? 0 : 1;
 
-        packet.req_stream_id = MAV_DATA_STREAM_RC_CHANNELS;
-        packet.req_message_rate = m_frqStreamRCChannels;
-        mavlink_msg_request_data_stream_encode(uavID, uavCompID, &msg, &packet);
-        send_mavlink_msg(msg);
+    m_recvMessageInSec = 0;
+    if( linkConnected == m_bLinkConnected ) return 0;
 
-        packet.req_stream_id = MAV_DATA_STREAM_RAW_CONTROLLER;
-        packet.req_message_rate = m_frqStreamRawController;
-        mavlink_msg_request_data_stream_encode(uavID, uavCompID, &msg, &packet);
-        send_mavlink_msg(msg);
+    m_bLinkConnected = linkConnected;
+    state_changed(UAS_STATE_LINK);
 
-        packet.req_stream_id = MAV_DATA_STREAM_POSITION;
-        packet.req_message_rate = m_frqStreamPos;
-        mavlink_msg_request_data_stream_encode(uavID, uavCompID, &msg, &packet);
-        send_mavlink_msg(msg);
+    // no message may come any more to publish it
+    shm_publish_state();
 
-        packet.req_stream_id = MAV_DATA_STREAM_EXTRA1;
-        packet.req_message_rate = m_frqStreamExtr1;
-        mavlink_msg_request_data_stream_encode(uavID, uavCompID, &msg, &packet);
-        send_mavlink_msg(msg);
+    // parameters of the (re)connected vehicle, from the cache if unchanged
+    if( linkConnected && g_paramAuto() ) param_download();
 
-        packet.req_stream_id = MAV_DATA_STREAM_EXTRA2;
-        packet.req_message_rate = m_frqStreamExtr2;
-        mavlink_msg_request_data_stream_encode(uavID, uavCompID, &msg, &packet);
-        send_mavlink_msg(msg);
+    return 1;
+}
+
+int UAS::stream_request(int all)
+{
+    mavlink_message_t msg;
+    mavlink_request_data_stream_t packet;
 
-        packet.req_stream_id = MAV_DATA_STREAM_EXTRA3;
-        packet.req_message_rate = m_frqStreamExtr3;
+    packet.target_system = uavID;
+    packet.target_component = uavCompID;
+    packet.start_stop = 1;
+
+    for(int i=0; i<m_streamRate.streamNum(); i++) {
+        int r = m_streamRate.rate(i);
+        if( !all && r == m_streamReq[i] ) continue;
+
+        packet.req_stream_id = m_streamRate.stream(i).id;
+        packet.req_message_rate = r;
         mavlink_msg_request_data_stream_encode(uavID, uavCompID, &msg, &packet);
         send_mavlink_msg(msg);
-    }
 
-    m_recvMessageInSec = 0;
+        m_streamReq[i] = r;
+    }
 
     return 0;
 }
 
-int UAS::send_mavlink_msg(mavlink_message_t &msg)
+void UAS::stream_set_displayed(int stateMask)
 {
-    uint8_t buffer[MAVLINK_MAX_PACKET_LEN];
+    if( !g_streamShown() ) return;
+
+    // streams of the state groups (RAW_IMU, RC & VFR_HUD are not shown)
+    int att = stateMask & UAS_STATE_MASK(UAS_STATE_ATT);
+    int pos = stateMask & UAS_STATE_MASK(UAS_STATE_POS);
+    int sta = stateMask & UAS_STATE_MASK(UAS_STATE_STATUS);
+
+    for(int i=0; i<m_streamRate.streamNum(); i++) {
+        int w = 0;
+
+        switch( m_streamRate.stream(i).id ) {
+        case MAV_DATA_STREAM_EXTRA1:            w = att;        break;
+        case MAV_DATA_STREAM_POSITION:          w = pos;        break;
+        case MAV_DATA_STREAM_EXTENDED_STATUS:   w = pos || sta; break;
+        case MAV_DATA_STREAM_EXTRA3:            w = sta;        break;
+        }
+
+        m_streamRate.setWanted(i, w != 0);
+    }
+}
+
+int UAS::send_mavlink_msg(mavlink_message_t &msg, int version)
+{
+    uint8_t buffer[MAVLINK_V2_MAX_PACKET_LEN];
+    int     len;
+
+    // signing needs MAVLink 2
+    if( version == 0 ) version = m_mavlinkTxVersion;
+    if( signing.enabled ) version = 2;
+
+    // timer, transfer timer & reader thread all send: the signing timestamp
+    //  must grow in the order the frames are queued
+    m_mutexSign.lock();
 
     // Write message into buffer, prepending start sign
-    int len = mavlink_msg_to_send_buffer(buffer, &msg);
+    if( version >= 2 )
+        len = mavlink_msg_to_send_buffer_v2(buffer, &msg, &signing);
+    else
+        len = mavlink_msg_to_send_buffer(buffer, &msg);
     static uint8_t messageKeys[256] = MAVLINK_MESSAGE_CRCS;
     mavlink_finalize_message_chan(&msg, gcsID, gcsCompID,
                                   uavMavlinkChan,
                                   msg.len, messageKeys[msg.msgid]);
 
-    return put_msg_buff(buffer, len);
+    int ret = put_msg_buff(buffer, len);
+
+    m_mutexSign.unlock();
+
+    return ret;
+}
+
+int UAS::mission_upload(const MissionItems &items)
+{
+    if( m_mutexMsgWrite == NULL ) return -1;
+    if( m_mission.busy() ) return MT_BUSY;
+
+    m_mission.setIDs(gcsID, gcsCompID, uavID, uavCompID);
+    m_mission.setWindow(g_missionWindow(), g_missionPush());
+    m_mission.setTimeout(g_missionRtoMin(), g_missionRtoMax(), g_missionRetry());
+
+    return m_mission.upload(items, tm_get_us());
+}
+
+int UAS::mission_download(void)
+{
+    if( m_mutexMsgWrite == NULL ) return -1;
+    if( m_mission.busy() ) return MT_BUSY;
+
+    m_mission.setIDs(gcsID, gcsCompID, uavID, uavCompID);
+    m_mission.setWindow(g_missionWindow(), g_missionPush());
+    m_mission.setTimeout(g_missionRtoMin(), g_missionRtoMax(), g_missionRetry());
+
+    return m_mission.download(tm_get_us());
+}
+
+int UAS::param_download(void)
+{
+    if( m_mutexMsgWrite == NULL ) return -1;
+
+    m_params.setIDs(gcsID, gcsCompID, uavID, uavCompID);
+    m_params.setTransfer(g_paramWindow(), g_paramRtoMin(), g_paramRtoMax(), g_paramRetry());
+
+    return m_params.start(tm_get_us());
+}
+
+int UAS::setSigningKey(const std::string &passphrase)
+{
+    m_mutexSign.lock();
+
+    mavlink_signing_set_key(&signing, passphrase);
+    if( signing.enabled ) m_mavlinkTxVersion = 2;
+
+    m_mutexSign.unlock();
+
+    return 0;
 }
 
 int UAS::put_msg_buff(uint8_t *buf, int len)
@@ -870,16 +1347,334 @@ int UAS::put_msg_buff(uint8_t *buf, int len)
 
 int UAS::get_msg_buff(uint8_t *buf, int *len)
 {
+    int     n;
+
     m_mutexMsgWrite->lock();
 
-    *len = m_msgBuffer.size();
-    for(int i=0; i<*len; i++) {
+    // at most the buffer size, the rest is sent next time
+    n = m_msgBuffer.size();
+    if( *len > 0 && n > *len ) n = *len;
+
+    for(int i=0; i<n; i++) {
         buf[i] = m_msgBuffer[i];
     }
 
-    m_msgBuffer.clear();
+    m_msgBuffer.erase(m_msgBuffer.begin(), m_msgBuffer.begin() + n);
+    *len = n;
 
     m_mutexMsgWrite->unlock();
 
     return 0;
 }
+
+void UAS::shm_publish_state(void)
+{
+    tshm_state_t    st;
+
+    if( m_shm == NULL ) return;
+
+    // the receiving thread & the link timer: TelemetryShm has one writer
+    m_mutexShm.lock();
+
+    st.time_us        = tm_get_us();
+    st.n_update       = 0;
+    st.lat            = gpLat;
+    st.lon            = gpLon;
+    st.alt            = gpAlt;
+    st.h              = gpH;
+    st.heading        = gpHeading;
+    st.hdop           = HDOP_h;
+    st.roll           = roll;
+    st.pitch          = pitch;
+    st.yaw            = yaw;
+    st.batt_volt      = battVolt;
+    st.batt_current   = battCurrent;
+    st.batt_remaining = battRemaining;
+    st.drop_rate      = commDropRate;
+    st.link           = m_bLinkConnected;
+    st.uav_id         = uavID;
+    st.base_mode      = uavBaseMode;
+    st.custom_mode    = uavCustomMode;
+    st.system_status  = uavSystemStatus;
+    st.gps_fix        = gpsFixType;
+    st.n_sat          = nSat;
+    st.rssi           = radioRSSI;
+    st.rssi_remote    = radioRSSI_remote;
+    st.pkg_lost       = m_pkgLost;
+
+    memcpy(st.status, uavStatusText, sizeof(uavStatusText));
+    st.status[sizeof(uavStatusText)] = 0;
+
+    m_shm->publishState(st);
+
+    m_mutexShm.unlock();
+}
+
+int UAS::state_json(char *buf, int len)
+{
+    int     n;
+
+    n = snprintf(buf, len,
+                 "{\"time\": %.3f, \"link\": %d, \"uav_id\": %d, \"base_mode\": %d, "
+                 "\"custom_mode\": %d, \"system_status\": %d, "
+                 "\"lat\": %.7f, \"lon\": %.7f, \"alt\": %.2f, \"h\": %.2f, \"heading\": %.2f, "
+                 "\"roll\": %.2f, \"pitch\": %.2f, \"yaw\": %.2f, "
+                 "\"gps_fix\": %d, \"n_sat\": %d, \"hdop\": %.2f, "
+                 "\"batt_volt\": %.2f, \"batt_current\": %.2f, \"batt_remaining\": %.1f, "
+                 "\"rssi\": %d, \"rssi_remote\": %d, \"drop_rate\": %.2f, \"pkg_lost\": %d, "
+                 "\"status\": \"",
+                 tm_get_millis() / 1000.0, m_bLinkConnected, uavID, uavBaseMode,
+                 uavCustomMode, uavSystemStatus,
+                 gpLat, gpLon, gpAlt, gpH, gpHeading,
+                 roll, pitch, yaw,
+                 gpsFixType, nSat, HDOP_h,
+                 battVolt, battCurrent, battRemaining,
+                 radioRSSI, radioRSSI_remote, commDropRate, m_pkgLost);
+    if( n < 0 || n >= len ) return len > 0 ? (int) strlen(buf) : 0;
+
+    // status text, escaped
+    for(int i=0; i<(int) sizeof(uavStatusText) && uavStatusText[i] && n + 4 < len; i++) {
+        char c = uavStatusText[i];
+
+        if( c == '"' || c == '\\' ) buf[n++] = '\\';
+        buf[n++] = (c >= 0x20) ? c : ' ';
+    }
+    n += snprintf(buf + n, len - n, "\"}");
+
+    return n < len ? n : len - 1;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// info list update benchmark
+////////////////////////////////////////////////////////////////////////////////
+
+// telemetry as seen by the 30 Hz GUI timer: position & attitude change every
+// tick, battery/CPU every few ticks, radio status once per second
+static void uas_sim_telemetry(UAS &u, int i)
+{
+    u.bootTime      = i*33;
+    u.battVolt      = 12.4 - i*1e-4 + ((i/3*7919) % 11)*0.002;
+    u.battCurrent   = 10.0 + ((i/3*104729) % 13)*0.01;
+    u.battRemaining = 80.0 - i*0.001;
+    u.cpuLoad       = 35.0 + (i/10 % 50)*0.1;
+
+    u.gpAlt         = 500.0 + 10.0*sin(i*0.01);
+    u.gpH           = u.gpAlt - 450.0;
+    u.gpHeading     = fmod(i*0.3, 360.0);
+    u.nSat          = 12;
+    u.HDOP_h        = 0.9;
+    u.HDOP_v        = 1.4;
+    u.gpsFixType    = 3;
+
+    if( i % 30 == 0 ) {
+        u.radioRSSI        = 150 + (i/30) % 5;
+        u.radioRSSI_remote = 140 + (i/30) % 3;
+    }
+
+    u.gcsBattVolt   = 16.2;
+    u.gcsNSat       = 10;
+    u.gcsGpsFixType = 3;
+}
+
+int test_telemetry_bench(CParamArray *pa)
+{
+    int     argc;
+    char**  argv;
+    int     n = 3000, show = 0;
+    ru64    t0, t1, t2;
+
+    argc = pa->i("argc");
+    argv = (char**) pa->p("argv");
+    pa->i("n", n);
+    pa->i("show", show);            // 1: show the views & include painting
+
+    QApplication app(argc, argv);
+
+    UAS                 uas;
+    QKeyValueListView   lvOld;
+    QTelemetryListView  lvNew;
+
+    uas.bind_telemetry(lvNew.telemetryModel());
+    if( show ) {
+        lvOld.resize(300, 600);     lvOld.show();
+        lvNew.resize(300, 600);     lvNew.show();
+        app.processEvents();
+    }
+
+    // previous path: rebuild the ListMap & rewrite every row
+    t0 = tm_get_us();
+    for(int i=0; i<n; i++) {
+        uas_sim_telemetry(uas, i);
+
+        ListMap lm;
+        lvOld.beginSetData();
+        uas.gen_listmap_important(lm);
+        lvOld.getData() = lm;
+        lvOld.endSetData();
+        lvOld.listReload();
+
+        if( show ) app.processEvents();
+    }
+    t1 = tm_get_us();
+
+    // bound fields: format & notify changed rows only
+    for(int i=0; i<n; i++) {
+        uas_sim_telemetry(uas, i);
+        lvNew.telemetryModel()->update();
+
+        if( show ) app.processEvents();
+    }
+    t2 = tm_get_us();
+
+    printf("ListMap + QKeyValueListView : %8.2f us/tick, %6.3f%% CPU at 30 Hz\n",
+           1.0*(t1-t0)/n, 1.0*(t1-t0)/n*30/1e4);
+    printf("QTelemetryModel::update     : %8.2f us/tick, %6.3f%% CPU at 30 Hz (%.2f values formatted/tick)\n",
+           1.0*(t2-t1)/n, 1.0*(t2-t1)/n*30/1e4,
+           1.0*lvNew.telemetryModel()->formatCount()/n);
+
+    return 0;
+}
+
+int test_listmap_alloc(CParamArray *pa)
+{
+    int         n = 3000, err = 0;
+    uint64_t    a0, a1, a2;
+    ru64        t0, t1, t2;
+    char        ref[128];
+
+    pa->i("n", n);
+
+    UAS         uas;
+    ListMap     lm, lmOld;
+
+    strcpy(uas.uavStatusText, "PreArm: Check mag field");
+    uas.uavSeverity = 4;
+
+    uas_sim_telemetry(uas, 0);
+    uas.gen_listmap_important(lm);
+
+    // row storage after the first frame
+    std::vector<const QChar*>   data0;
+    for(ListMap::iterator it=lm.begin(); it!=lm.end(); it++) data0.push_back(it.value().constData());
+
+    alloc_count_enable(1);
+
+    // previous path: rebuild the map with fmt::sprintf, trim & fromStdString
+    a0 = alloc_count();
+    t0 = tm_get_us();
+    for(int i=0; i<n; i++) {
+        uas_sim_telemetry(uas, i);
+
+        lmOld.clear();
+        for(int k=0; k<LMI_N; k++)
+            lmOld[g_listmapImportantKeys[k]] =
+                    QString::fromStdString(trim(fmt::sprintf("%9.2f", uas.gpAlt + k)));
+    }
+    t1 = tm_get_us();
+
+    // fixed buffers & reused rows
+    a1 = alloc_count();
+    for(int i=0; i<n; i++) {
+        uas_sim_telemetry(uas, i);
+        uas.gen_listmap_important(lm);
+    }
+    t2 = tm_get_us();
+    a2 = alloc_count();
+
+    alloc_count_enable(0);
+
+    // rows must keep their storage
+    int k = 0, nMoved = 0;
+    for(ListMap::iterator it=lm.begin(); it!=lm.end(); it++, k++)
+        if( it.value().constData() != data0[k] ) nMoved ++;
+
+    // texts must match the printf formats
+    snprintf(ref, sizeof(ref), "%3d(%5.1f%%), %3d(%5.1f%%)", uas.radioRSSI,
+             fmin(fmax((uas.radioRSSI - g_uasRSSIMin())*100.0/(g_uasRSSIMax() - g_uasRSSIMin()), 0.0), 100.0),
+             uas.radioRSSI_remote,
+             fmin(fmax((uas.radioRSSI_remote - g_uasRSSIMin())*100.0/(g_uasRSSIMax() - g_uasRSSIMin()), 0.0), 100.0));
+    if( lm["RSSI"] != QString::fromStdString(trim(ref)) ) err ++;
+    snprintf(ref, sizeof(ref), "%6.2f", uas.battVolt);
+    if( lm["sys_bat_v"] != QString::fromStdString(trim(ref)) ) err ++;
+    snprintf(ref, sizeof(ref), "%d:%02d.%03d", uas.bootTime/1000/60, uas.bootTime/1000%60, uas.bootTime%1000);
+    if( lm["sys_bTime"] != ref ) err ++;
+    snprintf(ref, sizeof(ref), "[%d] %s", uas.uavSeverity, uas.uavStatusText);
+    if( lm["sys_status"] != ref ) err ++;
+    if( lm["gp_Fixed"] != "3D fixed" ) err ++;
+
+    if( nMoved > 0 ) err ++;
+
+    if( !alloc_count_available() ) {
+        printf("ListMap rebuild (sprintf) : %8.2f us/frame\n", 1.0*(t1-t0)/n);
+        printf("gen_listmap_important     : %8.2f us/frame, %d/%d rows reallocated\n",
+               1.0*(t2-t1)/n, nMoved, LMI_N);
+        printf("operator new per frame: not built with SIMPGCS_ALLOC_COUNT, skipped\n");
+        printf("errors = %d (allocation check skipped)\n", err);
+
+        return err;
+    }
+
+    printf("ListMap rebuild (sprintf) : %8.2f us/frame, %6.1f operator new/frame\n",
+           1.0*(t1-t0)/n, 1.0*(a1-a0)/n);
+    printf("gen_listmap_important     : %8.2f us/frame, %6.1f operator new/frame, "
+           "%d/%d rows reallocated\n",
+           1.0*(t2-t1)/n, 1.0*(a2-a1)/n, nMoved, LMI_N);
+
+    if( a2 != a1 ) err ++;
+    printf("errors = %d\n", err);
+
+    return err;
+}
+
+int test_uas_shm_link(CParamArray *pa)
+{
+    std::string         name = fmt::sprintf("/SimpGCS_test_link_%d", getpid());
+    int                 err = 0;
+
+    UAS                 uas;
+    TelemetryShm        shm;
+    tshm_reader_t       r;
+    tshm_state_t        st;
+    mavlink_message_t   msg;
+
+    if( 0 != shm.open(name, 16) ) return 1;
+    if( 0 != tshm_open(&r, name.c_str()) ) { printf("can not open %s\n", name.c_str()); return 1; }
+
+    uas.set_shm(&shm);
+
+    // messages of one second: connected, readers see it with the messages
+    for(int i=0; i<5; i++) {
+        mavlink_msg_attitude_pack(1, 1, &msg, i, 0.1f, 0.2f, 0.3f, 0, 0, 0);
+        uas.parse_mavlink_msg(msg);
+    }
+    uas.link_check();
+
+    if( 0 != tshm_read_state(&r, &st) || st.link != 1 ) {
+        printf("connected: link = %d\n", st.link);
+        err ++;
+    }
+
+    // a second without messages: nothing but the link check publishes
+    uint64_t nUpdate = st.n_update;
+
+    if( uas.link_check() != 1 || uas.link_connected() != 0 ) err ++;
+
+    if( 0 != tshm_read_state(&r, &st) || st.link != 0 || st.n_update <= nUpdate ) {
+        printf("timeout: link = %d, %d updates\n", st.link, (int) (st.n_update - nUpdate));
+        err ++;
+    }
+
+    // no change, no publication
+    nUpdate = st.n_update;
+    if( uas.link_check() != 0 ) err ++;
+    if( 0 != tshm_read_state(&r, &st) || st.n_update != nUpdate ) err ++;
+
+    tshm_close(&r);
+    uas.set_shm(NULL);
+    shm.close();
+
+    printf("errors = %d\n", err);
+
+    return err;
+}
@@ -5,7 +5,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <rtk_timeseries.h>
+
 #include "utils_mavlink.h"
+#include "utils_filter.h"
+#include "utils_geodesy.h"
+#include "TelemetryShm.h"
+#include "MissionTransfer.h"
+#include "ParamManager.h"
+#include "StreamRate.h"
+#include "LinkStats.h"
+#include "MsgProfiler.h"
+#include "GeoFence.h"
 #include "qFlightInstruments.h"
 
 
@@ -19,6 +30,27 @@ enum UAS_Type
     UAS_TELEM   = 2,
 };
 
+/**
+ * @brief Groups of UAS state, each has its own generation counter
+ */
+enum UAS_StateGroup
+{
+    UAS_STATE_ATT       = 0,            ///< attitude
+    UAS_STATE_POS       = 1,            ///< GPS & global position
+    UAS_STATE_STATUS    = 2,            ///< system, sensors, RC, GCS & radio status
+    UAS_STATE_LINK      = 3,            ///< link connected/lost
+
+    UAS_STATE_N         = 4
+};
+
+#define UAS_STATE_MASK(g)   (1 << (g))
+#define UAS_STATE_ALL       ((1 << UAS_STATE_N) - 1)
+
+///
+/// \brief state changed notify function (called from the receiving thread)
+///
+typedef void (*UAS_StateNotify)(void *arg);
+
 /**
  * @brief The UAS class
  */
@@ -49,6 +81,8 @@ public:
     uint8_t                         uavMavlinkVersion;      ///< mavlink version
     int                             uavMavlinkChan;         ///< mavlink channel
 
+    mavlink_signing                 signing;                ///< MAVLink 2 signing of the link
+
     int                             uavSeverity;            ///< Severity of status. Relies on the definitions within RFC-5424. See enum MAV_SEVERITY.
     char                            uavStatusText[50];      ///< system status text
 
@@ -90,6 +124,11 @@ public:
     double                          lat, lon, alt;
     double                          latHome, lonHome, altHome, hHome;
     int                             homeSetCount;
+    rtk::GeoLocalFrame              homeFrame;              ///< ENU frame around home
+    double                          homeE, homeN, homeDis;  ///< position from home (m)
+    double                          pathLen;                ///< flown distance since home was set (m)
+    int                             fenceLevel;             ///< GeoFenceLevel of the vehicle of the last alert
+    char                            fenceText[64];          ///< last fence alert
     double                          HDOP_h, HDOP_v;
     double                          gpsGroundSpeed;
     int                             gpsFixType;
@@ -145,16 +184,40 @@ public:
 
 protected:
     rtk::RMutex                     *m_mutexMsgWrite;
+    rtk::RMutex                     m_mutexSign;            ///< pack, sign & queue as one step (any thread)
     rtk::OSA_HANDLE                 m_timer;
+    rtk::OSA_HANDLE                 m_timerTransfer;        ///< mission & parameter timeouts (20 ms)
     std::vector<uint8_t>            m_msgBuffer;
 
+    MissionTransfer                 m_mission;
+    ParamManager                    m_params;
+
     int                             m_bLinkConnected;
     uint64_t                        m_tmHB1, m_tmHB2;
     int                             m_pkgLost, m_pkgLastID;
     int                             m_recvMessageInSec;
     int                             m_uavStatusMsgTime;
 
-    ValueAverager<float>            m_avgBatMAV, m_avgBatGCS;
+    MovingAverage<float, 10>        m_avgBatMAV, m_avgBatGCS;   ///< battery voltage
+    EWMA<float>                     m_fltDropRate, m_fltDropRateGCS;
+    EWMA<float>                     m_fltRSSI, m_fltRSSIRemote;
+
+    QAtomicInt                      m_stateGen[UAS_STATE_N];///< state generations
+    UAS_StateNotify                 m_stateNotify;          ///< state changed notify
+    void                            *m_stateNotifyArg;
+
+    TelemetryShm                    *m_shm;                 ///< shared-memory publication (optional)
+    rtk::RMutex                     m_mutexShm;             ///< one state writer at a time (receiving
+                                                            ///<   thread, link timer)
+
+    rtk::RTimeSeriesStore           m_ts;                   ///< telemetry history for plots
+    rtk::RTimeSeries                *m_tsRoll, *m_tsPitch, *m_tsYaw;
+    rtk::RTimeSeries                *m_tsAlt, *m_tsH;
+    rtk::RTimeSeries                *m_tsBattVolt, *m_tsBattCurrent;
+    rtk::RTimeSeries                *m_tsRSSI;
+
+    int                             m_mavlinkTxVersion;     ///< protocol version of sent frames
+    int                             m_hbCount;
 
     int                             m_bStreamRequested;
     int                             m_frqStreamRawSensors;
@@ -166,6 +229,20 @@ protected:
     int                             m_frqStreamExtr2;
     int                             m_frqStreamExtr3;
 
+    LinkStats                       m_linkStats;            ///< per sender / msgid counters, round trip
+    LinkStatsSnapshot               m_linkSnapshot;
+    MsgProfiler                     m_msgProfiler;          ///< bytes per msgid & sender, sliding windows
+    GeoFenceEngine                  *m_fence;               ///< geofences of all vehicles (NULL: none)
+
+    StreamRateController            m_streamRate;           ///< stream rates from the link quality
+    std::vector<int>                m_streamReq;            ///< rates last requested (-1: none)
+    int                             m_radioStatusN;         ///< RADIO_STATUS in the last second
+    int                             m_radioRxErrLast;
+    uint64_t                        m_linkFramesLast;       ///< link statistics at the last rate update
+    uint64_t                        m_linkLostLast;
+
+    double                          m_pathE, m_pathN;       ///< last point of the flown distance
+
 public:
     int parse_mavlink_msg(mavlink_message_t &msg);
 
@@ -174,24 +251,175 @@ public:
     int parse_mavlink_msg_telem(mavlink_message_t &msg);
 
 
-    int send_mavlink_msg(mavlink_message_t &msg);
+    int send_mavlink_msg(mavlink_message_t &msg, int version = 0);
+
+    ///
+    /// \brief Request the data streams at the controller rates
+    /// \param all - 1: all streams, 0: only the changed rates
+    ///
+    int stream_request(int all);
+
+    ///
+    /// \brief Request only the streams of the UAS state groups shown by the UI
+    ///     (UAS_STATE_MASK), unless stream_shown is 0
+    ///
+    void stream_set_displayed(int stateMask);
+
+    StreamRateController* stream_rate(void) {
+        return &m_streamRate;
+    }
+
+    ///
+    /// \brief Link statistics, counted by the reading thread, a snapshot is
+    ///     taken every second (LinkStats::lastSnapshot)
+    ///
+    LinkStats* link_stats(void) {
+        return &m_linkStats;
+    }
+
+    ///
+    /// \brief Bandwidth per message type, counted by the reading thread
+    ///
+    MsgProfiler* msg_profiler(void) {
+        return &m_msgProfiler;
+    }
+
+    ///
+    /// \brief Evaluate every position (and terrain report) of all vehicles
+    ///     against the fences, alerts go to fenceLevel / fenceText
+    ///
+    void set_geofence(GeoFenceEngine *fence);
+
+    GeoFenceEngine* geofence(void) {
+        return m_fence;
+    }
 
     int put_msg_buff(uint8_t *buf, int len);
+
+    ///
+    /// \brief Take buffered messages for sending
+    /// \param len - in: buffer size (<= 0: no limit), out: data length
+    ///
     int get_msg_buff(uint8_t *buf, int *len);
 
+    ///
+    /// \brief One-line JSON snapshot of the vehicle state (headless state socket)
+    /// \return text length
+    ///
+    int state_json(char *buf, int len);
+
+    ///
+    /// \brief Publish the state snapshot to the shared memory (if set),
+    ///     from the receiving thread or the link check
+    ///
+    void shm_publish_state(void);
+
     int gen_listmap_important(ListMap &lm);
     int gen_listmap_all(ListMap &lm);
 
+    ///
+    /// \brief Bind info list rows to the telemetry fields of this UAS
+    ///
+    int bind_telemetry(QTelemetryModel *m);
+
+    ///
+    /// \brief Generation of a state group, it is changed after the group is updated
+    ///
+    uint32_t state_gen(int g) {
+        return m_stateGen[g].loadAcquire();
+    }
+
+    ///
+    /// \brief Sum of the generations of the groups in mask (UAS_STATE_MASK)
+    ///
+    uint32_t state_gen_mask(int mask) {
+        uint32_t gen = 0;
+
+        for(int i=0; i<UAS_STATE_N; i++)
+            if( mask & UAS_STATE_MASK(i) ) gen += m_stateGen[i].loadAcquire();
+
+        return gen;
+    }
+
+    ///
+    /// \brief Set the function called after any state group changed
+    ///
+    void set_state_notify(UAS_StateNotify fn, void *arg) {
+        m_stateNotifyArg = arg;
+        m_stateNotify    = fn;
+    }
+
+    void state_changed(int g) {
+        m_stateGen[g].fetchAndAddRelease(1);
+        if( m_stateNotify != NULL ) m_stateNotify(m_stateNotifyArg);
+    }
+
+    ///
+    /// \brief Telemetry history (channels: roll, pitch, yaw, gp_alt, gp_h,
+    ///     batt_volt, batt_current, radio_rssi), time in seconds
+    ///
+    rtk::RTimeSeriesStore* timeseries(void) {
+        return &m_ts;
+    }
+
+    ///
+    /// \brief Publish the state & received frames to a shared-memory segment
+    ///     (NULL to stop), the frames are given by the receiving thread
+    ///
+    void set_shm(TelemetryShm *shm) {
+        m_shm = shm;
+    }
+
+    TelemetryShm* shm(void) {
+        return m_shm;
+    }
+
     int link_connected(void) {
         return m_bLinkConnected;
     }
 
+    int mavlink_version(void) {
+        return m_mavlinkTxVersion;
+    }
+
+    int setSigningKey(const std::string &passphrase);
+
+    ///
+    /// \brief Start a mission upload / download (after beginRecv), progress
+    ///     and result from mission(), tunables mission_window, mission_push,
+    ///     mission_rto_min, mission_rto_max, mission_retry
+    /// \return 0 if started, MT_BUSY if a transfer is running
+    ///
+    int mission_upload(const MissionItems &items);
+    int mission_download(void);
+
+    MissionTransfer* mission(void) {
+        return &m_mission;
+    }
+
+    ///
+    /// \brief Get the parameters (cache or download), done automatically when
+    ///     the link comes up (param_auto), time to ready in params(); tunables
+    ///     param_window, param_rto_min, param_rto_max, param_retry
+    ///
+    int param_download(void);
+
+    ParamManager* params(void) {
+        return &m_params;
+    }
+
     int clearHome(void) {
         latHome = 9999;
         lonHome = 9999;
         altHome = 0;
         hHome   = 0;
 
+        homeFrame.clear();
+        homeE   = 0;
+        homeN   = 0;
+        homeDis = 0;
+        pathLen = 0;
+
         homeSetCount = 10;
     }
 
@@ -199,6 +427,17 @@ public:
     int beginRecv(void);
     int stopRecv(void);
     int timerFunction(void *arg);
+
+    ///
+    /// \brief Link state from the messages of the last second (timerFunction)
+    /// \return 1 if it changed
+    ///
+    int link_check(void);
 };
 
+
+int test_telemetry_bench(rtk::CParamArray *pa);
+int test_listmap_alloc(rtk::CParamArray *pa);
+int test_uas_shm_link(rtk::CParamArray *pa);
+
 #endif // end of __UAS_H__
@@ -1,12 +1,18 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include <QtCore>
 #include <QtGui>
 #include <QDebug>
 #include <QTableWidget>
 #include <QHeaderView>
+#include <QApplication>
+
+#include <rtk_utils.h>
+#include <rtk_paramarray.h>
+#include <rtk_trace.h>
 
 #include "qFlightInstruments.h"
 
@@ -33,6 +39,13 @@ QADI::QADI(QWidget *parent)
 
     m_roll  = 0.0;
     m_pitch = 0.0;
+
+    m_rollPainted  = 0.0;
+    m_pitchPainted = 0.0;
+
+    m_layerCache = 1;
+    m_layerSize  = 0;
+    m_layerDpr   = 0;
 }
 
 QADI::~QADI()
@@ -43,6 +56,13 @@ QADI::~QADI()
 
 void QADI::canvasReplot_slot(void)
 {
+    double r = m_size/2.0;
+
+    // skip repaint if the change moves nothing by half a pixel
+    if( fabs(m_roll  - m_rollPainted)*M_PI/180.0*r < 0.5 &&
+        fabs(m_pitch - m_pitchPainted)*r/45.0 < 0.5 )
+        return;
+
     update();
 }
 
@@ -52,80 +72,43 @@ void QADI::resizeEvent(QResizeEvent *event)
     m_size = qMin(width(),height()) - 2*m_offset;
 }
 
-void QADI::paintEvent(QPaintEvent *)
+void QADI::updateLayers(void)
 {
-    double      roll, pitch;
-
-    roll  = m_roll;
-    pitch = m_pitch;
-
-    QPainter painter(this);
-
-    QBrush bgSky(QColor(48,172,220));
-    QBrush bgGround(QColor(247,168,21));
-
-    QPen   whitePen(Qt::white);
-    QPen   blackPen(Qt::black);
-    QPen   pitchPen(Qt::white);
-    QPen   pitchZero(Qt::green);
-
-    whitePen.setWidth(2);
-    blackPen.setWidth(2);
-    pitchZero.setWidth(3);
+    qreal   dpr = devicePixelRatio();
 
-    painter.setRenderHint(QPainter::Antialiasing);
+    if( m_layerCache && m_layerSize == m_size && m_layerDpr == dpr ) return;
 
-    painter.translate(width() / 2, height() / 2);
-    painter.rotate(roll);
+    RTK_TRACE_ZONE("QADI::updateLayers");
 
-    // FIXME: AHRS output left-hand values
-    double pitch_tem = -pitch;
+    m_layerSize = m_size;
+    m_layerDpr  = dpr;
 
-    // draw background
+    // pitch lines & labels (-90 ~ 90 deg, pitch 0 at the center)
     {
-        int y_min, y_max;
-
-        y_min = m_size/2*-40.0/45.0;
-        y_max = m_size/2* 40.0/45.0;
-
-        int y = m_size/2*pitch_tem/45.;
-        if( y < y_min ) y = y_min;
-        if( y > y_max ) y = y_max;
-
-        int x = sqrt(m_size*m_size/4 - y*y);
-        qreal gr = atan((double)(y)/x);
-        gr = gr * 180./3.1415926;
-
-        painter.setPen(blackPen);
-        painter.setBrush(bgSky);
-        painter.drawChord(-m_size/2, -m_size/2, m_size, m_size,
-                          gr*16, (180-2*gr)*16);
-
-        painter.setBrush(bgGround);
-        painter.drawChord(-m_size/2, -m_size/2, m_size, m_size,
-                          gr*16, -(180+2*gr)*16);
-    }
-
-    // set mask
-    QRegion maskRegion(-m_size/2, -m_size/2, m_size, m_size, QRegion::Ellipse);
-    painter.setClipRegion(maskRegion);
-
-
-    // draw pitch lines & marker
-    {
-        int x, y, x1, y1;
-        int textWidth;
-        double p, r;
-        int ll = m_size/8, l;
+        int     w = m_size, h = 2*m_size + 40;
+        int     x, y, x1, y1;
+        int     textWidth;
+        double  p;
+        int     ll = m_size/8, l;
 
         int     fontSize = 8;
         QString s;
 
+        QPen    pitchPen(Qt::white);
+        QPen    pitchZero(Qt::green);
+
         pitchPen.setWidth(2);
-        painter.setFont(QFont("", fontSize));
+        pitchZero.setWidth(3);
 
+        m_layerLadder = QPixmap(w*dpr, h*dpr);
+        m_layerLadder.setDevicePixelRatio(dpr);
+        m_layerLadder.fill(Qt::transparent);
+
+        QPainter painter(&m_layerLadder);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.translate(w/2, h/2);
+        painter.setFont(QFont("", fontSize));
 
-        // draw lines
         for(int i=-9; i<=9; i++) {
             p = i*10;
 
@@ -143,12 +126,9 @@ void QADI::paintEvent(QPaintEvent *)
                 painter.setPen(pitchPen);
             }
 
-            y = m_size/2*p/45.0 - m_size/2*pitch_tem/45.;
+            y = m_size/2*p/45.0;
             x = l;
 
-            r = sqrt(x*x + y*y);
-            if( r > m_size/2 ) continue;
-
             painter.drawLine(QPointF(-l, 1.0*y), QPointF(l, 1.0*y));
 
             textWidth = 100;
@@ -162,45 +142,57 @@ void QADI::paintEvent(QPaintEvent *)
                                  Qt::AlignRight|Qt::AlignVCenter, s);
             }
         }
+    }
+
+    // roll degree lines & pitch marker (rotate with roll)
+    {
+        int     w = m_size + 2*m_offset;
+        int     nRollLines = 36;
+        float   rotAng = 360.0 / nRollLines;
+        int     rollLineLeng = m_size/25;
+        double  fx1, fy1, fx2, fy2;
+        int     fontSize = 8;
+        QString s;
+
+        QPen    blackPen(Qt::black);
+
+        m_layerScale = QPixmap(w*dpr, w*dpr);
+        m_layerScale.setDevicePixelRatio(dpr);
+        m_layerScale.fill(Qt::transparent);
+
+        QPainter painter(&m_layerScale);
+        painter.setRenderHint(QPainter::Antialiasing);
+        painter.translate(w/2, w/2);
 
         // draw marker
         int     markerSize = m_size/20;
-        float   fx1, fy1, fx2, fy2, fx3, fy3;
+        float   mx1, my1, mx2, my2, mx3, my3;
 
         painter.setBrush(QBrush(Qt::red));
         painter.setPen(Qt::NoPen);
 
-        fx1 = markerSize;
-        fy1 = 0;
-        fx2 = fx1 + markerSize;
-        fy2 = -markerSize/2;
-        fx3 = fx1 + markerSize;
-        fy3 = markerSize/2;
+        mx1 = markerSize;
+        my1 = 0;
+        mx2 = mx1 + markerSize;
+        my2 = -markerSize/2;
+        mx3 = mx1 + markerSize;
+        my3 = markerSize/2;
 
         QPointF points[3] = {
-            QPointF(fx1, fy1),
-            QPointF(fx2, fy2),
-            QPointF(fx3, fy3)
+            QPointF(mx1, my1),
+            QPointF(mx2, my2),
+            QPointF(mx3, my3)
         };
         painter.drawPolygon(points, 3);
 
         QPointF points2[3] = {
-            QPointF(-fx1, fy1),
-            QPointF(-fx2, fy2),
-            QPointF(-fx3, fy3)
+            QPointF(-mx1, my1),
+            QPointF(-mx2, my2),
+            QPointF(-mx3, my3)
         };
         painter.drawPolygon(points2, 3);
-    }
-
-    // draw roll degree lines
-    {
-        int     nRollLines = 36;
-        float   rotAng = 360.0 / nRollLines;
-        int     rollLineLeng = m_size/25;
-        double  fx1, fy1, fx2, fy2;
-        int     fontSize = 8;
-        QString s;
 
+        // draw roll lines
         blackPen.setWidth(1);
         painter.setPen(blackPen);
         painter.setFont(QFont("", fontSize));
@@ -230,6 +222,83 @@ void QADI::paintEvent(QPaintEvent *)
             painter.rotate(rotAng);
         }
     }
+}
+
+void QADI::paintEvent(QPaintEvent *)
+{
+    RTK_TRACE_ZONE("QADI::paintEvent");
+
+    double      roll, pitch;
+
+    roll  = m_roll;
+    pitch = m_pitch;
+
+    m_rollPainted  = roll;
+    m_pitchPainted = pitch;
+
+    updateLayers();
+
+    QPainter painter(this);
+
+    QBrush bgSky(QColor(48,172,220));
+    QBrush bgGround(QColor(247,168,21));
+
+    QPen   blackPen(Qt::black);
+
+    blackPen.setWidth(2);
+
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setRenderHint(QPainter::SmoothPixmapTransform);
+
+    painter.translate(width() / 2, height() / 2);
+    painter.rotate(roll);
+
+    // FIXME: AHRS output left-hand values
+    double pitch_tem = -pitch;
+
+    // draw background
+    {
+        int y_min, y_max;
+
+        y_min = m_size/2*-40.0/45.0;
+        y_max = m_size/2* 40.0/45.0;
+
+        int y = m_size/2*pitch_tem/45.;
+        if( y < y_min ) y = y_min;
+        if( y > y_max ) y = y_max;
+
+        int x = sqrt(m_size*m_size/4 - y*y);
+        qreal gr = atan((double)(y)/x);
+        gr = gr * 180./3.1415926;
+
+        painter.setPen(blackPen);
+        painter.setBrush(bgSky);
+        painter.drawChord(-m_size/2, -m_size/2, m_size, m_size,
+                          gr*16, (180-2*gr)*16);
+
+        painter.setBrush(bgGround);
+        painter.drawChord(-m_size/2, -m_size/2, m_size, m_size,
+                          gr*16, -(180+2*gr)*16);
+    }
+
+    // draw pitch lines (masked by the ball)
+    {
+        QPainterPath mask;
+        mask.addEllipse(-m_size/2, -m_size/2, m_size, m_size);
+
+        painter.save();
+        painter.setClipPath(mask);
+        painter.drawPixmap(QPointF(-m_size/2, -(2*m_size + 40)/2 - m_size/2*pitch_tem/45.),
+                           m_layerLadder);
+        painter.restore();
+    }
+
+    // draw roll degree lines & pitch marker
+    {
+        int w = m_size + 2*m_offset;
+
+        painter.drawPixmap(QPointF(-w/2, -w/2), m_layerScale);
+    }
 
     // draw roll marker
     {
@@ -237,6 +306,8 @@ void QADI::paintEvent(QPaintEvent *)
         double  fx1, fy1, fx2, fy2, fx3, fy3;
 
         painter.rotate(-roll);
+        blackPen.setWidth(1);
+        painter.setPen(blackPen);
         painter.setBrush(QBrush(Qt::black));
 
         fx1 = 0;
@@ -304,6 +375,14 @@ QCompass::QCompass(QWidget *parent)
     m_yaw  = 0.0;
     m_alt  = 0.0;
     m_h    = 0.0;
+
+    m_yawPainted = 0.0;
+    m_altPainted = 0.0;
+    m_hPainted   = 0.0;
+
+    m_layerCache = 1;
+    m_layerSize  = 0;
+    m_layerDpr   = 0;
 }
 
 QCompass::~QCompass()
@@ -314,6 +393,15 @@ QCompass::~QCompass()
 
 void QCompass::canvasReplot_slot(void)
 {
+    double r = m_size/2.0;
+
+    // skip repaint if the marker moves less than half a pixel and the
+    // displayed altitude text is the same
+    if( fabs(m_yaw - m_yawPainted)*M_PI/180.0*r < 0.5 &&
+        qRound(m_alt*10) == qRound(m_altPainted*10) &&
+        qRound(m_h*10)   == qRound(m_hPainted*10) )
+        return;
+
     update();
 }
 
@@ -322,27 +410,38 @@ void QCompass::resizeEvent(QResizeEvent *event)
     m_size = qMin(width(),height()) - 2*m_offset;
 }
 
-void QCompass::paintEvent(QPaintEvent *)
+void QCompass::updateLayers(void)
 {
-    QPainter painter(this);
+    qreal   dpr = devicePixelRatio();
+
+    if( m_layerCache && m_layerSize == m_size && m_layerDpr == dpr ) return;
+
+    RTK_TRACE_ZONE("QCompass::updateLayers");
+
+    m_layerSize = m_size;
+    m_layerDpr  = dpr;
+
+    int     w = m_size + 2*m_offset + 4;
+
+    m_layerStatic = QPixmap(w*dpr, w*dpr);
+    m_layerStatic.setDevicePixelRatio(dpr);
+    m_layerStatic.fill(Qt::transparent);
+
+    QPainter painter(&m_layerStatic);
 
     QBrush bgGround(QColor(48,172,220));
 
-    QPen   whitePen(Qt::white);
     QPen   blackPen(Qt::black);
     QPen   redPen(Qt::red);
     QPen   bluePen(Qt::blue);
-    QPen   greenPen(Qt::green);
 
-    whitePen.setWidth(1);
     blackPen.setWidth(2);
     redPen.setWidth(2);
     bluePen.setWidth(2);
-    greenPen.setWidth(2);
 
     painter.setRenderHint(QPainter::Antialiasing);
 
-    painter.translate(width() / 2, height() / 2);
+    painter.translate(w/2, w/2);
 
 
     // draw background
@@ -453,6 +552,36 @@ void QCompass::paintEvent(QPaintEvent *)
         };
         painter.drawPolygon(pointsS, 3);
     }
+}
+
+void QCompass::paintEvent(QPaintEvent *)
+{
+    RTK_TRACE_ZONE("QCompass::paintEvent");
+
+    m_yawPainted = m_yaw;
+    m_altPainted = m_alt;
+    m_hPainted   = m_h;
+
+    updateLayers();
+
+    QPainter painter(this);
+
+    QPen   blackPen(Qt::black);
+    QPen   bluePen(Qt::blue);
+
+    blackPen.setWidth(1);
+    bluePen.setWidth(2);
+
+    painter.setRenderHint(QPainter::Antialiasing);
+
+    painter.translate(width() / 2, height() / 2);
+
+    // draw background, yaw lines & S/N arrow
+    {
+        int w = m_size + 2*m_offset + 4;
+
+        painter.drawPixmap(QPointF(-w/2, -w/2), m_layerStatic);
+    }
 
 
     // draw yaw marker
@@ -461,6 +590,7 @@ void QCompass::paintEvent(QPaintEvent *)
         double  fx1, fy1, fx2, fy2, fx3, fy3;
 
         painter.rotate(m_yaw);
+        painter.setPen(Qt::NoPen);
         painter.setBrush(QBrush(QColor(0xFF, 0x00, 0x00, 0xE0)));
 
         fx1 = 0;
@@ -576,6 +706,8 @@ QKeyValueListView::~QKeyValueListView()
 
 void QKeyValueListView::listUpdate_slot(void)
 {
+    RTK_TRACE_ZONE("QKeyValueListView::listUpdate_slot");
+
     int                 i, n;
     ListMap::iterator   it;
 
@@ -634,3 +766,351 @@ void QKeyValueListView::listUpdate_slot(void)
 
     m_mutex->unlock();
 }
+
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+// half of the last printed digit of a "%W.Pf" format
+static double fmt_eps(const char *fmt)
+{
+    const char  *p = strchr(fmt, '.');
+    int         prec = 6;
+
+    if( p != NULL && p[1] >= '0' && p[1] <= '9' ) prec = atoi(p+1);
+
+    return 0.5 * pow(10.0, -prec);
+}
+
+QTelemetryModel::QTelemetryModel(QObject *parent) : QAbstractTableModel(parent)
+{
+    m_nFormat = 0;
+
+    m_font    = QFont("", 8);
+    m_clName  = QColor(0x00, 0x00, 0xFF);
+    m_clValue = QColor(0x00, 0x00, 0x00);
+    m_clB1    = QColor(0xFF, 0xFF, 0xFF);
+    m_clB2    = QColor(0xE0, 0xE0, 0xE0);
+}
+
+QTelemetryModel::~QTelemetryModel()
+{
+}
+
+int QTelemetryModel::addField(TelemetryField &f)
+{
+    int n = m_fields.size();
+
+    f.lastVal     = 0;
+    f.tmLast      = 0;
+    f.lastText[0] = 0;
+    f.valid       = 0;
+
+    beginInsertRows(QModelIndex(), n, n);
+    m_fields.append(f);
+    endInsertRows();
+
+    return n;
+}
+
+int QTelemetryModel::addField(const QString &name, const int *v, const char *fmt,
+                              double eps, int minInterval)
+{
+    TelemetryField f;
+
+    f.name = name;      f.type = TelemetryField::TF_INT;
+    f.ptr  = v;         f.fmt  = fmt;
+    f.eps  = eps < 0 ? 0 : eps;
+    f.minInterval = minInterval;
+    f.func = NULL;      f.obj  = NULL;
+
+    return addField(f);
+}
+
+int QTelemetryModel::addField(const QString &name, const float *v, const char *fmt,
+                              double eps, int minInterval)
+{
+    TelemetryField f;
+
+    f.name = name;      f.type = TelemetryField::TF_FLOAT;
+    f.ptr  = v;         f.fmt  = fmt;
+    f.eps  = eps < 0 ? fmt_eps(fmt) : eps;
+    f.minInterval = minInterval;
+    f.func = NULL;      f.obj  = NULL;
+
+    return addField(f);
+}
+
+int QTelemetryModel::addField(const QString &name, const double *v, const char *fmt,
+                              double eps, int minInterval)
+{
+    TelemetryField f;
+
+    f.name = name;      f.type = TelemetryField::TF_DOUBLE;
+    f.ptr  = v;         f.fmt  = fmt;
+    f.eps  = eps < 0 ? fmt_eps(fmt) : eps;
+    f.minInterval = minInterval;
+    f.func = NULL;      f.obj  = NULL;
+
+    return addField(f);
+}
+
+int QTelemetryModel::addField(const QString &name, TelemetryFormatFunc func, void *obj,
+                              int minInterval)
+{
+    TelemetryField f;
+
+    f.name = name;      f.type = TelemetryField::TF_FUNC;
+    f.ptr  = NULL;      f.fmt  = NULL;
+    f.eps  = 0;
+    f.minInterval = minInterval;
+    f.func = func;      f.obj  = obj;
+
+    return addField(f);
+}
+
+void QTelemetryModel::clearFields(void)
+{
+    beginResetModel();
+    m_fields.clear();
+    endResetModel();
+}
+
+int QTelemetryModel::updateField(TelemetryField &f, rtk::ru64 tmNow)
+{
+    char        buf[96];
+    const char  *p;
+    double      v;
+
+    // rate limit
+    if( f.valid && f.minInterval > 0 && tmNow - f.tmLast < (rtk::ru64) f.minInterval )
+        return 0;
+
+    if( f.type == TelemetryField::TF_FUNC ) {
+        buf[0] = 0;
+        f.func(f.obj, buf, sizeof(buf));
+        buf[sizeof(buf)-1] = 0;
+
+        if( f.valid && strcmp(buf, f.lastText) == 0 ) return 0;
+        strcpy(f.lastText, buf);
+        p = buf;
+    } else {
+        if( f.type == TelemetryField::TF_INT )          v = *((const int*) f.ptr);
+        else if( f.type == TelemetryField::TF_FLOAT )   v = *((const float*) f.ptr);
+        else                                            v = *((const double*) f.ptr);
+
+        if( f.valid && (v == f.lastVal || fabs(v - f.lastVal) < f.eps) ) return 0;
+        f.lastVal = v;
+
+        if( f.type == TelemetryField::TF_INT )
+            snprintf(buf, sizeof(buf), f.fmt, (int) v);
+        else
+            snprintf(buf, sizeof(buf), f.fmt, v);
+
+        // remove padding of the format
+        p = buf;
+        while( *p == ' ' ) p++;
+    }
+
+    f.text   = QString::fromUtf8(p);
+    f.tmLast = tmNow;
+    f.valid  = 1;
+    m_nFormat ++;
+
+    return 1;
+}
+
+int QTelemetryModel::update(void)
+{
+    RTK_TRACE_ZONE("QTelemetryModel::update");
+
+    rtk::ru64   tmNow = rtk::tm_get_ms();
+    int         i, n = m_fields.size();
+    int         nChanged = 0, r0 = -1;
+
+    // notify each contiguous range of changed rows once
+    for(i=0; i<n; i++) {
+        if( updateField(m_fields[i], tmNow) ) {
+            nChanged ++;
+            if( r0 < 0 ) r0 = i;
+        } else if( r0 >= 0 ) {
+            emit dataChanged(index(r0, 1), index(i-1, 1));
+            r0 = -1;
+        }
+    }
+    if( r0 >= 0 ) emit dataChanged(index(r0, 1), index(n-1, 1));
+
+    return nChanged;
+}
+
+int QTelemetryModel::rowCount(const QModelIndex &parent) const
+{
+    if( parent.isValid() ) return 0;
+    return m_fields.size();
+}
+
+int QTelemetryModel::columnCount(const QModelIndex &parent) const
+{
+    if( parent.isValid() ) return 0;
+    return 2;
+}
+
+QVariant QTelemetryModel::data(const QModelIndex &index, int role) const
+{
+    if( !index.isValid() || index.row() >= m_fields.size() ) return QVariant();
+
+    const TelemetryField &f = m_fields[index.row()];
+
+    switch( role ) {
+    case Qt::DisplayRole:
+        if( index.column() == 0 ) return f.name;
+        else                      return f.text;
+
+    case Qt::ForegroundRole:
+        return QBrush(index.column() == 0 ? m_clName : m_clValue);
+
+    case Qt::BackgroundRole:
+        return QBrush(index.row() % 2 == 0 ? m_clB1 : m_clB2);
+
+    case Qt::FontRole:
+        return m_font;
+    }
+
+    return QVariant();
+}
+
+
+QTelemetryListView::QTelemetryListView(QWidget *parent) : QTableView(parent)
+{
+    m_model = new QTelemetryModel(this);
+    setModel(m_model);
+
+    // set no headers
+    verticalHeader()->hide();
+    horizontalHeader()->hide();
+
+    // set last section is stretch-able, fixed row height
+    QHeaderView *HorzHdr = horizontalHeader();
+    HorzHdr->setStretchLastSection(true);
+    HorzHdr->resizeSection(0, 80);     // set first column width
+    verticalHeader()->setDefaultSectionSize(20);
+
+    // disable table edit & focus
+    setEditTriggers(QTableView::NoEditTriggers);
+    setFocusPolicy(Qt::NoFocus);
+}
+
+QTelemetryListView::~QTelemetryListView()
+{
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// instruments paint benchmark (offscreen, QT_QPA_PLATFORM=offscreen works)
+////////////////////////////////////////////////////////////////////////////////
+
+class CountingADI : public QADI
+{
+public:
+    CountingADI() : nPaint(0) {}
+    int nPaint;
+
+protected:
+    void paintEvent(QPaintEvent *event) { nPaint++; QADI::paintEvent(event); }
+};
+
+class CountingCompass : public QCompass
+{
+public:
+    CountingCompass() : nPaint(0) {}
+    int nPaint;
+
+protected:
+    void paintEvent(QPaintEvent *event) { nPaint++; QCompass::paintEvent(event); }
+};
+
+int test_instruments_bench(rtk::CParamArray *pa)
+{
+    int         argc;
+    char**      argv;
+    int         n = 1000, size = 300;
+    rtk::ru64   t0, t1, t2;
+
+    argc = pa->i("argc");
+    argv = (char**) pa->p("argv");
+    pa->i("n", n);
+    pa->i("size", size);
+
+    QApplication app(argc, argv);
+
+    QADI        adi;
+    QCompass    compass;
+    QImage      img(size, size, QImage::Format_ARGB32_Premultiplied);
+
+    adi.resize(size, size);
+    compass.resize(size, size);
+
+    // warm up (fonts, first layer rendering)
+    adi.render(&img);
+    compass.render(&img);
+
+    // full repaint every frame (static layers re-rendered)
+    adi.setLayerCache(0);
+    compass.setLayerCache(0);
+
+    t0 = rtk::tm_get_us();
+    for(int i=0; i<n; i++) {
+        adi.setData(20*sin(i*0.02), 10*sin(i*0.013));
+        adi.render(&img);
+    }
+    t1 = rtk::tm_get_us();
+    for(int i=0; i<n; i++) {
+        compass.setData(fmod(i*0.5, 360.0), 500 + i*0.01, 50 + i*0.01);
+        compass.render(&img);
+    }
+    t2 = rtk::tm_get_us();
+
+    printf("no layer cache : QADI %8.1f us/frame, QCompass %8.1f us/frame\n",
+           1.0*(t1-t0)/n, 1.0*(t2-t1)/n);
+
+    // cached static layers
+    adi.setLayerCache(1);
+    compass.setLayerCache(1);
+
+    t0 = rtk::tm_get_us();
+    for(int i=0; i<n; i++) {
+        adi.setData(20*sin(i*0.02), 10*sin(i*0.013));
+        adi.render(&img);
+    }
+    t1 = rtk::tm_get_us();
+    for(int i=0; i<n; i++) {
+        compass.setData(fmod(i*0.5, 360.0), 500 + i*0.01, 50 + i*0.01);
+        compass.render(&img);
+    }
+    t2 = rtk::tm_get_us();
+
+    printf("layer cache    : QADI %8.1f us/frame, QCompass %8.1f us/frame\n",
+           1.0*(t1-t0)/n, 1.0*(t2-t1)/n);
+
+    // repaints actually done for a hovering vehicle (sub-pixel attitude noise)
+    CountingADI     adiShown;
+    CountingCompass compassShown;
+
+    adiShown.resize(size, size);
+    compassShown.resize(size, size);
+    adiShown.show();
+    compassShown.show();
+    app.processEvents();
+    adiShown.nPaint = compassShown.nPaint = 0;
+
+    for(int i=0; i<n; i++) {
+        adiShown.setData(0.02*sin(i*1.7), 0.02*sin(i*1.1));
+        compassShown.setData(90 + 0.02*sin(i*1.3), 500.0, 50.0);
+        app.processEvents();
+    }
+
+    printf("hover noise    : QADI %d / %d, QCompass %d / %d setData repainted\n",
+           adiShown.nPaint, n, compassShown.nPaint, n);
+
+    return 0;
+}
@@ -5,7 +5,10 @@
 #include <QtGui>
 #include <QWidget>
 #include <QMap>
+#include <QVector>
 #include <QTableWidget>
+#include <QTableView>
+#include <QAbstractTableModel>
 
 #include <rtk_osa++.h>
 
@@ -75,6 +78,11 @@ public:
     ///
     double getPitch(){return m_pitch;}
 
+    ///
+    /// \brief Enable/disable caching of the static layers (for profiling)
+    ///
+    void setLayerCache(int en) { m_layerCache = en; update(); }
+
 
 signals:
     void canvasReplot(void);
@@ -87,12 +95,21 @@ protected:
     void resizeEvent(QResizeEvent *event);
     void keyPressEvent(QKeyEvent *event);
 
+    void updateLayers(void);
+
 protected:
     int     m_sizeMin, m_sizeMax;           ///< widget's min/max size (in pixel)
     int     m_size, m_offset;               ///< current size & offset
 
     double  m_roll;                         ///< roll angle (in degree)
     double  m_pitch;                        ///< pitch angle (in degree)
+    double  m_rollPainted, m_pitchPainted;  ///< values of the last paint
+
+    QPixmap m_layerLadder;                  ///< pitch lines & labels
+    QPixmap m_layerScale;                   ///< roll lines & pitch marker
+    int     m_layerCache;                   ///< cache static layers or not
+    int     m_layerSize;                    ///< size of the cached layers
+    qreal   m_layerDpr;                     ///< device pixel ratio of the cached layers
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -177,6 +194,11 @@ public:
     ///
     double getH()   {return m_h;}
 
+    ///
+    /// \brief Enable/disable caching of the static layers (for profiling)
+    ///
+    void setLayerCache(int en) { m_layerCache = en; update(); }
+
 signals:
     void canvasReplot(void);
 
@@ -188,6 +210,8 @@ protected:
     void resizeEvent(QResizeEvent *event);
     void keyPressEvent(QKeyEvent *event);
 
+    void updateLayers(void);
+
 protected:
     int     m_sizeMin, m_sizeMax;               ///< widget min/max size (in pixel)
     int     m_size, m_offset;                   ///< widget size and offset size
@@ -195,6 +219,12 @@ protected:
     double  m_yaw;                              ///< yaw angle (in degree)
     double  m_alt;                              ///< altitude (in m)
     double  m_h;                                ///< height from ground (in m)
+    double  m_yawPainted, m_altPainted, m_hPainted; ///< values of the last paint
+
+    QPixmap m_layerStatic;                      ///< background, yaw lines & S/N arrow
+    int     m_layerCache;                       ///< cache static layers or not
+    int     m_layerSize;                        ///< size of the cached layers
+    qreal   m_layerDpr;                         ///< device pixel ratio of the cached layers
 };
 
 
@@ -258,4 +288,137 @@ protected:
     rtk::RMutex     *m_mutex;
 };
 
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+
+///
+/// \brief format function of a computed telemetry field
+/// \param obj - user object
+/// \param buf - output text buffer
+/// \param len - buffer length
+///
+typedef void (*TelemetryFormatFunc)(void *obj, char *buf, int len);
+
+///
+/// \brief A telemetry row bound to a typed value
+///
+struct TelemetryField
+{
+    enum Type {
+        TF_INT,
+        TF_FLOAT,
+        TF_DOUBLE,
+        TF_FUNC,                                ///< value computed & formatted by func
+    };
+
+    QString                 name;               ///< row name
+    Type                    type;               ///< value type
+    const void              *ptr;               ///< bound value
+    const char              *fmt;               ///< printf format of the value
+    double                  eps;                ///< minimum change to re-format
+    int                     minInterval;        ///< minimum update interval (ms)
+
+    TelemetryFormatFunc     func;               ///< TF_FUNC: format function
+    void                    *obj;               ///< TF_FUNC: function argument
+
+    double                  lastVal;            ///< value of the displayed text
+    rtk::ru64               tmLast;             ///< time of the last update (ms)
+    char                    lastText[96];       ///< displayed text (TF_FUNC compare)
+    QString                 text;               ///< displayed text
+    int                     valid;              ///< text formatted at least once
+};
+
+///
+/// \brief Fixed-schema key/value table model
+///
+///     Rows are bound to typed fields once. update() polls the bound values,
+///     formats only the changed ones (per-field epsilon & rate limit) and
+///     emits dataChanged() for each contiguous range of changed rows.
+///
+class QTelemetryModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    QTelemetryModel(QObject *parent = 0);
+    virtual ~QTelemetryModel();
+
+    ///
+    /// \brief Add a row bound to a value
+    /// \param name - row name
+    /// \param v - value pointer (must stay valid)
+    /// \param fmt - printf format
+    /// \param eps - minimum change to update (< 0: half of the last printed digit)
+    /// \param minInterval - minimum update interval (ms)
+    /// \return row index
+    ///
+    int addField(const QString &name, const int *v, const char *fmt = "%d",
+                 double eps = 0, int minInterval = 0);
+    int addField(const QString &name, const float *v, const char *fmt,
+                 double eps = -1, int minInterval = 0);
+    int addField(const QString &name, const double *v, const char *fmt,
+                 double eps = -1, int minInterval = 0);
+
+    ///
+    /// \brief Add a row computed by a function, updated if its text changes
+    ///
+    int addField(const QString &name, TelemetryFormatFunc func, void *obj,
+                 int minInterval = 0);
+
+    ///
+    /// \brief Remove all rows
+    ///
+    void clearFields(void);
+
+    ///
+    /// \brief Poll bound values & notify views of the changed rows
+    /// \return number of changed rows
+    ///
+    Q_INVOKABLE int update(void);
+
+    ///
+    /// \brief Number of formatted values since created (for profiling)
+    ///
+    rtk::ru64 formatCount(void) { return m_nFormat; }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+protected:
+    int addField(TelemetryField &f);
+    int updateField(TelemetryField &f, rtk::ru64 tmNow);
+
+    QVector<TelemetryField> m_fields;
+    rtk::ru64               m_nFormat;
+
+    QFont                   m_font;
+    QColor                  m_clName, m_clValue;
+    QColor                  m_clB1, m_clB2;
+};
+
+///
+/// \brief Key/value view of a QTelemetryModel (same look as QKeyValueListView)
+///
+class QTelemetryListView : public QTableView
+{
+    Q_OBJECT
+
+public:
+    QTelemetryListView(QWidget *parent = 0);
+    virtual ~QTelemetryListView();
+
+    QTelemetryModel* telemetryModel(void) { return m_model; }
+
+protected:
+    QTelemetryModel         *m_model;
+};
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_instruments_bench(rtk::CParamArray *pa);
+
 #endif // end of __QFLIGHTINSTRUMENTS_H__
@@ -0,0 +1,150 @@
+/*
+ * Shared-memory telemetry, reader side (see telemetry_shm.h)
+ */
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "telemetry_shm.h"
+
+
+int tshm_open(tshm_reader_t *r, const char *name)
+{
+    struct stat         sb;
+    const tshm_header_t *h;
+    void                *p;
+
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+
+    r->fd = shm_open(name, O_RDONLY, 0);
+    if( r->fd < 0 ) return -1;
+
+    if( 0 != fstat(r->fd, &sb) || (size_t) sb.st_size < sizeof(tshm_header_t) ) {
+        tshm_close(r);
+        return -1;
+    }
+
+    p = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, r->fd, 0);
+    if( p == MAP_FAILED ) {
+        tshm_close(r);
+        return -1;
+    }
+
+    r->size = sb.st_size;
+    r->hdr  = h = (const tshm_header_t*) p;
+
+    if( h->magic != TSHM_MAGIC || h->version != TSHM_VERSION ||
+        h->header_size != sizeof(tshm_header_t) ||
+        h->slot_size   != sizeof(tshm_slot_t) ||
+        h->state_size  != sizeof(tshm_state_t) ||
+        h->n_slots == 0 || (h->n_slots & (h->n_slots - 1)) != 0 ||
+        r->size < h->header_size + (size_t) h->n_slots * h->slot_size ) {
+        tshm_close(r);
+        return -2;
+    }
+
+    r->slots = (const tshm_slot_t*) ((const uint8_t*) p + h->header_size);
+    r->next  = h->head;
+    r->lost  = 0;
+
+    return 0;
+}
+
+void tshm_close(tshm_reader_t *r)
+{
+    if( r->hdr != NULL ) munmap((void*) r->hdr, r->size);
+    if( r->fd >= 0 ) close(r->fd);
+
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+int tshm_read_state(tshm_reader_t *r, tshm_state_t *st)
+{
+    const tshm_header_t *h = r->hdr;
+    uint64_t            s1, s2;
+    int                 i;
+
+    for(i=0; i<1000; i++) {
+        s1 = h->state_seq;
+        if( s1 & 1 ) continue;
+        TSHM_RMB();
+
+        memcpy(st, (const void*) &h->state, sizeof(*st));
+
+        TSHM_RMB();
+        s2 = h->state_seq;
+        if( s1 == s2 ) return 0;
+    }
+
+    return -1;
+}
+
+/* the writer lapped us: skip to half a ring behind it */
+static void tshm_resync(tshm_reader_t *r)
+{
+    uint64_t head = r->hdr->head, next;
+
+    next = head > r->hdr->n_slots / 2 ? head - r->hdr->n_slots / 2 : 0;
+    if( next > r->next ) r->lost += next - r->next;
+    else                 r->lost ++;
+
+    r->next = next > r->next ? next : r->next + 1;
+}
+
+const tshm_slot_t* tshm_packet_peek(tshm_reader_t *r)
+{
+    const tshm_slot_t   *s;
+    uint64_t            head;
+
+    for(;;) {
+        head = r->hdr->head;
+        TSHM_RMB();
+
+        if( r->next >= head ) return NULL;
+
+        s = &r->slots[r->next & (r->hdr->n_slots - 1)];
+        if( s->seq == r->next + 1 ) {
+            TSHM_RMB();
+            return s;
+        }
+
+        tshm_resync(r);
+    }
+}
+
+int tshm_packet_done(tshm_reader_t *r, const tshm_slot_t *s)
+{
+    TSHM_RMB();
+
+    if( s->seq != r->next + 1 ) {
+        tshm_resync(r);
+        return -1;
+    }
+
+    r->next ++;
+    return 0;
+}
+
+int tshm_read_packet(tshm_reader_t *r, uint8_t *buf, int len, uint64_t *time_us)
+{
+    const tshm_slot_t   *s;
+    int                 n;
+
+    while( (s = tshm_packet_peek(r)) != NULL ) {
+        n = s->len;
+        if( n > TSHM_SLOT_DATA ) n = TSHM_SLOT_DATA;
+        if( n > len ) n = len;
+
+        memcpy(buf, s->data, n);
+        if( time_us != NULL ) *time_us = s->time_us;
+
+        if( 0 == tshm_packet_done(r, s) ) return n;
+    }
+
+    return 0;
+}
@@ -0,0 +1,138 @@
+#ifndef __TELEMETRY_SHM_H__
+#define __TELEMETRY_SHM_H__
+
+/*
+ * Shared-memory telemetry (C reader API)
+ *
+ *  SimpGCS publishes the vehicle state and the received MAVLink frames into
+ *  a POSIX shared-memory segment (option -shm_name, e.g. "/SimpGCS"). Local
+ *  processes map it read-only, any number of them, without disturbing the
+ *  writer:
+ *
+ *      tshm_reader_t   r;
+ *      tshm_state_t    st;
+ *      const tshm_slot_t *s;
+ *
+ *      if( 0 != tshm_open(&r, "/SimpGCS") ) return -1;
+ *
+ *      tshm_read_state(&r, &st);
+ *
+ *      while( (s = tshm_packet_peek(&r)) != NULL ) {
+ *          use(s->data, s->len);                   // in place, no copy
+ *          if( 0 != tshm_packet_done(&r, s) ) ;    // overwritten meanwhile
+ *      }
+ *
+ *      tshm_close(&r);
+ *
+ *  Layout: header (magic, version, sizes), the state snapshot guarded by a
+ *  seqlock, the packet count, then n_slots fixed-size packet slots used as
+ *  a ring. The writer never waits for readers; a reader which falls more
+ *  than n_slots packets behind loses the oldest ones (counted in r.lost).
+ *
+ *  Compile with the C or C++ compiler, needs -lrt on older glibc.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TSHM_MAGIC          0x4d485354      /* "TSHM" */
+#define TSHM_VERSION        1
+
+#define TSHM_FRAME_MAX      280             /* MAVLink 2 frame, signed */
+#define TSHM_SLOT_DATA      296             /* slot is 320 bytes (5 cache lines) */
+
+#define TSHM_ALIGN          __attribute__((aligned(64)))
+
+/* ordering of the plain stores/loads around the sequence counters */
+#define TSHM_WMB()          __atomic_thread_fence(__ATOMIC_RELEASE)
+#define TSHM_RMB()          __atomic_thread_fence(__ATOMIC_ACQUIRE)
+
+
+/* vehicle state snapshot, fields as in UAS::state_json */
+typedef struct tshm_state {
+    uint64_t            time_us;            /* update time, UNIX us */
+    uint64_t            n_update;           /* number of updates */
+
+    double              lat, lon;           /* global position (deg) */
+    double              alt, h;             /* altitude MSL, relative (m) */
+    double              heading;            /* deg */
+    double              hdop;
+
+    float               roll, pitch, yaw;   /* deg */
+    float               batt_volt, batt_current, batt_remaining;
+    float               drop_rate;
+
+    int32_t             link;               /* link connected */
+    int32_t             uav_id, base_mode, custom_mode, system_status;
+    int32_t             gps_fix, n_sat;
+    int32_t             rssi, rssi_remote;
+    int32_t             pkg_lost;
+
+    char                status[52];         /* last status text, terminated */
+} tshm_state_t;
+
+/* one received frame */
+typedef struct tshm_slot {
+    volatile uint64_t   seq;                /* packet number + 1, 0 while written */
+    uint64_t            time_us;            /* receive time, UNIX us */
+    uint32_t            len;
+    uint32_t            reserved;
+    uint8_t             data[TSHM_SLOT_DATA];
+} tshm_slot_t;
+
+typedef struct tshm_header {
+    uint32_t            magic;
+    uint32_t            version;
+    uint32_t            header_size;        /* sizeof(tshm_header_t), slots follow */
+    uint32_t            slot_size;          /* sizeof(tshm_slot_t) */
+    uint32_t            state_size;         /* sizeof(tshm_state_t) */
+    uint32_t            n_slots;            /* power of 2 */
+    int32_t             pid;                /* writer process */
+
+    TSHM_ALIGN volatile uint64_t state_seq; /* odd while the state is written */
+    tshm_state_t        state;
+
+    TSHM_ALIGN volatile uint64_t head;      /* packets published */
+} TSHM_ALIGN tshm_header_t;
+
+
+typedef struct tshm_reader {
+    int                 fd;
+    size_t              size;
+    const tshm_header_t *hdr;
+    const tshm_slot_t   *slots;
+
+    uint64_t            next;               /* next packet number to read */
+    uint64_t            lost;               /* packets overwritten before read */
+} tshm_reader_t;
+
+
+/*
+ * map the segment read-only, reading starts at the newest packet
+ * return 0 on success, -1 not found/mapped, -2 incompatible layout
+ */
+int  tshm_open(tshm_reader_t *r, const char *name);
+void tshm_close(tshm_reader_t *r);
+
+/* consistent copy of the state, return 0 or -1 (writer kept updating) */
+int  tshm_read_state(tshm_reader_t *r, tshm_state_t *st);
+
+/*
+ * next packet in place (NULL if none), then tshm_packet_done() tells
+ * whether it was still intact: 0 ok, -1 overwritten (skip what was read)
+ */
+const tshm_slot_t* tshm_packet_peek(tshm_reader_t *r);
+int  tshm_packet_done(tshm_reader_t *r, const tshm_slot_t *s);
+
+/* copying variant, return frame length, 0 if none */
+int  tshm_read_packet(tshm_reader_t *r, uint8_t *buf, int len, uint64_t *time_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* end of __TELEMETRY_SHM_H__ */
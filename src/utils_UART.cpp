@@ -33,6 +33,7 @@
 
 #include <rtk_utils.h>
 #include <rtk_debug.h>
+#include <rtk_binlog.h>
 
 #include "utils_UART.h"
 
@@ -300,12 +301,12 @@ int UART::write(void *d, int len)
                             NULL                /* overlapped buffer */
                     );
         if( !bRes ) {
-            dbg_pe("UART::write Send data error, errorcode: %d", GetLastError());
+            blog_pe("UART::write Send data error, errorcode: %d", GetLastError());
             return 2;
         }
 
         if( iByteWritten < len ) {
-            dbg_pw("UART::write Send data byte leng is not correct!");
+            blog_pw("UART::write Send data byte leng is not correct!");
             return 3;
         }
     } else {
@@ -336,13 +337,13 @@ int UART::read(void *d, int *len)
                         );
                         
         if( !bRes ) {
-            dbg_pe("UART::read Read data error, errorcode: %d", GetLastError());
+            blog_pe("UART::read Read data error, errorcode: %d", GetLastError());
             return 2;
         }
 
         *len = byte_read_act;
         if( byte_read_act < iByteRead ) {
-            dbg_pw("UART::read Read data byte leng is not correct!");
+            blog_pw("UART::read Read data byte leng is not correct!");
             return 3;
         }
     } else {
@@ -604,7 +605,7 @@ int UART::write(void *d, int len)
         r = ::write(pd->fd, d, len);
         return r;
     } else {
-        dbg_pe("UART port not opened yet!\n");
+        blog_pe("UART port not opened yet!\n");
         return -1;
     }
 }
@@ -619,7 +620,7 @@ int UART::read(void *d, int len)
         r = ::read(pd->fd, d, len);
         return r;
     } else {
-        dbg_pe("UART port not opened yet!\n");
+        blog_pe("UART port not opened yet!\n");
         return -1;
     }
 }
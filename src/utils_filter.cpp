@@ -0,0 +1,183 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+#include <algorithm>
+
+#include <rtk_utils.h>
+#include <rtk_paramarray.h>
+
+#include "utils_filter.h"
+
+using namespace rtk;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// test & benchmark
+////////////////////////////////////////////////////////////////////////////////
+
+// battery-like signal: slow discharge, noise & spikes
+static void filter_gen_signal(std::vector<float> &s, int n)
+{
+    s.resize(n);
+
+    srand(1234);
+    for(int i=0; i<n; i++) {
+        s[i] = 12.6f - 0.0001f*i + 0.05f*(rand()%1000 - 500)/500.0f;
+        if( rand() % 200 == 0 ) s[i] -= 2.0f;
+    }
+}
+
+// window [i-N+1, i] by brute force
+static void filter_window_ref(const std::vector<float> &s, int i, int N,
+                              double &avg, float &vMin, float &vMax, float &med)
+{
+    int                 i0 = i - N + 1;
+    std::vector<float>  w;
+
+    if( i0 < 0 ) i0 = 0;
+    w.assign(s.begin() + i0, s.begin() + i + 1);
+
+    avg = 0;
+    for(size_t k=0; k<w.size(); k++) avg += w[k];
+    avg /= w.size();
+
+    vMin = *std::min_element(w.begin(), w.end());
+    vMax = *std::max_element(w.begin(), w.end());
+
+    std::sort(w.begin(), w.end());
+    if( w.size() & 1 ) med = w[w.size()/2];
+    else               med = (float) ((w[w.size()/2 - 1] + w[w.size()/2]) / 2.0);
+}
+
+int test_filters(CParamArray *pa)
+{
+    const int               N = 16;
+    int                     n = 20000, err = 0;
+    std::vector<float>      s;
+
+    pa->i("n", n);
+    filter_gen_signal(s, n);
+
+    MovingAverage<float, N> ma;
+    MovingMinMax<float, N>  mm;
+    MovingMedian<float, N>  md;
+    RunningStats<float>     rs;
+    EWMA<float>             ew(0.1);
+    double                  ewRef = 0;
+
+    for(int i=0; i<n; i++) {
+        double  avg;
+        float   vMin, vMax, med;
+
+        ma.push(s[i]);
+        mm.push(s[i]);
+        md.push(s[i]);
+        rs.push(s[i]);
+        ew.push(s[i]);
+        ewRef = (i == 0) ? s[i] : ewRef + 0.1*(s[i] - ewRef);
+
+        filter_window_ref(s, i, N, avg, vMin, vMax, med);
+
+        if( fabs(ma.value() - avg) > 1e-5 || mm.min() != vMin || mm.max() != vMax ||
+            md.value() != med || fabs(ew.value() - ewRef) > 1e-5 ) {
+            printf("sample %d: avg %g (%g), min %g (%g), max %g (%g), median %g (%g), ewma %g (%g)\n",
+                   i, ma.value(), avg, mm.min(), vMin, mm.max(), vMax,
+                   md.value(), med, ew.value(), ewRef);
+            err ++;
+            break;
+        }
+    }
+
+    // whole-signal statistics
+    double sum = 0, var = 0;
+    for(int i=0; i<n; i++) sum += s[i];
+    double mean = sum / n;
+    for(int i=0; i<n; i++) var += (s[i] - mean)*(s[i] - mean);
+    var /= n - 1;
+
+    printf("RunningStats: mean = %g (%g), var = %g (%g), min = %g, max = %g\n",
+           rs.mean(), mean, rs.var(), var, rs.min(), rs.max());
+    if( fabs(rs.mean() - mean) > 1e-9 || fabs(rs.var() - var) > 1e-9*var + 1e-12 ||
+        rs.min() != *std::min_element(s.begin(), s.end()) ||
+        rs.max() != *std::max_element(s.begin(), s.end()) ) err ++;
+
+    printf("errors = %d\n", err);
+
+    return err;
+}
+
+// window sum on every push, as the old ValueAverager did
+template<int N>
+static float filter_naive_avg(float *ring, int &idx, int &num, float v)
+{
+    ring[idx] = v;
+    idx = (idx + 1) % N;
+    if( num < N ) num ++;
+
+    float avg = 0;
+    for(int i=0; i<num; i++) avg += ring[i];
+
+    return avg / num;
+}
+
+template<int N>
+static void filter_bench_window(const std::vector<float> &s)
+{
+    int                     n = s.size();
+    float                   ring[N];
+    int                     idx = 0, num = 0;
+    volatile float          sink = 0;
+    uint64_t                t0, t1, t2, t3, t4;
+
+    MovingAverage<float, N> ma;
+    MovingMinMax<float, N>  mm;
+    MovingMedian<float, N>  md;
+
+    t0 = tm_get_us();
+    for(int i=0; i<n; i++) sink = filter_naive_avg<N>(ring, idx, num, s[i]);
+    t1 = tm_get_us();
+    for(int i=0; i<n; i++) sink = ma.push(s[i]);
+    t2 = tm_get_us();
+    for(int i=0; i<n; i++) { mm.push(s[i]); sink = mm.min(); }
+    t3 = tm_get_us();
+    for(int i=0; i<n; i++) sink = md.push(s[i]);
+    t4 = tm_get_us();
+
+    printf("N = %4d: window sum %7.2f, MovingAverage %5.2f, MovingMinMax %5.2f, "
+           "MovingMedian %6.2f ns/sample (last %.3f)\n", N,
+           1000.0*(t1-t0)/n, 1000.0*(t2-t1)/n, 1000.0*(t3-t2)/n, 1000.0*(t4-t3)/n,
+           (double) sink);
+}
+
+int test_filters_bench(CParamArray *pa)
+{
+    int                     n = 2000000;
+    std::vector<float>      s;
+    volatile float          sink = 0;
+    uint64_t                t0, t1, t2;
+
+    pa->i("n", n);
+    filter_gen_signal(s, n);
+
+    filter_bench_window<10>(s);
+    filter_bench_window<64>(s);
+    filter_bench_window<256>(s);
+
+    EWMA<float>             ew(0.1);
+    RunningStats<float>     rs;
+
+    t0 = tm_get_us();
+    for(int i=0; i<n; i++) sink = ew.push(s[i]);
+    t1 = tm_get_us();
+    for(int i=0; i<n; i++) sink = rs.push(s[i]);
+    t2 = tm_get_us();
+
+    printf("EWMA %5.2f, RunningStats %5.2f ns/sample (last %.3f)\n",
+           1000.0*(t1-t0)/n, 1000.0*(t2-t1)/n, (double) sink);
+
+    return 0;
+}
@@ -0,0 +1,277 @@
+#ifndef __UTILS_FILTER_H__
+#define __UTILS_FILTER_H__
+
+#include <string.h>
+#include <math.h>
+
+////////////////////////////////////////////////////////////////////////////////
+/// Streaming filters for telemetry values
+///
+///     All filters take one sample per push() and keep fixed-size storage
+///     (window size N is a template parameter), no allocation after
+///     construction. push() returns the filtered value.
+///
+///         MovingAverage<T, N>     mean of the last N samples      O(1)
+///         EWMA<T>                 exponential moving average      O(1)
+///         RunningStats<T>         mean/variance (Welford), min/max O(1)
+///         MovingMinMax<T, N>      min & max of the last N samples O(1) amortized
+///         MovingMedian<T, N>      median of the last N samples    O(log N) search
+///                                                                 + O(N) move
+////////////////////////////////////////////////////////////////////////////////
+
+
+///
+/// \brief Mean of the last N samples
+///
+///     Keeps a running sum (in double) instead of summing the window on
+///     every push. The sum is rebuilt from the window each time the ring
+///     wraps, so rounding errors do not accumulate.
+///
+template<class T, int N>
+class MovingAverage
+{
+public:
+    MovingAverage() { reset(); }
+
+    T push(T v) {
+        if( m_n == N ) m_sum -= m_v[m_idx];
+        else           m_n ++;
+
+        m_v[m_idx] = v;
+        m_sum += v;
+
+        if( ++m_idx == N ) {
+            m_idx = 0;
+
+            m_sum = 0;
+            for(int i=0; i<N; i++) m_sum += m_v[i];
+        }
+
+        return value();
+    }
+
+    T value(void) const {
+        return m_n > 0 ? (T) (m_sum / m_n) : T(0);
+    }
+
+    int  size(void) const     { return m_n; }
+    int  capacity(void) const { return N; }
+    bool full(void) const     { return m_n == N; }
+
+    void reset(void) {
+        m_idx = 0;
+        m_n   = 0;
+        m_sum = 0;
+    }
+
+protected:
+    T           m_v[N];
+    int         m_idx, m_n;
+    double      m_sum;
+};
+
+
+///
+/// \brief Exponential weighted moving average
+///
+///     v = v + alpha*(x - v), the first sample initializes the value.
+///     alpha = 2/(N+1) gives roughly the lag of an N-sample moving average.
+///
+template<class T>
+class EWMA
+{
+public:
+    EWMA(double alpha = 0.2) { m_alpha = alpha; reset(); }
+
+    T push(T v) {
+        if( m_n == 0 ) m_v = v;
+        else           m_v += m_alpha * (v - m_v);
+        m_n ++;
+
+        return (T) m_v;
+    }
+
+    T value(void) const { return (T) m_v; }
+
+    void   setAlpha(double alpha) { m_alpha = alpha; }
+    double alpha(void) const      { return m_alpha; }
+
+    void reset(void) {
+        m_v = 0;
+        m_n = 0;
+    }
+
+protected:
+    double      m_alpha;
+    double      m_v;
+    long        m_n;
+};
+
+
+///
+/// \brief Mean, variance, min & max of all samples (Welford)
+///
+template<class T>
+class RunningStats
+{
+public:
+    RunningStats() { reset(); }
+
+    T push(T v) {
+        double d = v - m_mean;
+
+        m_n ++;
+        m_mean += d / m_n;
+        m_m2   += d * (v - m_mean);
+
+        if( m_n == 1 || v < m_min ) m_min = v;
+        if( m_n == 1 || v > m_max ) m_max = v;
+
+        return (T) m_mean;
+    }
+
+    long   count(void) const    { return m_n; }
+    double mean(void) const     { return m_mean; }
+    double var(void) const      { return m_n > 1 ? m_m2 / (m_n - 1) : 0.0; }
+    double stddev(void) const   { return sqrt(var()); }
+    T      min(void) const      { return m_min; }
+    T      max(void) const      { return m_max; }
+
+    void reset(void) {
+        m_n    = 0;
+        m_mean = 0;
+        m_m2   = 0;
+        m_min  = T(0);
+        m_max  = T(0);
+    }
+
+protected:
+    long        m_n;
+    double      m_mean, m_m2;
+    T           m_min, m_max;
+};
+
+
+///
+/// \brief Min & max of the last N samples
+///
+///     Two monotonic deques (fixed rings of N entries) hold the candidates:
+///     every sample enters and leaves each deque at most once.
+///
+template<class T, int N>
+class MovingMinMax
+{
+public:
+    MovingMinMax() { reset(); }
+
+    void push(T v) {
+        // drop candidates that left the window
+        if( m_nMin > 0 && m_cnt - m_minIdx[m_minHead] >= N ) { m_minHead = wrap(m_minHead + 1); m_nMin --; }
+        if( m_nMax > 0 && m_cnt - m_maxIdx[m_maxHead] >= N ) { m_maxHead = wrap(m_maxHead + 1); m_nMax --; }
+
+        // drop candidates the new sample dominates
+        while( m_nMin > 0 && m_minVal[wrap(m_minHead + m_nMin - 1)] >= v ) m_nMin --;
+        while( m_nMax > 0 && m_maxVal[wrap(m_maxHead + m_nMax - 1)] <= v ) m_nMax --;
+
+        int i;
+        i = wrap(m_minHead + m_nMin); m_minVal[i] = v; m_minIdx[i] = m_cnt; m_nMin ++;
+        i = wrap(m_maxHead + m_nMax); m_maxVal[i] = v; m_maxIdx[i] = m_cnt; m_nMax ++;
+
+        m_cnt ++;
+    }
+
+    T min(void) const { return m_nMin > 0 ? m_minVal[m_minHead] : T(0); }
+    T max(void) const { return m_nMax > 0 ? m_maxVal[m_maxHead] : T(0); }
+
+    int size(void) const { return m_cnt < N ? (int) m_cnt : N; }
+
+    void reset(void) {
+        m_cnt = 0;
+        m_minHead = m_nMin = 0;
+        m_maxHead = m_nMax = 0;
+    }
+
+protected:
+    static int wrap(int i) { return i >= N ? i - N : i; }
+
+    T           m_minVal[N], m_maxVal[N];
+    long        m_minIdx[N], m_maxIdx[N];
+    int         m_minHead, m_nMin;
+    int         m_maxHead, m_nMax;
+    long        m_cnt;
+};
+
+
+///
+/// \brief Median of the last N samples
+///
+///     A sorted copy of the window is kept next to the ring: the oldest
+///     sample is located by binary search and the new one inserted with one
+///     memmove. Meant for the small windows (N <= ~64) used to reject
+///     telemetry spikes.
+///
+template<class T, int N>
+class MovingMedian
+{
+public:
+    MovingMedian() { reset(); }
+
+    T push(T v) {
+        if( m_n == N ) {
+            int i = lower_bound(m_v[m_idx]);
+            memmove(m_sorted + i, m_sorted + i + 1, sizeof(T)*(m_n - i - 1));
+            m_n --;
+        }
+
+        int i = lower_bound(v);
+        memmove(m_sorted + i + 1, m_sorted + i, sizeof(T)*(m_n - i));
+        m_sorted[i] = v;
+        m_n ++;
+
+        m_v[m_idx] = v;
+        if( ++m_idx == N ) m_idx = 0;
+
+        return value();
+    }
+
+    T value(void) const {
+        if( m_n == 0 ) return T(0);
+        if( m_n & 1 )  return m_sorted[m_n/2];
+
+        return (T) ((m_sorted[m_n/2 - 1] + m_sorted[m_n/2]) / 2.0);
+    }
+
+    int size(void) const { return m_n; }
+
+    void reset(void) {
+        m_idx = 0;
+        m_n   = 0;
+    }
+
+protected:
+    int lower_bound(T v) const {
+        int l = 0, h = m_n;
+
+        while( l < h ) {
+            int m = (l + h) / 2;
+            if( m_sorted[m] < v ) l = m + 1;
+            else                  h = m;
+        }
+
+        return l;
+    }
+
+    T           m_v[N];                 ///< ring in arrival order
+    T           m_sorted[N];            ///< window in ascending order
+    int         m_idx, m_n;
+};
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_filters(rtk::CParamArray *pa);
+int test_filters_bench(rtk::CParamArray *pa);
+
+#endif // end of __UTILS_FILTER_H__
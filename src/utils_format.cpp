@@ -0,0 +1,333 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <new>
+
+#include <rtk_utils.h>
+#include <rtk_paramarray.h>
+
+#include "utils_format.h"
+
+using namespace rtk;
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// fixed-buffer formatting
+////////////////////////////////////////////////////////////////////////////////
+
+static const double g_fmtPow10[10] =
+{
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+};
+
+// digits of v (reversed) into the end of tmp, returns the first digit
+static inline char* fmt_digits_rev(char *end, uint64_t v, int minDigits)
+{
+    char *q = end;
+
+    do {
+        *--q = '0' + (char) (v % 10);
+        v /= 10;
+        minDigits --;
+    } while( v > 0 || minDigits > 0 );
+
+    return q;
+}
+
+// copy [q, end) right-aligned in width
+static inline char* fmt_pad_copy(char *p, const char *q, const char *end, int width, char pad)
+{
+    int n = end - q;
+
+    for(; width > n; width--) *p++ = pad;
+    memcpy(p, q, n);
+
+    return p + n;
+}
+
+char* fmt_int(char *p, long v, int width, char pad)
+{
+    char        tmp[32], *end = tmp + sizeof(tmp), *q;
+    int         neg = v < 0;
+    uint64_t    u = neg ? (uint64_t) (-(v + 1)) + 1 : (uint64_t) v;
+
+    if( neg && pad == '0' ) {
+        *p++ = '-';
+        q = fmt_digits_rev(end, u, width - 1);
+        return fmt_pad_copy(p, q, end, 0, pad);
+    }
+
+    q = fmt_digits_rev(end, u, 1);
+    if( neg ) *--q = '-';
+
+    return fmt_pad_copy(p, q, end, width, pad);
+}
+
+char* fmt_fixed(char *p, double v, int prec, int width)
+{
+    char        tmp[48], *end = tmp + sizeof(tmp), *q;
+    int         neg;
+    uint64_t    r, ip, fp;
+    double      s, f;
+
+    if( prec < 0 ) prec = 0;
+    if( prec > 9 ) prec = 9;
+
+    // NaN, Inf & values whose scaled product does not leave room for r + 0.5
+    //  in double (2^52, far below the uint64_t limit 1.8e19): leave them to
+    //  snprintf (no allocation either)
+    if( v != v || fabs(v) * g_fmtPow10[prec] >= 4503599627370496.0 ) {
+        int n = snprintf(tmp, sizeof(tmp), "%*.*f", width, prec, v);
+        if( n < 0 ) n = 0;
+        if( n >= (int) sizeof(tmp) ) n = sizeof(tmp) - 1;
+
+        memcpy(p, tmp, n);
+        return p + n;
+    }
+
+    neg = signbit(v) ? 1 : 0;
+    if( neg ) v = -v;
+
+    // printf rounds the exact decimal value of v: the sign of the exact
+    //  v*10^prec - (r + 0.5) (one rounding in fma, never to 0 unless it is 0)
+    //  decides the tie, not the rounded product s
+    s = v * g_fmtPow10[prec];
+    r = (uint64_t) s;
+    f = fma(v, g_fmtPow10[prec], -((double) r + 0.5));
+    if( f > 0 || (f == 0 && (r & 1)) ) r ++;
+
+    ip = r / (uint64_t) g_fmtPow10[prec];
+    fp = r % (uint64_t) g_fmtPow10[prec];
+
+    q = end;
+    if( prec > 0 ) {
+        q = fmt_digits_rev(q, fp, prec);
+        *--q = '.';
+    }
+    q = fmt_digits_rev(q, ip, 1);
+    if( neg ) *--q = '-';
+
+    return fmt_pad_copy(p, q, end, width, ' ');
+}
+
+char* fmt_str(char *p, const char *s, int maxLen)
+{
+    while( *s && maxLen-- > 0 ) *p++ = *s++;
+
+    return p;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// allocation counter
+////////////////////////////////////////////////////////////////////////////////
+
+#ifdef SIMPGCS_ALLOC_COUNT
+
+static volatile int     g_allocCountEnabled = 0;
+static uint64_t         g_allocCount = 0;
+
+int alloc_count_available(void)
+{
+    return 1;
+}
+
+void alloc_count_enable(int en)
+{
+    g_allocCountEnabled = en;
+}
+
+uint64_t alloc_count(void)
+{
+    return __sync_fetch_and_add(&g_allocCount, 0);
+}
+
+static inline void* alloc_counted(size_t n)
+{
+    if( g_allocCountEnabled ) __sync_fetch_and_add(&g_allocCount, 1);
+
+    void *p = malloc(n ? n : 1);
+    if( p == NULL ) throw std::bad_alloc();
+
+    return p;
+}
+
+void* operator new(size_t n) _GLIBCXX_THROW(std::bad_alloc)
+{
+    return alloc_counted(n);
+}
+
+void* operator new[](size_t n) _GLIBCXX_THROW(std::bad_alloc)
+{
+    return alloc_counted(n);
+}
+
+void operator delete(void *p) _GLIBCXX_USE_NOEXCEPT
+{
+    free(p);
+}
+
+void operator delete[](void *p) _GLIBCXX_USE_NOEXCEPT
+{
+    free(p);
+}
+
+#else
+
+int alloc_count_available(void)
+{
+    return 0;
+}
+
+void alloc_count_enable(int)
+{
+}
+
+uint64_t alloc_count(void)
+{
+    return 0;
+}
+
+#endif // end of SIMPGCS_ALLOC_COUNT
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// test
+////////////////////////////////////////////////////////////////////////////////
+
+int test_format(CParamArray *pa)
+{
+    int         n = 1000000, err = 0;
+    char        b1[64], b2[64];
+    uint64_t    t0, t1, t2;
+
+    pa->i("n", n);
+
+    srand(4321);
+
+    // integers
+    for(int i=0; i<n/10; i++) {
+        long    v = (long) (rand() - RAND_MAX/2) * (i % 3 == 0 ? 1000 : 1) / (i % 7 + 1);
+        int     w = i % 6;
+
+        fmt_end(fmt_int(b1, v, w));
+        snprintf(b2, sizeof(b2), "%*ld", w, v);
+        if( strcmp(b1, b2) != 0 ) {
+            printf("int %ld width %d: '%s' (%s)\n", v, w, b1, b2);
+            err ++;
+            break;
+        }
+
+        if( v >= 0 ) {
+            fmt_end(fmt_int(b1, v, w, '0'));
+            snprintf(b2, sizeof(b2), "%0*ld", w, v);
+            if( strcmp(b1, b2) != 0 ) {
+                printf("int %ld width 0%d: '%s' (%s)\n", v, w, b1, b2);
+                err ++;
+                break;
+            }
+        }
+    }
+
+    // telemetry-like values
+    for(int i=0; i<n; i++) {
+        double  v = (rand() - RAND_MAX/2) * 1.0 / RAND_MAX * pow(10.0, i % 8 - 2);
+        int     prec = i % 4, w = (i / 4) % 10;
+
+        if( i % 5 == 0 ) v = (float) v;
+
+        fmt_end(fmt_fixed(b1, v, prec, w));
+        snprintf(b2, sizeof(b2), "%*.*f", w, prec, v);
+        if( strcmp(b1, b2) != 0 ) {
+            printf("fixed %.17g %%%d.%df: '%s' (%s)\n", v, w, prec, b1, b2);
+            err ++;
+            break;
+        }
+    }
+
+    // ties: decimal .5 is never exact in binary, printf goes by the exact value;
+    //  dyadic .5 (0.125, 2.5) is exact and goes to the even digit
+    {
+        double  vt[] = { 0.05, 0.15, 0.25, 0.35, 0.45, 1.05, 2.675, 1.005, 0.125, 0.375, 2.5, 3.5,
+                         -0.05, -0.15, -1.05, -2.5, 1e-300, 0.5, 1.5, 1234.5675 };
+        int     pt[] = { 1,    1,    1,    1,    1,    1,    2,     2,     2,     2,     0,   0,
+                         1,     1,     1,     0,    9,      0,   0,   3 };
+
+        for(int i=0; i<(int) (sizeof(vt)/sizeof(vt[0])); i++) {
+            fmt_end(fmt_fixed(b1, vt[i], pt[i], 0));
+            snprintf(b2, sizeof(b2), "%.*f", pt[i], vt[i]);
+            if( strcmp(b1, b2) != 0 ) {
+                printf("fixed %.17g %%.%df: '%s' (%s)\n", vt[i], pt[i], b1, b2);
+                err ++;
+            }
+        }
+
+        // k.5 / 10^prec and its neighbours
+        for(int i=0; i<n/10; i++) {
+            int     prec = i % 10;
+            double  v = (rand() % 1000000 + 0.5) / pow(10.0, prec);
+
+            if( i % 3 == 1 ) v = nextafter(v, 0.0);
+            if( i % 3 == 2 ) v = nextafter(v, 1e300);
+
+            fmt_end(fmt_fixed(b1, v, prec, 0));
+            snprintf(b2, sizeof(b2), "%.*f", prec, v);
+            if( strcmp(b1, b2) != 0 ) {
+                printf("fixed %.17g %%.%df: '%s' (%s)\n", v, prec, b1, b2);
+                err ++;
+                break;
+            }
+        }
+    }
+
+    // large values: the scaled product beyond 2^52 (or uint64_t)
+    {
+        double  vb[] = { 1e11, -1e11, 1.8e10, 123456789012.5, 1e14, 9.5e13, 2e15, 1e19,
+                         29603161769.7343025, 771357697793914.875, 8.9e15, 9.1e15 };
+        int     pb[] = { 9,    9,     9,      9,              6,    6,      3,   0,
+                         7,                   3,                   0,      0 };
+
+        for(int i=0; i<(int) (sizeof(vb)/sizeof(vb[0])); i++) {
+            fmt_end(fmt_fixed(b1, vb[i], pb[i], 0));
+            snprintf(b2, sizeof(b2), "%.*f", pb[i], vb[i]);
+            if( strcmp(b1, b2) != 0 ) {
+                printf("fixed %.17g %%.%df: '%s' (%s)\n", vb[i], pb[i], b1, b2);
+                err ++;
+            }
+        }
+    }
+
+    // speed
+    t0 = tm_get_us();
+    for(int i=0; i<n; i++) fmt_end(fmt_fixed(b1, i * 0.37, 2, 9));
+    t1 = tm_get_us();
+    for(int i=0; i<n; i++) snprintf(b2, sizeof(b2), "%9.2f", i * 0.37);
+    t2 = tm_get_us();
+
+    // the counter sees operator new, the formatting does not allocate
+    uint64_t    a0, a1, a2;
+
+    alloc_count_enable(1);
+    a0 = alloc_count();
+    int * volatile pi = new int(1);
+    delete pi;
+    a1 = alloc_count();
+    for(int i=0; i<1000; i++) fmt_end(fmt_fixed(fmt_int(b1, i, 5), i * 0.37, 2, 9));
+    a2 = alloc_count();
+    alloc_count_enable(0);
+
+    if( !alloc_count_available() ) {
+        printf("alloc count: not built with SIMPGCS_ALLOC_COUNT, skipped\n");
+    } else if( a1 - a0 != 1 || a2 != a1 ) {
+        printf("alloc count: new int %d, formatting %d\n", (int) (a1 - a0), (int) (a2 - a1));
+        err ++;
+    }
+
+    printf("fmt_fixed %.1f ns, snprintf %.1f ns, errors = %d\n",
+           1000.0*(t1-t0)/n, 1000.0*(t2-t1)/n, err);
+
+    return err;
+}
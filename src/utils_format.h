@@ -0,0 +1,61 @@
+#ifndef __UTILS_FORMAT_H__
+#define __UTILS_FORMAT_H__
+
+#include <stdint.h>
+
+////////////////////////////////////////////////////////////////////////////////
+/// Fixed-buffer formatting
+///
+///     printf-compatible output for the few conversions the telemetry views
+///     use, written into a caller buffer without allocation or locale
+///     lookups. Each function returns the end of the written text (not
+///     terminated, call fmt_end() when done), so fields are chained:
+///
+///         char buf[64], *p = buf;
+///         p = fmt_int(p, bt_min);     p = fmt_char(p, ':');
+///         p = fmt_int(p, bt_sec, 2, '0');
+///         fmt_end(p);
+////////////////////////////////////////////////////////////////////////////////
+
+///
+/// \brief integer, as "%*d" (pad ' ') or "%0*d" (pad '0')
+///
+char* fmt_int(char *p, long v, int width = 0, char pad = ' ');
+
+///
+/// \brief fixed-point number, as "%*.*f" (prec <= 9)
+///
+///     Rounds the exact value of v, half to even, the same as printf.
+///
+char* fmt_fixed(char *p, double v, int prec, int width = 0);
+
+///
+/// \brief copy a string (at most maxLen characters)
+///
+char* fmt_str(char *p, const char *s, int maxLen = 0x7fffffff);
+
+inline char* fmt_char(char *p, char c) { *p = c; return p + 1; }
+inline char* fmt_end(char *p)          { *p = 0; return p; }
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// Allocation counter
+///
+///     Only built with SIMPGCS_ALLOC_COUNT (qmake "DEFINES+=SIMPGCS_ALLOC_COUNT"):
+///     global operator new/new[] then count the calls while enabled, so tests
+///     can check that a code path does not allocate. Otherwise allocation is
+///     untouched and alloc_count() stays 0.
+////////////////////////////////////////////////////////////////////////////////
+
+int      alloc_count_available(void);
+void     alloc_count_enable(int en);
+uint64_t alloc_count(void);
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_format(rtk::CParamArray *pa);
+
+#endif // end of __UTILS_FORMAT_H__
@@ -0,0 +1,566 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include <rtk_utils.h>
+#include <rtk_paramarray.h>
+
+#include "utils_geodesy.h"
+
+
+namespace rtk {
+
+////////////////////////////////////////////////////////////////////////////////
+/// LLA <-> ECEF
+////////////////////////////////////////////////////////////////////////////////
+
+void geo_lla2ecef(double lat, double lng, double h, double &x, double &y, double &z)
+{
+    double  sLat = sin(lat*GEO_D2R), cLat = cos(lat*GEO_D2R);
+    double  sLng = sin(lng*GEO_D2R), cLng = cos(lng*GEO_D2R);
+    double  N = GEO_WGS84_A / sqrt(1.0 - GEO_WGS84_E2*sLat*sLat);
+
+    x = (N + h) * cLat * cLng;
+    y = (N + h) * cLat * sLng;
+    z = (N*(1.0 - GEO_WGS84_E2) + h) * sLat;
+}
+
+void geo_ecef2lla(double x, double y, double z, double &lat, double &lng, double &h)
+{
+    const double    a = GEO_WGS84_A, b = GEO_WGS84_B, e2 = GEO_WGS84_E2;
+    const double    ep2 = (a*a - b*b) / (b*b);
+
+    double  p = sqrt(x*x + y*y);
+    double  th, st, ct, phi, sPhi, N;
+
+    lng = atan2(y, x) * GEO_R2D;
+
+    // Bowring
+    th  = atan2(z*a, p*b);
+    st  = sin(th);
+    ct  = cos(th);
+    phi = atan2(z + ep2*b*st*st*st, p - e2*a*ct*ct*ct);
+
+    // two fixed-point steps, h without 1/cos (fine at the poles)
+    for(int i=0; i<2; i++) {
+        sPhi = sin(phi);
+        N    = a / sqrt(1.0 - e2*sPhi*sPhi);
+        h    = p*cos(phi) + z*sPhi - a*sqrt(1.0 - e2*sPhi*sPhi);
+        phi  = atan2(z, p*(1.0 - e2*N/(N + h)));
+    }
+
+    sPhi = sin(phi);
+    h    = p*cos(phi) + z*sPhi - a*sqrt(1.0 - e2*sPhi*sPhi);
+    lat  = phi * GEO_R2D;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// haversine
+////////////////////////////////////////////////////////////////////////////////
+
+double geo_haversine(double lat1, double lng1, double lat2, double lng2)
+{
+    double  sa = sin((lat2 - lat1)*GEO_D2R*0.5);
+    double  sb = sin((lng2 - lng1)*GEO_D2R*0.5);
+    double  a  = sa*sa + cos(lat1*GEO_D2R)*cos(lat2*GEO_D2R)*sb*sb;
+
+    if( a > 1.0 ) a = 1.0;
+
+    return 2.0 * GEO_MEAN_RADIUS * asin(sqrt(a));
+}
+
+/*
+ * Batched haversine: sin() by its Taylor series to x^17 (|x| <= pi/2,
+ * |err| < 5e-14, as the batched Mercator projection), asin(sqrt(a)) by
+ * three half-angle steps to atan(t), t <= tan(pi/32), and its series to
+ * t^23 (|err| < 1e-18).
+ */
+#if defined(__SSE2__)
+static inline __m128d geo_sin2(__m128d x)
+{
+    __m128d x2 = _mm_mul_pd(x, x);
+    __m128d p  = _mm_set1_pd(1.0/355687428096000.0);
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(-1.0/1307674368000.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd( 1.0/6227020800.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(-1.0/39916800.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd( 1.0/362880.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(-1.0/5040.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd( 1.0/120.0));
+    p = _mm_add_pd(_mm_mul_pd(p, x2), _mm_set1_pd(-1.0/6.0));
+    return _mm_add_pd(x, _mm_mul_pd(_mm_mul_pd(x, x2), p));
+}
+
+// tan(x/2) from tan(x)
+static inline __m128d geo_half_tan2(__m128d t)
+{
+    const __m128d one = _mm_set1_pd(1.0);
+    return _mm_div_pd(t, _mm_add_pd(one, _mm_sqrt_pd(_mm_add_pd(one, _mm_mul_pd(t, t)))));
+}
+
+// wrap degrees to [-180, 180]
+static inline __m128d geo_wrap2(__m128d d)
+{
+    __m128d k = _mm_cvtepi32_pd(_mm_cvtpd_epi32(_mm_mul_pd(d, _mm_set1_pd(1.0/360.0))));
+    return _mm_sub_pd(d, _mm_mul_pd(k, _mm_set1_pd(360.0)));
+}
+#endif
+
+void geo_haversine_batch(double lat0, double lng0, const double *lat, const double *lng,
+                         int n, double *dis)
+{
+    int     i = 0;
+
+#if defined(__SSE2__)
+    const __m128d one   = _mm_set1_pd(1.0);
+    const __m128d zero  = _mm_setzero_pd();
+    const __m128d hd2r  = _mm_set1_pd(0.5*GEO_D2R);
+    const __m128d d2r   = _mm_set1_pd(GEO_D2R);
+    const __m128d pi2   = _mm_set1_pd(M_PI/2);
+    const __m128d sign  = _mm_set1_pd(-0.0);
+    const __m128d la0   = _mm_set1_pd(lat0), ln0 = _mm_set1_pd(lng0);
+    const __m128d cos0  = _mm_set1_pd(cos(lat0*GEO_D2R));
+    const __m128d k16R  = _mm_set1_pd(16.0*GEO_MEAN_RADIUS);
+
+    for(; i + 2 <= n; i += 2) {
+        __m128d la = _mm_loadu_pd(lat + i);
+        __m128d ln = _mm_loadu_pd(lng + i);
+
+        __m128d sa = geo_sin2(_mm_mul_pd(_mm_sub_pd(la, la0), hd2r));
+        __m128d sb = geo_sin2(_mm_mul_pd(geo_wrap2(_mm_sub_pd(ln, ln0)), hd2r));
+        __m128d cl = geo_sin2(_mm_sub_pd(pi2, _mm_andnot_pd(sign, _mm_mul_pd(la, d2r))));
+
+        __m128d a  = _mm_add_pd(_mm_mul_pd(sa, sa), _mm_mul_pd(_mm_mul_pd(cos0, cl), _mm_mul_pd(sb, sb)));
+        a = _mm_min_pd(_mm_max_pd(a, zero), one);
+
+        // tan(theta/4) = sin(theta/2) / (1 + cos(theta/2)), two more halvings
+        __m128d t  = _mm_div_pd(_mm_sqrt_pd(a), _mm_add_pd(one, _mm_sqrt_pd(_mm_sub_pd(one, a))));
+        t = geo_half_tan2(geo_half_tan2(t));
+
+        __m128d t2 = _mm_mul_pd(t, t);
+        __m128d p  = _mm_set1_pd(-1.0/23);
+        p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd( 1.0/21));
+        p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(-1.0/19));
+        p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd( 1.0/17));
+        p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(-1.0/15));
+        p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd( 1.0/13));
+        p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(-1.0/11));
+        p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd( 1.0/9));
+        p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(-1.0/7));
+        p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd( 1.0/5));
+        p = _mm_add_pd(_mm_mul_pd(p, t2), _mm_set1_pd(-1.0/3));
+        p = _mm_add_pd(_mm_mul_pd(p, t2), one);
+
+        _mm_storeu_pd(dis + i, _mm_mul_pd(k16R, _mm_mul_pd(t, p)));
+    }
+#endif
+
+    for(; i < n; i++) dis[i] = geo_haversine(lat0, lng0, lat[i], lng[i]);
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// Vincenty
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  inverse problem from the reduced latitude of the first point
+ *
+ *  @return 0 - success, -1 - no convergence
+ */
+static int geo_vincenty_u1(double sinU1, double cosU1, double lat2, double L,
+                           double &dis, double *az1, double *az2)
+{
+    const double    a = GEO_WGS84_A, b = GEO_WGS84_B, f = GEO_WGS84_F;
+
+    double  U2 = atan((1.0 - f) * tan(lat2*GEO_D2R));
+    double  sinU2 = sin(U2), cosU2 = cos(U2);
+    double  lambda = L, lambdaP;
+    double  sinL, cosL, sinS, cosS, sigma, sinA, cos2A, cos2Sm, C;
+    int     it = 0;
+
+    do {
+        sinL = sin(lambda);
+        cosL = cos(lambda);
+
+        double t1 = cosU2*sinL, t2 = cosU1*sinU2 - sinU1*cosU2*cosL;
+        sinS = sqrt(t1*t1 + t2*t2);
+        if( sinS == 0 ) {
+            // same point
+            dis = 0;
+            if( az1 ) *az1 = 0;
+            if( az2 ) *az2 = 0;
+            return 0;
+        }
+
+        cosS   = sinU1*sinU2 + cosU1*cosU2*cosL;
+        sigma  = atan2(sinS, cosS);
+        sinA   = cosU1*cosU2*sinL / sinS;
+        cos2A  = 1.0 - sinA*sinA;
+        cos2Sm = cos2A != 0 ? cosS - 2.0*sinU1*sinU2/cos2A : 0;     // equatorial line
+        C      = f/16.0 * cos2A * (4.0 + f*(4.0 - 3.0*cos2A));
+
+        lambdaP = lambda;
+        lambda  = L + (1.0 - C) * f * sinA *
+                  (sigma + C*sinS*(cos2Sm + C*cosS*(-1.0 + 2.0*cos2Sm*cos2Sm)));
+    } while( fabs(lambda - lambdaP) > 1e-12 && ++it < 200 );
+
+    if( it >= 200 ) return -1;
+
+    double u2 = cos2A * (a*a - b*b) / (b*b);
+    double A  = 1.0 + u2/16384.0*(4096.0 + u2*(-768.0 + u2*(320.0 - 175.0*u2)));
+    double B  = u2/1024.0*(256.0 + u2*(-128.0 + u2*(74.0 - 47.0*u2)));
+    double dS = B*sinS*(cos2Sm + B/4.0*(cosS*(-1.0 + 2.0*cos2Sm*cos2Sm) -
+                B/6.0*cos2Sm*(-3.0 + 4.0*sinS*sinS)*(-3.0 + 4.0*cos2Sm*cos2Sm)));
+
+    dis = b * A * (sigma - dS);
+
+    if( az1 ) *az1 = atan2(cosU2*sinL, cosU1*sinU2 - sinU1*cosU2*cosL) * GEO_R2D;
+    if( az2 ) *az2 = atan2(cosU1*sinL, -sinU1*cosU2 + cosU1*sinU2*cosL) * GEO_R2D;
+
+    return 0;
+}
+
+static inline double geo_wrap_rad(double d)
+{
+    d = fmod(d, 360.0);
+    if( d > 180.0 ) d -= 360.0;
+    else if( d < -180.0 ) d += 360.0;
+
+    return d * GEO_D2R;
+}
+
+int geo_vincenty(double lat1, double lng1, double lat2, double lng2,
+                 double &dis, double *az1, double *az2)
+{
+    double  U1 = atan((1.0 - GEO_WGS84_F) * tan(lat1*GEO_D2R));
+
+    return geo_vincenty_u1(sin(U1), cos(U1), lat2, geo_wrap_rad(lng2 - lng1), dis, az1, az2);
+}
+
+int geo_vincenty_batch(double lat0, double lng0, const double *lat, const double *lng,
+                       int n, double *dis)
+{
+    double  U1 = atan((1.0 - GEO_WGS84_F) * tan(lat0*GEO_D2R));
+    double  sinU1 = sin(U1), cosU1 = cos(U1);
+    int     nFail = 0;
+
+    for(int i=0; i<n; i++) {
+        if( 0 != geo_vincenty_u1(sinU1, cosU1, lat[i], geo_wrap_rad(lng[i] - lng0),
+                                 dis[i], NULL, NULL) ) {
+            dis[i] = geo_haversine(lat0, lng0, lat[i], lng[i]);
+            nFail ++;
+        }
+    }
+
+    return nFail;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// local tangent plane
+////////////////////////////////////////////////////////////////////////////////
+
+void GeoLocalFrame::setOrigin(double lat, double lng, double h)
+{
+    double  w, M, N;
+
+    m_lat0 = lat;
+    m_lng0 = lng;
+    m_h0   = h;
+
+    geo_lla2ecef(lat, lng, h, m_x0, m_y0, m_z0);
+
+    m_sinLat = sin(lat*GEO_D2R);
+    m_cosLat = cos(lat*GEO_D2R);
+    m_sinLng = sin(lng*GEO_D2R);
+    m_cosLng = cos(lng*GEO_D2R);
+
+    // radii of curvature: meridian (M) & prime vertical (N)
+    w = 1.0 - GEO_WGS84_E2*m_sinLat*m_sinLat;
+    N = GEO_WGS84_A / sqrt(w);
+    M = GEO_WGS84_A*(1.0 - GEO_WGS84_E2) / (w*sqrt(w));
+
+    m_kN    = (M + h) * GEO_D2R;
+    m_kE    = (N + h) * m_cosLat * GEO_D2R;
+    m_kConv = (M + h) / (N + h) * m_sinLat / m_cosLat * GEO_D2R;
+    m_kPar  = 0.5 * (N + h) * m_sinLat * m_cosLat * GEO_D2R * GEO_D2R;
+
+    m_valid = 1;
+}
+
+void GeoLocalFrame::lla2enu(double lat, double lng, double h, double &e, double &n, double &u)
+{
+    double  x, y, z, dx, dy, dz;
+
+    geo_lla2ecef(lat, lng, h, x, y, z);
+    dx = x - m_x0;
+    dy = y - m_y0;
+    dz = z - m_z0;
+
+    e = -m_sinLng*dx + m_cosLng*dy;
+    n = -m_sinLat*m_cosLng*dx - m_sinLat*m_sinLng*dy + m_cosLat*dz;
+    u =  m_cosLat*m_cosLng*dx + m_cosLat*m_sinLng*dy + m_sinLat*dz;
+}
+
+void GeoLocalFrame::enu2lla(double e, double n, double u, double &lat, double &lng, double &h)
+{
+    double  x, y, z;
+
+    x = m_x0 - m_sinLng*e - m_sinLat*m_cosLng*n + m_cosLat*m_cosLng*u;
+    y = m_y0 + m_cosLng*e - m_sinLat*m_sinLng*n + m_cosLat*m_sinLng*u;
+    z = m_z0 + m_cosLat*n + m_sinLat*u;
+
+    geo_ecef2lla(x, y, z, lat, lng, h);
+}
+
+void GeoLocalFrame::offsetBatch(const double *lat, const double *lng, int n, double *e, double *nn)
+{
+    int     i = 0;
+
+#if defined(__SSE2__)
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d la0 = _mm_set1_pd(m_lat0), ln0 = _mm_set1_pd(m_lng0);
+    const __m128d kN  = _mm_set1_pd(m_kN), kE = _mm_set1_pd(m_kE), kC = _mm_set1_pd(m_kConv);
+    const __m128d kP  = _mm_set1_pd(m_kPar);
+
+    for(; i + 2 <= n; i += 2) {
+        __m128d dLat = _mm_sub_pd(_mm_loadu_pd(lat + i), la0);
+        __m128d dLng = geo_wrap2(_mm_sub_pd(_mm_loadu_pd(lng + i), ln0));
+
+        _mm_storeu_pd(nn + i, _mm_add_pd(_mm_mul_pd(dLat, kN), _mm_mul_pd(_mm_mul_pd(dLng, dLng), kP)));
+        _mm_storeu_pd(e + i,  _mm_mul_pd(_mm_mul_pd(dLng, kE), _mm_sub_pd(one, _mm_mul_pd(kC, dLat))));
+    }
+#endif
+
+    for(; i < n; i++) offset(lat[i], lng[i], e[i], nn[i]);
+}
+
+} // end of namespace rtk
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// test
+////////////////////////////////////////////////////////////////////////////////
+
+using namespace rtk;
+
+static double geo_rand(double a, double b)
+{
+    return a + (b - a) * rand() / RAND_MAX;
+}
+
+static double geo_dms(int d, int m, double s)
+{
+    double v = abs(d) + m/60.0 + s/3600.0;
+    return d < 0 ? -v : v;
+}
+
+int test_geodesy(CParamArray *pa)
+{
+    int             nPoints = 1000000, rep = 5;
+    double          lat0 = 34.257287, lng0 = 108.888931;        // default map position
+    int             err = 0;
+    int             i, r;
+
+    pa->i("nPoints", nPoints);
+    pa->i("rep", rep);
+    pa->d("lat0", lat0);
+    pa->d("lng0", lng0);
+
+    srand(11);
+
+    // Vincenty: Flinders Peak -> Buninyong (Vincenty 1975 / Geoscience Australia)
+    {
+        double la1 = geo_dms(-37, 57, 3.72030), ln1 = geo_dms(144, 25, 29.52440);
+        double la2 = geo_dms(-37, 39, 10.15610), ln2 = geo_dms(143, 55, 35.38390);
+        double s, az1, az2;
+        double az1Ref = geo_dms(306, 52, 5.37), az2Ref = geo_dms(127, 10, 25.07) - 180.0;
+
+        geo_vincenty(la1, ln1, la2, ln2, s, &az1, &az2);
+        if( az1 < 0 ) az1 += 360;
+        if( az2 < 0 ) az2 += 360;
+        if( az2Ref < 0 ) az2Ref += 360;
+
+        printf("vincenty: %.4f m (54972.271), az %.6f / %.6f deg (%.6f / %.6f)\n",
+               s, az1, az2, az1Ref, az2Ref);
+        if( fabs(s - 54972.271) > 0.001 ) err ++;
+        if( fabs(az1 - az1Ref) * 3600 > 0.01 || fabs(az2 - az2Ref) * 3600 > 0.01 ) err ++;
+
+        // meridian quadrant (pole to equator) is 10001965.729 m on WGS-84
+        geo_vincenty(0, 0, 90, 0, s);
+        printf("vincenty: equator -> pole %.4f m (10001965.7293)\n", s);
+        if( fabs(s - 10001965.7293) > 0.001 ) err ++;
+
+        // nearly antipodal: no convergence
+        if( 0 == geo_vincenty(0, 0, 0.5, 179.7, s) ) {
+            printf("vincenty: antipodal pair converged (%.1f m)\n", s);
+        }
+    }
+
+    // ECEF: axes & round trip
+    {
+        double x, y, z, la, ln, h, eMax = 0;
+
+        geo_lla2ecef(0, 0, 0, x, y, z);
+        if( fabs(x - GEO_WGS84_A) > 1e-6 || fabs(y) > 1e-6 || fabs(z) > 1e-6 ) err ++;
+        geo_lla2ecef(90, 0, 0, x, y, z);
+        if( fabs(x) > 1e-6 || fabs(z - GEO_WGS84_B) > 1e-6 ) err ++;
+
+        for(i=0; i<100000; i++) {
+            double la0 = geo_rand(-90, 90), ln0 = geo_rand(-180, 180), h0 = geo_rand(-500, 20000);
+
+            geo_lla2ecef(la0, ln0, h0, x, y, z);
+            geo_ecef2lla(x, y, z, la, ln, h);
+
+            double de = fabs(la - la0) * GEO_D2R * GEO_WGS84_A;
+            de = std::max(de, fabs(ln - ln0) * GEO_D2R * GEO_WGS84_A * cos(la0*GEO_D2R));
+            de = std::max(de, fabs(h - h0));
+            eMax = std::max(eMax, de);
+        }
+
+        printf("ECEF round trip: max error %.2e m\n", eMax);
+        if( eMax > 1e-3 ) err ++;
+    }
+
+    // haversine: batch against scalar, against the ellipsoid
+    {
+        std::vector<double>     la(10001), ln(10001), d(10001);
+        double                  eRel = 0, eEll = 0, s;
+
+        for(i=0; i<la.size(); i++) {
+            la[i] = geo_rand(-89.9, 89.9);
+            ln[i] = geo_rand(-180, 180);
+        }
+        la[0] = lat0;                   // same point
+        ln[0] = lng0;
+
+        geo_haversine_batch(lat0, lng0, &la[0], &ln[0], la.size(), &d[0]);
+
+        for(i=0; i<la.size(); i++) {
+            double ref = geo_haversine(lat0, lng0, la[i], ln[i]);
+            eRel = std::max(eRel, fabs(d[i] - ref) / std::max(ref, 1.0));
+
+            if( 0 == geo_vincenty(lat0, lng0, la[i], ln[i], s) && s > 1000 )
+                eEll = std::max(eEll, fabs(d[i] - s) / s);
+        }
+
+        printf("haversine: batch / scalar %.2e, to the ellipsoid %.2f%%\n", eRel, eEll*100);
+        if( eRel > 1e-11 || eEll > 0.006 ) err ++;
+    }
+
+    // local frame: exact round trip, offset() against the exact frame
+    {
+        GeoLocalFrame   lf;
+        double          rMax[3] = { 1000, 10000, 50000 };
+        double          eMax[3] = { 0.02, 0.25, 25 };
+        double          e, n, u, la, ln, h, eRt = 0;
+
+        lf.setOrigin(lat0, lng0, 400);
+
+        for(int k=0; k<3; k++) {
+            double eOff = 0, eDis = 0;
+
+            for(i=0; i<20000; i++) {
+                double  dn = geo_rand(-rMax[k], rMax[k]) / 111000.0;
+                double  de = geo_rand(-rMax[k], rMax[k]) / (111000.0 * cos(lat0*GEO_D2R));
+                double  oe, on, s;
+
+                lf.lla2enu(lat0 + dn, lng0 + de, 450, e, n, u);
+                lf.offset(lat0 + dn, lng0 + de, oe, on);
+                eOff = std::max(eOff, sqrt((oe-e)*(oe-e) + (on-n)*(on-n)));
+
+                geo_vincenty(lat0, lng0, lat0 + dn, lng0 + de, s);
+                eDis = std::max(eDis, fabs(sqrt(oe*oe + on*on) - s*(1.0 + 400.0/GEO_WGS84_A)));
+
+                lf.enu2lla(e, n, u, la, ln, h);
+                double dln = fmod(ln - lng0 - de + 540.0, 360.0) - 180.0;
+                eRt = std::max(eRt, fabs(h - 450) + (fabs(la - lat0 - dn) + fabs(dln)) * 111000.0);
+            }
+
+            printf("local frame %5.0f m: offset to ENU %.3f m (limit %.2f), distance to vincenty %.3f m\n",
+                   rMax[k], eOff, eMax[k], eDis);
+            if( eOff > eMax[k] ) err ++;
+        }
+
+        printf("local frame round trip: %.2e m\n", eRt);
+        if( eRt > 1e-3 ) err ++;
+
+        // batch equals the inline one
+        double  bla[5] = { lat0, lat0 + 0.01, lat0 - 0.02, lat0 + 0.003, lat0 };
+        double  bln[5] = { lng0, lng0 + 0.01, lng0 + 0.02, lng0 - 0.004, lng0 - 360.0 };
+        double  be[5], bn[5];
+
+        lf.offsetBatch(bla, bln, 5, be, bn);
+        for(i=0; i<5; i++) {
+            lf.offset(bla[i], bln[i], e, n);
+            if( fabs(e - be[i]) > 1e-9 || fabs(n - bn[i]) > 1e-9 ) {
+                printf("offsetBatch %d: %f %f / %f %f\n", i, be[i], bn[i], e, n);
+                err ++;
+            }
+        }
+    }
+
+    // throughput: points within 10 km of the origin (trail, fence, home distance)
+    {
+        std::vector<double>     la(nPoints), ln(nPoints), d(nPoints), d2(nPoints);
+        GeoLocalFrame           lf;
+        double                  tHav = 1e9, tHavB = 1e9, tVin = 1e9, tVinB = 1e9, tEnu = 1e9, tOff = 1e9;
+        double                  sum = 0, t0;
+        double                  e, n, u;
+
+        for(i=0; i<nPoints; i++) {
+            la[i] = lat0 + geo_rand(-0.09, 0.09);
+            ln[i] = lng0 + geo_rand(-0.11, 0.11);
+        }
+        lf.setOrigin(lat0, lng0, 0);
+
+        for(r=0; r<rep; r++) {
+            t0 = tm_get_millis();
+            for(i=0; i<nPoints; i++) d[i] = geo_haversine(lat0, lng0, la[i], ln[i]);
+            tHav = std::min(tHav, tm_get_millis() - t0);
+            sum += d[nPoints/2];
+
+            t0 = tm_get_millis();
+            geo_haversine_batch(lat0, lng0, &la[0], &ln[0], nPoints, &d[0]);
+            tHavB = std::min(tHavB, tm_get_millis() - t0);
+            sum += d[nPoints/2];
+
+            t0 = tm_get_millis();
+            for(i=0; i<nPoints; i++) geo_vincenty(lat0, lng0, la[i], ln[i], d[i]);
+            tVin = std::min(tVin, tm_get_millis() - t0);
+            sum += d[nPoints/2];
+
+            t0 = tm_get_millis();
+            geo_vincenty_batch(lat0, lng0, &la[0], &ln[0], nPoints, &d[0]);
+            tVinB = std::min(tVinB, tm_get_millis() - t0);
+            sum += d[nPoints/2];
+
+            t0 = tm_get_millis();
+            for(i=0; i<nPoints; i++) { lf.lla2enu(la[i], ln[i], 0, e, n, u); d[i] = e; }
+            tEnu = std::min(tEnu, tm_get_millis() - t0);
+            sum += d[nPoints/2];
+
+            t0 = tm_get_millis();
+            lf.offsetBatch(&la[0], &ln[0], nPoints, &d[0], &d2[0]);
+            tOff = std::min(tOff, tm_get_millis() - t0);
+            sum += d[nPoints/2];
+        }
+
+        double k = 1e6 / nPoints;
+        printf("ns/point: haversine %.1f, batch %.1f; vincenty %.1f, batch %.1f; "
+               "ENU exact %.1f, offset batch %.1f [%.0f]\n",
+               tHav*k, tHavB*k, tVin*k, tVinB*k, tEnu*k, tOff*k, fmod(sum, 10.0));
+    }
+
+    printf("errors = %d\n", err);
+
+    return err;
+}
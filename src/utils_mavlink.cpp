@@ -6,8 +6,20 @@
 
 #include <algorithm>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include <rtk_utils.h>
+#include <rtk_paramarray.h>
+
 #include "utils_mavlink.h"
 
+using namespace rtk;
+
 
 ////////////////////////////////////////////////////////////////////////////////
 /// enum to name
@@ -115,16 +127,37 @@ int mavlink_mav_mode_name(uint8_t mf, mavlink_nameList &nl)
     char        *name;
 
     m = 1;
-    for(i=0; i<7; i++) {
+    for(i=0; i<8; i++) {
         if( (mf & m) > 0 ) {
             mavlink_mav_mode_getName(i, &name);
             nl.push_back(name);
         }
+
+        m = m << 1;
     }
 
     return 0;
 }
 
+int mavlink_mav_mode_name(uint8_t mf, char *buf, int len)
+{
+    int     n = 0;
+
+    if( len <= 0 ) return 0;
+    buf[0] = 0;
+
+    for(int i=0; i<8; i++) {
+        if( (mf & (1 << i)) == 0 ) continue;
+
+        const char *name = g_mavlink_mav_mode_name[i];
+        if( n > 0 && n + 2 < len ) { buf[n++] = ','; buf[n++] = ' '; }
+        while( *name && n + 1 < len ) buf[n++] = *name++;
+    }
+    buf[n] = 0;
+
+    return n;
+}
+
 
 char g_mavlink_mav_state_name[][200] =
 {
@@ -149,6 +182,25 @@ int mavlink_mav_state_name(uint8_t ms, char **name)
     }
 }
 
+
+static const char *g_mavlink_gps_fix_name[] =
+{
+    "Not fixed",            // GPS_FIX_TYPE_NO_GPS
+    "Not fixed",            // GPS_FIX_TYPE_NO_FIX
+    "2D fixed",
+    "3D fixed",
+    "DGPS",
+    "RTK",
+};
+
+const char* mavlink_gps_fix_name(int fix)
+{
+    if( fix < 0 || fix >= (int) (sizeof(g_mavlink_gps_fix_name)/sizeof(g_mavlink_gps_fix_name[0])) )
+        return "";
+
+    return g_mavlink_gps_fix_name[fix];
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// MAV_SYS_STATUS_SENSOR
 ////////////////////////////////////////////////////////////////////////////////
@@ -249,6 +301,34 @@ int mavlink_sys_status_sensor_getName(uint32_t id, char **name)
     return -1;
 }
 
+/**
+ *  Sensor names indexed by bit number, built from the ID/name table
+ */
+struct MavlinkSensorNameTable
+{
+    const char  *name[32];
+
+    MavlinkSensorNameTable() {
+        for(int b=0; b<32; b++) name[b] = "";
+
+        for(int i=0; g_mavlink_sys_status_sensor_idname[i].id != MAV_SYS_STATUS_SENSOR_ENUM_END; i++) {
+            uint32_t id = g_mavlink_sys_status_sensor_idname[i].id;
+
+            for(int b=0; b<32; b++)
+                if( id == (1u << b) ) name[b] = g_mavlink_sys_status_sensor_idname[i].name;
+        }
+    }
+};
+
+static MavlinkSensorNameTable g_mavlinkSensorNameTable;
+
+const char* mavlink_sys_status_sensor_name(uint32_t id)
+{
+    if( id == 0 || (id & (id - 1)) != 0 ) return "";
+
+    return g_mavlinkSensorNameTable.name[__builtin_ctz(id)];
+}
+
 int mavlink_sys_status_sensor_getNames(mavlink_sys_status_sensor_list &l,
                                        mavlink_sys_status_sensor_namelist &nl)
 {
@@ -289,3 +369,1179 @@ int mavlink_sys_status_sensor_getID_Difference(mavlink_sys_status_sensor_list &l
 
     return 0;
 }
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// block frame scanner
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  CRC tables, T[0] is the byte table, T[k] is a byte followed by k zeros
+ */
+struct MavlinkCRCTable
+{
+    uint16_t    T[4][256];
+
+    MavlinkCRCTable() {
+        for(int i=0; i<256; i++) {
+            uint16_t crc = 0;
+            crc_accumulate((uint8_t) i, &crc);
+            T[0][i] = crc;
+        }
+
+        for(int k=1; k<4; k++) {
+            for(int i=0; i<256; i++)
+                T[k][i] = (T[k-1][i] >> 8) ^ T[0][T[k-1][i] & 0xff];
+        }
+    }
+};
+
+static MavlinkCRCTable  g_mavlinkCRCTable;
+
+static const uint8_t    g_mavlinkCRCExtra[256] = MAVLINK_MESSAGE_CRCS;
+static const uint8_t    g_mavlinkMsgLengths[256] = MAVLINK_MESSAGE_LENGTHS;
+
+
+uint16_t mavlink_crc_block(const uint8_t *p, int len, uint16_t crc)
+{
+    const uint16_t  (*T)[256] = g_mavlinkCRCTable.T;
+    uint32_t        v;
+
+    while( len >= 4 ) {
+        v = ((uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+             ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24)) ^ crc;
+
+        crc = T[3][v & 0xff] ^ T[2][(v >> 8) & 0xff] ^
+              T[1][(v >> 16) & 0xff] ^ T[0][v >> 24];
+
+        p   += 4;
+        len -= 4;
+    }
+
+    while( len-- > 0 ) crc = (crc >> 8) ^ T[0][(crc ^ *p++) & 0xff];
+
+    return crc;
+}
+
+/**
+ *  find the first byte equal to stx1 or stx2 in p[0..n), return -1 if not found
+ */
+static inline int mavlink_find_stx(const uint8_t *p, int n, uint8_t stx1, uint8_t stx2)
+{
+    int i = 0;
+
+#if defined(__AVX2__)
+    const __m256i s1_32 = _mm256_set1_epi8((char) stx1);
+    const __m256i s2_32 = _mm256_set1_epi8((char) stx2);
+
+    for(; i+32 <= n; i+=32) {
+        __m256i  v = _mm256_loadu_si256((const __m256i*)(p+i));
+        unsigned m = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, s1_32),
+                                                          _mm256_cmpeq_epi8(v, s2_32)));
+        if( m ) return i + __builtin_ctz(m);
+    }
+#endif
+
+#if defined(__SSE2__)
+    const __m128i s1_16 = _mm_set1_epi8((char) stx1);
+    const __m128i s2_16 = _mm_set1_epi8((char) stx2);
+
+    for(; i+16 <= n; i+=16) {
+        __m128i  v = _mm_loadu_si128((const __m128i*)(p+i));
+        unsigned m = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, s1_16),
+                                                    _mm_cmpeq_epi8(v, s2_16)));
+        if( m ) return i + __builtin_ctz(m);
+    }
+#endif
+
+    for(; i<n; i++) if( p[i] == stx1 || p[i] == stx2 ) return i;
+
+    return -1;
+}
+
+/**
+ *  msgid of the frame (header) at buf[0] is in the dialect
+ */
+static inline int mavlink_msgid_known(const uint8_t *buf)
+{
+    uint32_t    msgid;
+
+    if( buf[0] == MAVLINK_STX_V2 ) msgid = buf[7] | (buf[8] << 8) | (buf[9] << 16);
+    else                           msgid = buf[5];
+
+    return msgid < 256 && g_mavlinkMsgLengths[msgid] != 0;
+}
+
+int mavlink_frame_known(const mavlink_frame_span &f)
+{
+    return mavlink_msgid_known(f.p);
+}
+
+/**
+ *  check a MAVLink 1 candidate at buf[0]
+ *      (msgid not in the dialect: only the length in RESYNC_NEXT mode)
+ *
+ *  @return frame length (> 0), 0 - incomplete, -1 - bad header, -(k+1) - bad CRC byte at k
+ */
+static inline int mavlink_check_frame_v1(const uint8_t *buf, int len, int resync)
+{
+    int         pl, fl;
+    uint16_t    crc;
+
+    // wait for the header
+    if( MAVLINK_NUM_HEADER_BYTES > len ) return 0;
+    pl = buf[1];
+
+    fl = pl + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+
+    // resyncing at every STX gives more chances to random CRC matches,
+    //  so only messages of the dialect with their length are checked
+    if( resync == MAVLINK_SCAN_RESYNC_NEXT ) {
+        if( g_mavlinkMsgLengths[buf[5]] == 0 ) return fl > len ? 0 : fl;
+        if( g_mavlinkMsgLengths[buf[5]] != pl ) return -1;
+    }
+
+    // wait for the whole frame
+    if( fl > len ) return 0;
+
+    // check CRC (LEN .. payload, plus CRC_EXTRA of the msgid)
+    crc = mavlink_crc_block(buf+1, MAVLINK_CORE_HEADER_LEN + pl);
+#if MAVLINK_CRC_EXTRA
+    crc_accumulate(g_mavlinkCRCExtra[buf[5]], &crc);
+#endif
+
+    if( (crc & 0xff) != buf[6+pl] ) return -(6+pl+1);
+    if( (crc >> 8)   != buf[7+pl] ) return -(7+pl+1);
+
+    return fl;
+}
+
+/**
+ *  check a MAVLink 2 candidate at buf[0]
+ *      (msgid not in the dialect: only the header)
+ *
+ *  @return frame length (> 0), 0 - incomplete, -1 - bad frame
+ */
+static inline int mavlink_check_frame_v2(const uint8_t *buf, int len)
+{
+    int         pl, fl;
+    uint32_t    msgid;
+    uint16_t    crc;
+
+    // wait for the header
+    if( MAVLINK_V2_HEADER_LEN > len ) return 0;
+    pl    = buf[1];
+    msgid = buf[7] | (buf[8] << 8) | (buf[9] << 16);
+
+    // unknown incompat flags must not be parsed, payload can be truncated
+    if( (buf[2] & ~MAVLINK_V2_IFLAG_SIGNED) != 0 ) return -1;
+    if( msgid < 256 && pl > g_mavlinkMsgLengths[msgid] && g_mavlinkMsgLengths[msgid] != 0 ) return -1;
+
+    // wait for the whole frame
+    fl = MAVLINK_V2_HEADER_LEN + pl + MAVLINK_NUM_CHECKSUM_BYTES;
+    if( buf[2] & MAVLINK_V2_IFLAG_SIGNED ) fl += MAVLINK_V2_SIGNATURE_LEN;
+    if( fl > len ) return 0;
+
+    // CRC_EXTRA is only known for the messages of the dialect
+    if( msgid > 255 || g_mavlinkMsgLengths[msgid] == 0 ) return fl;
+
+    crc = mavlink_crc_block(buf+1, MAVLINK_V2_HEADER_LEN - 1 + pl);
+    crc_accumulate(g_mavlinkCRCExtra[msgid], &crc);
+
+    if( (crc & 0xff) != buf[MAVLINK_V2_HEADER_LEN+pl] ||
+        (crc >> 8)   != buf[MAVLINK_V2_HEADER_LEN+pl+1] ) return -1;
+
+    return fl;
+}
+
+/**
+ *  a checked frame begins inside the unknown msgid frame buf[0..fl)
+ *      (then its STX was a false one)
+ *
+ *  @return 1 - yes, 0 - no, -1 - incomplete
+ */
+static int mavlink_unknown_hides_frame(const uint8_t *buf, int len, int fl, int resync)
+{
+    int     p = 1, j, r;
+
+    while( p < fl ) {
+        j = mavlink_find_stx(buf+p, fl-p, MAVLINK_STX, MAVLINK_STX_V2);
+        if( j < 0 ) break;
+        p += j;
+
+        if( buf[p] == MAVLINK_STX ) r = mavlink_check_frame_v1(buf+p, len-p, resync);
+        else                        r = mavlink_check_frame_v2(buf+p, len-p);
+
+        if( r == 0 ) return -1;
+        if( r > 0 && mavlink_msgid_known(buf+p) ) return 1;
+        p ++;
+    }
+
+    return 0;
+}
+
+/**
+ *  the run beginning with an unknown msgid frame of length fl at buf[0]: the
+ *      frames must follow each other directly, end in a checked frame and
+ *      not hide a checked frame
+ *
+ *  @return end of the checked frame (> 0), 0 - incomplete, -1 - no such run
+ */
+static int mavlink_check_unknown_run(const uint8_t *buf, int len, int fl, int resync)
+{
+    int     p = 0, r = fl, h, k;
+
+    for(k=0; k<=MAVLINK_SCAN_UNKNOWN_RUN; k++) {
+        h = mavlink_unknown_hides_frame(buf+p, len-p, r, resync);
+        if( h != 0 ) return h < 0 ? 0 : -1;
+
+        p += r;
+        if( p >= len ) return 0;
+
+        if( buf[p] == MAVLINK_STX )
+            r = mavlink_check_frame_v1(buf+p, len-p, resync);
+        else if( buf[p] == MAVLINK_STX_V2 )
+            r = mavlink_check_frame_v2(buf+p, len-p);
+        else
+            return -1;
+
+        if( r <= 0 ) return r == 0 ? 0 : -1;
+        if( mavlink_msgid_known(buf+p) ) return p + r;
+    }
+
+    return -1;
+}
+
+/**
+ *  scan frames beginning before 'limit', return position where it stopped
+ *      (sync: the previous candidate ended at a frame, kept between calls)
+ */
+static int mavlink_frame_scan_limit(const uint8_t *buf, int len, int limit,
+                                    mavlink_frame_spans &spans, int resync,
+                                    mavlink_scan_stats *st, int *sync)
+{
+    mavlink_frame_span  f;
+    uint8_t             stx2;
+    int                 i = 0, j, r, known, runEnd = 0;
+
+    // compat mode only knows MAVLink 1
+    stx2 = (resync == MAVLINK_SCAN_RESYNC_COMPAT) ? MAVLINK_STX : MAVLINK_STX_V2;
+
+    while( i < limit ) {
+        // find STX candidate
+        j = mavlink_find_stx(buf+i, limit-i, MAVLINK_STX, stx2);
+        if( j < 0 ) {
+            if( st ) st->skipped += limit - i;
+            i = limit;
+            *sync = 0;
+            break;
+        }
+        if( st ) st->skipped += j;
+        if( j > 0 ) *sync = 0;
+        i += j;
+
+        if( buf[i] == MAVLINK_STX )
+            r = mavlink_check_frame_v1(buf+i, len-i, resync);
+        else
+            r = mavlink_check_frame_v2(buf+i, len-i);
+
+        // wait for more data
+        if( r == 0 ) break;
+
+        // unknown msgid (header complete if r != 0): an STX in garbage or in
+        //  a lost frame makes one easily, so only runs of them directly
+        //  behind a frame and ending in a checked frame are taken
+        known = mavlink_msgid_known(buf+i);
+        if( r > 0 && !known && i >= runEnd && resync == MAVLINK_SCAN_RESYNC_NEXT ) {
+            if( !*sync ) {
+                r = -1;
+            } else {
+                j = mavlink_check_unknown_run(buf+i, len-i, r, resync);
+                if( j == 0 ) break;
+
+                if( j < 0 ) r = -1;
+                else        runEnd = i + j;
+            }
+        }
+
+        if( r > 0 ) {
+            f.p   = buf + i;
+            f.len = r;
+            spans.push_back(f);
+
+            if( st ) {
+                if( known ) st->frames ++;
+                else        st->unknown ++;
+            }
+            i += r;
+            *sync = 1;
+        } else {
+            // unknown msgids can not be checked: not a checksum failure
+            if( st ) {
+                if( known ) st->crcErrors ++;
+                else if( resync == MAVLINK_SCAN_RESYNC_COMPAT ) st->unknown ++;
+            }
+            *sync = 0;
+
+            // mavlink_parse_char goes on at the first wrong CRC byte
+            if( resync == MAVLINK_SCAN_RESYNC_COMPAT && r < -1 )
+                j = -r - 1;
+            else
+                j = 1;
+
+            if( st ) st->skipped += j;
+            i += j;
+        }
+    }
+
+    return i;
+}
+
+int mavlink_frame_scan(const uint8_t *buf, int len, mavlink_frame_spans &spans,
+                       int resync, mavlink_scan_stats *st)
+{
+    int     sync = 0;
+
+    return mavlink_frame_scan_limit(buf, len, len, spans, resync, st, &sync);
+}
+
+int mavlink_frame_to_msg(const mavlink_frame_span &f, mavlink_message_t *msg)
+{
+    const uint8_t   *p = f.p;
+    uint8_t         *pp = (uint8_t*) _MAV_PAYLOAD_NON_CONST(msg);
+    int             pl = p[1];
+    uint32_t        msgid;
+
+    if( p[0] == MAVLINK_STX_V2 ) {
+        msgid = p[7] | (p[8] << 8) | (p[9] << 16);
+        if( msgid > 255 ) return -1;
+
+        msg->magic  = p[0];
+        msg->seq    = p[4];
+        msg->sysid  = p[5];
+        msg->compid = p[6];
+        msg->msgid  = msgid;
+
+        // restore truncated zero bytes
+        msg->len = std::max(pl, (int) g_mavlinkMsgLengths[msgid]);
+        memcpy(pp, p+MAVLINK_V2_HEADER_LEN, pl);
+        memset(pp+pl, 0, msg->len - pl);
+
+        pp[msg->len]   = p[MAVLINK_V2_HEADER_LEN+pl];
+        pp[msg->len+1] = p[MAVLINK_V2_HEADER_LEN+pl+1];
+        msg->checksum  = pp[msg->len] | (pp[msg->len+1] << 8);
+
+        return 0;
+    }
+
+    msg->magic  = p[0];
+    msg->len    = p[1];
+    msg->seq    = p[2];
+    msg->sysid  = p[3];
+    msg->compid = p[4];
+    msg->msgid  = p[5];
+
+    // payload followed by the two CRC bytes, like mavlink_parse_char
+    memcpy(pp, p+6, pl+2);
+    msg->checksum = p[6+pl] | (p[7+pl] << 8);
+
+    return 0;
+}
+
+
+MavlinkFrameScanner::MavlinkFrameScanner(int resync)
+{
+    m_resync = resync;
+    reset();
+}
+
+void MavlinkFrameScanner::reset(void)
+{
+    m_bufIdx   = 0;
+    m_carryLen = 0;
+    m_sync     = 0;
+
+    memset(&stats, 0, sizeof(stats));
+}
+
+int MavlinkFrameScanner::push(const uint8_t *buf, int len, mavlink_frame_spans &spans)
+{
+    uint8_t     *cb;
+    int         n, pos, off = 0;
+
+    spans.clear();
+
+    // finish frames begun in the carried bytes, with a window of new bytes
+    //  appended to them (enough to decide any frame starting there)
+    if( m_carryLen > 0 ) {
+        cb = m_buf[m_bufIdx];
+        n  = std::min(len, (int) SCAN_WINDOW);
+        memcpy(cb + m_carryLen, buf, n);
+
+        pos = mavlink_frame_scan_limit(cb, m_carryLen + n, m_carryLen,
+                                       spans, m_resync, &stats, &m_sync);
+
+        if( pos < m_carryLen ) {
+            // still incomplete, then all input was copied
+            m_bufIdx = 1 - m_bufIdx;
+            m_carryLen = m_carryLen + n - pos;
+            memcpy(m_buf[m_bufIdx], cb + pos, m_carryLen);
+            return spans.size();
+        }
+
+        off = pos - m_carryLen;
+        m_carryLen = 0;
+    }
+
+    // scan input directly
+    pos = off;
+    if( off < len )
+        pos = off + mavlink_frame_scan_limit(buf + off, len - off, len - off,
+                                             spans, m_resync, &stats, &m_sync);
+
+    // keep the tail (spans may point into current buffer, so use the other)
+    if( pos < len ) {
+        m_bufIdx = 1 - m_bufIdx;
+        m_carryLen = len - pos;
+        memcpy(m_buf[m_bufIdx], buf + pos, m_carryLen);
+    }
+
+    return spans.size();
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// MAVLink 2 framing & signing
+////////////////////////////////////////////////////////////////////////////////
+
+static const uint32_t g_sha256K[64] =
+{
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROR(x, n)    (((x) >> (n)) | ((x) << (32-(n))))
+
+static void mavlink_sha256_block(uint32_t *h, const uint8_t *b)
+{
+    uint32_t    w[64], a, bb, c, d, e, f, g, hh, t1, t2;
+    int         i;
+
+    for(i=0; i<16; i++)
+        w[i] = (b[4*i] << 24) | (b[4*i+1] << 16) | (b[4*i+2] << 8) | b[4*i+3];
+    for(i=16; i<64; i++)
+        w[i] = w[i-16] + w[i-7] +
+               (SHA256_ROR(w[i-15], 7) ^ SHA256_ROR(w[i-15], 18) ^ (w[i-15] >> 3)) +
+               (SHA256_ROR(w[i-2], 17) ^ SHA256_ROR(w[i-2], 19) ^ (w[i-2] >> 10));
+
+    a = h[0]; bb = h[1]; c = h[2]; d = h[3];
+    e = h[4]; f  = h[5]; g = h[6]; hh = h[7];
+
+    for(i=0; i<64; i++) {
+        t1 = hh + (SHA256_ROR(e, 6) ^ SHA256_ROR(e, 11) ^ SHA256_ROR(e, 25)) +
+             ((e & f) ^ (~e & g)) + g_sha256K[i] + w[i];
+        t2 = (SHA256_ROR(a, 2) ^ SHA256_ROR(a, 13) ^ SHA256_ROR(a, 22)) +
+             ((a & bb) ^ (a & c) ^ (bb & c));
+
+        hh = g; g = f; f = e; e = d + t1;
+        d = c; c = bb; bb = a; a = t1 + t2;
+    }
+
+    h[0] += a; h[1] += bb; h[2] += c; h[3] += d;
+    h[4] += e; h[5] += f;  h[6] += g; h[7] += hh;
+}
+
+void mavlink_sha256(const uint8_t *d, int len, uint8_t *out)
+{
+    uint32_t    h[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    uint8_t     b[128];
+    uint64_t    bits = (uint64_t) len * 8;
+    int         i, n;
+
+    for(i=0; i+64<=len; i+=64) mavlink_sha256_block(h, d+i);
+
+    // padding: 0x80, zeros, 64-bit big-endian bit length
+    n = len - i;
+    memset(b, 0, sizeof(b));
+    memcpy(b, d+i, n);
+    b[n] = 0x80;
+    n = (n + 1 + 8 <= 64) ? 64 : 128;
+    for(i=0; i<8; i++) b[n-1-i] = (uint8_t)(bits >> (8*i));
+
+    mavlink_sha256_block(h, b);
+    if( n == 128 ) mavlink_sha256_block(h, b+64);
+
+    for(i=0; i<8; i++) {
+        out[4*i]   = h[i] >> 24;
+        out[4*i+1] = h[i] >> 16;
+        out[4*i+2] = h[i] >> 8;
+        out[4*i+3] = h[i];
+    }
+}
+
+/**
+ *  48-bit signature: SHA-256(key + header + payload + CRC + link id + timestamp)
+ */
+static void mavlink_sign_frame(const uint8_t *key, const uint8_t *frame, int len, uint8_t *sig)
+{
+    uint8_t     b[32 + MAVLINK_V2_MAX_PACKET_LEN], h[32];
+
+    memcpy(b, key, 32);
+    memcpy(b+32, frame, len);
+    mavlink_sha256(b, 32+len, h);
+
+    memcpy(sig, h, 6);
+}
+
+void mavlink_signing_init(mavlink_signing *s)
+{
+    s->enabled       = 0;
+    memset(s->key, 0, sizeof(s->key));
+    s->linkID        = 0;
+    s->timestamp     = 0;
+    s->allowUnsigned = 0;
+
+    s->streams.clear();
+
+    s->nBadSignature = 0;
+    s->nReplay       = 0;
+    s->nUnsigned     = 0;
+}
+
+void mavlink_signing_set_key(mavlink_signing *s, const std::string &passphrase)
+{
+    if( passphrase.size() == 0 ) {
+        s->enabled = 0;
+        return;
+    }
+
+    mavlink_sha256((const uint8_t*) passphrase.c_str(), passphrase.size(), s->key);
+    s->enabled = 1;
+}
+
+int mavlink_frame_check_signature(const mavlink_frame_span &f, mavlink_signing *s)
+{
+    const uint8_t   *sig;
+    uint8_t         sc[6];
+    uint64_t        ts = 0;
+    uint32_t        sid;
+    int             i;
+
+    if( s == NULL || !s->enabled ) return 0;
+
+    if( mavlink_frame_version(f) == 1 || (f.p[2] & MAVLINK_V2_IFLAG_SIGNED) == 0 ) {
+        // RADIO_STATUS is injected unsigned by radios
+        if( s->allowUnsigned ||
+            (mavlink_frame_version(f) == 1 && f.p[5] == MAVLINK_MSG_ID_RADIO_STATUS) ||
+            (mavlink_frame_version(f) == 2 && f.p[7] == MAVLINK_MSG_ID_RADIO_STATUS &&
+             f.p[8] == 0 && f.p[9] == 0) ) return 0;
+
+        s->nUnsigned ++;
+        return -3;
+    }
+
+    sig = f.p + f.len - MAVLINK_V2_SIGNATURE_LEN;
+    mavlink_sign_frame(s->key, f.p, f.len - 6, sc);
+    if( memcmp(sc, sig+7, 6) != 0 ) {
+        s->nBadSignature ++;
+        return -1;
+    }
+
+    // timestamp must increase for each (link, sysid, compid) stream
+    for(i=0; i<6; i++) ts |= (uint64_t) sig[1+i] << (8*i);
+    sid = sig[0] | (f.p[5] << 8) | (f.p[6] << 16);
+
+    std::map<uint32_t, uint64_t>::iterator it = s->streams.find(sid);
+    if( it != s->streams.end() && ts <= it->second ) {
+        s->nReplay ++;
+        return -2;
+    }
+    s->streams[sid] = ts;
+
+    return 0;
+}
+
+int mavlink_msg_to_send_buffer_v2(uint8_t *buf, const mavlink_message_t *msg,
+                                  mavlink_signing *s)
+{
+    const uint8_t   *pp = (const uint8_t*) _MAV_PAYLOAD(msg);
+    uint8_t         *sig;
+    uint64_t        ts;
+    uint16_t        crc;
+    int             pl, n, i;
+
+    // truncate trailing zeros, the first payload byte is always sent
+    pl = msg->len;
+    while( pl > 1 && pp[pl-1] == 0 ) pl--;
+
+    buf[0] = MAVLINK_STX_V2;
+    buf[1] = pl;
+    buf[2] = (s != NULL && s->enabled) ? MAVLINK_V2_IFLAG_SIGNED : 0;
+    buf[3] = 0;
+    buf[4] = msg->seq;
+    buf[5] = msg->sysid;
+    buf[6] = msg->compid;
+    buf[7] = msg->msgid;
+    buf[8] = 0;
+    buf[9] = 0;
+    memcpy(buf+MAVLINK_V2_HEADER_LEN, pp, pl);
+
+    crc = mavlink_crc_block(buf+1, MAVLINK_V2_HEADER_LEN - 1 + pl);
+    crc_accumulate(g_mavlinkCRCExtra[msg->msgid], &crc);
+
+    n = MAVLINK_V2_HEADER_LEN + pl;
+    buf[n++] = crc & 0xff;
+    buf[n++] = crc >> 8;
+
+    if( buf[2] & MAVLINK_V2_IFLAG_SIGNED ) {
+        // 10 us units since 2015-01-01, increasing for every frame
+        ts = (tm_get_us() - 1420070400000000ULL) / 10;
+        if( ts <= s->timestamp ) ts = s->timestamp + 1;
+        s->timestamp = ts;
+
+        sig = buf + n;
+        sig[0] = s->linkID;
+        for(i=0; i<6; i++) sig[1+i] = (uint8_t)(ts >> (8*i));
+        mavlink_sign_frame(s->key, buf, n + 7, sig + 7);
+
+        n += MAVLINK_V2_SIGNATURE_LEN;
+    }
+
+    return n;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// frame scanner tests
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  frame of another dialect (MAVLink 1 msgid not in the dialect, or MAVLink 2
+ *  msgid >= 256), with its own CRC_EXTRA
+ */
+static int mavlink_scan_gen_unknown(uint8_t *fb, int v2, int seq)
+{
+    int         id, pl, hl, i;
+    uint16_t    crc;
+
+    pl = rand() % 256;
+
+    if( v2 ) {
+        id = 256 + rand() % 20000;
+        fb[0] = MAVLINK_STX_V2; fb[1] = pl;  fb[2] = 0;    fb[3] = 0;
+        fb[4] = seq;            fb[5] = 1;   fb[6] = 1;
+        fb[7] = id & 0xFF;      fb[8] = (id >> 8) & 0xFF;  fb[9] = id >> 16;
+        hl = MAVLINK_V2_HEADER_LEN;
+    } else {
+        do {
+            id = rand() % 256;
+        } while( g_mavlinkMsgLengths[id] != 0 );
+
+        fb[0] = MAVLINK_STX;    fb[1] = pl;  fb[2] = seq;
+        fb[3] = 1;              fb[4] = 1;   fb[5] = id;
+        hl = MAVLINK_NUM_HEADER_BYTES;
+    }
+
+    for(i=0; i<pl; i++) fb[hl+i] = rand() % 256;
+
+    crc = mavlink_crc_block(fb+1, hl - 1 + pl);
+    crc_accumulate(1 + rand() % 255, &crc);
+    fb[hl+pl]   = crc & 0xFF;
+    fb[hl+pl+1] = crc >> 8;
+
+    return hl + pl + 2;
+}
+
+/**
+ *  generate a random byte stream: good frames, corrupted frames and garbage
+ *  (garbage contains STX bytes on purpose), unknown % of the frames are
+ *  followed by one of another dialect
+ */
+static void mavlink_scan_gen_stream(std::vector<uint8_t> &s, int nFrames, int garbage,
+                                    int unknown = 0, int *nUnknown = NULL)
+{
+    mavlink_message_t   msg;
+    uint8_t             fb[MAVLINK_V2_MAX_PACKET_LEN];
+    int                 i, j, n, id, fl;
+
+    s.clear();
+    if( nUnknown ) *nUnknown = 0;
+
+    for(i=0; i<nFrames; i++) {
+        // random garbage
+        if( rand() % 100 < garbage ) {
+            n = rand() % 64;
+            for(j=0; j<n; j++)
+                s.push_back( rand()%8 == 0 ? MAVLINK_STX : rand()%256 );
+        }
+
+        // a few messages of another dialect (runs the scanner takes)
+        for(j=0; j<MAVLINK_SCAN_UNKNOWN_RUN && i > 0 && rand() % 100 < unknown; j++) {
+            fl = mavlink_scan_gen_unknown(fb, rand() % 2, i);
+            s.insert(s.end(), fb, fb + fl);
+            if( nUnknown ) (*nUnknown) ++;
+        }
+
+        // random message with known length
+        do {
+            id = rand() % 256;
+        } while( g_mavlinkMsgLengths[id] == 0 );
+
+        msg.msgid = id;
+        for(j=0; j<g_mavlinkMsgLengths[id]; j++)
+            _MAV_PAYLOAD_NON_CONST(&msg)[j] = rand() % 256;
+
+        mavlink_finalize_message_chan(&msg, rand()%256, rand()%256, MAVLINK_COMM_2,
+                                      g_mavlinkMsgLengths[id], g_mavlinkCRCExtra[id]);
+        fl = mavlink_msg_to_send_buffer(fb, &msg);
+
+        // corrupt some frames
+        if( rand() % 100 < garbage/4 ) fb[rand() % fl] ^= 1 << (rand()%8);
+        // truncate some frames
+        if( rand() % 100 < garbage/8 ) fl = rand() % fl;
+
+        for(j=0; j<fl; j++) s.push_back(fb[j]);
+    }
+
+    // flush frames waiting behind a false STX near the end
+    for(j=0; j<MAVLINK_MAX_PACKET_LEN; j++) s.push_back(0);
+}
+
+static int mavlink_msg_equal(const mavlink_message_t &a, const mavlink_message_t &b)
+{
+    if( a.magic != b.magic || a.len != b.len || a.seq != b.seq ||
+        a.sysid != b.sysid || a.compid != b.compid || a.msgid != b.msgid ||
+        a.checksum != b.checksum ) return 0;
+
+    return 0 == memcmp(_MAV_PAYLOAD(&a), _MAV_PAYLOAD(&b), a.len+2);
+}
+
+int test_mavlink_scan(CParamArray *pa)
+{
+    std::vector<uint8_t>            s;
+    std::vector<mavlink_message_t>  mRef, mCompat, mNext;
+    mavlink_message_t               msg;
+    mavlink_status_t                status;
+    mavlink_frame_spans             spans;
+    int                             round, nRound = 200;
+    int                             i, j, k, n, err = 0;
+
+    pa->i("n", nRound);
+
+    // CRC table against crc_calculate
+    for(i=0; i<1000; i++) {
+        uint8_t b[300];
+        n = rand() % 300;
+        for(j=0; j<n; j++) b[j] = rand() % 256;
+        if( mavlink_crc_block(b, n) != crc_calculate(b, n) ) err++;
+    }
+    if( err ) printf("CRC mismatch: %d\n", err);
+
+    for(round=0; round<nRound; round++) {
+        int nUnknown = 0;
+
+        mavlink_scan_gen_stream(s, 1 + rand()%200, round % 100, round % 3 ? 30 : 0, &nUnknown);
+
+        // reference parser
+        mRef.clear();
+        mavlink_reset_channel_status(MAVLINK_COMM_3);
+        for(i=0; i<s.size(); i++) {
+            if( mavlink_parse_char(MAVLINK_COMM_3, s[i], &msg, &status) )
+                mRef.push_back(msg);
+        }
+
+        // block scanners, pushed in random chunks
+        MavlinkFrameScanner scCompat(MAVLINK_SCAN_RESYNC_COMPAT),
+                            scNext(MAVLINK_SCAN_RESYNC_NEXT);
+
+        mCompat.clear();
+        mNext.clear();
+
+        for(i=0; i<s.size(); i+=n) {
+            n = std::min((int)(s.size() - i), 1 + rand() % 700);
+
+            scCompat.push(&s[i], n, spans);
+            for(j=0; j<spans.size(); j++) {
+                mavlink_frame_to_msg(spans[j], &msg);
+                mCompat.push_back(msg);
+            }
+
+            scNext.push(&s[i], n, spans);
+            for(j=0; j<spans.size(); j++) {
+                mavlink_frame_to_msg(spans[j], &msg);
+                mNext.push_back(msg);
+            }
+        }
+
+        // compat mode gives exactly the same messages
+        if( mCompat.size() != mRef.size() ) {
+            printf("round %d: compat %d msgs, reference %d msgs\n",
+                   round, (int) mCompat.size(), (int) mRef.size());
+            err++;
+        } else {
+            for(i=0; i<mRef.size(); i++) {
+                if( !mavlink_msg_equal(mRef[i], mCompat[i]) ) {
+                    printf("round %d: message %d differs\n", round, i);
+                    err++;
+                    break;
+                }
+            }
+        }
+
+        // next mode finds every reference message of the dialect (and maybe more)
+        for(i=0, k=0; i<mRef.size(); i++) {
+            if( mRef[i].len != g_mavlinkMsgLengths[mRef[i].msgid] ) continue;
+
+            while( k < mNext.size() && !mavlink_msg_equal(mRef[i], mNext[k]) ) k++;
+            if( k >= mNext.size() ) {
+                printf("round %d: next mode lost message %d\n", round, i);
+                err++;
+                break;
+            }
+            k++;
+        }
+
+        // clean stream: every frame of the other dialect, no checksum error
+        if( round % 100 == 0 &&
+            (scNext.stats.unknown != nUnknown || scNext.stats.crcErrors != 0 ||
+             scNext.stats.frames + scNext.stats.unknown != mNext.size()) ) {
+            printf("round %d: next mode %d unknown msgid frames (%d), %d CRC errors\n",
+                   round, (int) scNext.stats.unknown, nUnknown, (int) scNext.stats.crcErrors);
+            err++;
+        }
+    }
+
+    printf("rounds = %d, errors = %d\n", nRound, err);
+
+    return err;
+}
+
+int test_mavlink_scan_bench(CParamArray *pa)
+{
+    std::vector<uint8_t>    s;
+    mavlink_message_t       msg;
+    mavlink_status_t        status;
+    mavlink_frame_spans     spans;
+    int                     i, j, nFrames = 200000, garbage = 30, chunk = 512;
+    int                     n1 = 0, n2 = 0, n3 = 0;
+    ru64                    t0, t1, t2, t3;
+
+    pa->i("nFrames", nFrames);
+    pa->i("garbage", garbage);
+    pa->i("chunk",   chunk);
+
+    mavlink_scan_gen_stream(s, nFrames, garbage);
+
+    // byte-wise reference parser
+    mavlink_reset_channel_status(MAVLINK_COMM_3);
+    t0 = tm_get_us();
+    for(i=0; i<s.size(); i++) {
+        if( mavlink_parse_char(MAVLINK_COMM_3, s[i], &msg, &status) ) n1++;
+    }
+    t1 = tm_get_us();
+
+    // block scanners
+    MavlinkFrameScanner scCompat(MAVLINK_SCAN_RESYNC_COMPAT),
+                        scNext(MAVLINK_SCAN_RESYNC_NEXT);
+
+    for(i=0; i<s.size(); i+=chunk) {
+        scCompat.push(&s[i], std::min((int)(s.size()-i), chunk), spans);
+        for(j=0; j<spans.size(); j++) mavlink_frame_to_msg(spans[j], &msg);
+        n2 += spans.size();
+    }
+    t2 = tm_get_us();
+
+    for(i=0; i<s.size(); i+=chunk) {
+        scNext.push(&s[i], std::min((int)(s.size()-i), chunk), spans);
+        for(j=0; j<spans.size(); j++) mavlink_frame_to_msg(spans[j], &msg);
+        n3 += spans.size();
+    }
+    t3 = tm_get_us();
+
+    printf("stream: %d bytes, %d%% garbage\n", (int) s.size(), garbage);
+    printf("mavlink_parse_char     : %8.1f MB/s, %d msgs\n", 1.0*s.size()/(t1-t0), n1);
+    printf("scanner (resync compat): %8.1f MB/s, %d msgs\n", 1.0*s.size()/(t2-t1), n2);
+    printf("scanner (resync next)  : %8.1f MB/s, %d msgs\n", 1.0*s.size()/(t3-t2), n3);
+
+    return 0;
+}
+
+
+////////////////////////////////////////////////////////////////////////////////
+/// MAVLink 2 tests
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ *  messages of an ArduCopter stream (default stream rates), t in 10 ms steps
+ */
+void mavlink_gen_copter_msgs(std::vector<mavlink_message_t> &msgs, int seconds)
+{
+    mavlink_message_t   m;
+    int                 t, ms;
+    double              a;
+
+    msgs.clear();
+
+    for(t=0; t<seconds*100; t++) {
+        ms = t * 10;
+        a  = t * 0.01;
+
+        if( t % 100 == 0 ) {
+            mavlink_msg_heartbeat_pack(1, 1, &m, MAV_TYPE_QUADROTOR, MAV_AUTOPILOT_ARDUPILOTMEGA,
+                                       MAV_MODE_FLAG_CUSTOM_MODE_ENABLED|MAV_MODE_FLAG_SAFETY_ARMED,
+                                       5, MAV_STATE_ACTIVE);
+            msgs.push_back(m);
+            mavlink_msg_system_time_pack(1, 1, &m, 1500000000000000ULL + ms*1000ULL, ms);
+            msgs.push_back(m);
+            mavlink_msg_mission_current_pack(1, 1, &m, 0);
+            msgs.push_back(m);
+        }
+
+        if( t % 50 == 0 ) {
+            mavlink_msg_sys_status_pack(1, 1, &m, 0x0361fc2f, 0x0361fc2f, 0x0361fc2f,
+                                        230 + t%7, 12400 - t/100, 1240, 87, 0, 0, 0, 0, 0, 0);
+            msgs.push_back(m);
+            mavlink_msg_scaled_pressure_pack(1, 1, &m, ms, 1005.3 + 0.01*sin(a), 0, 3120);
+            msgs.push_back(m);
+        }
+
+        if( t % 20 == 0 ) {
+            mavlink_msg_gps_raw_int_pack(1, 1, &m, ms*1000ULL, 3,
+                                         343260000 + (int)(1000*sin(a)), 1089120000 + (int)(1000*cos(a)),
+                                         412000 + t, 121, 65535, 250 + t%11, 9000 + t%97, 12);
+            msgs.push_back(m);
+            mavlink_msg_nav_controller_output_pack(1, 1, &m, 0.02*sin(a), -0.01*cos(a), 90, 0, 0, 0, 0, 0);
+            msgs.push_back(m);
+        }
+
+        if( t % 25 == 0 ) {
+            mavlink_msg_vfr_hud_pack(1, 1, &m, 0, 2.5 + sin(a), 90 + (int)(10*sin(a)), 47,
+                                     20.5 + sin(a), 0.1*cos(a));
+            msgs.push_back(m);
+            mavlink_msg_rc_channels_raw_pack(1, 1, &m, ms, 0, 1500, 1500, 1450, 1500,
+                                             1100, 1900, 0, 0, 0);
+            msgs.push_back(m);
+            mavlink_msg_servo_output_raw_pack(1, 1, &m, ms*1000, 0, 1540 + t%13, 1520, 1530, 1545,
+                                              0, 0, 0, 0);
+            msgs.push_back(m);
+        }
+
+        if( t % 10 == 0 ) {
+            mavlink_msg_attitude_pack(1, 1, &m, ms, 0.05*sin(a), 0.03*cos(a), 1.57 + 0.1*sin(a),
+                                      0.01*cos(a), 0.01*sin(a), 0.002);
+            msgs.push_back(m);
+            mavlink_msg_global_position_int_pack(1, 1, &m, ms,
+                                                 343260000 + (int)(1000*sin(a)), 1089120000 + (int)(1000*cos(a)),
+                                                 412000 + t, 20500 + t, 250, -10, 3, 9000);
+            msgs.push_back(m);
+            mavlink_msg_raw_imu_pack(1, 1, &m, ms*1000ULL, 3, -2, -998, 1, 0, -1, 231, -45, 402);
+            msgs.push_back(m);
+        }
+    }
+}
+
+int test_mavlink_v2(CParamArray *pa)
+{
+    std::vector<mavlink_message_t>  msgs, msgsRecv;
+    std::vector<int>                sigRes;
+    std::vector<uint8_t>            s;
+    uint8_t                         fb[MAVLINK_V2_MAX_PACKET_LEN];
+    uint8_t                         h[32];
+    mavlink_message_t               msg;
+    mavlink_frame_spans             spans;
+    mavlink_signing                 sgTx, sgRx;
+    int                             i, j, n, fl, err = 0;
+
+    // SHA-256 test vectors
+    const uint8_t h_abc[4] = { 0xba, 0x78, 0x16, 0xbf };
+    const uint8_t h_448[4] = { 0x24, 0x8d, 0x6a, 0x61 };
+
+    mavlink_sha256((const uint8_t*) "abc", 3, h);
+    if( memcmp(h, h_abc, 4) != 0 ) { printf("SHA-256 (abc) wrong\n"); err++; }
+    mavlink_sha256((const uint8_t*) "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 56, h);
+    if( memcmp(h, h_448, 4) != 0 ) { printf("SHA-256 (448 bits) wrong\n"); err++; }
+
+    // mixed v1 / v2 / signed v2 stream with garbage
+    mavlink_signing_init(&sgTx);
+    mavlink_signing_init(&sgRx);
+    mavlink_signing_set_key(&sgTx, "FastGCS");
+    mavlink_signing_set_key(&sgRx, "FastGCS");
+
+    mavlink_gen_copter_msgs(msgs, 20);
+
+    for(i=0; i<msgs.size(); i++) {
+        if( rand() % 4 == 0 ) {
+            n = rand() % 32;
+            for(j=0; j<n; j++) s.push_back(rand() % 256);
+        }
+
+        switch( i % 3 ) {
+        case 0:  fl = mavlink_msg_to_send_buffer(fb, &msgs[i]);             break;
+        case 1:  fl = mavlink_msg_to_send_buffer_v2(fb, &msgs[i]);          break;
+        default: fl = mavlink_msg_to_send_buffer_v2(fb, &msgs[i], &sgTx);   break;
+        }
+
+        for(j=0; j<fl; j++) s.push_back(fb[j]);
+    }
+    for(j=0; j<MAVLINK_V2_MAX_PACKET_LEN; j++) s.push_back(0);
+
+    // receive, RADIO_STATUS is not in the stream, so allow unsigned v1 / v2
+    MavlinkFrameScanner sc;
+    sgRx.allowUnsigned = 1;
+
+    for(i=0; i<s.size(); i+=n) {
+        n = std::min((int)(s.size()-i), 1 + rand() % 300);
+        sc.push(&s[i], n, spans);
+
+        for(j=0; j<spans.size(); j++) {
+            sigRes.push_back(mavlink_frame_check_signature(spans[j], &sgRx));
+            if( 0 == mavlink_frame_to_msg(spans[j], &msg) ) msgsRecv.push_back(msg);
+        }
+    }
+
+    if( msgsRecv.size() != msgs.size() ) {
+        printf("received %d msgs, sent %d\n", (int) msgsRecv.size(), (int) msgs.size());
+        err++;
+    } else {
+        for(i=0; i<msgs.size(); i++) {
+            if( msgsRecv[i].msgid != msgs[i].msgid || msgsRecv[i].len != msgs[i].len ||
+                msgsRecv[i].sysid != msgs[i].sysid || msgsRecv[i].seq != msgs[i].seq ||
+                0 != memcmp(_MAV_PAYLOAD(&msgsRecv[i]), _MAV_PAYLOAD(&msgs[i]), msgs[i].len) ||
+                sigRes[i] != 0 ) {
+                printf("message %d (msgid %d) differs\n", i, msgs[i].msgid);
+                err++;
+                break;
+            }
+        }
+    }
+
+    // signature checks: replay, tamper, wrong key, unsigned
+    mavlink_frame_span  f;
+
+    fl = mavlink_msg_to_send_buffer_v2(fb, &msgs[0], &sgTx);
+    f.p = fb; f.len = fl;
+    if( mavlink_frame_check_signature(f, &sgRx) != 0 )  { printf("signed frame rejected\n"); err++; }
+    if( mavlink_frame_check_signature(f, &sgRx) != -2 ) { printf("replay accepted\n"); err++; }
+
+    fl = mavlink_msg_to_send_buffer_v2(fb, &msgs[1], &sgTx);
+    fb[MAVLINK_V2_HEADER_LEN] ^= 1;
+    f.p = fb; f.len = fl;
+    if( mavlink_frame_check_signature(f, &sgRx) != -1 ) { printf("tampered frame accepted\n"); err++; }
+
+    mavlink_signing_set_key(&sgRx, "wrong key");
+    fl = mavlink_msg_to_send_buffer_v2(fb, &msgs[2], &sgTx);
+    f.p = fb; f.len = fl;
+    if( mavlink_frame_check_signature(f, &sgRx) != -1 ) { printf("wrong key accepted\n"); err++; }
+
+    sgRx.allowUnsigned = 0;
+    fl = mavlink_msg_to_send_buffer_v2(fb, &msgs[3]);
+    f.p = fb; f.len = fl;
+    if( mavlink_frame_check_signature(f, &sgRx) != -3 ) { printf("unsigned frame accepted\n"); err++; }
+
+    printf("messages = %d, errors = %d\n", (int) msgs.size(), err);
+
+    return err;
+}
+
+int test_mavlink_v2_bench(CParamArray *pa)
+{
+    std::vector<mavlink_message_t>  msgs;
+    std::vector<uint8_t>            s[3];
+    std::string                     fn = "";
+    uint8_t                         fb[MAVLINK_V2_MAX_PACKET_LEN];
+    mavlink_message_t               msg;
+    mavlink_frame_spans             spans;
+    mavlink_signing                 sg;
+    int                             seconds = 600, rep = 10;
+    int                             i, j, k, fl, n;
+    ru64                            t0, t1;
+
+    const char *name[3] = { "MAVLink 1", "MAVLink 2", "MAVLink 2 signed" };
+
+    pa->s("fn", fn);
+    pa->i("seconds", seconds);
+    pa->i("rep", rep);
+
+    mavlink_signing_init(&sg);
+    mavlink_signing_set_key(&sg, "FastGCS");
+
+    // messages from a capture (tlog or raw bytes), or a generated ArduCopter stream
+    if( fn.size() > 0 ) {
+        FILE                    *fp;
+        std::vector<uint8_t>    cap;
+
+        fp = fopen(fn.c_str(), "rb");
+        if( fp == NULL ) {
+            printf("can not open capture: %s\n", fn.c_str());
+            return -1;
+        }
+        while( (n = fread(fb, 1, sizeof(fb), fp)) > 0 ) cap.insert(cap.end(), fb, fb+n);
+        fclose(fp);
+
+        mavlink_frame_scan(&cap[0], cap.size(), spans);
+        for(i=0; i<spans.size(); i++)
+            if( 0 == mavlink_frame_to_msg(spans[i], &msg) ) msgs.push_back(msg);
+    } else {
+        mavlink_gen_copter_msgs(msgs, seconds);
+    }
+
+    // serialize in the three formats
+    for(i=0; i<msgs.size(); i++) {
+        fl = mavlink_msg_to_send_buffer(fb, &msgs[i]);
+        s[0].insert(s[0].end(), fb, fb+fl);
+        fl = mavlink_msg_to_send_buffer_v2(fb, &msgs[i]);
+        s[1].insert(s[1].end(), fb, fb+fl);
+        fl = mavlink_msg_to_send_buffer_v2(fb, &msgs[i], &sg);
+        s[2].insert(s[2].end(), fb, fb+fl);
+    }
+
+    printf("%s: %d messages\n", fn.size() ? fn.c_str() : "generated ArduCopter stream",
+           (int) msgs.size());
+
+    for(k=0; k<3; k++) {
+        MavlinkFrameScanner sc;
+
+        n  = 0;
+        t0 = tm_get_us();
+        for(j=0; j<rep; j++) {
+            for(i=0; i<s[k].size(); i+=512) {
+                sc.push(&s[k][i], std::min((int)(s[k].size()-i), 512), spans);
+                for(int q=0; q<spans.size(); q++) {
+                    if( k == 2 ) mavlink_frame_check_signature(spans[q], NULL);
+                    mavlink_frame_to_msg(spans[q], &msg);
+                }
+                n += spans.size();
+            }
+        }
+        t1 = tm_get_us();
+
+        printf("%-17s: %9d bytes (%5.1f%%), %6.1f ns/msg\n", name[k], (int) s[k].size(),
+               100.0*s[k].size()/s[0].size(), 1000.0*(t1-t0)/n);
+    }
+
+    // signature verification cost
+    {
+        mavlink_frame_spans     sp;
+        mavlink_signing         sgRx;
+
+        mavlink_signing_init(&sgRx);
+        mavlink_signing_set_key(&sgRx, "FastGCS");
+
+        mavlink_frame_scan(&s[2][0], s[2].size(), sp);
+        t0 = tm_get_us();
+        for(i=0; i<sp.size(); i++) mavlink_frame_check_signature(sp[i], &sgRx);
+        t1 = tm_get_us();
+
+        printf("signature check  : %6.1f ns/msg (rejected %d)\n", 1000.0*(t1-t0)/sp.size(),
+               (int)(sgRx.nBadSignature + sgRx.nReplay + sgRx.nUnsigned));
+    }
+
+    return 0;
+}
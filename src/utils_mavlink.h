@@ -6,6 +6,7 @@
 #include <string>
 #include <list>
 #include <vector>
+#include <map>
 
 #include <mavlink/v1.0/common/mavlink.h>
 
@@ -19,6 +20,12 @@ int mavlink_mav_type_name(uint8_t mt, char **name);
 int mavlink_mav_mode_name(uint8_t mf, mavlink_nameList &nl);
 int mavlink_mav_state_name(uint8_t ms, char **name);
 
+/**
+ *  Allocation-free variants for per-frame use
+ */
+int mavlink_mav_mode_name(uint8_t mf, char *buf, int len);     ///< "Stabilize, Armed", returns length
+const char* mavlink_gps_fix_name(int fix);                      ///< "" if unknown
+
 ////////////////////////////////////////////////////////////////////////////////
 /// MAV_SYS_STATUS_SENSOR
 ////////////////////////////////////////////////////////////////////////////////
@@ -35,6 +42,7 @@ typedef  std::vector<std::string>  mavlink_sys_status_sensor_namelist;
 
 int mavlink_sys_status_sensor_getIDs(uint32_t s, mavlink_sys_status_sensor_list &l);
 int mavlink_sys_status_sensor_getName(uint32_t id, char **name);
+const char* mavlink_sys_status_sensor_name(uint32_t id);       ///< O(1), "" if unknown
 int mavlink_sys_status_sensor_getNames(mavlink_sys_status_sensor_list &l,
                                         mavlink_sys_status_sensor_namelist &nl);
 
@@ -44,78 +52,191 @@ int mavlink_sys_status_sensor_getID_Difference(mavlink_sys_status_sensor_list &l
 
 
 ////////////////////////////////////////////////////////////////////////////////
-/// utils
+/// block frame scanner
 ////////////////////////////////////////////////////////////////////////////////
 
+#define MAVLINK_STX_V2                  0xFD
+#define MAVLINK_V2_HEADER_LEN           10      ///< STX, LEN, IFLAGS, CFLAGS, SEQ, SYSID, COMPID, MSGID (3 bytes)
+#define MAVLINK_V2_SIGNATURE_LEN        13      ///< link id (1) + timestamp (6) + signature (6)
+#define MAVLINK_V2_MAX_PACKET_LEN       (MAVLINK_V2_HEADER_LEN + MAVLINK_MAX_PAYLOAD_LEN + \
+                                         MAVLINK_NUM_CHECKSUM_BYTES + MAVLINK_V2_SIGNATURE_LEN)
+
+#define MAVLINK_V2_IFLAG_SIGNED         0x01    ///< incompat flag: frame is signed
+
+/**
+ *  CRC-16/MCRF4XX (the X.25 checksum used by MAVLink) of a byte block,
+ *  table driven and sliced by 4. Same result as crc_accumulate() byte by byte.
+ */
+uint16_t mavlink_crc_block(const uint8_t *p, int len, uint16_t crc = X25_INIT_CRC);
+
+/**
+ *  A complete frame found by the scanner, it points into the scanned buffer
+ */
+struct mavlink_frame_span {
+    const uint8_t   *p;                     ///< frame begin (STX)
+    int             len;                    ///< frame length (header + payload + checksum)
+};
+
+typedef std::vector<mavlink_frame_span> mavlink_frame_spans;
+
+/**
+ *  How to go on after a STX candidate failed the checksum
+ */
+enum mavlink_scan_resync {
+    MAVLINK_SCAN_RESYNC_NEXT   = 0,         ///< retry from the byte after the bad STX,
+                                            ///<   only dialect messages with their length
+    MAVLINK_SCAN_RESYNC_COMPAT = 1,         ///< skip bytes like mavlink_parse_char()
+};
+
+#define MAVLINK_SCAN_UNKNOWN_RUN    8       ///< unknown msgid frames before a checked one
+
+struct mavlink_scan_stats {
+    uint64_t        frames;                 ///< good frames (checksum checked)
+    uint64_t        unknown;                ///< frames with a msgid not in the dialect
+                                            ///<   (no CRC_EXTRA, so no checksum check)
+    uint64_t        crcErrors;              ///< STX candidates with bad checksum
+    uint64_t        skipped;                ///< bytes not belonging to frames
+};
+
+/**
+ *  Scan a block of bytes for MAVLink 1 & 2 frames
+ *      (MAVLINK_SCAN_RESYNC_COMPAT only finds MAVLink 1 frames)
+ *
+ *  Frames with a msgid not in the dialect (other dialects, MAVLink 2 msgid
+ *  >= 256) can not be checked. MAVLINK_SCAN_RESYNC_NEXT returns them when
+ *  they follow a frame directly and are followed by at most
+ *  MAVLINK_SCAN_UNKNOWN_RUN such frames and a checked frame, so their
+ *  sequence numbers are seen (mavlink_frame_known() tells them apart).
+ *  MAVLINK_SCAN_RESYNC_COMPAT drops them as mavlink_parse_char() does.
+ *
+ *  @param buf      - input bytes
+ *  @param len      - input length
+ *  @param spans    - found frames are appended
+ *  @param resync   - resync mode (mavlink_scan_resync)
+ *  @param st       - statistics (can be NULL)
+ *
+ *  @return consumed bytes, buf[ret..len) is the begin of an incomplete frame
+ */
+int mavlink_frame_scan(const uint8_t *buf, int len, mavlink_frame_spans &spans,
+                       int resync = MAVLINK_SCAN_RESYNC_NEXT,
+                       mavlink_scan_stats *st = NULL);
+
+/**
+ *  Copy a frame into a message (same content as mavlink_parse_char gives),
+ *      truncated MAVLink 2 payload is filled with zeros
+ *
+ *  @return 0 - success, -1 - msgid can not be stored in mavlink_message_t
+ */
+int  mavlink_frame_to_msg(const mavlink_frame_span &f, mavlink_message_t *msg);
+
+/**
+ *  Frame msgid is in the dialect (length & CRC_EXTRA known, checksum checked)
+ */
+int  mavlink_frame_known(const mavlink_frame_span &f);
+
+/**
+ *  Frame protocol version (1 or 2)
+ */
+inline int mavlink_frame_version(const mavlink_frame_span &f) {
+    return f.p[0] == MAVLINK_STX_V2 ? 2 : 1;
+}
 
 /**
- *  Value averager
+ *  Streaming scanner, keeps incomplete frames between push() calls.
+ *      The spans point into the pushed buffer or into the scanner itself,
+ *      they are valid until the next push().
  */
-template<class T>
-class ValueAverager
+class MavlinkFrameScanner
 {
 public:
-    ValueAverager() {
-        init();
+    MavlinkFrameScanner(int resync = MAVLINK_SCAN_RESYNC_NEXT);
+    ~MavlinkFrameScanner() {}
 
-        valArray.resize(nMax);
-    }
+    int push(const uint8_t *buf, int len, mavlink_frame_spans &spans);
+    void reset(void);
 
-    ValueAverager(int n) {
-        init();
+public:
+    mavlink_scan_stats  stats;
 
-        nMax = n;
-        valArray.resize(nMax);
-    }
+protected:
+    // a frame is decided within this many bytes from its STX
+    enum { SCAN_WINDOW = (MAVLINK_SCAN_UNKNOWN_RUN + 2) * MAVLINK_V2_MAX_PACKET_LEN };
 
-    ~ValueAverager() {
-        init();
-    }
+    uint8_t             m_buf[2][2*SCAN_WINDOW];
+    int                 m_bufIdx;
+    int                 m_carryLen;
+    int                 m_resync;
+    int                 m_sync;                 ///< last candidate ended at a frame
+};
 
-    T push(T v) {
-        valArray[idx%nMax] = v;
-        num ++;
-        idx ++;
 
-        return calcAvg();
-    }
+////////////////////////////////////////////////////////////////////////////////
+/// MAVLink 2 framing
+///     Only the v1.0 dialect headers are in the tree, so MAVLink 2 frames are
+///     handled here. mavlink_message_t has an 8-bit msgid, messages with
+///     msgid >= 256 are skipped.
+////////////////////////////////////////////////////////////////////////////////
 
-    T calcAvg(void) {
-        T   avg;
-        int i;
+/**
+ *  Signing state of a link (MAVLink 2 message signing)
+ */
+struct mavlink_signing
+{
+    int                             enabled;        ///< secret key is set
+    uint8_t                         key[32];        ///< secret key
+    uint8_t                         linkID;         ///< link id of sent frames
+    uint64_t                        timestamp;      ///< last sent timestamp (10 us since 2015-01-01)
+    int                             allowUnsigned;  ///< accept unsigned frames when key is set
 
-        avg = 0;
-        if( idx < nMax ) {
-            for(i=0; i<idx; i++) avg += valArray[i];
+    std::map<uint32_t, uint64_t>    streams;        ///< last timestamp of (link, sysid, compid)
 
-            avg = avg / idx;
-        } else {
-            for(i=0; i<nMax; i++) avg += valArray[i];
+    uint64_t                        nBadSignature;  ///< rejected: wrong signature
+    uint64_t                        nReplay;        ///< rejected: old timestamp
+    uint64_t                        nUnsigned;      ///< rejected: not signed
+};
 
-            avg = avg / nMax;
-        }
+void mavlink_signing_init(mavlink_signing *s);
 
-        return avg;
-    }
+/**
+ *  Set secret key, the key is SHA-256 of the passphrase (as MAVProxy does)
+ */
+void mavlink_signing_set_key(mavlink_signing *s, const std::string &passphrase);
 
-    void setSize(int n) {
-        init();
+/**
+ *  Check signature of a received frame
+ *
+ *  @return 0 - accept, -1 - bad signature, -2 - replayed, -3 - unsigned
+ */
+int  mavlink_frame_check_signature(const mavlink_frame_span &f, mavlink_signing *s);
 
-        nMax = n;
-        valArray.resize(nMax);
-    }
+/**
+ *  Serialize a message as MAVLink 2 frame (trailing zero bytes of the payload
+ *      are truncated), signed if s is given and enabled
+ *
+ *  @return frame length
+ */
+int  mavlink_msg_to_send_buffer_v2(uint8_t *buf, const mavlink_message_t *msg,
+                                   mavlink_signing *s = NULL);
 
-    void init(void) {
-        nMax = 10;
-        num  = 0;
-        idx  = 0;
-        valArray.clear();
-    }
+/**
+ *  SHA-256 digest
+ */
+void mavlink_sha256(const uint8_t *d, int len, uint8_t *out);
 
-public:
-    int                 nMax, num, idx;
-    std::vector<T>      valArray;
-};
+/**
+ *  Messages of an ArduCopter stream (default stream rates), for the benchmarks
+ */
+void mavlink_gen_copter_msgs(std::vector<mavlink_message_t> &msgs, int seconds);
+
+
+namespace rtk {
+class CParamArray;
+}
+
+int test_mavlink_scan(rtk::CParamArray *pa);
+int test_mavlink_scan_bench(rtk::CParamArray *pa);
+int test_mavlink_v2(rtk::CParamArray *pa);
+int test_mavlink_v2_bench(rtk::CParamArray *pa);
 
 
 #endif // end of __MAVLINK_UTILS_H__
@@ -0,0 +1,87 @@
+#ifndef __UTILS_SIMLINK_H__
+#define __UTILS_SIMLINK_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <map>
+#include <algorithm>
+
+#include "utils_mavlink.h"
+
+////////////////////////////////////////////////////////////////////////////////
+/// Serial radio link in simulated time, for protocol tests & benchmarks
+///
+///     Each direction is serialized at bytesPerSec (a frame occupies the
+///     link even if it is lost), then delayed by latency + uniform jitter,
+///     without reordering. Loss is drawn from rand(), so srand() makes a
+///     run repeatable.
+///
+///         dir 0: GCS -> vehicle,  dir 1: vehicle -> GCS
+////////////////////////////////////////////////////////////////////////////////
+struct SimLink
+{
+    struct Pkt {
+        int                 dir;
+        mavlink_message_t   msg;
+    };
+
+    std::multimap<uint64_t, Pkt>    q;              ///< arrival time -> frame
+    uint64_t                        tNow, busy[2];  ///< us
+    uint64_t                        tLast[2];       ///< last arrival
+    double                          bytesPerSec, lossRate;
+    int                             latencyUs, jitterUs;
+    uint64_t                        nBytes[2], nLost;
+
+    SimLink(double bps, int latencyMs, int jitterMs, double loss) {
+        bytesPerSec = bps;
+        latencyUs   = latencyMs * 1000;
+        jitterUs    = jitterMs * 1000;
+        lossRate    = loss;
+        reset();
+    }
+
+    void reset(void) {
+        q.clear();
+        tNow        = 0;
+        busy[0]     = busy[1] = 0;
+        tLast[0]    = tLast[1] = 0;
+        nBytes[0]   = nBytes[1] = 0;
+        nLost       = 0;
+    }
+
+    void send(int dir, mavlink_message_t &msg) {
+        int         len = msg.len + MAVLINK_NUM_NON_PAYLOAD_BYTES;
+        uint64_t    t0 = std::max(tNow, busy[dir]);
+
+        busy[dir] = t0 + (uint64_t) (len * 1e6 / bytesPerSec);
+        nBytes[dir] += len;
+
+        if( rand() < lossRate * RAND_MAX ) { nLost ++; return; }
+
+        Pkt p;
+        p.dir = dir;
+        p.msg = msg;
+        tLast[dir] = std::max(tLast[dir], busy[dir] + latencyUs + (jitterUs > 0 ? rand() % jitterUs : 0));
+        q.insert(std::make_pair(tLast[dir], p));
+    }
+
+    ///
+    /// \brief Take the next frame arriving until tEnd (tNow is moved to its
+    ///     arrival), or move tNow to tEnd
+    /// \return 1 if a frame is taken
+    ///
+    int poll(uint64_t tEnd, Pkt &p) {
+        if( !q.empty() && q.begin()->first <= tEnd ) {
+            tNow = q.begin()->first;
+            p    = q.begin()->second;
+            q.erase(q.begin());
+            return 1;
+        }
+
+        tNow = tEnd;
+        return 0;
+    }
+};
+
+#endif // end of __UTILS_SIMLINK_H__